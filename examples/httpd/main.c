@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <string.h>
+
 #include "hardware/regs/clocks.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
@@ -15,8 +17,10 @@
 #include "lwip/init.h"
 
 #include "lwip/apps/httpd.h"
+#include "lwip/apps/fs.h"
 
 #include "rmii_ethernet/netif.h"
+#include "rmii_ethernet/stat.h"
 
 
 void netif_link_callback(struct netif *netif) {
@@ -28,6 +32,38 @@ void netif_status_callback(struct netif *netif) {
   printf("netif status changed %s\n", ip4addr_ntoa(netif_ip4_addr(netif)));
 }
 
+// GET /stat.json : driver statistics since boot (LWIP_HTTPD_CUSTOM_FILES, see CMakeLists.txt)
+// one response buffer, a request arriving while another is sent gets the newer snapshot
+static char stat_json[1280];
+
+int fs_open_custom(struct fs_file *file, const char *name) {
+  rmii_ethernet_stat_t snap;
+  int hdr, len;
+
+  if (strcmp(name, "/stat.json") != 0) {
+    return 0;
+  }
+
+  netif_rmii_ethernet_stat(&snap);
+  hdr = snprintf(stat_json, sizeof(stat_json),
+                 "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nCache-Control: no-cache\r\n\r\n");
+  len = netif_rmii_ethernet_stat_json(&snap, stat_json + hdr, sizeof(stat_json) - hdr);
+  if (len >= (int)sizeof(stat_json) - hdr) {
+    len = sizeof(stat_json) - hdr - 1;
+  }
+
+  memset(file, 0, sizeof(*file));
+  file->data = stat_json;
+  file->len = hdr + len;
+  file->index = file->len;
+  file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+  return 1;
+}
+
+void fs_close_custom(struct fs_file *file) {
+  (void)file;
+}
+
 extern void cli_init(void);
 extern void cli_run(void);
 
@@ -97,6 +133,9 @@ int main() {
   while (1) {
     tight_loop_contents();
     cli_run();
+#ifdef USE_RX_PIPELINE
+    netif_rmii_ethernet_poll(); // LwIP runs here, core1 only receives
+#endif
   }
 
   return 0;
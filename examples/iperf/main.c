@@ -16,6 +16,7 @@
 
 #include "lwip/apps/lwiperf.h"
 
+#include "rmii_ethernet/call.h"
 #include "rmii_ethernet/netif.h"
 
 void report(void *arg, enum lwiperf_report_type report_type,
@@ -26,6 +27,11 @@ void report(void *arg, enum lwiperf_report_type report_type,
 		   (int)report_type, ipaddr_ntoa(remote_addr), (int)remote_port, bytes_transferred, ms_duration, bandwidth_kbitpsec);
 }
 
+void iperf_start(void *arg)	// LwIP context
+{	(void)arg;
+	lwiperf_start_tcp_server_default(report, NULL);
+}
+
 void netif_link_callback(struct netif *netif)
 {	printf("netif link status changed %s\n",
 		   netif_is_link_up(netif) ? "up" : "down");
@@ -100,13 +106,18 @@ int main()
 	// This let's core 0 do other things :)
 	multicore_launch_core1(netif_rmii_ethernet_loop);
 
-	lwiperf_start_tcp_server_default(report, NULL);
+	// LwIP runs on core1 from now, core0 posts its calls (rmii_ethernet/call.h)
+	netif_rmii_ethernet_call_wait(iperf_start, NULL);
 	printf("iperf TCP server launched\n");
 
 	cli_init();
 	while (1)
 	{	tight_loop_contents();
 		cli_run();
+		netif_rmii_ethernet_call_poll();
+#ifdef USE_RX_PIPELINE
+		netif_rmii_ethernet_poll();	// LwIP runs here, core1 only receives
+#endif
 	}
 
 	return 0;
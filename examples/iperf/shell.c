@@ -12,6 +12,16 @@
 #include "pico/stdlib.h"
 #include "pico/bootrom.h"
 #include "hardware/watchdog.h"
+#include "hardware/structs/systick.h"
+#include "lwip/memp.h"
+#include "lwip/priv/memp_priv.h"
+#include "arch/sys_arch.h"
+
+#include "rmii_ethernet/call.h"
+#include "rmii_ethernet/capture.h"
+#include "rmii_ethernet/prio.h"
+#include "rmii_ethernet/stat.h"
+#include "rmii_ethernet/trace.h"
 
 #define LEN_CMDLINE 		40
 #define MAX_ARGV 			20
@@ -47,6 +57,147 @@ void cli_dload(int argc, char* argv[])
     reset_usb_boot (0, 0);
 }
 
+#ifdef USE_CHKSUM_OFFLOAD // lwipopts.h, sniffer is free (USE_RX_INLINE_FCS off), RX DMA never owns it
+void cli_chksum(int argc, char *argv[])
+{	// CPU cycles of IP checksum over a TCP segment, LwIP software vs DMA sniffer (src/fcs.c)
+	extern uint16_t lwip_standard_chksum(const void *dataptr, int len);
+	extern uint16_t fcs_chksum(const void *buf, int size);
+	static uint8_t	seg[1460 + 1];
+	int				len = (argc > 1) ? atoi(argv[1]) : 1460;
+	const int		loop = 100;
+
+	if (len < 0 || len > 1460)	{	len = 1460;	}
+	for (int i = 0; i < (int)sizeof(seg); i++)	{	seg[i] = (uint8_t)(i * 7 + 1);	}
+
+	systick_hw->rvr = 0x00ffffff;
+	systick_hw->csr = 0x05;			// processor clock, no interrupt
+
+	for (int odd = 0; odd < 2; odd++)
+	{	uint32_t	c0, c1, c2;
+		uint16_t	sw = 0, dma = 0;
+
+		c0 = systick_hw->cvr;
+		for (int i = 0; i < loop; i++)	{	sw = lwip_standard_chksum(seg + odd, len);	}
+		c1 = systick_hw->cvr;
+		for (int i = 0; i < loop; i++)	{	dma = fcs_chksum(seg + odd, len);	}
+		c2 = systick_hw->cvr;
+
+		// systick counts down, 24 bit
+		PRT("%4d bytes%s : LWIP %5d DMA %5d cycles %s", len, odd ? " (odd addr)" : "",
+			(int)(((c0 - c1) & 0x00ffffff) / loop), (int)(((c1 - c2) & 0x00ffffff) / loop), (sw == dma) ? "" : "MISMATCH");
+	}
+}
+#endif
+
+void cli_stat(int argc, char *argv[])
+{	// driver statistics since boot or last 'stat clr', copied without stopping RX core
+	static rmii_ethernet_stat_t	base;
+	static char					json[1536];
+	rmii_ethernet_stat_t		now;
+
+	netif_rmii_ethernet_stat(&now);
+	if (argc > 1 && strcmp(argv[1], "clr") == 0)
+	{	base = now;
+		PRT("Cleared");
+		return;
+	}
+
+	netif_rmii_ethernet_stat_sub(&now, &now, &base);
+	if (argc > 1 && strcmp(argv[1], "json") == 0)
+	{	netif_rmii_ethernet_stat_json(&now, json, sizeof(json));
+		puts(json);
+		return;
+	}
+	netif_rmii_ethernet_stat_prt(&now);
+}
+
+void cli_trace(int argc, char *argv[])
+{	// hot path trace (USE_RMII_TRACE), 'dump' output is input of host/trace_json
+	if (argc < 2)							{	netif_rmii_ethernet_trace_report();	}
+	else if (strcmp(argv[1], "on") == 0)	{	netif_rmii_ethernet_trace_on(1);	PRT("Trace restarted");	}
+	else if (strcmp(argv[1], "off") == 0)	{	netif_rmii_ethernet_trace_on(0);	PRT("Trace stopped");	}
+	else if (strcmp(argv[1], "dump") == 0)	{	netif_rmii_ethernet_trace_dump();	}
+	else									{	PRT("trace [on|off|dump]");	}
+}
+
+void cli_cap(int argc, char *argv[])
+{	// packet capture to console, write to a file by host/pcap_dump
+	rmii_ethernet_capture_t	cfg = RMII_ETHERNET_CAPTURE_DEFAULT();
+
+	if (argc < 2)						{	netif_rmii_ethernet_capture_prt();	return;	}
+	if (strcmp(argv[1], "stop") == 0)	{	netif_rmii_ethernet_capture_stop();	return;	}
+
+	cfg.dir = 0;
+	if (strstr(argv[1], "rx"))		{	cfg.dir |= RMII_CAP_RX;	}
+	if (strstr(argv[1], "tx"))		{	cfg.dir |= RMII_CAP_TX;	}
+	if (strstr(argv[1], "drop"))	{	cfg.dir |= RMII_CAP_DROP;	}
+	if (strstr(argv[1], "all"))		{	cfg.dir |= RMII_CAP_ALL;	}
+	if (cfg.dir == 0)
+	{	PRT("cap [rx,tx,drop|all|stop] [snap=N] [n=N] [type=HEX] [proto=N] [port=N]");
+		return;
+	}
+
+	for (int i = 2; i < argc; i++)
+	{	char	*val = strchr(argv[i], '=');
+
+		if (val == NULL)	{	continue;	}
+		val++;
+		if (strncmp(argv[i], "snap=", 5) == 0)	{	cfg.snap = atoi(val);	}
+		if (strncmp(argv[i], "n=", 2) == 0)		{	cfg.every = atoi(val);	}
+		if (strncmp(argv[i], "type=", 5) == 0)	{	cfg.type = strtoul(val, NULL, 16);	}
+		if (strncmp(argv[i], "proto=", 6) == 0)	{	cfg.proto = atoi(val);	}
+		if (strncmp(argv[i], "port=", 5) == 0)	{	cfg.port = atoi(val);	}
+	}
+	netif_rmii_ethernet_capture_start(&cfg);
+}
+
+static void prio_set(void *arg)	// LwIP context
+{	static const rmii_prio_rule_t	rule[] = RMII_PRIO_DEFAULT_RULES();
+	char							**argv = (char**)arg;
+
+	if (strcmp(argv[1], "off") == 0)		{	netif_rmii_ethernet_prio_rule(NULL, 0);	}
+	else if (strcmp(argv[1], "on") == 0)	{	netif_rmii_ethernet_prio_rule(rule, count_of(rule));	}
+	else if (argv[2] && argv[3])			{	netif_rmii_ethernet_prio_reserve(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]));	}
+}
+
+void cli_prio(int argc, char *argv[])
+{	// RX priority admission, 'off' drops by arrival only (as before classes)
+	if (argc > 1)	{	netif_rmii_ethernet_call_wait(prio_set, argv);	}
+	netif_rmii_ethernet_prio_prt();
+}
+
+void cli_lwip(int argc, char *argv[])
+{	// RAM of LwIP pools & heap of the profile built (RMII_LWIP_PROFILE), compare profiles by this total
+	// lwip_mutex per core : core0 takes none while it posts calls instead of calling LwIP (rmii_ethernet/call.h)
+	static const char	*name[] = {
+		#define LWIP_MEMPOOL(name, num, size, desc)	#name,
+		#include "lwip/priv/memp_std.h"
+	};
+	uint32_t				total = 0;
+#ifdef USE_LWIP_LOCK_STAT
+	sys_arch_lock_stat_t	lock[2];
+
+	sys_arch_lock_stat(lock, argc > 1 && strcmp(argv[1], "clr") == 0);
+	for (int i = 0; i < 2; i++)
+	{	PRT("LOCK CORE%d ENTER %u WAIT %u WAIT-US-MAX %u HOLD-US-AVG/MAX %u %u", i, (unsigned)lock[i].enter,
+			(unsigned)lock[i].wait, (unsigned)lock[i].wait_us_max,
+			(unsigned)(lock[i].enter ? lock[i].hold_us / lock[i].enter : 0), (unsigned)lock[i].hold_us_max);
+	}
+#else
+	PRT("LOCK off, define USE_LWIP_LOCK_STAT in src/lwip/arch/sys_arch.h");
+#endif
+	PRT("Profile %s, TCP_MSS %u WND %u SND_BUF %u", RMII_LWIP_PROFILE_NAME,
+		(unsigned)TCP_MSS, (unsigned)TCP_WND, (unsigned)TCP_SND_BUF);
+	for (int i = 0; i < MEMP_MAX; i++)
+	{	uint32_t	bytes = (uint32_t)memp_pools[i]->num * memp_pools[i]->size;
+
+		PRT("%-16s %4u x %5u = %6u", name[i], memp_pools[i]->num, memp_pools[i]->size, (unsigned)bytes);
+		total += bytes;
+	}
+	PRT("%-16s %21u", "MEM_SIZE", (unsigned)MEM_SIZE);
+	PRT("%-16s %21u", "total", (unsigned)(total + MEM_SIZE));
+}
+
 void cli_help(int argc, char *argv[])
 {	cli_cmd_t*	pcmd;
 
@@ -166,6 +317,14 @@ void cli_init()
 		{"help", cli_help, ": Show command list"},
 		{"dload", cli_dload, ": reboot to bootmode"},
 		{"reboot", cli_reboot, ": reboot"},
+		{"stat", cli_stat, ": [clr|json] driver statistics since boot or last clr"},
+		{"cap", cli_cap, ": [rx,tx,drop|all|stop] [snap=N] [n=N] [type=HEX] [proto=N] [port=N] pcapng to console, 1-in-N"},
+		{"prio", cli_prio, ": [on|off|CLASS RING SLOT] RX priority rules & headroom reserved per class"},
+		{"trace", cli_trace, ": [on|off|dump] hot path latency percentiles of last records, on clears"},
+		{"lwip", cli_lwip, ": [clr] lwip_mutex hold & wait per core, LwIP profile, RAM of pools & heap"},
+#ifdef USE_CHKSUM_OFFLOAD
+		{"chksum", cli_chksum, ": [len] cycles of IP checksum, LwIP vs DMA"},
+#endif
 	};
 
 	cli_add(cmd, count_of(cmd));
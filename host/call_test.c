@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Lock hold & wait of application core calling LwIP, shared lock vs call forwarding (src/call_ring.h)
+
+	call_test [options]
+		--calls <n>			stack calls of application thread (default 20000)
+		--call-ns <n>		work of a stack call (default 2000, tcp_write of a segment)
+		--frame-ns <n>		work of a received frame in LwIP thread (default 3000)
+		--hold-ns <n>		lwip_mutex hold per frame by LwIP thread (default 200, memp & pbuf ref)
+		--batch <n>			frames per RX batch (default 8, RX_POLL_BUDGET)
+
+	Two threads model the cores of netif_rmii_ethernet_loop() :
+		'LwIP core'		: RX batches, each frame takes the lock for hold-ns, then does frame-ns of work
+		'app core'		: issues stack calls of call-ns work
+	Models :
+		lock	: app core runs each call holding the same lock (lwip_mutex serializing both cores, before)
+		call	: app core posts each call, LwIP core runs calls after each RX batch (rmii_ethernet/call.h)
+	Reports per model : wait of app core (lock, or queue full), lock hold of app core, lock wait of LwIP core
+	& gap between RX batches. Needs 2 CPUs, on 1 CPU both models measure the scheduler.
+	Every call must run once & in order (exit 1 otherwise).
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "call_ring.h"
+
+#define TEST_SAMPLE			(1 << 16)			// samples kept per metric
+#define TEST_SPIN			256					// cpu_relax() rounds before a wait yields the CPU
+
+static struct
+{	uint64_t		calls;
+	uint32_t		call_ns;
+	uint32_t		frame_ns;
+	uint32_t		hold_ns;
+	int				batch;
+} s_opt = {	.calls = 20000, .call_ns = 2000, .frame_ns = 3000, .hold_ns = 200, .batch = 8	};
+
+typedef struct
+{	uint32_t		v[TEST_SAMPLE];
+	uint64_t		n;
+} test_sample_t;
+
+static pthread_mutex_t		s_lock = PTHREAD_MUTEX_INITIALIZER;
+static call_msg_t			s_slot[RMII_CALL_QUEUE];
+static call_ring_t			s_ring;
+static volatile int			s_stop;
+static uint64_t				s_run, s_bad;				// calls run & out of order, LwIP thread
+static test_sample_t		s_app_wait, s_app_hold, s_lwip_wait, s_gap;
+
+static uint64_t now_ns(void)
+{	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void work(uint32_t ns)
+{	uint64_t	end = now_ns() + ns;
+
+	while (now_ns() < end)	{	__asm__ volatile("" ::: "memory");	}
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ volatile("yield" ::: "memory");
+#else
+	__asm__ volatile("" ::: "memory");
+#endif
+}
+
+static void spin_wait(uint32_t *spin)			// LwIP core frees a slot in < 1 batch, spin first, yield when it is descheduled
+{	if (++*spin < TEST_SPIN)	{	cpu_relax();	}
+	else						{	sched_yield();	}
+}
+
+static void sample(test_sample_t *s, uint64_t v)
+{	s->v[s->n++ & (TEST_SAMPLE - 1)] = (v < UINT32_MAX) ? (uint32_t)v : UINT32_MAX;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{	uint32_t	x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+static void report(const char *name, test_sample_t *s)
+{	uint32_t	n = (s->n < TEST_SAMPLE) ? (uint32_t)s->n : TEST_SAMPLE;
+
+	if (n == 0)	{	printf("  %-10s %8s %8s %8s %10s\n", name, "-", "-", "-", "-");	return;	}
+	qsort(s->v, n, sizeof(s->v[0]), cmp_u32);
+	printf("  %-10s %8u %8u %8u %10u\n", name, (unsigned)s->v[n / 2], (unsigned)s->v[n * 99 / 100],
+		(unsigned)s->v[n - 1], (unsigned)s->n);
+}
+
+// ------------------------------------------------------------------
+// - Threads
+// ------------------------------------------------------------------
+static void stack_call(void *arg)				// LwIP thread in 'call' model
+{	if ((uint64_t)(uintptr_t)arg != s_run)	{	s_bad++;	}
+	work(s_opt.call_ns);
+	__atomic_store_n(&s_run, s_run + 1, __ATOMIC_RELEASE);
+}
+
+static void *lwip_thread(void *arg)
+{	uint64_t	last = now_ns();
+	(void)arg;
+
+	while (!s_stop)
+	{	uint64_t	t = now_ns();
+
+		sample(&s_gap, t - last);
+		last = t;
+		for (int i = 0; i < s_opt.batch; i++)
+		{	uint64_t	t0 = now_ns();
+
+			pthread_mutex_lock(&s_lock);
+			sample(&s_lwip_wait, now_ns() - t0);
+			work(s_opt.hold_ns);
+			pthread_mutex_unlock(&s_lock);
+			work(s_opt.frame_ns);
+		}
+		call_ring_run(&s_ring, RMII_CALL_QUEUE);	// like call_run() of netif_rmii_ethernet_poll()
+	}
+	call_ring_run(&s_ring, RMII_CALL_QUEUE);
+	return NULL;
+}
+
+static void app_thread(int forward)
+{	for (uint64_t i = 0; i < s_opt.calls; i++)
+	{	if (forward)
+		{	uint64_t	t0 = now_ns();
+			uint32_t	spin = 0;
+
+			while (!call_ring_put(&s_ring, stack_call, (void*)(uintptr_t)i))	{	spin_wait(&spin);	}
+			sample(&s_app_wait, now_ns() - t0);				// queue full, LwIP core is busy
+		}
+		else
+		{	uint64_t	t0 = now_ns(), t1;
+
+			pthread_mutex_lock(&s_lock);
+			t1 = now_ns();
+			sample(&s_app_wait, t1 - t0);
+			work(s_opt.call_ns);
+			s_run++;
+			sample(&s_app_hold, now_ns() - t1);
+			pthread_mutex_unlock(&s_lock);
+		}
+	}
+	uint32_t	spin = 0;
+
+	while (forward && __atomic_load_n(&s_run, __ATOMIC_RELAXED) < s_opt.calls)	{	spin_wait(&spin);	}
+}
+
+static int run(int forward)
+{	static const char	*name[] = {	"lock", "call"	};
+	pthread_t			lwip;
+	uint64_t			t0, t1;
+
+	memset(&s_app_wait, 0, sizeof(s_app_wait));
+	memset(&s_app_hold, 0, sizeof(s_app_hold));
+	memset(&s_lwip_wait, 0, sizeof(s_lwip_wait));
+	memset(&s_gap, 0, sizeof(s_gap));
+	call_ring_init(&s_ring, s_slot, RMII_CALL_QUEUE);
+	s_stop = 0;
+	s_run = s_bad = 0;
+
+	pthread_create(&lwip, NULL, lwip_thread, NULL);
+	t0 = now_ns();
+	app_thread(forward);
+	t1 = now_ns();
+	s_stop = 1;
+	pthread_join(lwip, NULL);
+
+	int		ok = (s_run == s_opt.calls && s_bad == 0);
+
+	printf("%s : %llu calls in %.1f ms, RUN %llu BAD-ORDER %llu => %s\n", name[forward], (unsigned long long)s_opt.calls,
+		(double)(t1 - t0) / 1e6, (unsigned long long)s_run, (unsigned long long)s_bad, ok ? "OK" : "FAIL");
+	printf("  %-10s %8s %8s %8s %10s\n", "NS", "P50", "P99", "MAX", "N");
+	report("app-wait", &s_app_wait);
+	report("app-hold", &s_app_hold);
+	report("lwip-wait", &s_lwip_wait);
+	report("batch-gap", &s_gap);
+	return ok ? 0 : 1;
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		i++;
+		if (strcmp(a, "--calls") == 0)			{	s_opt.calls = strtoull(v, NULL, 0);	}
+		else if (strcmp(a, "--call-ns") == 0)	{	s_opt.call_ns = atoi(v);			}
+		else if (strcmp(a, "--frame-ns") == 0)	{	s_opt.frame_ns = atoi(v);			}
+		else if (strcmp(a, "--hold-ns") == 0)	{	s_opt.hold_ns = atoi(v);			}
+		else if (strcmp(a, "--batch") == 0)		{	s_opt.batch = atoi(v);				}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+	}
+	if (s_opt.batch < 1)	{	fprintf(stderr, "bad --batch\n");	return 2;	}
+
+	return run(0) | run(1);
+}
@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Per frame cost of hot kernels of the driver over frame size mixes
+
+	kernel_bench [options]
+		--mix <name|all>		ack, imix, tcp, mtu, uniform (default all)
+		--kernel <name|all>		(default all)
+		--ms <n>				time of a measurement (default 50), best of --rep
+		--rep <n>				(default 5)
+		--seed <n>
+		--csv					machine readable output : mix,kernel,ns_frame,ns_byte,mb_s,check
+		--baseline <csv>		compare with saved --csv output, exit 1 if a kernel is slower than --tolerance
+		--tolerance <pct>		(default 25)
+		--fcs <name>			CRC32 backend of crc_frag & tx_build : table, slice4, slice8 (default, as driver without DMA)
+
+	Kernels (frame length of mix includes FCS)
+		crc_bit		: bit serial CRC32, model of DMA sniffer & reference of other CRC kernels
+		crc_table	: fcs_crc32_sw(), RX FCS check of USE_RX_INLINE_FCS (sniffer owned by RX DMA)
+		crc_s4		: fcs_crc32_s4_update(), slicing-by-4
+		crc_s8		: fcs_crc32_s8_update(), slicing-by-8
+		crc_frag	: fcs_crc32_update() over 54 bytes header + payload, TX pbuf chain of LwIP
+		crc_search	: CRC compared with next 4 bytes at each byte, '#if 0' end-of-frame search of rmii_ethernet.c
+		chksum		: fcs_chksum_sw() over IPv4 packet, checksum offload by software
+		rx_copy		: copy to PBUF_POOL, LwIP holds too many RX slots (rx_frame_input)
+		rx_ring		: rx_ring_put() + rx_ring_get() of ready ring
+		tx_build	: DMA descriptors & FCS of pbuf chain + padding (netif_rmii_ethernet_output)
+
+	CRC kernels & tx_build are checked against crc_bit, a mismatch exits 1.
+	Numbers are host nsec, compare runs of the same host & compiler flags only.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rx_ring.h"
+
+#include "rmii_ethernet/fcs.h"
+
+// ------------------------------------------------------------------
+// - Config, same as src/rmii_ethernet.c for RP2040
+// ------------------------------------------------------------------
+#define BENCH_FRAMES		4096				// frames of a mix, replayed until --ms
+#define BENCH_FRAME_LEN		1518				// max frame with FCS
+#define BENCH_MIN_LEN		60					// ETH_MIN_FRAME_LEN
+#define BENCH_HDR_LEN		54					// Ethernet + IPv4 + TCP header, first pbuf of LwIP TX
+#define BENCH_READY			64					// MAX_RX_READY
+#define BENCH_TX_DESC		(16+3)				// MAX_TX_DESC
+
+static struct
+{	const char*		mix;
+	const char*		kernel;
+	int				ms;
+	int				rep;
+	unsigned		seed;
+	int				csv;
+	const char*		baseline;
+	int				tolerance;
+	int				fcs;						// RMII_FCS_xxx
+} s_opt = {	.mix = "all", .kernel = "all", .ms = 50, .rep = 5, .seed = 1, .tolerance = 25, .fcs = RMII_FCS_SLICE8	};
+
+// ------------------------------------------------------------------
+// - Frame size mixes, length with FCS (same as rx_arena_bench)
+// ------------------------------------------------------------------
+typedef struct
+{	const char*		name;
+	int				n;
+	int				len[4];
+	int				weight[4];					// n == 0 : uniform 64 ~ 1518
+} mix_t;
+
+static const mix_t			s_mix[] =
+{	{	"ack",		1,	{	64	},				{	1	}			},
+	{	"imix",		3,	{	64, 594, 1518	},	{	7, 4, 1	}		},
+	{	"tcp",		2,	{	1518, 64	},		{	9, 1	}		},
+	{	"mtu",		1,	{	1518	},			{	1	}			},
+	{	"uniform",	0,	{	0	},				{	0	}			},
+};
+
+static int mix_len(const mix_t *m)
+{	int		sum = 0, r;
+
+	if (m->n == 0)	{	return 64 + rand() % (BENCH_FRAME_LEN - 64 + 1);	}
+
+	for (int i = 0; i < m->n; i++)	{	sum += m->weight[i];	}
+	r = rand() % sum;
+	for (int i = 0; i < m->n; i++)
+	{	if (r < m->weight[i])	{	return m->len[i];	}
+		r -= m->weight[i];
+	}
+	return m->len[0];
+}
+
+// ------------------------------------------------------------------
+// - Frames
+// ------------------------------------------------------------------
+typedef struct bench_pbuf
+{	struct bench_pbuf*	next;					// fields used by TX loop of struct pbuf
+	void*				payload;
+	uint16_t			len, tot_len;
+} bench_pbuf_t;
+
+typedef struct
+{	uint8_t*		data;						// frame + FCS
+	int				len;						// with FCS
+	uint32_t		fcs;						// crc_bit of len - 4 bytes
+	uint32_t		fcs_tx;						// crc_bit of TX frame padded to BENCH_MIN_LEN
+	bench_pbuf_t	pb[2];						// TX chain, header + payload
+} bench_frame_t;
+
+typedef struct
+{	uint32_t		len;						// rmii_hal_tx_desc_t
+	const void*		addr;
+} bench_desc_t;
+
+static bench_frame_t		s_frame[BENCH_FRAMES];
+static uint8_t				s_data[BENCH_FRAMES][BENCH_FRAME_LEN + 4];
+static uint8_t				s_pool[BENCH_FRAME_LEN];	// PBUF_POOL buffer of rx_copy
+static const uint8_t		s_tx_pad[BENCH_MIN_LEN];
+static void* volatile		s_ready_slot[BENCH_READY];
+static rx_ring_t			s_ready;
+static volatile uint32_t	s_sink;						// keeps results alive
+
+static uint32_t crc_bit(const uint8_t *buf, int size)	// reflected CRC32 a bit per step, like the sniffer
+{	uint32_t	crc = 0xffffffff;
+
+	while (size--)
+	{	crc ^= *buf++;
+		for (int i = 0; i < 8; i++)	{	crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));	}
+	}
+	return ~crc;
+}
+
+static void frame_init(const mix_t *m)
+{	srand(s_opt.seed);
+	for (int i = 0; i < BENCH_FRAMES; i++)
+	{	bench_frame_t	*f = &s_frame[i];
+		int				n;
+
+		f->data = s_data[i];
+		f->len = mix_len(m);
+		n = f->len - 4;
+		for (int k = 0; k < n; k++)	{	f->data[k] = rand();	}
+		f->data[12] = 0x08;						// IPv4, header length 20
+		f->data[13] = 0x00;
+		f->data[14] = 0x45;
+
+		f->fcs = crc_bit(f->data, n);
+		memcpy(&f->data[n], &f->fcs, 4);
+
+		// TX : LwIP frame without FCS, a minimal frame is a bare TCP ACK padded by driver
+		uint8_t		pad[BENCH_MIN_LEN] = {0};
+		int			tx = (n <= BENCH_MIN_LEN) ? BENCH_HDR_LEN : n;
+
+		memcpy(pad, f->data, BENCH_HDR_LEN);
+		f->fcs_tx = (tx < BENCH_MIN_LEN) ? crc_bit(pad, BENCH_MIN_LEN) : f->fcs;
+
+		f->pb[0] = (bench_pbuf_t){	.next = (tx > BENCH_HDR_LEN) ? &f->pb[1] : NULL, .payload = f->data, .len = BENCH_HDR_LEN, .tot_len = tx	};
+		f->pb[1] = (bench_pbuf_t){	.next = NULL, .payload = f->data + BENCH_HDR_LEN, .len = tx - BENCH_HDR_LEN, .tot_len = tx - BENCH_HDR_LEN	};
+	}
+}
+
+// ------------------------------------------------------------------
+// - Kernels
+// ------------------------------------------------------------------
+enum // result check
+{	CHECK_NONE = 0,
+	CHECK_FCS,									// == bench_frame_t.fcs
+	CHECK_FCS_TX,								// == bench_frame_t.fcs_tx
+	CHECK_LEN,									// == len - 4
+};
+
+static uint32_t k_crc_bit(bench_frame_t *f)		{	return crc_bit(f->data, f->len - 4);	}
+static uint32_t k_crc_table(bench_frame_t *f)	{	return fcs_crc32_sw(f->data, f->len - 4);	}
+
+static uint32_t k_crc_s4(bench_frame_t *f)		{	return fcs_crc32_s4_update(0, f->data, f->len - 4);	}
+static uint32_t k_crc_s8(bench_frame_t *f)		{	return fcs_crc32_s8_update(0, f->data, f->len - 4);	}
+
+static uint32_t k_crc_frag(bench_frame_t *f)
+{	uint32_t	crc = fcs_crc32_update(0, f->data, BENCH_HDR_LEN);
+
+	return fcs_crc32_update(crc, f->data + BENCH_HDR_LEN, f->len - 4 - BENCH_HDR_LEN);
+}
+
+static uint32_t k_crc_search(bench_frame_t *f)	// ethernet_frame_length() of rmii_ethernet.c
+{	extern const uint32_t crc32_tab[];
+	const uint8_t	*data = f->data;
+	uint32_t		crc = 0xffffffff, index = 0;
+	int				length = f->len;
+
+	while (--length >= 0)
+	{	crc = crc32_tab[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+		index++;
+
+		uint32_t	inverted_crc = ~crc;
+
+		if (memcmp(data, &inverted_crc, sizeof(inverted_crc)) == 0)	{	return index;	}
+	}
+	return 0;
+}
+
+static uint32_t k_chksum(bench_frame_t *f)		{	return fcs_chksum_sw(f->data + 14, f->len - 4 - 14);	}
+
+static uint32_t k_rx_copy(bench_frame_t *f)
+{	memcpy(s_pool, f->data, f->len - 4);
+	return s_pool[0];
+}
+
+static uint32_t k_rx_ring(bench_frame_t *f)
+{	rx_ring_put(&s_ready, f);
+	return ((bench_frame_t*)rx_ring_get(&s_ready))->len;
+}
+
+static uint32_t k_tx_build(bench_frame_t *f)	// loop of netif_rmii_ethernet_output()
+{	static bench_desc_t	descs[BENCH_TX_DESC];
+	static uint8_t		fcs[4];
+	bench_desc_t		*desc = descs;
+	uint32_t			tot_len = 0, crc = 0;
+
+	for (bench_pbuf_t *q = &f->pb[0]; q != NULL; q = q->next)
+	{	if (q->len)
+		{	desc->len = q->len;
+			desc->addr = q->payload;
+			desc++;
+
+			crc = fcs_crc32_update(crc, q->payload, q->len);
+			tot_len += q->len;
+		}
+		if (q->len == q->tot_len)	{	break;	}
+	}
+
+	if (tot_len < BENCH_MIN_LEN)
+	{	desc->len = BENCH_MIN_LEN - tot_len;
+		desc->addr = s_tx_pad;
+		desc++;
+
+		crc = fcs_crc32_update(crc, s_tx_pad, BENCH_MIN_LEN - tot_len);
+	}
+
+	memcpy(fcs, &crc, 4);
+	desc->len = 4;
+	desc->addr = fcs;
+	desc++;
+
+	desc->len = 0;
+	desc->addr = NULL;
+	return crc;
+}
+
+typedef struct
+{	const char*		name;
+	uint32_t		(*run)(bench_frame_t *f);
+	int				check;						// CHECK_xxx
+	int				hdr;						// bytes not processed per frame (for NS/BYTE)
+} kernel_t;
+
+static const kernel_t		s_kernel[] =
+{	{	"crc_bit",		k_crc_bit,		CHECK_FCS,		4	},
+	{	"crc_table",	k_crc_table,	CHECK_FCS,		4	},
+	{	"crc_s4",		k_crc_s4,		CHECK_FCS,		4	},
+	{	"crc_s8",		k_crc_s8,		CHECK_FCS,		4	},
+	{	"crc_frag",		k_crc_frag,		CHECK_FCS,		4	},
+	{	"crc_search",	k_crc_search,	CHECK_LEN,		0	},
+	{	"chksum",		k_chksum,		CHECK_NONE,		18	},
+	{	"rx_copy",		k_rx_copy,		CHECK_NONE,		4	},
+	{	"rx_ring",		k_rx_ring,		CHECK_NONE,		0	},
+	{	"tx_build",		k_tx_build,		CHECK_FCS_TX,	4	},
+};
+
+static int kernel_check(const kernel_t *k)		// 1 if every frame matches reference
+{	for (int i = 0; i < BENCH_FRAMES; i++)
+	{	bench_frame_t	*f = &s_frame[i];
+		uint32_t		v = k->run(f);
+
+		if (k->check == CHECK_FCS && v != f->fcs)				{	return 0;	}
+		if (k->check == CHECK_FCS_TX && v != f->fcs_tx)			{	return 0;	}
+		if (k->check == CHECK_LEN && v != (uint32_t)f->len - 4)	{	return 0;	}
+	}
+	return 1;
+}
+
+static double now_ns(void)
+{	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double kernel_time(const kernel_t *k, double *bytes_per_frame)	// best nsec per frame of --rep runs
+{	double		best = 0;
+	uint64_t	bytes = 0;
+
+	for (int i = 0; i < BENCH_FRAMES; i++)	{	bytes += s_frame[i].len - k->hdr;	}
+	*bytes_per_frame = (double)bytes / BENCH_FRAMES;
+
+	for (int r = 0; r < s_opt.rep; r++)
+	{	double		t0 = now_ns(), t1;
+		uint64_t	frames = 0;
+		uint32_t	sink = 0;
+
+		do
+		{	for (int i = 0; i < BENCH_FRAMES; i++)	{	sink += k->run(&s_frame[i]);	}
+			frames += BENCH_FRAMES;
+			t1 = now_ns();
+		} while (t1 - t0 < s_opt.ms * 1e6);
+
+		s_sink = sink;
+		if (r == 0 || (t1 - t0) / frames < best)	{	best = (t1 - t0) / frames;	}
+	}
+	return best;
+}
+
+// ------------------------------------------------------------------
+// - Baseline
+// ------------------------------------------------------------------
+#define BASE_MAX			256
+
+static struct
+{	char			mix[16], kernel[16];
+	double			ns;
+} s_base[BASE_MAX];
+static int					s_base_num;
+
+static int base_load(const char *path)
+{	FILE	*fp = fopen(path, "r");
+	char	line[256];
+
+	if (fp == NULL)	{	perror(path);	return 0;	}
+	while (fgets(line, sizeof(line), fp) != NULL && s_base_num < BASE_MAX)
+	{	if (sscanf(line, "%15[^,],%15[^,],%lf", s_base[s_base_num].mix, s_base[s_base_num].kernel, &s_base[s_base_num].ns) == 3)
+		{	s_base_num++;
+		}
+	}
+	fclose(fp);
+	return 1;
+}
+
+static double base_find(const char *mix, const char *kernel)	// 0 if not found
+{	for (int i = 0; i < s_base_num; i++)
+	{	if (strcmp(s_base[i].mix, mix) == 0 && strcmp(s_base[i].kernel, kernel) == 0)	{	return s_base[i].ns;	}
+	}
+	return 0;
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{	int		found = 0, fail = 0;
+
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(a, "--csv") == 0)			{	s_opt.csv = 1;	continue;	}
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		if (strcmp(a, "--mix") == 0)			{	s_opt.mix = v;	}
+		else if (strcmp(a, "--kernel") == 0)	{	s_opt.kernel = v;	}
+		else if (strcmp(a, "--ms") == 0)		{	s_opt.ms = atoi(v);	}
+		else if (strcmp(a, "--rep") == 0)		{	s_opt.rep = atoi(v);	}
+		else if (strcmp(a, "--seed") == 0)		{	s_opt.seed = atoi(v);	}
+		else if (strcmp(a, "--baseline") == 0)	{	s_opt.baseline = v;	}
+		else if (strcmp(a, "--tolerance") == 0)	{	s_opt.tolerance = atoi(v);	}
+		else if (strcmp(a, "--fcs") == 0)
+		{	for (s_opt.fcs = RMII_FCS_TABLE; s_opt.fcs < RMII_FCS_BACKEND && strcmp(v, fcs_crc32_name(s_opt.fcs)) != 0; s_opt.fcs++)	{	}
+			if (s_opt.fcs == RMII_FCS_BACKEND)	{	fprintf(stderr, "%s : unknown FCS backend\n", v);	return 2;	}
+		}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+		i++;
+	}
+	if (s_opt.ms < 1 || s_opt.rep < 1)				{	fprintf(stderr, "--ms, --rep : 1 or more\n");	return 2;	}
+	if (s_opt.baseline && !base_load(s_opt.baseline))	{	return 2;	}
+
+	rx_ring_init(&s_ready, s_ready_slot, BENCH_READY);
+	fcs_crc32_init(s_opt.fcs, 0);				// slicing tables of crc_s4 & crc_s8 too
+
+	if (s_opt.csv)	{	printf("mix,kernel,ns_frame,ns_byte,mb_s,check%s\n", s_opt.baseline ? ",base_pct" : "");	}
+	else			{	printf("MIX      KERNEL      NS/FRAME  NS/BYTE     MB/S  CHECK%s\n", s_opt.baseline ? "  BASE%" : "");	}
+
+	for (unsigned i = 0; i < sizeof(s_mix) / sizeof(s_mix[0]); i++)
+	{	if (strcmp(s_opt.mix, "all") != 0 && strcmp(s_opt.mix, s_mix[i].name) != 0)	{	continue;	}
+
+		frame_init(&s_mix[i]);
+		for (unsigned j = 0; j < sizeof(s_kernel) / sizeof(s_kernel[0]); j++)
+		{	const kernel_t	*k = &s_kernel[j];
+			const char		*check;
+			double			ns, bytes, base, pct = 0;
+
+			if (strcmp(s_opt.kernel, "all") != 0 && strcmp(s_opt.kernel, k->name) != 0)	{	continue;	}
+			found = 1;
+
+			check = (k->check == CHECK_NONE) ? "-" : kernel_check(k) ? "OK" : "MISMATCH";
+			if (check[0] == 'M')	{	fail = 1;	}
+
+			ns = kernel_time(k, &bytes);
+			if (s_opt.baseline && (base = base_find(s_mix[i].name, k->name)) > 0)
+			{	pct = (ns - base) * 100 / base;
+				if (pct > s_opt.tolerance)	{	fail = 1;	}
+			}
+
+			if (s_opt.csv)
+			{	printf("%s,%s,%.1f,%.3f,%.1f,%s", s_mix[i].name, k->name, ns, ns / bytes, bytes * 1e3 / ns, check);
+				if (s_opt.baseline)	{	printf(",%.1f", pct);	}
+			}
+			else
+			{	printf("%-8s %-10s %9.1f %8.3f %8.1f  %-8s", s_mix[i].name, k->name, ns, ns / bytes, bytes * 1e3 / ns, check);
+				if (s_opt.baseline)	{	printf(" %+6.1f%s", pct, (pct > s_opt.tolerance) ? " SLOWER" : "");	}
+			}
+			putchar('\n');
+		}
+	}
+	if (!found)	{	fprintf(stderr, "%s %s : unknown mix or kernel\n", s_opt.mix, s_opt.kernel);	return 2;	}
+
+	return fail;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Run the driver & LwIP on Linux through src/hal/rmii_hal_host.c
+
+	rmii_host					: in-process peer pings the driver (ARP + ICMP echo flood), then flaps the link & checks statistics
+	rmii_host hold				: LwIP keeps received pbufs, frames past RMII_RX_HELD are copied, lent slots come back by custom free
+	rmii_host tap <ifname>		: bridge to a TAP device & run iperf server
+								  ip link set <ifname> up; ip addr add 192.168.7.1/24 dev <ifname>
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/apps/lwiperf.h"
+
+#include "rmii_ethernet/call.h"
+#include "rmii_ethernet/depth.h"
+#include "rmii_ethernet/netif.h"
+#include "rmii_ethernet/stat.h"
+
+#include "hal/rmii_hal.h"
+
+#define PEER_COUNT			10000		// ICMP echo requests sent by in-process peer
+#define HOLD_MAX			64			// frames kept by 'hold' test at most
+#define HOLD_COPY			4			// copied frames seen before 'hold' test releases
+#define HOLD_LEN			100			// frame length without FCS
+
+static const uint8_t	s_peer_mac[6] = {	0x02, 0x00, 0x00, 0x00, 0x00, 0x01	};
+static const uint8_t	s_peer_ip[4] = {	192, 168, 7, 1	};
+static const uint8_t	s_dut_ip[4] = {	192, 168, 7, 2	};
+static uint8_t			s_dut_mac[6];
+static volatile int		s_peer_reply;
+static int				s_stat_torn;		// snapshots taken during flood with partial event
+static struct pbuf*		s_hold[HOLD_MAX];	// pbufs kept by hold_input(), LwIP context
+static volatile int		s_hold_num, s_hold_lent, s_hold_freed;
+static pbuf_free_custom_fn	s_hold_free;	// custom free of driver, called by hold_free()
+
+// ------------------------------------------------------------------
+// - In-process peer
+// ------------------------------------------------------------------
+
+static uint16_t peer_chksum(const uint8_t *buf, int len)
+{	uint32_t	sum = 0;
+
+	for (int i = 0; i < len - 1; i += 2)	{	sum += (buf[i] << 8) | buf[i+1];	}
+	if (len & 1)							{	sum += buf[len-1] << 8;	}
+	while (sum >> 16)						{	sum = (sum & 0xffff) + (sum >> 16);	}
+
+	return ~sum;
+}
+
+static void peer_rx(const uint8_t *frame, int len)
+{	// called in TX DMA thread with frames sent by the driver
+	uint8_t		out[64];
+
+	if (len < 42)	{	return;	}
+
+	if (frame[12] == 0x08 && frame[13] == 0x06 && frame[21] == 1 && memcmp(&frame[38], s_peer_ip, 4) == 0)
+	{	// ARP request for peer, reply
+		memcpy(&out[0], &frame[6], 6);
+		memcpy(&out[6], s_peer_mac, 6);
+		memcpy(&out[12], &frame[12], 8);			// type, htype, ptype, hlen, plen, (op)
+		out[21] = 2;
+		memcpy(&out[22], s_peer_mac, 6);
+		memcpy(&out[28], s_peer_ip, 4);
+		memcpy(&out[32], &frame[22], 10);			// sender of request
+		rmii_hal_host_peer_send(out, 42);
+	}
+	else if (frame[12] == 0x08 && frame[13] == 0x00 && frame[23] == 1 && frame[34] == 0)
+	{	s_peer_reply++;								// ICMP echo reply
+	}
+}
+
+static void peer_ping(uint16_t seq)
+{	uint8_t		f[14 + 20 + 8 + 32];
+
+	memset(f, 0, sizeof(f));
+	memcpy(&f[0], s_dut_mac, 6);
+	memcpy(&f[6], s_peer_mac, 6);
+	f[12] = 0x08;	f[13] = 0x00;
+
+	uint8_t		*ip = &f[14];
+	ip[0] = 0x45;	ip[3] = 20 + 8 + 32;	ip[8] = 64;		ip[9] = 1;
+	memcpy(&ip[12], s_peer_ip, 4);
+	memcpy(&ip[16], s_dut_ip, 4);
+	uint16_t	sum = peer_chksum(ip, 20);
+	ip[10] = sum >> 8;	ip[11] = sum;
+
+	uint8_t		*icmp = &ip[20];
+	icmp[0] = 8;	icmp[6] = seq >> 8;		icmp[7] = seq;
+	for (int i = 0; i < 32; i++)	{	icmp[8+i] = i;	}
+	sum = peer_chksum(icmp, 8 + 32);
+	icmp[2] = sum >> 8;	icmp[3] = sum;
+
+	rmii_hal_host_peer_send(f, sizeof(f));
+}
+
+static int peer_link_flap(void)
+{	// 10ms flap is shorter than link poll, seen by latched low link status of BMSR
+	int			n = s_peer_reply;
+
+	rmii_hal_host_set_link(0);
+	usleep(10000);
+	rmii_hal_host_set_link(1);
+
+	uint32_t	start = rmii_hal_time_us();
+
+	for (int i = 0; i < 3000 && s_peer_reply == n; i++)	{	peer_ping(PEER_COUNT + i);	usleep(1000);	}
+	if (s_peer_reply == n)	{	printf("PEER link flap, no reply\n");	return 0;	}
+
+	printf("PEER link flap, ICMP replied in %u ms\n", (rmii_hal_time_us() - start) / 1000);
+	return 1;
+}
+
+static int peer_stat_consistent(void)
+{	// events counted by several fields are seen all or none by snapshot
+	rmii_ethernet_stat_t	snap;
+	uint32_t				batch = 0, tx = 0;
+
+	netif_rmii_ethernet_stat(&snap);
+	for (int i = 0; i < RMII_STAT_BATCH_BINS; i++)	{	batch += snap.batch_hist[i];	}
+	for (int i = 0; i < RMII_STAT_SIZE_BINS; i++)	{	tx += snap.tx_size[i];	}
+
+	return batch == snap.batch && tx == snap.tx_ok;
+}
+
+static void *peer_thread(void *arg)
+{	(void)arg;
+
+	sleep(2);	// wait link up by netif_rmii_ethernet_poll()
+
+	uint32_t	start = rmii_hal_time_us();
+
+	for (int i = 0; i < PEER_COUNT; i++)
+	{	peer_ping(i);
+		while (i - s_peer_reply > 2)	{	usleep(10);	}	// keep a few requests in flight
+		if ((i & 15) == 0)	{	s_stat_torn += !peer_stat_consistent();	}
+	}
+	sleep(1);
+
+	uint32_t	elapsed = rmii_hal_time_us() - start;
+	int			replied = s_peer_reply;
+
+	printf("PEER ICMP %d sent %d replied in %u ms\n", PEER_COUNT, replied, elapsed / 1000);
+
+	int			flap_ok = peer_link_flap();
+
+	// snapshot while driver threads run, each echo request (74+4 bytes) is counted once
+	rmii_ethernet_stat_t	snap;
+
+	netif_rmii_ethernet_stat(&snap);
+	netif_rmii_ethernet_stat_prt(&snap);
+	int			stat_ok = (snap.rx_size[1] >= (uint32_t)replied && snap.link_down == 1 && s_stat_torn == 0);
+
+	printf("PEER driver stat %s, torn snapshot %d\n", stat_ok ? "OK" : "MISMATCH", s_stat_torn);
+	rmii_hal_host_stat_prt();
+	exit((replied == PEER_COUNT && flap_ok && stat_ok) ? 0 : 1);
+}
+
+// ------------------------------------------------------------------
+// - Hold test, LwIP keeps RX slots (TCP out-of-order queue...)
+// ------------------------------------------------------------------
+static void hold_free(struct pbuf *p)		// LwIP context, lent slot goes back to driver
+{	s_hold_freed++;
+	s_hold_free(p);
+}
+
+static err_t hold_input(struct pbuf *p, struct netif *netif)	// netif->input, keeps every frame
+{	(void)netif;
+
+	if (p->flags & PBUF_FLAG_IS_CUSTOM)
+	{	struct pbuf_custom	*pc = (struct pbuf_custom*)p;
+
+		s_hold_free = pc->custom_free_function;
+		pc->custom_free_function = hold_free;
+		s_hold_lent++;
+	}
+	if (s_hold_num == HOLD_MAX)	{	pbuf_free(p);	}
+	else						{	s_hold[s_hold_num] = p;	}
+	s_hold_num++;
+	return ERR_OK;
+}
+
+static void hold_release(void *arg)			// LwIP context, posted by hold_release_wait()
+{	for (int i = 0; i < s_hold_num && i < HOLD_MAX; i++)	{	pbuf_free(s_hold[i]);	}
+	s_hold_num = 0;
+	__atomic_store_n((int*)arg, 1, __ATOMIC_RELEASE);
+}
+
+static void hold_release_wait(void)
+{	// not netif_rmii_ethernet_call_wait(), it runs at once with USE_RX_PIPELINE but this thread is not LwIP context
+	int		done = 0;
+
+	while (!netif_rmii_ethernet_call(hold_release, &done))	{	usleep(100);	}
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE))		{	usleep(100);	}
+}
+
+static int hold_round(int max, int copy_stop, int *lent, int *copied)
+{	// send frames one by one until 'max' or 'copy_stop' copied, return frames with a wrong copy count
+	uint8_t		f[HOLD_LEN];
+	int			bad = 0;
+
+	memset(f, 0, sizeof(f));
+	memcpy(&f[0], s_dut_mac, 6);
+	memcpy(&f[6], s_peer_mac, 6);
+	f[12] = 0x88;	f[13] = 0xb5;				// local experimental, never passed beyond hold_input()
+	*lent = *copied = 0;
+
+	for (int i = 0; i < max && *copied < copy_stop; i++)
+	{	rmii_ethernet_stat_t	s0, s1;
+		int						n = s_hold_num, l = s_hold_lent;
+
+		netif_rmii_ethernet_stat(&s0);
+		f[14] = i;
+		rmii_hal_host_peer_send(f, sizeof(f));
+		for (int t = 0; t < 1000 && s_hold_num == n; t++)	{	usleep(1000);	}
+		if (s_hold_num == n)	{	printf("HOLD frame %d lost\n", i);	return bad + 1;	}
+		netif_rmii_ethernet_stat(&s1);
+
+		uint32_t	copy = s1.rx_copy - s0.rx_copy, bytes = s1.rx_copy_bytes - s0.rx_copy_bytes;
+
+		if (s_hold_lent != l)
+		{	(*lent)++;
+			bad += (copy != 0 || bytes != 0 || *copied != 0);	// lent after a copy : held count is wrong
+		}
+		else
+		{	(*copied)++;
+			bad += (copy != 1 || bytes != HOLD_LEN);
+		}
+	}
+	return bad;
+}
+
+static void *hold_thread(void *arg)
+{	int		lent, copied, relent, recopied, bad;
+	(void)arg;
+
+	sleep(2);	// wait link up by netif_rmii_ethernet_poll()
+
+	bad = hold_round(HOLD_MAX, HOLD_COPY, &lent, &copied);
+	hold_release_wait();
+	printf("HOLD lent %d (RMII_RX_HELD %d) then copied %d, freed by custom free %d\n", lent, RMII_RX_HELD, copied, s_hold_freed);
+	bad += (copied != HOLD_COPY || s_hold_freed != lent);
+
+	// every slot is back : same number is lent again
+	bad += hold_round(lent, 1, &relent, &recopied);
+	hold_release_wait();
+	printf("HOLD lent %d again, freed by custom free %d\n", relent, s_hold_freed);
+	bad += (relent != lent || s_hold_freed != 2 * lent);
+
+	printf("HOLD %s\n", (bad == 0) ? "OK" : "FAIL");
+	exit((bad == 0) ? 0 : 1);
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+
+static void report(void *arg, enum lwiperf_report_type report_type,
+			const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr, u16_t remote_port,
+			u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec)
+{
+	printf("IPERF report: type=%d, remote: %s:%d, total bytes: %" U32_F ", duration in ms: %" U32_F ", kbits/s: %" U32_F "\n",
+		   (int)report_type, ipaddr_ntoa(remote_addr), (int)remote_port, bytes_transferred, ms_duration, bandwidth_kbitpsec);
+}
+
+#ifdef USE_RX_PIPELINE
+static void *rx_thread(void *arg)	// 'core1', receives & checks FCS, LwIP runs in main()
+{	(void)arg;
+
+	netif_rmii_ethernet_loop();
+	return NULL;
+}
+#endif
+
+int main(int argc, char **argv)
+{	struct netif	netif;
+	ip4_addr_t		ip, mask, gw;
+	int				use_tap = (argc >= 3 && strcmp(argv[1], "tap") == 0);
+	int				use_hold = (argc >= 2 && strcmp(argv[1], "hold") == 0);
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+	printf("pico rmii ethernet - host\n");
+
+	lwip_init();
+	netif_rmii_ethernet_init(&netif, NULL);
+
+	IP4_ADDR(&ip, s_dut_ip[0], s_dut_ip[1], s_dut_ip[2], s_dut_ip[3]);
+	IP4_ADDR(&mask, 255, 255, 255, 0);
+	IP4_ADDR(&gw, s_peer_ip[0], s_peer_ip[1], s_peer_ip[2], s_peer_ip[3]);
+	netif_set_addr(&netif, &ip, &mask, &gw);
+	netif_set_default(&netif);
+	netif_set_up(&netif);
+	memcpy(s_dut_mac, netif.hwaddr, 6);
+
+	if (use_tap)
+	{	if (rmii_hal_host_tap_open(argv[2]) != 0)	{	return 1;	}
+		lwiperf_start_tcp_server_default(report, NULL);
+	}
+	else
+	{	pthread_t	peer;
+
+		rmii_hal_host_peer_set_rx(peer_rx);
+		if (use_hold)	{	netif.input = hold_input;	}
+		pthread_create(&peer, NULL, use_hold ? hold_thread : peer_thread, NULL);
+	}
+
+#ifdef USE_RX_PIPELINE
+	pthread_t	rx;
+
+	pthread_create(&rx, NULL, rx_thread, NULL);
+	while (1)	{	netif_rmii_ethernet_poll();	sched_yield();	}
+#else
+	netif_rmii_ethernet_loop();
+#endif
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Write packet capture (USE_RMII_CAPTURE, 'cap' of example shell) of console to a pcapng file
+
+	pcap_dump <log|tty|-> <out.pcapng|->	log : console capture or serial port (stty -F /dev/ttyACM0 raw), - = stdin
+											out : - = stdout, e.g. pcap_dump /dev/ttyACM0 - | wireshark -k -i -
+
+	- lines "@PCAP <base64>" are pcapng blocks, other lines are ignored
+	- a block is written after its length fields are checked, a broken line (lost console bytes) is skipped
+	- blocks before first section header are skipped, each 'cap' start begins a new section
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PCAP_BLK_MAX		4096
+
+static int b64_val(int c)
+{	if (c >= 'A' && c <= 'Z')	{	return c - 'A';	}
+	if (c >= 'a' && c <= 'z')	{	return c - 'a' + 26;	}
+	if (c >= '0' && c <= '9')	{	return c - '0' + 52;	}
+	if (c == '+')				{	return 62;	}
+	if (c == '/')				{	return 63;	}
+	return -1;
+}
+
+static int b64_decode(const char *in, uint8_t *out, int size)	// return bytes, -1 if broken
+{	int		len = 0;
+
+	while (in[0] && in[0] != '\r' && in[0] != '\n')
+	{	int		v[4];
+
+		for (int i = 0; i < 4; i++)	{	v[i] = (in[i] == '=') ? 0 : b64_val(in[i]);	}
+		if (v[0] < 0 || v[1] < 0 || v[2] < 0 || v[3] < 0 || len + 3 > size)	{	return -1;	}
+
+		uint32_t	w = (v[0] << 18) | (v[1] << 12) | (v[2] << 6) | v[3];
+
+		out[len++] = w >> 16;
+		if (in[2] != '=')	{	out[len++] = w >> 8;	}
+		if (in[3] != '=')	{	out[len++] = w;	}
+		in += 4;
+	}
+	return len;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int main(int argc, char **argv)
+{	static char		line[PCAP_BLK_MAX * 2];
+	static uint8_t	blk[PCAP_BLK_MAX];
+	FILE			*in = stdin, *out = stdout;
+	int				section = 0, packet = 0, broken = 0, lost = 0;
+
+	if (argc < 3)
+	{	fprintf(stderr, "usage: %s <log|tty|-> <out.pcapng|->\n", argv[0]);
+		return 1;
+	}
+	if (strcmp(argv[1], "-") != 0 && (in = fopen(argv[1], "r")) == NULL)	{	perror(argv[1]);	return 1;	}
+	if (strcmp(argv[2], "-") != 0 && (out = fopen(argv[2], "wb")) == NULL)	{	perror(argv[2]);	return 1;	}
+
+	while (fgets(line, sizeof(line), in) != NULL)
+	{	int			len;
+		uint32_t	type;
+
+		if (strncmp(line, "@PCAP ", 6) != 0)	{	continue;	}
+
+		len = b64_decode(line + 6, blk, sizeof(blk));
+		if (len < 12 || (len & 3) || get_u32(blk + 4) != (uint32_t)len || get_u32(blk + len - 4) != (uint32_t)len)
+		{	broken++;
+			continue;
+		}
+
+		type = get_u32(blk);
+		if (type == 0x0a0d0d0a)		{	section++;	}
+		else if (section == 0)		{	continue;	}
+		else if (type == 6)
+		{	packet++;
+			for (int i = 28 + ((get_u32(blk + 20) + 3) & ~3u); i + 4 <= len - 4; )	// epb_dropcount
+			{	uint32_t	code = get_u32(blk + i) & 0xffff, n = get_u32(blk + i) >> 16;
+
+				if (code == 0)	{	break;	}
+				if (code == 4 && n == 8)	{	lost += get_u32(blk + i + 4);	}
+				i += 4 + ((n + 3) & ~3u);
+			}
+		}
+
+		fwrite(blk, 1, len, out);
+		fflush(out);							// readable while capturing
+	}
+
+	fprintf(stderr, "SECTION %d PACKET %d LOST %d BROKEN-LINE %d\n", section, packet, lost, broken);
+	if (out != stdout)	{	fclose(out);	}
+	if (in != stdin)	{	fclose(in);	}
+	return 0;
+}
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pio_sim.h"
+
+// ------------------------------------------------------------------
+// - Debug
+// ------------------------------------------------------------------
+#define LOG(x, y...)	fprintf(stderr, x "\n", ##y)
+
+// ------------------------------------------------------------------
+// - Assembler, subset of pioasm syntax used by src/*.pio
+// ------------------------------------------------------------------
+enum {	OP_JMP = 0, OP_WAIT, OP_IN, OP_OUT, OP_PUSHPULL, OP_MOV, OP_IRQ, OP_SET	};
+
+typedef struct
+{	char		name[32];
+	int			addr;
+} asm_label_t;
+
+typedef struct
+{	char		text[128];
+	int			line;
+} asm_line_t;
+
+static int asm_lookup(const char *s, const char * const *tab, int n)
+{	for (int i = 0; i < n; i++)
+	{	if (tab[i] != NULL && strcmp(s, tab[i]) == 0)	{	return i;	}
+	}
+	return -1;
+}
+
+static int asm_value(const char *s, const asm_label_t *label, int nlabel, int *val)
+{	char	*end;
+
+	if (isdigit((unsigned char)s[0]) || s[0] == '-')
+	{	if (s[0] == '0' && s[1] == 'b')	{	*val = strtol(s + 2, &end, 2);	}
+		else							{	*val = strtol(s, &end, 0);		}
+		return (*end == 0) ? 0 : -1;
+	}
+	for (int i = 0; i < nlabel; i++)
+	{	if (strcmp(s, label[i].name) == 0)	{	*val = label[i].addr;	return 0;	}
+	}
+	return -1;
+}
+
+static int asm_encode(pio_sim_program_t *prog, const char *src, const asm_label_t *label, int nlabel, uint16_t *out)
+{	static const char * const jmp_cond[] = {	"", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre"	};
+	static const char * const in_src[] = {	"pins", "x", "y", "null", NULL, NULL, "isr", "osr"	};
+	static const char * const out_dst[] = {	"pins", "x", "y", "null", "pindirs", "pc", "isr", "exec"	};
+	static const char * const mov_dst[] = {	"pins", "x", "y", NULL, "exec", "pc", "isr", "osr"	};
+	static const char * const mov_src[] = {	"pins", "x", "y", "null", NULL, "status", "isr", "osr"	};
+	static const char * const set_dst[] = {	"pins", "x", "y", NULL, "pindirs"	};
+	static const char * const wait_src[] = {	"gpio", "pin", "irq"	};
+	char	buf[128], *tok[8], *p;
+	int		ntok = 0, delay = 0, side = -1, v;
+	uint16_t	ins;
+
+	snprintf(buf, sizeof(buf), "%.127s", src);
+
+	// [delay]
+	if ((p = strchr(buf, '[')) != NULL)
+	{	delay = atoi(p + 1);
+		*p = 0;
+	}
+	for (p = buf; *p; p++)	{	if (*p == ',')	{	*p = ' ';	}	}
+	for (p = strtok(buf, " \t"); p != NULL && ntok < 8; p = strtok(NULL, " \t"))	{	tok[ntok++] = p;	}
+
+	// side <n>
+	for (int i = 0; i < ntok - 1; i++)
+	{	if (strcmp(tok[i], "side") == 0 || strcmp(tok[i], "sideset") == 0)
+		{	side = atoi(tok[i + 1]);
+			ntok = i;
+			break;
+		}
+	}
+	if (ntok == 0)	{	return -1;	}
+
+	if (strcmp(tok[0], "nop") == 0)
+	{	ins = 0xa042;		// mov y, y
+	}
+	else if (strcmp(tok[0], "jmp") == 0)
+	{	int		cond = 0;
+
+		if (ntok == 3)	{	if ((cond = asm_lookup(tok[1], jmp_cond, 8)) < 0)	{	return -1;	}	}
+		if (asm_value(tok[ntok - 1], label, nlabel, &v) < 0)	{	return -1;	}
+		ins = (OP_JMP << 13) | (cond << 5) | (v & 0x1f);
+	}
+	else if (strcmp(tok[0], "wait") == 0)
+	{	int		pol, src, idx, rel = (strcmp(tok[ntok - 1], "rel") == 0);
+
+		if (ntok < 4 || (src = asm_lookup(tok[2], wait_src, 3)) < 0)	{	return -1;	}
+		pol = atoi(tok[1]);
+		idx = atoi(tok[3]);
+		ins = (OP_WAIT << 13) | (pol << 7) | (src << 5) | (idx & 0x1f) | (rel ? 0x10 : 0);
+	}
+	else if (strcmp(tok[0], "in") == 0 || strcmp(tok[0], "out") == 0)
+	{	int		is_in = (tok[0][0] == 'i'), sel;
+
+		if (ntok != 3)	{	return -1;	}
+		sel = is_in ? asm_lookup(tok[1], in_src, 8) : asm_lookup(tok[1], out_dst, 8);
+		if (sel < 0 || asm_value(tok[2], label, nlabel, &v) < 0)	{	return -1;	}
+		ins = ((is_in ? OP_IN : OP_OUT) << 13) | (sel << 5) | (v & 0x1f);
+	}
+	else if (strcmp(tok[0], "push") == 0 || strcmp(tok[0], "pull") == 0)
+	{	int		is_pull = (tok[0][1] == 'u' && tok[0][2] == 'l'), cond = 0, block = 1;
+
+		for (int i = 1; i < ntok; i++)
+		{	if (strcmp(tok[i], "iffull") == 0 || strcmp(tok[i], "ifempty") == 0)	{	cond = 1;	}
+			else if (strcmp(tok[i], "noblock") == 0)								{	block = 0;	}
+		}
+		ins = (OP_PUSHPULL << 13) | (is_pull << 7) | (cond << 6) | (block << 5);
+	}
+	else if (strcmp(tok[0], "mov") == 0)
+	{	int		dst, src, op = 0;
+		char	*s;
+
+		if (ntok != 3)	{	return -1;	}
+		s = tok[2];
+		if (s[0] == '!' || s[0] == '~')					{	op = 1;	s++;	}
+		else if (s[0] == ':' && s[1] == ':')			{	op = 2;	s += 2;	}
+		if ((dst = asm_lookup(tok[1], mov_dst, 8)) < 0 || (src = asm_lookup(s, mov_src, 8)) < 0)	{	return -1;	}
+		ins = (OP_MOV << 13) | (dst << 5) | (op << 3) | src;
+	}
+	else if (strcmp(tok[0], "irq") == 0)
+	{	int		clr = 0, wait = 0, i = 1, rel = (strcmp(tok[ntok - 1], "rel") == 0);
+
+		if (strcmp(tok[i], "clear") == 0)								{	clr = 1;	i++;	}
+		else if (strcmp(tok[i], "wait") == 0)							{	wait = 1;	i++;	}
+		else if (strcmp(tok[i], "set") == 0 || strcmp(tok[i], "nowait") == 0)	{	i++;	}
+		if (i >= ntok)	{	return -1;	}
+		ins = (OP_IRQ << 13) | (clr << 6) | (wait << 5) | (atoi(tok[i]) & 0x07) | (rel ? 0x10 : 0);
+	}
+	else if (strcmp(tok[0], "set") == 0)
+	{	int		dst;
+
+		if (ntok != 3 || (dst = asm_lookup(tok[1], set_dst, 5)) < 0)	{	return -1;	}
+		if (asm_value(tok[2], label, nlabel, &v) < 0)	{	return -1;	}
+		ins = (OP_SET << 13) | (dst << 5) | (v & 0x1f);
+	}
+	else
+	{	return -1;
+	}
+
+	// delay/side-set field, side-set takes MSBs
+	int		delay_bits = 5 - prog->side_set;
+
+	if (delay >= (1 << delay_bits))	{	return -1;	}
+	ins |= delay << 8;
+	if (side >= 0)
+	{	int		side_bits = prog->side_set - prog->side_opt;
+
+		ins |= (side & ((1 << side_bits) - 1)) << (8 + delay_bits);
+		if (prog->side_opt)	{	ins |= 1 << 12;	}
+	}
+	else if (prog->side_set && !prog->side_opt)
+	{	return -1;	// side-set is mandatory
+	}
+	*out = ins;
+
+	return 0;
+}
+
+int pio_sim_asm(pio_sim_program_t *prog, const char *path, const char *name)
+{	static asm_line_t	lines[PIO_SIM_MAX_INSTR];
+	asm_label_t			label[PIO_SIM_MAX_INSTR];
+	int					nlabel = 0, in_prog = 0, in_block = 0, line_no = 0;
+	char				buf[256];
+	FILE				*fp = fopen(path, "r");
+
+	if (fp == NULL)	{	LOG("%s : can not open", path);	return -1;	}
+
+	memset(prog, 0, sizeof(*prog));
+	prog->wrap = -1;
+
+	// pass 1 : collect labels & instructions
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{	char	*p = buf, *c;
+
+		line_no++;
+		if (in_block)	{	if (strncmp(p, "%}", 2) == 0)	{	in_block = 0;	}	continue;	}
+		if (p[0] == '%')	{	in_block = 1;	continue;	}
+
+		if ((c = strchr(p, ';')) != NULL)	{	*c = 0;	}
+		if ((c = strstr(p, "//")) != NULL)	{	*c = 0;	}
+		while (isspace((unsigned char)*p))	{	p++;	}
+		for (c = p + strlen(p); c > p && isspace((unsigned char)c[-1]); c--)	{	c[-1] = 0;	}
+		if (*p == 0)	{	continue;	}
+
+		if (strncmp(p, ".program", 8) == 0)
+		{	char	pname[64];
+
+			if (in_prog)	{	break;	}	// next program
+			sscanf(p + 8, "%63s", pname);
+			if (name == NULL || strcmp(name, pname) == 0)
+			{	in_prog = 1;
+				strcpy(prog->name, pname);
+			}
+			continue;
+		}
+		if (!in_prog)	{	continue;	}
+
+		if (strncmp(p, ".side_set", 9) == 0)
+		{	prog->side_set = atoi(p + 9);
+			if (strstr(p, "opt") != NULL)	{	prog->side_opt = 1;	prog->side_set++;	}
+		}
+		else if (strcmp(p, ".wrap_target") == 0)	{	prog->wrap_target = prog->len;		}
+		else if (strcmp(p, ".wrap") == 0)			{	prog->wrap = prog->len - 1;		}
+		else if (p[0] == '.')						{	/* .origin, .define... not used */	}
+		else
+		{	if ((c = strchr(p, ':')) != NULL && (c[1] == 0 || isspace((unsigned char)c[1])))
+			{	*c = 0;
+				if (strncmp(p, "public ", 7) == 0)
+				{	p += 7;
+					if (prog->pub_cnt < PIO_SIM_MAX_PUBLIC)
+					{	snprintf(prog->pub_name[prog->pub_cnt], sizeof(prog->pub_name[0]), "%.*s", (int)sizeof(prog->pub_name[0]) - 1, p);
+						prog->pub_addr[prog->pub_cnt++] = prog->len;
+					}
+				}
+				snprintf(label[nlabel].name, sizeof(label[0].name), "%.*s", (int)sizeof(label[0].name) - 1, p);
+				label[nlabel].addr = prog->len;
+				nlabel++;
+				for (p = c + 1; isspace((unsigned char)*p); p++)	{	}
+				if (*p == 0)	{	continue;	}
+			}
+			if (prog->len >= PIO_SIM_MAX_INSTR)	{	LOG("%s : too many instructions", path);	fclose(fp);	return -1;	}
+			snprintf(lines[prog->len].text, sizeof(lines[0].text), "%.*s", (int)sizeof(lines[0].text) - 1, p);
+			lines[prog->len].line = line_no;
+			prog->len++;
+		}
+	}
+	fclose(fp);
+
+	if (!in_prog || prog->len == 0)	{	LOG("%s : program %s not found", path, name ? name : "");	return -1;	}
+	if (prog->wrap < 0)	{	prog->wrap = prog->len - 1;	}
+
+	// pass 2 : encode
+	for (int i = 0; i < prog->len; i++)
+	{	if (asm_encode(prog, lines[i].text, label, nlabel, &prog->instr[i]) < 0)
+		{	LOG("%s:%d : can not assemble '%s'", path, lines[i].line, lines[i].text);
+			return -1;
+		}
+		prog->line[i] = lines[i].line;
+		snprintf(prog->text[i], sizeof(prog->text[0]), "%.47s", lines[i].text);
+	}
+	return 0;
+}
+
+int pio_sim_public(const pio_sim_program_t *prog, const char *label)
+{	for (int i = 0; i < prog->pub_cnt; i++)
+	{	if (strcmp(prog->pub_name[i], label) == 0)	{	return prog->pub_addr[i];	}
+	}
+	return -1;
+}
+
+// ------------------------------------------------------------------
+// - FIFO
+// ------------------------------------------------------------------
+int pio_sim_fifo_put(pio_sim_fifo_t *f, uint32_t v)
+{	if (f->count == PIO_SIM_FIFO_DEPTH)	{	return 0;	}
+
+	f->data[f->head] = v;
+	f->head = (f->head != (PIO_SIM_FIFO_DEPTH-1)) ? f->head + 1 : 0;
+	f->count++;
+	return 1;
+}
+
+int pio_sim_fifo_get(pio_sim_fifo_t *f, uint32_t *v)
+{	if (f->count == 0)	{	return 0;	}
+
+	*v = f->data[f->rear];
+	f->rear = (f->rear != (PIO_SIM_FIFO_DEPTH-1)) ? f->rear + 1 : 0;
+	f->count--;
+	return 1;
+}
+
+// ------------------------------------------------------------------
+// - Executor
+// ------------------------------------------------------------------
+static inline uint32_t sim_pins(pio_sim_t *pio)
+{	return pio->pins_sync[PIO_SIM_SYNC_CYCLES - 1];
+}
+
+static inline uint32_t sim_rotr(uint32_t v, int n)
+{	n &= 31;
+	return n ? (v >> n) | (v << (32 - n)) : v;
+}
+
+static inline void sim_write_bits(uint32_t *reg, int base, int count, uint32_t val)
+{	for (int i = 0; i < count; i++)
+	{	int		pin = (base + i) & 31;
+
+		if (val & (1u << i))	{	*reg |= (1u << pin);	}
+		else					{	*reg &= ~(1u << pin);	}
+	}
+}
+
+static inline void sim_write_pins(pio_sim_t *pio, int base, int count, uint32_t val)
+{	sim_write_bits(&pio->pins_out, base, count, val);
+}
+
+static inline int sim_irq_index(int sm_no, int idx)
+{	// relative IRQ : add SM number to lower 2 bits
+	if (idx & 0x10)	{	return (idx & 0x04) | ((idx + sm_no) & 0x03);	}
+	return idx & 0x07;
+}
+
+static uint32_t sim_mov_src(pio_sim_t *pio, pio_sim_sm_t *sm, int src)
+{	switch (src)
+	{	case 0 :	return sim_rotr(sim_pins(pio), sm->in_base);
+		case 1 :	return sm->x;
+		case 2 :	return sm->y;
+		case 5 :	return 0;		// status, not modeled
+		case 6 :	return sm->isr;
+		case 7 :	return sm->osr;
+		default :	return 0;
+	}
+}
+
+// execute one instruction, return 1 if completed, 0 if stalled
+static int sim_exec(pio_sim_t *pio, int sm_no, uint16_t ins, uint8_t irq_snap, uint8_t *irq_set, uint8_t *irq_clr, int *jumped)
+{	pio_sim_sm_t	*sm = &pio->sm[sm_no];
+	int				op = ins >> 13, arg1 = (ins >> 5) & 0x07, arg2 = ins & 0x1f;
+	int				n = arg2 ? arg2 : 32;
+	uint32_t		mask = (n == 32) ? 0xffffffff : ((1u << n) - 1);
+
+	switch (op)
+	{	case OP_JMP :
+		{	int		take = 0;
+
+			switch (arg1)
+			{	case 0 :	take = 1;								break;
+				case 1 :	take = (sm->x == 0);					break;
+				case 2 :	take = (sm->x != 0);	sm->x--;		break;
+				case 3 :	take = (sm->y == 0);					break;
+				case 4 :	take = (sm->y != 0);	sm->y--;		break;
+				case 5 :	take = (sm->x != sm->y);				break;
+				case 6 :	take = (sim_pins(pio) >> sm->jmp_pin) & 1;	break;
+				case 7 :	take = (sm->osr_cnt < sm->pull_thresh);	break;
+			}
+			if (take)	{	sm->pc = arg2;	*jumped = 1;	}
+			return 1;
+		}
+		case OP_WAIT :
+		{	int		pol = (ins >> 7) & 1, src = (ins >> 5) & 0x03, lvl;
+
+			if (src == 0)		{	lvl = (sim_pins(pio) >> arg2) & 1;						}
+			else if (src == 1)	{	lvl = (sim_pins(pio) >> ((sm->in_base + arg2) & 31)) & 1;	}
+			else
+			{	int		idx = sim_irq_index(sm_no, arg2);
+
+				lvl = (irq_snap >> idx) & 1;
+				if (pol && lvl)	{	*irq_clr |= (1 << idx);	}	// 'wait 1 irq' clears the flag
+			}
+			return lvl == pol;
+		}
+		case OP_IN :
+		{	uint32_t	data;
+
+			switch (arg1)
+			{	case 0 :	data = sim_rotr(sim_pins(pio), sm->in_base);	break;
+				case 1 :	data = sm->x;	break;
+				case 2 :	data = sm->y;	break;
+				case 6 :	data = sm->isr;	break;
+				case 7 :	data = sm->osr;	break;
+				default :	data = 0;		break;
+			}
+			data &= mask;
+
+			int		cnt = sm->isr_cnt + n;
+			if (cnt > 32)	{	cnt = 32;	}
+			if (sm->autopush && cnt >= sm->push_thresh && sm->rxf.count == PIO_SIM_FIFO_DEPTH)	{	return 0;	}
+
+			if (sm->in_shift_right)	{	sm->isr = (n == 32) ? data : (sm->isr >> n) | (data << (32 - n));	}
+			else					{	sm->isr = (n == 32) ? data : (sm->isr << n) | data;				}
+			sm->isr_cnt = cnt;
+
+			if (sm->autopush && sm->isr_cnt >= sm->push_thresh)
+			{	pio_sim_fifo_put(&sm->rxf, sm->isr);
+				sm->isr = 0;
+				sm->isr_cnt = 0;
+			}
+			return 1;
+		}
+		case OP_OUT :
+		{	uint32_t	data;
+
+			if (sm->autopull && sm->osr_cnt >= sm->pull_thresh)
+			{	if (!pio_sim_fifo_get(&sm->txf, &sm->osr))	{	return 0;	}
+				sm->osr_cnt = 0;
+			}
+			if (sm->out_shift_right)	{	data = sm->osr & mask;	sm->osr = (n == 32) ? 0 : sm->osr >> n;	}
+			else						{	data = (n == 32) ? sm->osr : sm->osr >> (32 - n);	sm->osr = (n == 32) ? 0 : sm->osr << n;	}
+			sm->osr_cnt = (sm->osr_cnt + n > 32) ? 32 : sm->osr_cnt + n;
+
+			switch (arg1)
+			{	case 0 :	sim_write_pins(pio, sm->out_base, n, data);	break;
+				case 1 :	sm->x = data;	break;
+				case 2 :	sm->y = data;	break;
+				case 5 :	sm->pc = data & 0x1f;	*jumped = 1;	break;
+				case 4 :	sim_write_bits(&pio->pindirs, sm->out_base, n, data);	break;
+				case 6 :	sm->isr = data;	sm->isr_cnt = n;	break;
+				default :	break;	// null, exec (not modeled)
+			}
+
+			// autopull refills as soon as OSR is emptied
+			if (sm->autopull && sm->osr_cnt >= sm->pull_thresh && pio_sim_fifo_get(&sm->txf, &sm->osr))
+			{	sm->osr_cnt = 0;
+			}
+			return 1;
+		}
+		case OP_PUSHPULL :
+		{	int		is_pull = (ins >> 7) & 1, cond = (ins >> 6) & 1, block = (ins >> 5) & 1;
+
+			if (!is_pull)
+			{	if (cond && sm->isr_cnt < sm->push_thresh)	{	return 1;	}
+				if (sm->rxf.count == PIO_SIM_FIFO_DEPTH)	{	if (block)	{	return 0;	}	}
+				else										{	pio_sim_fifo_put(&sm->rxf, sm->isr);	}
+				sm->isr = 0;
+				sm->isr_cnt = 0;
+			}
+			else
+			{	if (cond && sm->osr_cnt < sm->pull_thresh)	{	return 1;	}
+				if (!pio_sim_fifo_get(&sm->txf, &sm->osr))
+				{	if (block)	{	return 0;	}
+					sm->osr = sm->x;
+				}
+				sm->osr_cnt = 0;
+			}
+			return 1;
+		}
+		case OP_MOV :
+		{	int			mop = (ins >> 3) & 0x03;
+			uint32_t	data = sim_mov_src(pio, sm, ins & 0x07);
+
+			if (mop == 1)		{	data = ~data;	}
+			else if (mop == 2)
+			{	uint32_t	r = 0;
+
+				for (int i = 0; i < 32; i++)	{	if (data & (1u << i))	{	r |= 1u << (31 - i);	}	}
+				data = r;
+			}
+			switch (arg1)
+			{	case 0 :	sim_write_pins(pio, sm->out_base, sm->out_count, data);	break;
+				case 1 :	sm->x = data;	break;
+				case 2 :	sm->y = data;	break;
+				case 5 :	sm->pc = data & 0x1f;	*jumped = 1;	break;
+				case 6 :	sm->isr = data;	sm->isr_cnt = 0;	break;
+				case 7 :	sm->osr = data;	sm->osr_cnt = 0;	break;
+				default :	break;	// exec (not modeled)
+			}
+			return 1;
+		}
+		case OP_IRQ :
+		{	int		clr = (ins >> 6) & 1, wait = (ins >> 5) & 1;
+			int		idx = sim_irq_index(sm_no, arg2);
+
+			if (clr)	{	*irq_clr |= (1 << idx);	return 1;	}
+			if (!wait)	{	*irq_set |= (1 << idx);	return 1;	}
+
+			if (!sm->irq_waiting)
+			{	*irq_set |= (1 << idx);
+				sm->irq_waiting = 1;
+				return 0;
+			}
+			if (irq_snap & (1 << idx))	{	return 0;	}
+			sm->irq_waiting = 0;
+			return 1;
+		}
+		case OP_SET :
+		{	switch (arg1)
+			{	case 0 :	sim_write_pins(pio, sm->set_base, sm->set_count, arg2);	break;
+				case 1 :	sm->x = arg2;	break;
+				case 2 :	sm->y = arg2;	break;
+				case 4 :	sim_write_bits(&pio->pindirs, sm->set_base, sm->set_count, arg2);	break;
+				default :	break;
+			}
+			return 1;
+		}
+	}
+	return 1;
+}
+
+void pio_sim_init(pio_sim_t *pio)
+{	memset(pio, 0, sizeof(*pio));
+}
+
+void pio_sim_stat_clr(pio_sim_sm_t *sm)
+{	memset(sm->stat, 0, sizeof(sm->stat));
+	for (int i = 0; i < PIO_SIM_MAX_INSTR; i++)	{	sm->stat[i].stall_min = 0xffffffff;	}
+}
+
+void pio_sim_sm_init(pio_sim_t *pio, int sm_no, const pio_sim_program_t *prog)
+{	pio_sim_sm_t	*sm = &pio->sm[sm_no];
+
+	memset(sm, 0, sizeof(*sm));
+	sm->prog = prog;
+	sm->pc = 0;
+	sm->clkdiv = 0x100;
+	sm->in_shift_right = sm->out_shift_right = 1;
+	sm->push_thresh = sm->pull_thresh = 32;
+	sm->osr_cnt = 32;						// OSR empty after reset
+	pio_sim_stat_clr(sm);
+}
+
+void pio_sim_step(pio_sim_t *pio)
+{	uint8_t		irq_snap = pio->irq, irq_set = 0, irq_clr = 0;
+
+	for (int sm_no = 0; sm_no < PIO_SIM_NUM_SM; sm_no++)
+	{	pio_sim_sm_t			*sm = &pio->sm[sm_no];
+		const pio_sim_program_t	*prog = sm->prog;
+
+		sm->retired = -1;
+		if (!sm->enabled || prog == NULL)	{	continue;	}
+
+		// clock divider, SM runs when accumulator passes the divisor
+		sm->div_acc += 0x100;
+		if (sm->div_acc < sm->clkdiv)	{	continue;	}
+		sm->div_acc -= sm->clkdiv;
+
+		if (sm->delay > 0)	{	sm->delay--;	continue;	}
+
+		uint16_t	ins = prog->instr[sm->pc];
+		int			delay_bits = 5 - prog->side_set;
+		int			pc = sm->pc, jumped = 0;
+
+		// side-set is asserted at first cycle of instruction even if it stalls
+		if (prog->side_set && (!prog->side_opt || (ins & (1 << 12))))
+		{	int		side_bits = prog->side_set - prog->side_opt;
+
+			sim_write_pins(pio, sm->side_base, side_bits, (ins >> (8 + delay_bits)) & ((1 << side_bits) - 1));
+		}
+
+		if (!sim_exec(pio, sm_no, ins, irq_snap, &irq_set, &irq_clr, &jumped))
+		{	sm->stall++;
+			continue;
+		}
+
+		pio_sim_stat_t	*st = &sm->stat[pc];
+		st->exec++;
+		st->stall_sum += sm->stall;
+		if (sm->stall < st->stall_min)	{	st->stall_min = sm->stall;	}
+		if (sm->stall > st->stall_max)	{	st->stall_max = sm->stall;	}
+		sm->stall = 0;
+		sm->retired = pc;
+
+		sm->delay = (ins >> 8) & ((1 << delay_bits) - 1);
+		if (!jumped)	{	sm->pc = (pc == prog->wrap) ? prog->wrap_target : pc + 1;	}
+	}
+
+	// IRQ flags changed in this cycle are visible from next cycle
+	pio->irq = (pio->irq | irq_set) & ~irq_clr;
+
+	// input synchronizer, SM sees 'pins_in' PIO_SIM_SYNC_CYCLES later
+	for (int i = PIO_SIM_SYNC_CYCLES - 1; i > 0; i--)	{	pio->pins_sync[i] = pio->pins_sync[i - 1];	}
+	pio->pins_sync[0] = pio->pins_in;
+	pio->cycle++;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Cycle level model of a RP2040 PIO block, enough to run the .pio programs of src/ on the host
+
+	- pio_sim_asm() assembles a .pio source (first .program or given one) into real instruction words,
+	  so the executor decodes the same 16-bit encoding (delay/side-set bits included) as the hardware
+	- pio_sim_step() advances every enabled SM by one system clock, honoring clock divider, stalls & delays
+	- inputs pass a 2-flop synchronizer (PIO_SIM_SYNC_CYCLES) like GPIO of RP2040
+	- per instruction statistics : executed count & cycles stalled (min/max), used as timing margin
+*/
+
+#ifndef __PIO_SIM_H__
+#define __PIO_SIM_H__
+
+#include <stdint.h>
+
+#define PIO_SIM_MAX_INSTR		32
+#define PIO_SIM_MAX_PUBLIC		8
+#define PIO_SIM_NUM_SM			4
+#define PIO_SIM_FIFO_DEPTH		8				// joined FIFO
+#define PIO_SIM_SYNC_CYCLES		2				// input synchronizer delay
+
+typedef struct
+{	char				name[64];
+	uint16_t			instr[PIO_SIM_MAX_INSTR];
+	int					line[PIO_SIM_MAX_INSTR];	// source line of each instruction
+	char				text[PIO_SIM_MAX_INSTR][48];	// source text of each instruction
+	int					len;
+	int					wrap_target;
+	int					wrap;
+	int					side_set;				// side-set bits (including enable bit if 'opt')
+	int					side_opt;
+	char				pub_name[PIO_SIM_MAX_PUBLIC][32];	// 'public' labels (<program>_offset_<label> of pioasm)
+	int					pub_addr[PIO_SIM_MAX_PUBLIC];
+	int					pub_cnt;
+} pio_sim_program_t;
+
+typedef struct
+{	uint32_t			data[PIO_SIM_FIFO_DEPTH];
+	int					head, rear, count;
+} pio_sim_fifo_t;
+
+typedef struct
+{	uint64_t			exec;					// completed count
+	uint64_t			stall_sum;
+	uint32_t			stall_min, stall_max;	// cycles waited before completion
+} pio_sim_stat_t;
+
+typedef struct
+{	// ----- config (pio_sm_config equivalent)
+	const pio_sim_program_t*	prog;
+	int					enabled;
+	int					in_base, out_base, out_count, set_base, set_count, side_base, jmp_pin;
+	int					in_shift_right, autopush, push_thresh;
+	int					out_shift_right, autopull, pull_thresh;
+	uint32_t			clkdiv;					// 16.8 fixed point like CLKDIV register, 0x100 = 1.0
+
+	// ----- state
+	int					pc;
+	uint32_t			x, y, isr, osr;
+	int					isr_cnt, osr_cnt;
+	int					delay;
+	int					irq_waiting;			// 'irq wait' already set its flag
+	uint32_t			stall;					// cycles stalled at current instruction
+	uint32_t			div_acc;
+	int					retired;				// pc of instruction completed in last cycle, -1 if none
+	pio_sim_fifo_t		rxf, txf;
+
+	pio_sim_stat_t		stat[PIO_SIM_MAX_INSTR];
+} pio_sim_sm_t;
+
+typedef struct
+{	pio_sim_sm_t		sm[PIO_SIM_NUM_SM];
+	uint8_t				irq;					// IRQ flags 0~7
+	uint32_t			pins_out;				// driven by SM
+	uint32_t			pindirs;				// 1 = output, by 'set/out pindirs', testbench resolves bus
+	uint32_t			pins_in;				// driven by testbench, before synchronizer
+	uint32_t			pins_sync[PIO_SIM_SYNC_CYCLES];
+	uint64_t			cycle;
+} pio_sim_t;
+
+int		pio_sim_asm(pio_sim_program_t *prog, const char *path, const char *name);	// return 0 if OK
+int		pio_sim_public(const pio_sim_program_t *prog, const char *label);	// address of public label, -1 if not found
+void	pio_sim_init(pio_sim_t *pio);
+void	pio_sim_sm_init(pio_sim_t *pio, int sm, const pio_sim_program_t *prog);	// default config, not enabled
+void	pio_sim_step(pio_sim_t *pio);
+void	pio_sim_stat_clr(pio_sim_sm_t *sm);
+
+int		pio_sim_fifo_put(pio_sim_fifo_t *f, uint32_t v);	// return 0 if full
+int		pio_sim_fifo_get(pio_sim_fifo_t *f, uint32_t *v);	// return 0 if empty
+
+#endif // __PIO_SIM_H__
@@ -0,0 +1,843 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Run RMII RX/TX PIO programs of src/ against generated RMII waveforms (see pio_sim.h)
+
+	rmii_sim [options]
+		--rx-sm <1|2|4>		RX SM in turn (default 2), 1 = single SM program, 2/4 = rx_2 program with patched baton handoff
+		--tx				run TX program instead of RX
+		--speed <10|100>	link speed (default 100), 10 = PHY holds each dibit for 10 RETCLK,
+							SM clock divider 10 & 'clk_wait' patched like rmii_hal_set_speed()
+		--pcap <file>		frames from pcap file (LINKTYPE_ETHERNET, FCS is appended)
+		--pcap-time			keep inter-frame time of pcap if longer than IPG
+		--gen <n>			n random frames (default 1000)
+		--len <min[:max]>	length of random frames without FCS (default 60:1514)
+		--ipg <ns>			inter packet gap (default 96 bit times, 960 at 100Mbps)
+		--burst <n>			n frames back-to-back at IPG, then idle for --burst-gap (default 0 = no idle)
+		--burst-gap <ns>	idle between bursts (default 200000)
+		--toggle <n>		RMII v1.2, CRS/DV toggles for last n dibits (default 0)
+		--pre <n>			dibits of RXD=00 after CRS/DV rises before preamble (default 0)
+		--phy-delay <ns>	PHY output delay of RXD/CRS after rising edge of RETCLK (default 4)
+		--jitter <ns>		each RXD/CRS transition moves randomly by -ns ~ +ns (default 0, max 9)
+		--isr <cycles>		RX ISR service time, end-of-frame IRQ ~ SM resume (default 200)
+		--tx-gap <cycles>	TX SM ISR latency between frames (default 200)
+		--poll <cycles>		interval of poll loop clearing deadlock between RX SM (default 10000)
+		--no-restore		ISR does not pass the baton again when previous SM passed it while waiting ISR
+		--mdio				run MDIO program against a PHY model, --gen random register read/write
+		--mdio-delay <ns>	PHY output delay of read data after rising edge of MDC (default 300, max of 802.3)
+		--sweep <n>			lost frames for burst length 1 ~ n with 1, 2 and 4 RX SM (--gen frames each)
+		--seed <n>
+		--src <dir>			directory of .pio files
+
+	Timing : system clock is 100MHz (1 cycle = 10ns), RETCLK = 50MHz is high at even cycles,
+	PHY changes RXD/CRS --phy-delay (+ jitter) after rising edge in ns, pins take the value at each cycle,
+	PIO samples through a 2-cycle synchronizer (PIO_SIM_SYNC_CYCLES). RX SM aligns to the SFD transition,
+	so a sample is (10 - phy-delay) ns after the transition, jitter beyond that setup takes the old dibit
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pio_sim.h"
+
+// ------------------------------------------------------------------
+// - extern
+// ------------------------------------------------------------------
+extern uint32_t fcs_crc32_sw(const uint8_t *buf, int size);
+
+// ------------------------------------------------------------------
+// - Config
+// ------------------------------------------------------------------
+#define SIM_RX_PIN			6				// RXD0, RXD1, CRS/DV
+#define SIM_TX_PIN			10				// TXD0, TXD1, TX-EN
+#define SIM_CLK_PIN			23				// RETCLK, hard coded in rmii_ethernet_phy_rx*.pio
+#define SIM_SM_RX			0				// first RX SM, others are (SIM_SM_RX + i * 4/N) % 4
+#define SIM_SM_TX			1
+#define SIM_NS_PER_CYCLE	10
+#define SIM_FRAME_LEN		(1514+4)
+#define SIM_PREAMBLE_DIBIT	32				// 7 x 0x55 + 0xd5
+
+#ifndef RMII_SRC_DIR
+	#define RMII_SRC_DIR	"src"
+#endif
+
+static struct
+{	int				rx_sm;
+	int				tx;
+	int				speed;
+	int				clk_per_dibit;			// RETCLK cycles per dibit, 1 at 100Mbps, 10 at 10Mbps
+	const char*		pcap;
+	int				pcap_time;
+	int				gen;
+	int				len_min, len_max;
+	int				ipg_ns;
+	int				burst;
+	int				burst_gap_ns;
+	int				toggle;
+	int				pre;
+	int				phy_delay;				// ns
+	int				jitter;					// ns
+	int				isr_cycles;
+	int				tx_gap;
+	int				poll;
+	int				no_restore;
+	int				sweep;
+	int				mdio;
+	int				mdio_delay;
+	unsigned		seed;
+	const char*		src;
+} s_opt = {	.rx_sm = 2, .speed = 100, .gen = 1000, .len_min = 60, .len_max = 1514, .burst_gap_ns = 200000,
+			.phy_delay = 4, .isr_cycles = 200, .tx_gap = 200, .poll = 10000, .mdio_delay = 300, .seed = 1, .src = RMII_SRC_DIR	};
+
+// ------------------------------------------------------------------
+// - Frames
+// ------------------------------------------------------------------
+typedef struct
+{	uint8_t			data[SIM_FRAME_LEN];	// frame + FCS
+	int				len;					// FCS included
+	int				gap_dibit;				// idle dibits before this frame
+} sim_frame_t;
+
+static sim_frame_t*	s_frame;
+static int			s_frame_cnt;
+
+static sim_frame_t *frame_add(const uint8_t *data, int len, int gap_ns)
+{	sim_frame_t		*f;
+	uint32_t		fcs;
+
+	if (len > SIM_FRAME_LEN - 4)	{	len = SIM_FRAME_LEN - 4;	}
+
+	s_frame = realloc(s_frame, sizeof(sim_frame_t) * (s_frame_cnt + 1));
+	f = &s_frame[s_frame_cnt++];
+	memset(f->data, 0, sizeof(f->data));
+	memcpy(f->data, data, len);
+	if (len < 60)	{	len = 60;	}		// padding
+	fcs = fcs_crc32_sw(f->data, len);
+	memcpy(&f->data[len], &fcs, 4);
+	f->len = len + 4;
+	f->gap_dibit = (gap_ns + s_opt.clk_per_dibit * 20 - 1) / (s_opt.clk_per_dibit * 20);	// 20ns per dibit at 100Mbps
+
+	return f;
+}
+
+static void frame_gen(void)
+{	uint8_t		buf[SIM_FRAME_LEN];
+
+	for (int i = 0; i < s_opt.gen; i++)
+	{	int		len = s_opt.len_min + ((s_opt.len_max > s_opt.len_min) ? rand() % (s_opt.len_max - s_opt.len_min + 1) : 0);
+
+		for (int j = 0; j < len; j++)	{	buf[j] = rand();	}
+		memcpy(buf, "\x02\x00\x00\x00\x00\x02\x02\x00\x00\x00\x00\x01\x08\x00", 14);
+		buf[14] = i >> 8;	buf[15] = i;	// sequence
+		frame_add(buf, len, (s_opt.burst && i && (i % s_opt.burst) == 0) ? s_opt.burst_gap_ns : s_opt.ipg_ns);
+	}
+}
+
+static int frame_load_pcap(const char *path)
+{	FILE		*fp = fopen(path, "rb");
+	uint32_t	hdr[6], rec[4], magic;
+	int			swap, nsec;
+	uint64_t	last_ts = 0, last_wire = 0;
+	uint8_t		buf[65536];
+
+	if (fp == NULL || fread(hdr, 4, 6, fp) != 6)	{	fprintf(stderr, "%s : can not read\n", path);	return -1;	}
+
+	magic = hdr[0];
+	swap = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+	if (swap)	{	magic = __builtin_bswap32(magic);	hdr[5] = __builtin_bswap32(hdr[5]);	}
+	if (magic != 0xa1b2c3d4 && magic != 0xa1b23c4d)	{	fprintf(stderr, "%s : not a pcap file\n", path);	fclose(fp);	return -1;	}
+	if (hdr[5] != 1)	{	fprintf(stderr, "%s : link type %u is not Ethernet\n", path, hdr[5]);	fclose(fp);	return -1;	}
+	nsec = (magic == 0xa1b23c4d);
+
+	while (fread(rec, 4, 4, fp) == 4)
+	{	if (swap)	{	for (int i = 0; i < 4; i++)	{	rec[i] = __builtin_bswap32(rec[i]);	}	}
+		if (rec[2] > sizeof(buf) || fread(buf, 1, rec[2], fp) != rec[2])	{	break;	}
+
+		uint64_t	ts = (uint64_t)rec[0] * 1000000000ull + (uint64_t)rec[1] * (nsec ? 1 : 1000);
+		int			gap = s_opt.ipg_ns;
+
+		if (s_opt.pcap_time && s_frame_cnt > 0 && ts > last_ts + last_wire + gap)
+		{	uint64_t	idle = ts - last_ts - last_wire;
+
+			gap = (idle > 100000000ull) ? 100000000 : (int)idle;	// 100ms at most
+		}
+		sim_frame_t	*f = frame_add(buf, rec[2], gap);
+
+		last_ts = ts;
+		last_wire = (uint64_t)(f->len + 8) * 80 * s_opt.clk_per_dibit;	// 80ns per byte at 100Mbps
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+// ------------------------------------------------------------------
+// - RX wire, PHY side of RMII
+// ------------------------------------------------------------------
+static struct
+{	int				frame;					// s_frame[] index
+	int				pos;					// dibit position from start of gap
+	uint32_t		pins;					// RXD0/1, CRS/DV currently driven
+	uint64_t		dibit;					// dibit count
+	uint64_t		t_edge;					// rising edge of RETCLK launching next dibit (ns)
+	uint64_t		t_next;					// next transition, t_edge + PHY delay + jitter (ns)
+	uint64_t		t_valid[8];				// recent transitions (ns), [0] = latest
+	int				done;
+	uint64_t		frame_start[2];			// cycle of first preamble dibit, current & previous frame
+} s_wire;
+
+static int wire_dibit(uint32_t *pins)
+{	// return value of next dibit, 0 at end of frames
+	while (s_wire.frame < s_frame_cnt)
+	{	sim_frame_t	*f = &s_frame[s_wire.frame];
+		int			pos = s_wire.pos++;
+		int			data_dibit = f->len * 4;
+		uint32_t	rxd, crs;
+
+		if (pos < f->gap_dibit)	{	*pins = 0;	return 1;	}
+		pos -= f->gap_dibit;
+
+		if (pos < s_opt.pre)	{	*pins = 0x04;	return 1;	}
+		pos -= s_opt.pre;
+
+		if (pos == 0)	{	s_wire.frame_start[1] = s_wire.frame_start[0];	s_wire.frame_start[0] = s_wire.t_next / SIM_NS_PER_CYCLE;	}
+
+		if (pos < SIM_PREAMBLE_DIBIT)
+		{	rxd = (pos == SIM_PREAMBLE_DIBIT - 1) ? 0x03 : 0x01;
+			*pins = rxd | 0x04;
+			return 1;
+		}
+		pos -= SIM_PREAMBLE_DIBIT;
+
+		if (pos < data_dibit)
+		{	rxd = (f->data[pos / 4] >> ((pos % 4) * 2)) & 0x03;
+			crs = 1;
+			if (pos >= data_dibit - s_opt.toggle)	{	crs = (pos & 1);	}	// low at first dibit of nibble
+			*pins = rxd | (crs << 2);
+			return 1;
+		}
+
+		s_wire.frame++;
+		s_wire.pos = 0;
+	}
+	*pins = 0;
+	return 0;
+}
+
+static void wire_step(uint64_t cycle)
+{	// PHY drives new dibit after rising edge of RETCLK (every 10th at 10Mbps), pins hold the value at this cycle
+	if (cycle * SIM_NS_PER_CYCLE >= s_wire.t_next)
+	{	uint32_t	pins;
+
+		if (!wire_dibit(&pins))	{	s_wire.done = 1;	}
+		s_wire.pins = pins;
+		memmove(&s_wire.t_valid[1], &s_wire.t_valid[0], sizeof(s_wire.t_valid) - sizeof(s_wire.t_valid[0]));
+		s_wire.t_valid[0] = s_wire.t_next;
+		s_wire.dibit++;
+
+		// from the edge, a moved transition does not shift the next one
+		s_wire.t_edge += 2 * s_opt.clk_per_dibit * SIM_NS_PER_CYCLE;
+		s_wire.t_next = s_wire.t_edge + s_opt.phy_delay + (s_opt.jitter ? rand() % (2 * s_opt.jitter + 1) - s_opt.jitter : 0);
+	}
+}
+
+// ------------------------------------------------------------------
+// - RX DMA & ISR model
+// ------------------------------------------------------------------
+typedef struct
+{	uint8_t			buf[2048];
+	int				len;
+} sim_rx_dma_t;
+
+static sim_rx_dma_t	s_rx_dma[PIO_SIM_NUM_SM];
+
+static struct
+{	int				sent;
+	int				ok;						// captured with exact length
+	int				lost;
+	int				corrupt;
+	int				len_long;				// captured correctly but with trailing bytes
+	int				len_short;
+	uint32_t		setup_min, hold_min;	// ns between RXD transition & sampling cycle, as seen through synchronizer
+	uint64_t		setup_sum;
+	uint32_t		sample;
+	uint32_t		isr_margin_min;			// cycles between SM resume & next preamble
+	int				deadlock;				// cleared by poll loop, see rmii_hal_rx_deadlock()
+	int				restore;				// baton passed again by ISR, see rx_baton_restore() of rmii_hal_rp2040.c
+	int				expect;					// s_frame[] index expected next
+} s_rx_stat;
+
+static void rx_capture(const uint8_t *buf, int len)
+{	// match captured buffer with expected frames in order
+	for (int i = s_rx_stat.expect; i < s_frame_cnt && i < s_rx_stat.expect + 64; i++)
+	{	sim_frame_t	*f = &s_frame[i];
+		int			n = (len < f->len) ? len : f->len;
+
+		if (n < 16 || memcmp(buf, f->data, n) != 0)	{	continue;	}
+
+		s_rx_stat.lost += i - s_rx_stat.expect;
+		s_rx_stat.expect = i + 1;
+
+		if (len == f->len)		{	s_rx_stat.ok++;			}
+		else if (len > f->len)	{	s_rx_stat.len_long++;	}
+		else					{	s_rx_stat.len_short++;	}
+		return;
+	}
+	s_rx_stat.corrupt++;
+}
+
+static int prog_speed(pio_sim_program_t *prog, const char *path, uint16_t nop, const char *text)
+{	// 10Mbps : 'clk_wait' never sees RETCLK change under divided clock, patched like rmii_hal_set_speed()
+	int		pc;
+
+	if (s_opt.clk_per_dibit == 1)	{	return 0;	}
+	if ((pc = pio_sim_public(prog, "clk_wait")) < 0)
+	{	fprintf(stderr, "%s : public label 'clk_wait' not found\n", path);
+		return -1;
+	}
+	prog->instr[pc] = nop;
+	snprintf(prog->text[pc], sizeof(prog->text[0]), "%s", text);
+	return 0;
+}
+
+static void prt_steps(pio_sim_t *pio, int sm_no)
+{	pio_sim_sm_t	*sm = &pio->sm[sm_no];
+
+	printf("SM%d %s\n", sm_no, sm->prog->name);
+	printf("  PC  LINE  %-28s %10s %8s %8s %8s\n", "INSTRUCTION", "EXEC", "WAIT-MIN", "WAIT-AVG", "WAIT-MAX");
+	for (int i = 0; i < sm->prog->len; i++)
+	{	pio_sim_stat_t	*st = &sm->stat[i];
+
+		if (st->exec == 0)
+		{	printf("  %2d  %4d  %-28s %10d %8s %8s %8s\n", i, sm->prog->line[i], sm->prog->text[i], 0, "-", "-", "-");
+			continue;
+		}
+		printf("  %2d  %4d  %-28s %10llu %8u %8.1f %8u\n", i, sm->prog->line[i], sm->prog->text[i],
+			(unsigned long long)st->exec, st->stall_min, (double)st->stall_sum / st->exec, st->stall_max);
+	}
+}
+
+static int run_rx(int verbose)
+{	static pio_sim_program_t	prog;
+	static pio_sim_t			pio;
+	char						path[512];
+	int							sm_cnt = s_opt.rx_sm;
+	int							sm_list[PIO_SIM_NUM_SM];
+	int							isr_idx = -1, isr_next = 0, restore_sm = -1;
+	uint64_t					isr_end = 0, resume[PIO_SIM_NUM_SM] = {0}, drain_end = 0;
+
+	if (sm_cnt != 1 && sm_cnt != 2 && sm_cnt != 4)	{	fprintf(stderr, "--rx-sm %d : 1, 2 or 4\n", sm_cnt);	return -1;	}
+	for (int i = 0; i < sm_cnt; i++)	{	sm_list[i] = (SIM_SM_RX + i * (4 / sm_cnt)) & 3;	}
+
+	snprintf(path, sizeof(path), "%s/rmii_ethernet_phy_%s.pio", s_opt.src, (sm_cnt == 1) ? "rx" : "rx_2");
+	if (pio_sim_asm(&prog, path, NULL) != 0)	{	return -1;	}
+	if (sm_cnt > 1)
+	{	// baton goes to next SM of the ring like rmii_hal_init(), 'irq clear (4 + 4/N) rel'
+		int		pc = pio_sim_public(&prog, "handoff");
+
+		if (pc < 0)	{	fprintf(stderr, "%s : public label 'handoff' not found\n", path);	return -1;	}
+		prog.instr[pc] = (prog.instr[pc] & ~0x1f) | 0x10 | (4 + 4 / sm_cnt);
+		snprintf(prog.text[pc], sizeof(prog.text[0]), "irq clear %d rel", 4 + 4 / sm_cnt);
+	}
+	if (prog_speed(&prog, path, 0xa142, "nop [1]") != 0)	{	return -1;	}	// mov y, y [1]
+
+	memset(&s_rx_stat, 0, sizeof(s_rx_stat));
+	memset(s_rx_dma, 0, sizeof(s_rx_dma));
+	s_rx_stat.isr_margin_min = s_rx_stat.setup_min = s_rx_stat.hold_min = 0xffffffff;
+
+	pio_sim_init(&pio);
+	for (int i = 0; i < sm_cnt; i++)
+	{	pio_sim_sm_t	*sm = &pio.sm[sm_list[i]];
+
+		pio_sim_sm_init(&pio, sm_list[i], &prog);
+		sm->in_base = SIM_RX_PIN;
+		sm->jmp_pin = SIM_RX_PIN + 2;
+		sm->in_shift_right = 1;
+		sm->autopush = 1;
+		sm->push_thresh = 8;
+		sm->clkdiv = s_opt.clk_per_dibit << 8;
+		sm->enabled = 1;
+	}
+
+	memset(&s_wire, 0, sizeof(s_wire));
+	while (1)
+	{	uint64_t	t = pio.cycle;
+
+		// ----- wire & clock
+		wire_step(t);
+		pio.pins_in = (s_wire.pins << SIM_RX_PIN) | (((t & 1) == 0) << SIM_CLK_PIN);
+
+		pio_sim_step(&pio);
+
+		// driver kicks first RX SM after every SM is waiting at 'irq wait 4 rel'
+		if (sm_cnt > 1 && t == 16 * (uint64_t)s_opt.clk_per_dibit)	{	pio.irq &= ~(1 << (4 + sm_list[0]));	}
+
+		// poll loop : every SM waits the baton when 'irq clear' came before 'irq wait'
+		if (sm_cnt > 1 && s_opt.poll && (t % s_opt.poll) == 0)
+		{	uint8_t		mask = 0;
+
+			for (int i = 0; i < sm_cnt; i++)	{	mask |= 1 << (4 + sm_list[i]);	}
+			if ((pio.irq & mask) == mask)
+			{	pio.irq &= ~(1 << (4 + sm_list[isr_next]));
+				s_rx_stat.deadlock++;
+			}
+		}
+
+		// ISR passes the baton again once resumed SM waits for it
+		if (restore_sm >= 0 && (pio.irq & (1 << (4 + restore_sm))))
+		{	pio.irq &= ~(1 << (4 + restore_sm));
+			restore_sm = -1;
+			s_rx_stat.restore++;
+		}
+
+		for (int i = 0; i < sm_cnt; i++)
+		{	int				sm_no = sm_list[i];
+			pio_sim_sm_t	*sm = &pio.sm[sm_no];
+			uint32_t		v;
+
+			// sampling margin of 'in pins', in SM cycles
+			if (sm->retired >= 0 && (prog.instr[sm->retired] & 0xe0e0) == 0x4000)
+			{	// 'in' of this cycle took pins of PIO_SIM_SYNC_CYCLES before
+				uint64_t	ts = (t - PIO_SIM_SYNC_CYCLES) * SIM_NS_PER_CYCLE, setup = 0, hold = s_wire.t_next - ts;
+
+				for (int k = 0; k < 8; k++)
+				{	if (s_wire.t_valid[k] <= ts)	{	setup = ts - s_wire.t_valid[k];	break;	}
+					hold = s_wire.t_valid[k] - ts;
+				}
+				if (setup < s_rx_stat.setup_min)	{	s_rx_stat.setup_min = setup;	}
+				if (hold < s_rx_stat.hold_min)		{	s_rx_stat.hold_min = hold;		}
+				s_rx_stat.setup_sum += setup;
+				s_rx_stat.sample++;
+			}
+
+			// DMA is faster than RMII, take every byte at once
+			while (pio_sim_fifo_get(&sm->rxf, &v))
+			{	sim_rx_dma_t	*dma = &s_rx_dma[sm_no];
+
+				if (dma->len < (int)sizeof(dma->buf))	{	dma->buf[dma->len++] = v >> 24;	}
+			}
+		}
+
+		// ----- ISR, single CPU serves end-of-frame IRQ in ring order like rx_sm_isr_handler()
+		if (isr_idx >= 0 && t >= isr_end)
+		{	int		sm_no = sm_list[isr_idx];
+
+			pio.irq &= ~(1 << sm_no);	// resume SM
+			resume[sm_no] = t;
+			if (!s_opt.no_restore && sm_cnt > 1 && (pio.irq & (1 << sm_list[(isr_idx != 0) ? isr_idx - 1 : sm_cnt - 1])))
+			{	restore_sm = sm_no;		// previous SM finished next frame, baton came while waiting ISR
+			}
+			isr_next = (isr_idx != (sm_cnt - 1)) ? isr_idx + 1 : 0;
+			isr_idx = -1;
+		}
+		if (isr_idx < 0)
+		{	for (int k = 0; k < sm_cnt; k++)
+			{	int		i = (isr_next + k) % sm_cnt, sm_no = sm_list[i];
+
+				if ((pio.irq & (1 << sm_no)) && pio.sm[sm_no].irq_waiting)
+				{	rx_capture(s_rx_dma[sm_no].buf, s_rx_dma[sm_no].len);
+					s_rx_dma[sm_no].len = 0;
+					isr_idx = i;
+					isr_end = t + s_opt.isr_cycles;
+					break;
+				}
+			}
+		}
+
+		// ISR margin : SM released by ISR before preamble of the frame it receives
+		for (int i = 0; i < sm_cnt; i++)
+		{	int		sm_no = sm_list[i];
+
+			if (resume[sm_no] && s_wire.frame_start[0] > resume[sm_no])
+			{	uint64_t	m = s_wire.frame_start[0] - resume[sm_no];
+
+				// with N SM, SM receives every N-th frame
+				if (sm_cnt == 1 || m > 0)
+				{	if (m < s_rx_stat.isr_margin_min)	{	s_rx_stat.isr_margin_min = m;	}
+					resume[sm_no] = 0;
+				}
+			}
+		}
+
+		if (s_wire.done)
+		{	if (drain_end == 0)	{	drain_end = t + 2000 + s_opt.isr_cycles * 2;	}
+			if (t >= drain_end)	{	break;	}
+		}
+	}
+
+	s_rx_stat.sent = s_frame_cnt;
+	s_rx_stat.lost += s_frame_cnt - s_rx_stat.expect;
+	if (!verbose)	{	return (s_rx_stat.ok == s_rx_stat.sent) ? 0 : 1;	}
+
+	printf("RX %s (%d SM), %d Mbps, IPG %d ns, toggle %d, pre %d, PHY delay %d ns, jitter %d ns, ISR %d cycles, %llu cycles\n",
+		prog.name, sm_cnt, s_opt.speed, s_opt.ipg_ns, s_opt.toggle, s_opt.pre, s_opt.phy_delay, s_opt.jitter, s_opt.isr_cycles,
+		(unsigned long long)pio.cycle);
+	printf("FRAME SENT %d OK %d LOST %d CORRUPT %d LEN-LONG %d LEN-SHORT %d DEADLOCK %d RESTORE %d\n",
+		s_rx_stat.sent, s_rx_stat.ok, s_rx_stat.lost, s_rx_stat.corrupt, s_rx_stat.len_long, s_rx_stat.len_short,
+		s_rx_stat.deadlock, s_rx_stat.restore);
+	if (s_rx_stat.sample)
+	{	printf("SAMPLE %u, setup (RXD transition ~ sampling) min %u avg %.1f ns, hold (sampling ~ next transition) min %u ns\n",
+			s_rx_stat.sample, s_rx_stat.setup_min, (double)s_rx_stat.setup_sum / s_rx_stat.sample, s_rx_stat.hold_min);
+	}
+	if (s_rx_stat.isr_margin_min != 0xffffffff)
+	{	printf("ISR MARGIN (SM resume ~ its next preamble) min %u cycles\n", s_rx_stat.isr_margin_min);
+	}
+	for (int i = 0; i < sm_cnt; i++)	{	prt_steps(&pio, sm_list[i]);	}
+
+	return (s_rx_stat.ok == s_rx_stat.sent) ? 0 : 1;
+}
+
+static int run_sweep(void)
+{	// lost frames against burst length, same frames (seed) for each RX SM count
+	static const int	sm_num[] = {	1, 2, 4	};
+
+	printf("RX sweep, %d frames per point, len %d:%d, IPG %d ns, burst gap %d ns, ISR %d cycles%s\n",
+		s_opt.gen, s_opt.len_min, s_opt.len_max, s_opt.ipg_ns, s_opt.burst_gap_ns, s_opt.isr_cycles,
+		s_opt.no_restore ? ", no baton restore" : "");
+	printf("BURST");
+	for (int j = 0; j < 3; j++)	{	printf("   %d-SM LOST%%  DEADLOCK", sm_num[j]);	}
+	printf("\n");
+
+	for (int b = 1; b <= s_opt.sweep; b++)
+	{	printf("%5d", b);
+		for (int j = 0; j < 3; j++)
+		{	free(s_frame);
+			s_frame = NULL;
+			s_frame_cnt = 0;
+			srand(s_opt.seed);
+			s_opt.burst = b;
+			s_opt.rx_sm = sm_num[j];
+			frame_gen();
+
+			if (run_rx(0) < 0)	{	return 2;	}
+			printf("   %11.2f  %8d", 100.0 * s_rx_stat.lost / s_rx_stat.sent, s_rx_stat.deadlock);
+		}
+		printf("\n");
+	}
+	return 0;
+}
+
+// ------------------------------------------------------------------
+// - TX
+// ------------------------------------------------------------------
+static int run_tx(void)
+{	static pio_sim_program_t	prog;
+	static pio_sim_t			pio;
+	static uint8_t				rx_dibit[(SIM_FRAME_LEN + 64) * 4];
+	char						path[512];
+	int							feed = 0, feed_pos = 0, expect = 0, n_dibit = 0, prev_en = 0;
+	int							ok = 0, merged = 0, bad = 0, bad_pre = 0;
+	uint64_t					feed_at = 64, last_end = 0, ipg_min = ~0ull, drain_end = 0, en_at = 0;
+
+	snprintf(path, sizeof(path), "%s/rmii_ethernet_phy_tx.pio", s_opt.src);
+	if (pio_sim_asm(&prog, path, NULL) != 0)	{	return -1;	}
+	if (prog_speed(&prog, path, 0xa042, "nop side 0") != 0)	{	return -1;	}	// mov y, y side 0
+
+	pio_sim_init(&pio);
+	pio_sim_sm_t	*sm = &pio.sm[SIM_SM_TX];
+
+	pio_sim_sm_init(&pio, SIM_SM_TX, &prog);
+	sm->in_base = SIM_CLK_PIN;
+	sm->out_base = sm->set_base = SIM_TX_PIN;
+	sm->out_count = sm->set_count = 2;
+	sm->side_base = SIM_TX_PIN + 2;
+	sm->out_shift_right = 1;
+	sm->autopull = 1;
+	sm->pull_thresh = 8;
+	sm->clkdiv = s_opt.clk_per_dibit << 8;
+	sm->enabled = 1;
+
+	while (1)
+	{	uint64_t	t = pio.cycle;
+
+		pio.pins_in = (((t & 1) == 0) << SIM_CLK_PIN);
+
+		// ----- TX SM ISR : 'irq 0 rel' after IPG, starts DMA of next frame once previous one was fed
+		if (pio.irq & (1 << SIM_SM_TX))
+		{	pio.irq &= ~(1 << SIM_SM_TX);
+			if (feed_at == 0)	{	feed_at = t + s_opt.tx_gap;	}
+		}
+
+		// ----- DMA, byte write to txf+3 is replicated to every byte lane
+		if (feed < s_frame_cnt && feed_at != 0 && t >= feed_at && sm->txf.count < PIO_SIM_FIFO_DEPTH)
+		{	pio_sim_fifo_put(&sm->txf, s_frame[feed].data[feed_pos] * 0x01010101u);
+			if (++feed_pos == s_frame[feed].len)
+			{	feed++;
+				feed_pos = 0;
+				feed_at = 0;				// DMA idle until TX SM ISR
+			}
+		}
+
+		// ----- PHY samples TXD at rising edge, at 10Mbps every 10th from the middle of first dibit
+		if ((t & 1) == 0)
+		{	int		en = (pio.pins_out >> (SIM_TX_PIN + 2)) & 1;
+
+			if (en)
+			{	if (!prev_en)
+				{	if (last_end && t - last_end < ipg_min)	{	ipg_min = t - last_end;	}
+					n_dibit = 0;
+					en_at = t;
+				}
+				if (((t - en_at) / 2) % s_opt.clk_per_dibit == (uint64_t)s_opt.clk_per_dibit / 2
+					&& n_dibit < (int)sizeof(rx_dibit))
+				{	rx_dibit[n_dibit++] = (pio.pins_out >> SIM_TX_PIN) & 0x03;
+				}
+			}
+			else if (prev_en)
+			{	static uint8_t	frame[SIM_FRAME_LEN + 64];
+				int				len = n_dibit / 4;
+
+				for (int i = 0; i < len; i++)
+				{	frame[i] = rx_dibit[i*4] | (rx_dibit[i*4+1] << 2) | (rx_dibit[i*4+2] << 4) | (rx_dibit[i*4+3] << 6);
+				}
+				if (len < 8 || memcmp(frame, "\x55\x55\x55\x55\x55\x55\x55\xd5", 8) != 0)	{	bad_pre++;	}
+				else if (expect < s_frame_cnt && len - 8 == s_frame[expect].len
+						 && memcmp(&frame[8], s_frame[expect].data, s_frame[expect].len) == 0)
+				{	ok++;
+					expect++;
+				}
+				else if (expect < s_frame_cnt && len - 8 > s_frame[expect].len
+						 && memcmp(&frame[8], s_frame[expect].data, s_frame[expect].len) == 0)
+				{	merged++;
+					while (expect < s_frame_cnt && len - 8 > 0)	{	len -= s_frame[expect++].len;	}
+				}
+				else
+				{	bad++;
+					expect++;
+				}
+				last_end = t;
+			}
+			prev_en = en;
+		}
+
+		pio_sim_step(&pio);
+
+		if (feed == s_frame_cnt && sm->txf.count == 0 && sm->osr_cnt >= 8)
+		{	if (drain_end == 0)	{	drain_end = t + 400 * s_opt.clk_per_dibit;	}
+			if (t >= drain_end)	{	break;	}
+		}
+	}
+
+	printf("TX %s, %d Mbps, TX SM ISR gap %d cycles, %llu cycles\n", prog.name, s_opt.speed, s_opt.tx_gap,
+		(unsigned long long)pio.cycle);
+	printf("FRAME SENT %d OK %d MERGED %d BAD %d BAD-PREAMBLE %d\n", s_frame_cnt, ok, merged, bad, bad_pre);
+	if (ipg_min != ~0ull)	{	printf("IPG min %llu ns\n", (unsigned long long)ipg_min * SIM_NS_PER_CYCLE);	}
+	prt_steps(&pio, SIM_SM_TX);
+
+	return (ok == s_frame_cnt) ? 0 : 1;
+}
+
+// ------------------------------------------------------------------
+// - MDIO
+// ------------------------------------------------------------------
+#define SIM_MDIO_PIN		14				// MDIO, MDC = +1
+#define SIM_MDIO_PHY		1				// PHYAD of PHY model, others read 0xffff by pull-up
+
+static int run_mdio(void)
+{	static pio_sim_program_t	prog;
+	static pio_sim_t			pio;
+	char						path[512];
+	uint16_t					reg[32];
+	int							ok = 0, bad = 0, conflict = 0, n_rd = 0, n_wr = 0;
+	int							mdc = 0, mdio = 1, busy = 0, addr = 0, ra = 0, rd = 0, val = 0;
+	uint64_t					rise = 0, fall = 0, change = 0, start = 0, t_rd = 0, t_wr = 0;
+	uint64_t					period_min = ~0ull, high_min = ~0ull, low_min = ~0ull, setup_min = ~0ull, hold_min = ~0ull;
+	struct
+	{	int			ones, pos, drive, bit;		// pos : bits after preamble, 0 = idle
+		uint32_t	sr, hdr;				// hdr : ST, OP, PHYAD, REGAD
+		int			next_drive, next_bit;
+		uint64_t	next_at;					// output delay after rising edge
+	} phy = {	0	};
+
+	snprintf(path, sizeof(path), "%s/rmii_ethernet_phy_mdio.pio", s_opt.src);
+	if (pio_sim_asm(&prog, path, NULL) != 0)	{	return -1;	}
+
+	for (int i = 0; i < 32; i++)	{	reg[i] = rand();	}
+
+	pio_sim_init(&pio);
+	pio_sim_sm_t	*sm = &pio.sm[0];
+
+	pio_sim_sm_init(&pio, 0, &prog);
+	sm->in_base = sm->out_base = sm->set_base = SIM_MDIO_PIN;
+	sm->out_count = sm->set_count = 1;
+	sm->side_base = SIM_MDIO_PIN + 1;
+	sm->out_shift_right = sm->in_shift_right = 0;				// MSB first
+	sm->autopull = 1;
+	sm->pull_thresh = sm->push_thresh = 32;
+	sm->clkdiv = (100 * 1000 * 1000 / (4 * 1250000)) << 8;	// MDIO_SM_HZ of rmii_hal_rp2040.c
+	sm->osr_cnt = 32;										// 'out null, 32' by rmii_ethernet_phy_mdio_init()
+	sm->enabled = 1;
+
+	for (int n = 0; n < s_opt.gen || busy; )
+	{	uint64_t	t = pio.cycle;
+
+		// ----- driver, rmii_hal_mdio_start() & rmii_hal_mdio_result()
+		if (!busy && t >= start + 100)
+		{	addr = (rand() % 8) ? SIM_MDIO_PHY : rand() % 32;
+			ra = rand() % 32;
+			rd = rand() & 1;
+			val = rand() & 0xffff;
+			pio_sim_fifo_put(&sm->txf, rd ? 45 : 63);
+			pio_sim_fifo_put(&sm->txf, 0xffffffff);
+			pio_sim_fifo_put(&sm->txf, (1u << 30) | ((rd ? 2u : 1u) << 28) | (addr << 23) | (ra << 18) | (2u << 16) | (rd ? 0 : val));
+			busy = 1;
+			start = t;
+			n++;
+		}
+		else if (busy)
+		{	uint32_t	v;
+
+			if (pio_sim_fifo_get(&sm->rxf, &v))
+			{	int		expect = rd ? ((addr == SIM_MDIO_PHY) ? reg[ra] : 0xffff) : 0;
+
+				if (!rd && addr == SIM_MDIO_PHY && reg[ra] != val)	{	bad++;	}
+				else if (v != (uint32_t)expect)						{	bad++;	}
+				else												{	ok++;	}
+				if (rd)	{	n_rd++;	t_rd += t - start;	}
+				else	{	n_wr++;	t_wr += t - start;	}
+				busy = 0;
+			}
+		}
+
+		// ----- bus, SM drives while pindir is set, else PHY or pull-up
+		if (phy.next_at && t >= phy.next_at)
+		{	phy.drive = phy.next_drive;
+			phy.bit = phy.next_bit;
+			phy.next_at = 0;
+		}
+		int		sm_drive = (pio.pindirs >> SIM_MDIO_PIN) & 1;
+		int		bus = sm_drive ? (int)((pio.pins_out >> SIM_MDIO_PIN) & 1) : phy.drive ? (int)phy.bit : 1;
+
+		if (sm_drive && phy.drive)	{	conflict++;	}
+		if (bus != mdio)
+		{	if (sm_drive && rise && t - rise < hold_min)	{	hold_min = t - rise;	}
+			mdio = bus;
+			change = t;
+		}
+		pio.pins_in = (uint32_t)bus << SIM_MDIO_PIN;
+
+		// ----- PHY samples MDIO at rising edge of MDC, drives TA '0' & DATA of read after it
+		int		clk = (pio.pins_out >> (SIM_MDIO_PIN + 1)) & 1;
+
+		if (clk && !mdc)
+		{	if (rise && t - rise < period_min)	{	period_min = t - rise;	}
+			if (fall && t - fall < low_min)		{	low_min = t - fall;	}
+			if (sm_drive && t - change < setup_min)	{	setup_min = t - change;	}
+			rise = t;
+
+			if (phy.pos == 0)
+			{	if (bus)					{	phy.ones++;	}
+				else if (phy.ones >= 32)	{	phy.pos = 1;	phy.sr = 0;	}
+				else						{	phy.ones = 0;	}
+			}
+			else
+			{	phy.pos++;
+				phy.sr = (phy.sr << 1) | bus;
+				if (phy.pos == 14)
+				{	phy.hdr = phy.sr;
+					if ((phy.hdr >> 12) != 1)	{	phy.pos = phy.ones = 0;	}	// bad ST
+				}
+				else if (phy.pos > 14 && ((phy.hdr >> 10) & 3) == 2)	// read, TA 'Z' at 15, DATA[15] ~ DATA[0] after 16 ~ 31
+				{	int		k = phy.pos - 15;
+
+					if (((phy.hdr >> 5) & 0x1f) != SIM_MDIO_PHY || k > 16)
+					{	phy.next_drive = 0;
+						phy.pos = phy.ones = 0;
+					}
+					else
+					{	phy.next_drive = 1;
+						phy.next_bit = (k == 0) ? 0 : (reg[phy.hdr & 0x1f] >> (16 - k)) & 1;
+					}
+					phy.next_at = t + s_opt.mdio_delay / SIM_NS_PER_CYCLE;
+				}
+				else if (phy.pos == 32)		// write, TA '10' & DATA
+				{	if (((phy.hdr >> 10) & 3) == 1 && ((phy.hdr >> 5) & 0x1f) == SIM_MDIO_PHY && ((phy.sr >> 16) & 3) == 2)
+					{	reg[phy.hdr & 0x1f] = phy.sr & 0xffff;
+					}
+					phy.pos = phy.ones = 0;
+				}
+			}
+		}
+		else if (!clk && mdc)
+		{	if (t - rise < high_min)	{	high_min = t - rise;	}
+			fall = t;
+		}
+		mdc = clk;
+
+		pio_sim_step(&pio);
+	}
+
+	printf("MDIO %s, %d transactions (read %d, write %d), MDC %d kHz, PHY output delay %d ns, %llu cycles\n",
+		prog.name, ok + bad, n_rd, n_wr, (int)(1000000 / (period_min * SIM_NS_PER_CYCLE)), s_opt.mdio_delay,
+		(unsigned long long)pio.cycle);
+	printf("OK %d BAD %d CONFLICT %d\n", ok, bad, conflict);
+	printf("MDC period min %llu ns, high min %llu ns, low min %llu ns\n", (unsigned long long)period_min * SIM_NS_PER_CYCLE,
+		(unsigned long long)high_min * SIM_NS_PER_CYCLE, (unsigned long long)low_min * SIM_NS_PER_CYCLE);
+	printf("MDIO by SM, setup min %llu ns, hold min %llu ns\n", (unsigned long long)setup_min * SIM_NS_PER_CYCLE,
+		(unsigned long long)hold_min * SIM_NS_PER_CYCLE);
+	if (n_rd)	{	printf("READ avg %.1f us\n", t_rd * SIM_NS_PER_CYCLE / 1000.0 / n_rd);	}
+	if (n_wr)	{	printf("WRITE avg %.1f us\n", t_wr * SIM_NS_PER_CYCLE / 1000.0 / n_wr);	}
+	prt_steps(&pio, 0);
+
+	return (bad == 0 && conflict == 0 && period_min >= 40) ? 0 : 1;
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(a, "--tx") == 0)				{	s_opt.tx = 1;			continue;	}
+		if (strcmp(a, "--pcap-time") == 0)		{	s_opt.pcap_time = 1;	continue;	}
+		if (strcmp(a, "--no-restore") == 0)		{	s_opt.no_restore = 1;	continue;	}
+		if (strcmp(a, "--mdio") == 0)			{	s_opt.mdio = 1;			continue;	}
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		i++;
+		if (strcmp(a, "--rx-sm") == 0)			{	s_opt.rx_sm = atoi(v);			}
+		else if (strcmp(a, "--speed") == 0)		{	s_opt.speed = atoi(v);			}
+		else if (strcmp(a, "--pcap") == 0)		{	s_opt.pcap = v;					}
+		else if (strcmp(a, "--gen") == 0)		{	s_opt.gen = atoi(v);			}
+		else if (strcmp(a, "--len") == 0)
+		{	s_opt.len_min = s_opt.len_max = atoi(v);
+			if (strchr(v, ':') != NULL)			{	s_opt.len_max = atoi(strchr(v, ':') + 1);	}
+		}
+		else if (strcmp(a, "--ipg") == 0)		{	s_opt.ipg_ns = atoi(v);			}
+		else if (strcmp(a, "--burst") == 0)		{	s_opt.burst = atoi(v);			}
+		else if (strcmp(a, "--burst-gap") == 0)	{	s_opt.burst_gap_ns = atoi(v);	}
+		else if (strcmp(a, "--toggle") == 0)	{	s_opt.toggle = atoi(v) & ~1;	}
+		else if (strcmp(a, "--pre") == 0)		{	s_opt.pre = atoi(v);			}
+		else if (strcmp(a, "--jitter") == 0)	{	s_opt.jitter = atoi(v);			}
+		else if (strcmp(a, "--phy-delay") == 0)	{	s_opt.phy_delay = atoi(v);		}
+		else if (strcmp(a, "--isr") == 0)		{	s_opt.isr_cycles = atoi(v);		}
+		else if (strcmp(a, "--tx-gap") == 0)	{	s_opt.tx_gap = atoi(v);			}
+		else if (strcmp(a, "--poll") == 0)		{	s_opt.poll = atoi(v);			}
+		else if (strcmp(a, "--mdio-delay") == 0)	{	s_opt.mdio_delay = atoi(v);	}
+		else if (strcmp(a, "--sweep") == 0)		{	s_opt.sweep = atoi(v);			}
+		else if (strcmp(a, "--seed") == 0)		{	s_opt.seed = atoi(v);			}
+		else if (strcmp(a, "--src") == 0)		{	s_opt.src = v;					}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+	}
+	if (s_opt.speed != 10 && s_opt.speed != 100)	{	fprintf(stderr, "--speed %d : 10 or 100\n", s_opt.speed);	return 2;	}
+	if (s_opt.jitter < 0 || s_opt.jitter > 9 || s_opt.phy_delay < 0 || s_opt.phy_delay > 19)
+	{	fprintf(stderr, "--jitter 0 ~ 9, --phy-delay 0 ~ 19 (ns)\n");
+		return 2;
+	}
+	s_opt.clk_per_dibit = 100 / s_opt.speed;
+	if (s_opt.ipg_ns == 0)	{	s_opt.ipg_ns = 960 * s_opt.clk_per_dibit;	}
+	srand(s_opt.seed);
+
+	if (s_opt.mdio)		{	return run_mdio();	}
+	if (s_opt.sweep)	{	return run_sweep();	}
+	if (s_opt.pcap != NULL)	{	if (frame_load_pcap(s_opt.pcap) != 0)	{	return 2;	}	}
+	else					{	frame_gen();	}
+
+	return s_opt.tx ? run_tx() : run_rx(1);
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Replay frame size distributions against RX buffer models of src/rmii_ethernet.c
+
+	rx_arena_bench [options]
+		--dist <name|all>	ack, imix, tcp, mtu, uniform (default all)
+		--frames <n>		frames to replay (default 100000)
+		--burst <n>			back-to-back frames at 100Mbps & 960ns IPG, then idle (default 16)
+		--idle <us>			idle time between bursts (default 200)
+		--svc <us>			poll loop service time per frame, CRC + LwIP input (default 10)
+		--hold <pct>		percent of frames kept by LwIP, TCP out-of-order queue... (default 5)
+		--hold-us <us>		time LwIP keeps a held frame (default 2000)
+		--mem <bytes>		RX buffer memory of both models (default 4 x max frame, 15520 = 10 slots of RMII_RX_SLOT)
+		--seed <n>
+
+	Models (same memory)
+		slot  : fixed slots of max frame, all but 2 lent to LwIP at most (default)
+		arena : src/rx_arena.h, one arena per RX SM borrowing from the other if full, a quarter of memory lent to LwIP at most (USE_RX_ARENA)
+
+	Reports lost frames (no buffer armed when frame arrived), occupancy, fragmentation
+	and host time of buffer management per frame
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rx_arena.h"
+
+// ------------------------------------------------------------------
+// - Config, same as src/rmii_ethernet.c for RP2040
+// ------------------------------------------------------------------
+#define BENCH_HDR			28				// sizeof(rx_frame_t) at RP2040
+#define BENCH_FRAME_LEN		(1514+4+6)		// ETH_FRAME_LEN
+#define BENCH_NEED			(BENCH_HDR + BENCH_FRAME_LEN)
+#define BENCH_RX_SM			2
+#define BENCH_MEM_MAX		(64*1024)
+#define BENCH_READY			64				// MAX_RX_READY
+#define BENCH_IPG_NS		960
+#define BENCH_NS_PER_BYTE	80				// 100Mbps
+
+static struct
+{	const char*		dist;
+	int				frames;
+	int				burst;
+	int				idle_us;
+	int				svc_us;
+	int				hold;
+	int				hold_us;
+	int				mem;
+	unsigned		seed;
+} s_opt = {	.dist = "all", .frames = 100000, .burst = 16, .idle_us = 200, .svc_us = 10,
+			.hold = 5, .hold_us = 2000, .mem = 4 * BENCH_NEED, .seed = 1	};
+
+// ------------------------------------------------------------------
+// - Frame size distributions, length with FCS
+// ------------------------------------------------------------------
+typedef struct
+{	const char*		name;
+	int				n;
+	int				len[4];
+	int				weight[4];				// n == 0 : uniform 64 ~ 1518
+} dist_t;
+
+static const dist_t			s_dist[] =
+{	{	"ack",		1,	{	64	},				{	1	}			},
+	{	"imix",		3,	{	64, 594, 1518	},	{	7, 4, 1	}		},
+	{	"tcp",		2,	{	1518, 64	},		{	9, 1	}		},	// iperf server, data + some ACK/ARP
+	{	"mtu",		1,	{	1518	},			{	1	}			},
+	{	"uniform",	0,	{	0	},				{	0	}			},
+};
+
+static int dist_len(const dist_t *d)
+{	int		sum = 0, r;
+
+	if (d->n == 0)	{	return 64 + rand() % (1518 - 64 + 1);	}
+
+	for (int i = 0; i < d->n; i++)	{	sum += d->weight[i];	}
+	r = rand() % sum;
+	for (int i = 0; i < d->n; i++)
+	{	if (r < d->weight[i])	{	return d->len[i];	}
+		r -= d->weight[i];
+	}
+	return d->len[0];
+}
+
+// ------------------------------------------------------------------
+// - Buffer models
+// ------------------------------------------------------------------
+typedef struct
+{	const char*		name;
+	void			(*init)(void);
+	void*			(*arm)(int sm);						// NULL if no buffer
+	void			(*commit)(int sm, void *h, int len);
+	void			(*release)(void *h);
+	int				(*size)(void *h);					// bytes counted for LwIP held limit
+	int				(*held)(void);						// max lent to LwIP, in unit of size()
+	uint32_t		(*frag)(void);
+	uint32_t		use, use_max, frm, frm_max;
+} model_t;
+
+// ----- slot
+static struct
+{	int				state[BENCH_MEM_MAX / BENCH_NEED];
+	int				n;
+	int				last;
+} s_slot;
+
+static void slot_init(void)
+{	memset(&s_slot, 0, sizeof(s_slot));
+	s_slot.n = s_opt.mem / BENCH_NEED;
+}
+
+static void *slot_arm(int sm)
+{	int		idx = s_slot.last;
+	(void)sm;
+
+	for (int i = 0; i < s_slot.n; i++)
+	{	idx = (idx != (s_slot.n - 1)) ? idx + 1 : 0;
+		if (s_slot.state[idx] == 0)
+		{	s_slot.state[idx] = 1;
+			s_slot.last = idx;
+			return &s_slot.state[idx];
+		}
+	}
+	return NULL;
+}
+
+static void slot_commit(int sm, void *h, int len)	{	(void)sm;	(void)h;	(void)len;	}
+static void slot_release(void *h)					{	*(int*)h = 0;	}
+static int slot_size(void *h)						{	(void)h;	return 1;	}
+static int slot_held(void)							{	return s_slot.n - 2;	}
+static uint32_t slot_frag(void)						{	return 0;	}
+
+// ----- arena
+static uint32_t				s_arena_buf[BENCH_RX_SM][BENCH_MEM_MAX / BENCH_RX_SM / 4];
+static rx_arena_t			s_arena[BENCH_RX_SM];
+
+static void arena_init(void)
+{	for (int i = 0; i < BENCH_RX_SM; i++)	{	rx_arena_init(&s_arena[i], s_arena_buf[i], s_opt.mem / BENCH_RX_SM);	}
+}
+
+static void *arena_arm(int sm)		// own arena first, then borrow like rx_frame_alloc()
+{	for (int i = 0; i < BENCH_RX_SM; i++)
+	{	int				idx = (sm + i) % BENCH_RX_SM;
+		rx_arena_blk_t	*blk = rx_arena_reserve(&s_arena[idx], BENCH_NEED);
+
+		if (blk != NULL)
+		{	blk->state = 1;
+			blk->user = idx;
+			return blk;
+		}
+	}
+	return NULL;
+}
+
+static void arena_commit(int sm, void *h, int len)	{	(void)sm;	rx_arena_commit(&s_arena[((rx_arena_blk_t*)h)->user], h, BENCH_HDR + len);	}
+static void arena_release(void *h)					{	rx_arena_release(&s_arena[((rx_arena_blk_t*)h)->user], h, 0);	}
+static int arena_size(void *h)						{	return ((rx_arena_blk_t*)h)->size;	}
+static int arena_held(void)							{	return s_opt.mem / 4;	}
+
+static uint32_t arena_frag(void)
+{	uint32_t	sum = 0;
+
+	for (int i = 0; i < BENCH_RX_SM; i++)	{	sum += s_arena[i].frag;	}
+	return sum;
+}
+
+static model_t				s_model[] =
+{	{	"slot",		slot_init,	slot_arm,	slot_commit,	slot_release,	slot_size,	slot_held,	slot_frag,	0, 0, 0, 0	},
+	{	"arena",	arena_init,	arena_arm,	arena_commit,	arena_release,	arena_size,	arena_held,	arena_frag,	0, 0, 0, 0	},
+};
+
+// ------------------------------------------------------------------
+// - Replay
+// ------------------------------------------------------------------
+typedef struct
+{	void*			h;
+	int				sm;
+	int				len;
+	uint64_t		t;						// ready time (ns)
+} bench_frame_t;
+
+typedef struct
+{	uint32_t		offered, lost, q_full, copied, held_max;
+} bench_result_t;
+
+static bench_frame_t		s_ready[BENCH_READY];
+static int					s_ready_head, s_ready_rear;
+static bench_frame_t		s_held[BENCH_READY];
+static int					s_held_cnt;
+
+static void model_use(model_t *m, int bytes, int frm)
+{	m->use += bytes;
+	m->frm += frm;
+	if (m->use > m->use_max)	{	m->use_max = m->use;	}
+	if (m->frm > m->frm_max)	{	m->frm_max = m->frm;	}
+}
+
+static void bench_release(model_t *m, bench_frame_t *f, int *held)
+{	if (held != NULL)	{	*held -= m->size(f->h);	}
+	model_use(m, -(m == &s_model[0] ? BENCH_NEED : m->size(f->h)), -1);
+	m->release(f->h);
+}
+
+static void bench_consume(model_t *m, bench_result_t *r, uint64_t now, uint64_t *busy, int *held)
+{	// LwIP releases held frames
+	for (int i = 0; i < s_held_cnt; )
+	{	if (s_held[i].t <= now)
+		{	bench_release(m, &s_held[i], held);
+			s_held[i] = s_held[--s_held_cnt];
+		}
+		else	{	i++;	}
+	}
+
+	// poll loop handles a frame per 'svc'
+	while (s_ready_head != s_ready_rear)
+	{	bench_frame_t	*f = &s_ready[s_ready_rear];
+		uint64_t		done = ((*busy > f->t) ? *busy : f->t) + (uint64_t)s_opt.svc_us * 1000;
+
+		if (done > now)	{	break;	}
+		*busy = done;
+		s_ready_rear = (s_ready_rear != (BENCH_READY - 1)) ? s_ready_rear + 1 : 0;
+
+		if ((rand() % 100) < s_opt.hold && s_held_cnt < BENCH_READY)
+		{	if (*held + m->size(f->h) <= m->held())
+			{	*held += m->size(f->h);
+				if ((uint32_t)*held > r->held_max)	{	r->held_max = *held;	}
+				s_held[s_held_cnt] = *f;
+				s_held[s_held_cnt++].t = done + (uint64_t)s_opt.hold_us * 1000;
+				continue;
+			}
+			r->copied++;
+		}
+		bench_release(m, f, NULL);
+	}
+}
+
+static void bench_run(model_t *m, const dist_t *d, bench_result_t *r)
+{	void*		cur[BENCH_RX_SM];
+	uint64_t	now = 0, busy = 0;
+	int			held = 0;					// bytes (arena) or slots lent to LwIP, one counter for simplicity
+
+	memset(r, 0, sizeof(*r));
+	m->init();
+	m->use = m->use_max = m->frm = m->frm_max = 0;
+	s_ready_head = s_ready_rear = s_held_cnt = 0;
+	srand(s_opt.seed);
+
+	for (int i = 0; i < BENCH_RX_SM; i++)	{	cur[i] = m->arm(i);	}
+
+	for (int i = 0; i < s_opt.frames; i++)
+	{	int		sm = i % BENCH_RX_SM;
+		int		len = dist_len(d);
+
+		if (i != 0 && (i % s_opt.burst) == 0)	{	now += (uint64_t)s_opt.idle_us * 1000;	}
+		now += (uint64_t)(len + 8) * BENCH_NS_PER_BYTE;	// preamble + frame, end-of-frame
+		r->offered++;
+
+		bench_consume(m, r, now, &busy, &held);
+
+		// end-of-frame ISR
+		if (cur[sm] == NULL)	{	r->lost++;	}
+		else
+		{	int		head = (s_ready_head != (BENCH_READY - 1)) ? s_ready_head + 1 : 0;
+
+			if (head == s_ready_rear)	{	r->q_full++;	}
+			else
+			{	m->commit(sm, cur[sm], len);
+				model_use(m, (m == &s_model[0]) ? BENCH_NEED : m->size(cur[sm]), 1);
+				s_ready[s_ready_head] = (bench_frame_t){	.h = cur[sm], .sm = sm, .len = len, .t = now	};
+				s_ready_head = head;
+				cur[sm] = NULL;
+			}
+		}
+		if (cur[sm] == NULL)	{	cur[sm] = m->arm(sm);	}
+
+		now += BENCH_IPG_NS;
+	}
+}
+
+static double bench_time(model_t *m, const dist_t *d)
+{	// host time of arm + commit + release per frame, nothing held
+	enum	{	N = 1000000	};
+	static int		len[1024];
+	struct timespec	t0, t1;
+
+	srand(s_opt.seed);
+	for (int i = 0; i < 1024; i++)	{	len[i] = dist_len(d);	}
+	m->init();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int i = 0; i < N; i++)
+	{	int		sm = i % BENCH_RX_SM;
+		void	*h = m->arm(sm);
+
+		m->commit(sm, h, len[i & 1023]);
+		m->release(h);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / N;
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		i++;
+		if (strcmp(a, "--dist") == 0)			{	s_opt.dist = v;					}
+		else if (strcmp(a, "--frames") == 0)	{	s_opt.frames = atoi(v);			}
+		else if (strcmp(a, "--burst") == 0)		{	s_opt.burst = atoi(v);			}
+		else if (strcmp(a, "--idle") == 0)		{	s_opt.idle_us = atoi(v);		}
+		else if (strcmp(a, "--svc") == 0)		{	s_opt.svc_us = atoi(v);			}
+		else if (strcmp(a, "--hold") == 0)		{	s_opt.hold = atoi(v);			}
+		else if (strcmp(a, "--hold-us") == 0)	{	s_opt.hold_us = atoi(v);		}
+		else if (strcmp(a, "--mem") == 0)		{	s_opt.mem = atoi(v);			}
+		else if (strcmp(a, "--seed") == 0)		{	s_opt.seed = atoi(v);			}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+	}
+	if (s_opt.burst < 1)	{	s_opt.burst = 1;	}
+	if (s_opt.mem < 2 * BENCH_NEED || s_opt.mem > BENCH_MEM_MAX)	{	fprintf(stderr, "--mem : %d ~ %d\n", 2 * BENCH_NEED, BENCH_MEM_MAX);	return 2;	}
+
+	printf("FRAMES %d BURST %d IDLE %dus SVC %dus HOLD %d%% %dus MEMORY %d\n",
+		s_opt.frames, s_opt.burst, s_opt.idle_us, s_opt.svc_us, s_opt.hold, s_opt.hold_us, s_opt.mem);
+	printf("DIST     MODEL   LOST   LOST%%  Q-FULL  COPIED  USE-MAX%%  FRM-MAX  FRAG  NS/FRAME\n");
+
+	int		found = 0;
+
+	for (unsigned i = 0; i < sizeof(s_dist) / sizeof(s_dist[0]); i++)
+	{	if (strcmp(s_opt.dist, "all") != 0 && strcmp(s_opt.dist, s_dist[i].name) != 0)	{	continue;	}
+		found = 1;
+
+		for (unsigned j = 0; j < sizeof(s_model) / sizeof(s_model[0]); j++)
+		{	model_t			*m = &s_model[j];
+			bench_result_t	r;
+
+			bench_run(m, &s_dist[i], &r);
+
+			uint32_t	frag = m->frag();
+			double		ns = bench_time(m, &s_dist[i]);		// re-initializes the model
+
+			printf("%-8s %-6s %6u %6.2f %7u %7u %9u %8u %5u %9.1f\n", s_dist[i].name, m->name,
+				r.lost, 100.0 * r.lost / r.offered, r.q_full, r.copied,
+				(m->use_max * 100) / s_opt.mem,
+				m->frm_max, frag, ns);
+		}
+	}
+	if (!found)	{	fprintf(stderr, "%s : unknown distribution\n", s_opt.dist);	return 2;	}
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Slot recycling & copied bytes of RX frames lent to LwIP (src/rx_lend.h), no LwIP needed
+
+	rx_lend_test [options]
+		--frames <n>		frames of stress phase (default 200000)
+		--hold <n>			percent of lent frames LwIP keeps for a while (default 50, TCP out-of-order queue)
+		--seed <n>			random seed (default 1)
+
+	Models the RX path of src/rmii_ethernet.c, fixed slots (RMII_RX_SLOT) and USE_RX_ARENA :
+		'ISR'		: each of RMII_RX_SM_NUM SMs has a frame armed, at end-of-frame it is committed & the SM re-armed,
+					  no frame armed = frame discarded (NO-SLOT)
+		'LwIP'		: rx_lend_take() lends the frame (custom free returns it by rx_lend_back()), or copies it
+					  (COPIED & BYTES) and releases the slot at once
+	Phases per model :
+		hold		: LwIP keeps every frame, frames up to the limit are lent, remains are copied, then LwIP frees all,
+					  every lent slot must come back and the same number is lent again
+		stress		: random frame length, LwIP keeps --hold % of lent frames & frees them out of order
+	Exit 1 if a frame is discarded (fixed slots), accounting is wrong or a slot is not returned.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rmii_ethernet/depth.h"
+#include "rx_arena.h"
+#include "rx_lend.h"
+
+#define ETH_FRAME_LEN		1514
+#define TEST_KEEP			256					// frames LwIP keeps at most
+#define TEST_SM				RMII_RX_SM_NUM
+
+enum
+{	TEST_FREE = RX_ARENA_FREE,
+	TEST_DMA,
+	TEST_LWIP,
+};
+
+typedef struct
+{	rx_arena_blk_t			blk;				// as rx_frame_t, user = pool index
+	uint16_t				len;
+	uint32_t				seq;
+	uint8_t					data[];
+} test_frame_t;
+#define TEST_FRAME_NEED		RX_ARENA_ALIGN(sizeof(test_frame_t) + ETH_FRAME_LEN)
+#define TEST_POOL			(RMII_RX_SLOT * TEST_FRAME_NEED)
+
+static struct
+{	uint32_t		frames;
+	uint32_t		hold;
+	unsigned		seed;
+} s_opt = {	.frames = 200000, .hold = 50, .seed = 1	};
+
+static uint32_t				s_pool[TEST_POOL / 4];
+static rx_arena_t			s_arena[TEST_SM];
+static rx_lend_t			s_lend[TEST_SM];
+static test_frame_t*		s_cur[TEST_SM];		// frame armed per SM
+static int					s_use_arena, s_pool_num, s_last;
+static test_frame_t*		s_keep[TEST_KEEP];	// lent frames kept by LwIP
+static int					s_keep_num;
+
+static struct
+{	uint64_t		lent, copied, copied_bytes, freed;
+	uint64_t		no_slot;
+	uint64_t		bad;						// accounting mismatch or slot state
+} s_stat;
+
+// ------------------------------------------------------------------
+// - RX path model
+// ------------------------------------------------------------------
+static test_frame_t *slot_of(int idx)	{	return (test_frame_t*)((uint8_t*)s_pool + idx * TEST_FRAME_NEED);	}
+
+static uint32_t held_unit(test_frame_t *f)	{	return s_use_arena ? f->blk.size : 1;	}
+
+static test_frame_t *frame_alloc(int sm)		// as rx_frame_alloc()
+{	if (s_use_arena)
+	{	int		idx = sm;
+
+		for (int i = 0; i < TEST_SM; i++)
+		{	test_frame_t	*f = (test_frame_t*)rx_arena_reserve(&s_arena[idx], TEST_FRAME_NEED);
+
+			if (f != NULL)	{	f->blk.user = idx;	f->blk.state = TEST_DMA;	return f;	}
+			idx = (idx != TEST_SM - 1) ? idx + 1 : 0;
+		}
+		return NULL;
+	}
+	for (int i = 0, idx = s_last; i < RMII_RX_SLOT; i++)
+	{	idx = (idx != RMII_RX_SLOT - 1) ? idx + 1 : 0;
+		if (slot_of(idx)->blk.state == TEST_FREE)
+		{	s_last = idx;
+			slot_of(idx)->blk.state = TEST_DMA;
+			return slot_of(idx);
+		}
+	}
+	return NULL;
+}
+
+static void frame_release(test_frame_t *f)
+{	if (f->blk.state != TEST_LWIP && f->blk.state != TEST_DMA)	{	s_stat.bad++;	}
+	if (s_use_arena)	{	rx_arena_release(&s_arena[f->blk.user], &f->blk, 0);	}
+	else				{	f->blk.state = TEST_FREE;	}
+}
+
+static void frame_free(test_frame_t *f)		// custom free of LwIP, as rx_frame_pbuf_free()
+{	if (f->blk.state != TEST_LWIP)	{	s_stat.bad++;	}
+	rx_lend_back(&s_lend[f->blk.user], held_unit(f));
+	frame_release(f);
+	s_stat.freed++;
+}
+
+static void frame_input(test_frame_t *f, int keep)	// LwIP context, as rx_frame_input()
+{	uint8_t		copy[ETH_FRAME_LEN];
+
+	if (rx_lend_take(&s_lend[f->blk.user], held_unit(f)))
+	{	f->blk.state = TEST_LWIP;
+		s_stat.lent++;
+		if (keep && s_keep_num < TEST_KEEP)	{	s_keep[s_keep_num++] = f;	}
+		else								{	frame_free(f);				}
+	}
+	else
+	{	memcpy(copy, f->data, f->len);			// PBUF_POOL, slot goes back at once
+		s_stat.copied++;
+		s_stat.copied_bytes += f->len;
+		frame_release(f);
+	}
+}
+
+static void frame_rx(uint32_t seq, int len, int keep)	// ISR end-of-frame of next SM, then poll loop
+{	int				sm = seq % TEST_SM;
+	test_frame_t	*f = s_cur[sm];
+
+	s_cur[sm] = NULL;
+	if (f == NULL)	{	s_stat.no_slot++;	}
+	else
+	{	f->len = len;
+		f->seq = seq;
+		memset(f->data, (uint8_t)seq, len);
+		if (s_use_arena)	{	rx_arena_commit(&s_arena[f->blk.user], &f->blk, sizeof(test_frame_t) + len);	}
+	}
+	for (int i = 0; i < TEST_SM; i++)
+	{	if (s_cur[i] == NULL)	{	s_cur[i] = frame_alloc(i);	}	// re-arm, retry SMs left without frame
+	}
+	if (f != NULL)	{	frame_input(f, keep);	}
+}
+
+static void keep_free(int idx)
+{	frame_free(s_keep[idx]);
+	s_keep[idx] = s_keep[--s_keep_num];
+}
+
+static void model_init(int use_arena)
+{	s_use_arena = use_arena;
+	s_pool_num = use_arena ? TEST_SM : 1;
+	s_last = 0;
+	s_keep_num = 0;
+	memset(s_pool, 0, sizeof(s_pool));
+	memset(&s_stat, 0, sizeof(s_stat));
+
+	if (use_arena)
+	{	uint32_t	size = (sizeof(s_pool) / TEST_SM) & ~3u;
+
+		for (int i = 0; i < TEST_SM; i++)
+		{	rx_arena_init(&s_arena[i], (uint8_t*)s_pool + i * size, size);
+			rx_lend_init(&s_lend[i], s_arena[i].size / 4);
+		}
+	}
+	else
+	{	for (int i = 0; i < RMII_RX_SLOT; i++)	{	slot_of(i)->blk.size = TEST_FRAME_NEED;	}
+		rx_lend_init(&s_lend[0], RMII_RX_HELD);
+	}
+	for (int i = 0; i < TEST_SM; i++)	{	s_cur[i] = frame_alloc(i);	}
+}
+
+static int model_check(void)			// held units match kept frames, only armed frames remain after all are freed
+{	uint64_t	held[TEST_SM] = {	0	};
+	int			bad = 0;
+
+	for (int i = 0; i < s_keep_num; i++)	{	held[s_keep[i]->blk.user] += held_unit(s_keep[i]);	}
+	for (int i = 0; i < s_pool_num; i++)
+	{	bad += (s_lend[i].held != held[i] || s_lend[i].held > s_lend[i].max);
+	}
+	if (s_keep_num == 0)
+	{	int		busy = 0;
+
+		if (s_use_arena)	{	for (int i = 0; i < TEST_SM; i++)	{	busy += rx_arena_frames(&s_arena[i]);	}	}
+		else				{	for (int i = 0; i < RMII_RX_SLOT; i++)	{	busy += (slot_of(i)->blk.state != TEST_FREE);	}	}
+		bad += (busy != (s_use_arena ? 0 : TEST_SM));	// arena counts committed frames, armed ones are reserved only
+	}
+	return bad;
+}
+
+// ------------------------------------------------------------------
+// - Phases
+// ------------------------------------------------------------------
+static int phase_hold(const char *name, int len)
+{	uint64_t	lent[2], copied, bytes;
+	int			bad = 0;
+
+	for (int round = 0; round < 2; round++)
+	{	uint64_t	l = s_stat.lent, c = s_stat.copied, b = s_stat.copied_bytes;
+
+		for (int i = 0; i < 64; i++)	{	frame_rx(i, len, 1);	}
+		lent[round] = s_stat.lent - l;
+		copied = s_stat.copied - c;
+		bytes = s_stat.copied_bytes - b;
+		bad += model_check();
+		while (s_keep_num > 0)	{	keep_free(s_keep_num / 2);	}	// out of order
+		bad += model_check();
+	}
+	bad += (lent[0] == 0 || lent[1] != lent[0] || lent[0] + copied != 64 || bytes != copied * len);
+	bad += (s_stat.freed != lent[0] + lent[1] || s_stat.no_slot != 0 || s_stat.bad != 0);
+
+	printf("%-5s hold   len %4d : LENT %llu AGAIN %llu COPIED %llu BYTES %llu (%llu/frame) FREED %llu NO-SLOT %llu => %s\n",
+		name, len, (unsigned long long)lent[0], (unsigned long long)lent[1], (unsigned long long)copied,
+		(unsigned long long)bytes, (unsigned long long)(copied ? bytes / copied : 0), (unsigned long long)s_stat.freed,
+		(unsigned long long)s_stat.no_slot, bad ? "FAIL" : "OK");
+	return bad;
+}
+
+static int phase_stress(const char *name)
+{	unsigned	seed = s_opt.seed;
+	int			bad = 0;
+
+	for (uint32_t i = 0; i < s_opt.frames; i++)
+	{	int		len = 60 + rand_r(&seed) % (ETH_FRAME_LEN - 60 + 1);
+
+		frame_rx(i, len, (uint32_t)(rand_r(&seed) % 100) < s_opt.hold);
+		if (s_keep_num > 0 && rand_r(&seed) % 2)	{	keep_free(rand_r(&seed) % s_keep_num);	}
+		if ((i & 1023) == 0)	{	bad += model_check();	}
+	}
+	while (s_keep_num > 0)	{	keep_free(rand_r(&seed) % s_keep_num);	}
+	bad += model_check();
+	bad += (s_stat.freed != s_stat.lent || s_stat.bad != 0);
+	bad += (!s_use_arena && s_stat.no_slot != 0);		// RMII_RX_HELD keeps a slot per RX SM, arena reports only
+
+	printf("%-5s stress %u frames : LENT %llu COPIED %llu BYTES %llu (%.1f/frame) FREED %llu NO-SLOT %llu => %s\n",
+		name, s_opt.frames, (unsigned long long)s_stat.lent, (unsigned long long)s_stat.copied,
+		(unsigned long long)s_stat.copied_bytes, s_opt.frames ? (double)s_stat.copied_bytes / s_opt.frames : 0.0,
+		(unsigned long long)s_stat.freed, (unsigned long long)s_stat.no_slot, bad ? "FAIL" : "OK");
+	return bad;
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{	static const char	*name[] = {	"slot", "arena"	};
+	int					bad = 0;
+
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		i++;
+		if (strcmp(a, "--frames") == 0)			{	s_opt.frames = strtoul(v, NULL, 0);	}
+		else if (strcmp(a, "--hold") == 0)		{	s_opt.hold = strtoul(v, NULL, 0);	}
+		else if (strcmp(a, "--seed") == 0)		{	s_opt.seed = strtoul(v, NULL, 0);	}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+	}
+	if (s_opt.hold > 100)	{	fprintf(stderr, "bad --hold\n");	return 2;	}
+
+	for (int m = 0; m < 2; m++)
+	{	model_init(m);
+		bad += phase_hold(name[m], ETH_FRAME_LEN);
+		model_init(m);
+		bad += phase_hold(name[m], 64);
+		model_init(m);
+		bad += phase_stress(name[m]);
+	}
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	RX priority admission (src/rx_prio.h) under overload, same slot & ready ring handling as rx_sm_isr_run()
+
+	rx_prio_test [options]
+		--frames <n>		frames on wire (default 1000000)
+		--sm <n>			RX SMs receiving in turn (default 2)
+		--slots <n>			RX slots, MAX_RX_FRAME (default sm + 6)
+		--ring <n>			ready ring, MAX_RX_READY (default 64)
+		--ctrl <n>			1-in-n frame is not bulk TCP (ARP, PTP, PCP 6, PCP 4, TCP ACK) (default 32)
+		--poll-ns <n>		poll loop cost per frame (default 6000)
+		--byte-ns <n>		poll loop cost per byte (default 80), default drains 1518 bytes frames slower than 100Mbps
+		--reserve <c,r,s>	reserve ring entries 'r' & slots 's' for class 'c', repeatable (default RMII_PRIO_DEFAULT_RING & _SLOT)
+		--seed <n>
+
+	Back-to-back frames at 100Mbps : bulk TCP 1518 bytes (class 0) mixed with control frames of each rule,
+	poll loop drains the ready ring slower than the wire. A frame is lost if dropped by ISR (ring full,
+	headroom) or received while its SM had no slot. Same traffic runs with admission off & on (default rules),
+	exit 1 if admission on loses a frame of highest class or rx_prio_class() disagrees with the generator.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rx_ring.h"
+#include "rx_prio.h"
+
+#define TEST_SLOT_MAX		64
+#define TEST_RING_MAX		1024
+#define TEST_KIND			6
+
+static struct
+{	uint64_t		frames;
+	int				sm;
+	int				slots;
+	int				ring;
+	int				ctrl;
+	int				poll_ns;
+	int				byte_ns;
+	int				reserve_ring[RMII_PRIO_CLASS];
+	int				reserve_slot[RMII_PRIO_CLASS];
+	unsigned		seed;
+} s_opt = {	.frames = 1000000, .sm = 2, .ring = 64, .ctrl = 32, .poll_ns = 6000, .byte_ns = 80, .seed = 1,
+			.reserve_ring = RMII_PRIO_DEFAULT_RING, .reserve_slot = RMII_PRIO_DEFAULT_SLOT	};
+
+// ------------------------------------------------------------------
+// - Traffic, real headers so rx_prio_class() runs on bytes
+// ------------------------------------------------------------------
+typedef struct
+{	const char*		name;
+	int				len;						// with FCS
+	int				cls;						// expected class of RMII_PRIO_DEFAULT_RULES()
+	uint8_t			hdr[24];					// from destination MAC
+	int				hdr_len;
+} kind_t;
+
+#define MAC_HDR		0xb8, 0x27, 0xeb, 1, 2, 3,  0x02, 0, 0, 0, 0, 1
+
+static const kind_t			s_kind[TEST_KIND] =
+{	{	"tcp",		1518,	0,	{	MAC_HDR, 0x08, 0x00, 0x45, 0, 0x05, 0xdc, 0, 0, 0x40, 0, 64, 6	},				24	},
+	{	"ack",		70,		1,	{	MAC_HDR, 0x08, 0x00, 0x45, 0, 0x00, 0x34, 0, 0, 0x40, 0, 64, 6	},				24	},
+	{	"pcp4",		200,	2,	{	MAC_HDR, 0x81, 0x00, 0x80, 0x0a, 0x08, 0x00	},								18	},
+	{	"arp",		64,		3,	{	MAC_HDR, 0x08, 0x06, 0, 1, 0x08, 0x00, 6, 4, 0, 2	},							22	},
+	{	"ptp",		90,		3,	{	MAC_HDR, 0x88, 0xf7, 0x00, 0x02	},										16	},
+	{	"pcp6",		100,	3,	{	MAC_HDR, 0x81, 0x00, 0xc0, 0x0a, 0x08, 0x00	},								18	},
+};
+
+static uint8_t				s_data[TEST_KIND][1518];
+
+// ------------------------------------------------------------------
+// - ISR & poll loop model
+// ------------------------------------------------------------------
+typedef struct
+{	int				busy;						// not RX_SLOT_FREE
+	int				kind;
+} slot_t;
+
+static slot_t				s_slot[TEST_SLOT_MAX];
+static slot_t*				s_cur[TEST_SLOT_MAX];	// slot of each SM, NULL = discard
+static int					s_last;
+static void* volatile		s_ring_slot[TEST_RING_MAX];
+static rx_ring_t			s_ring;
+static rx_prio_t			s_prio;
+
+static slot_t*				s_svc;				// frame in poll loop
+static uint64_t				s_svc_done, s_cons_t;
+
+static struct
+{	uint64_t		sent[RMII_PRIO_CLASS], lost[RMII_PRIO_CLASS];
+	uint64_t		no_slot, full, headroom, bad_class;
+} s_stat;
+
+static slot_t* slot_alloc(void)					// rx_frame_alloc()
+{	for (int i = 0; i < s_opt.slots; i++)
+	{	s_last = (s_last != (s_opt.slots - 1)) ? s_last + 1 : 0;
+		if (!s_slot[s_last].busy)	{	s_slot[s_last].busy = 1;	return &s_slot[s_last];	}
+	}
+	return NULL;
+}
+
+static uint32_t slot_room(int sm)				// rx_frame_room()
+{	int		n = 0;
+
+	for (int i = 0; i < s_opt.slots; i++)	{	n += !s_slot[i].busy;	}
+	for (int i = 0; i < s_opt.sm; i++)		{	n -= (i != sm && s_cur[i] == NULL);	}
+	return (n > 0) ? n : 0;
+}
+
+static void poll_run(uint64_t t)				// drain ready ring until time t, a slot is freed when its frame is done
+{	while (1)
+	{	if (s_svc != NULL)
+		{	if (s_svc_done > t)	{	return;	}
+			s_svc->busy = 0;
+			s_cons_t = s_svc_done;
+			s_svc = NULL;
+		}
+		if (rx_ring_empty(&s_ring))	{	s_cons_t = t;	return;	}
+
+		s_svc = rx_ring_get(&s_ring);
+		s_svc_done = s_cons_t + s_opt.poll_ns + (uint64_t)s_kind[s_svc->kind].len * s_opt.byte_ns;
+	}
+}
+
+static void isr_run(int sm, int kind)			// end of frame of 'sm', rx_sm_isr_run()
+{	slot_t		*f = s_cur[sm];
+	const kind_t	*k = &s_kind[kind];
+
+	s_stat.sent[k->cls]++;
+	if (f == NULL)
+	{	s_stat.no_slot++;
+		s_stat.lost[k->cls]++;
+	}
+	else
+	{	int		cls = rx_prio_class(&s_prio, s_data[kind], k->len);
+
+		if (s_prio.rule_num != 0 && cls != k->cls)	{	s_stat.bad_class++;	}
+
+		if (rx_ring_full(&s_ring))
+		{	s_stat.full++;
+			s_stat.lost[k->cls]++;
+		}
+		else if (!rx_prio_admit(&s_prio, cls, s_opt.ring - 1 - rx_ring_count(&s_ring), slot_room(sm)))
+		{	s_stat.headroom++;
+			s_stat.lost[k->cls]++;
+		}
+		else
+		{	f->kind = kind;
+			rx_ring_put(&s_ring, f);
+			f = NULL;
+		}
+	}
+	s_cur[sm] = (f != NULL) ? f : slot_alloc();
+}
+
+static void run(int on)
+{	static const rmii_prio_rule_t	rule[] = RMII_PRIO_DEFAULT_RULES();
+	unsigned	seed = s_opt.seed;
+	uint64_t	t = 0;
+
+	memset(&s_stat, 0, sizeof(s_stat));
+	memset(s_slot, 0, sizeof(s_slot));
+	s_last = s_opt.slots - 1;
+	s_svc = NULL;
+	s_cons_t = 0;
+	rx_ring_init(&s_ring, s_ring_slot, s_opt.ring);
+
+	rx_prio_init(&s_prio);
+	if (on)
+	{	rx_prio_rule(&s_prio, rule, sizeof(rule) / sizeof(rule[0]));
+		for (int i = 1; i < RMII_PRIO_CLASS; i++)	{	rx_prio_reserve(&s_prio, i, s_opt.reserve_ring[i], s_opt.reserve_slot[i]);	}
+	}
+	for (int i = 0; i < s_opt.sm; i++)	{	s_cur[i] = slot_alloc();	}
+
+	for (uint64_t n = 0; n < s_opt.frames; n++)
+	{	int		kind = (rand_r(&seed) % s_opt.ctrl == 0) ? 1 + rand_r(&seed) % (TEST_KIND - 1) : 0;
+
+		t += (uint64_t)(s_kind[kind].len + 20) * 80;	// preamble, SFD & IPG at 100Mbps
+		poll_run(t);
+		isr_run(n % s_opt.sm, kind);
+	}
+
+	printf("%-4s", on ? "ON" : "OFF");
+	for (int i = 0; i < RMII_PRIO_CLASS; i++)
+	{	printf("  %2d:%7llu/%-8llu %5.2f%%", i, (unsigned long long)s_stat.lost[i], (unsigned long long)s_stat.sent[i],
+			s_stat.sent[i] ? s_stat.lost[i] * 100.0 / s_stat.sent[i] : 0);
+	}
+	printf("  NO-SLOT/FULL/HEADROOM %llu %llu %llu\n", (unsigned long long)s_stat.no_slot,
+		(unsigned long long)s_stat.full, (unsigned long long)s_stat.headroom);
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{	int		fail;
+
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+		int			c, r, s;
+
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		if (strcmp(a, "--frames") == 0)			{	s_opt.frames = strtoull(v, NULL, 0);	}
+		else if (strcmp(a, "--sm") == 0)		{	s_opt.sm = atoi(v);	}
+		else if (strcmp(a, "--slots") == 0)		{	s_opt.slots = atoi(v);	}
+		else if (strcmp(a, "--ring") == 0)		{	s_opt.ring = atoi(v);	}
+		else if (strcmp(a, "--ctrl") == 0)		{	s_opt.ctrl = atoi(v);	}
+		else if (strcmp(a, "--poll-ns") == 0)	{	s_opt.poll_ns = atoi(v);	}
+		else if (strcmp(a, "--byte-ns") == 0)	{	s_opt.byte_ns = atoi(v);	}
+		else if (strcmp(a, "--seed") == 0)		{	s_opt.seed = atoi(v);	}
+		else if (strcmp(a, "--reserve") == 0 && sscanf(v, "%d,%d,%d", &c, &r, &s) == 3 && c > 0 && c < RMII_PRIO_CLASS)
+		{	s_opt.reserve_ring[c] = r;
+			s_opt.reserve_slot[c] = s;
+		}
+		else									{	fprintf(stderr, "%s %s : unknown option\n", a, v);	return 2;	}
+		i++;
+	}
+	if (s_opt.slots == 0)	{	s_opt.slots = s_opt.sm + 6;	}
+	if (s_opt.sm < 1 || s_opt.sm > 4 || s_opt.slots <= s_opt.sm || s_opt.slots > TEST_SLOT_MAX ||
+		s_opt.ring < 2 || s_opt.ring > TEST_RING_MAX || s_opt.ctrl < 1)
+	{	fprintf(stderr, "--sm 1~4, --slots sm+1~%d, --ring 2~%d, --ctrl 1~\n", TEST_SLOT_MAX, TEST_RING_MAX);
+		return 2;
+	}
+
+	for (int i = 0; i < TEST_KIND; i++)
+	{	memset(s_data[i], 0x5a, sizeof(s_data[i]));
+		memcpy(s_data[i], s_kind[i].hdr, s_kind[i].hdr_len);
+	}
+
+	printf("SM %d SLOTS %d RING %d CTRL 1/%d POLL %dns + %dns/byte, LOST/SENT per class\n",
+		s_opt.sm, s_opt.slots, s_opt.ring, s_opt.ctrl, s_opt.poll_ns, s_opt.byte_ns);
+	run(0);
+	run(1);
+
+	fail = (s_stat.lost[RX_PRIO_TOP] != 0 || s_stat.bad_class != 0);
+	printf("CLASS %d LOST %llu BAD-CLASS %llu => %s\n", RX_PRIO_TOP, (unsigned long long)s_stat.lost[RX_PRIO_TOP],
+		(unsigned long long)s_stat.bad_class, fail ? "FAIL" : "OK");
+	return fail;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Stress & cost of src/rx_ring.h, the ISR -> poll loop ring of src/rmii_ethernet.c
+
+	rx_ring_test [options]
+		--items <n>			frames passed by producer thread (default 10000000)
+		--size <n>			ring slots (default 64, MAX_RX_READY)
+		--burst <n>			producer puts up to n frames then pauses a random time (default 16)
+		--bench <n>			frames of cost comparison (default 10000000, 0 = skip)
+
+	Stress : producer ('ISR') writes sequence & pattern into a frame of a pool, then puts it,
+	consumer ('poll loop') checks order, pattern and returns the frame to the pool by a flag,
+	like rx_frame_t.blk.state. Any lost, duplicated or torn frame fails the test (exit 1).
+
+	Cost : per frame time of
+		ring		: rx_ring_put() + rx_ring_get()
+		ring+sem	: same ring with a counting semaphore per frame (sem_post() / sem_wait()),
+					  like rmii_hal_rx_signal() / rmii_hal_rx_wait() before
+	in one thread (operation cost) and in two threads (handoff throughput)
+*/
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rx_ring.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define test_cycles()		__rdtsc()
+#else
+	#define test_cycles()		0ull
+#endif
+
+#define TEST_SIZE_MAX		1024
+#define TEST_POOL			(TEST_SIZE_MAX * 2)
+#define TEST_DATA			16
+
+static struct
+{	uint64_t		items;
+	int				size;
+	int				burst;
+	uint64_t		bench;
+} s_opt = {	.items = 10000000, .size = 64, .burst = 16, .bench = 10000000	};
+
+// ------------------------------------------------------------------
+// - Stress
+// ------------------------------------------------------------------
+typedef struct
+{	volatile int	busy;					// set by producer, cleared by consumer after reading
+	uint64_t		seq;
+	uint32_t		data[TEST_DATA];
+} test_frame_t;
+
+static test_frame_t			s_pool[TEST_POOL];
+static void* volatile		s_slot[TEST_SIZE_MAX];
+static rx_ring_t			s_ring;
+
+static struct
+{	uint64_t		full;					// producer found ring full
+	uint64_t		dropped;				// still full after yield, frame is dropped like rx_full, atomic
+	uint64_t		empty;					// consumer found ring empty
+	uint64_t		got;
+	uint64_t		bad_order, bad_data;
+} s_stat;
+
+static void *stress_producer(void *arg)
+{	unsigned	seed = 1;
+	int			pool_idx = 0;
+	(void)arg;
+
+	for (uint64_t seq = 0; seq < s_opt.items; )
+	{	int		n = 1 + rand_r(&seed) % s_opt.burst;
+
+		for (int i = 0; i < n && seq < s_opt.items; i++, seq++)
+		{	test_frame_t	*f = NULL;
+
+			// take a free frame, consumer releases out of this order only by timing
+			for (int k = 0; k < TEST_POOL; k++)
+			{	test_frame_t	*c = &s_pool[pool_idx];
+
+				pool_idx = (pool_idx != (TEST_POOL - 1)) ? pool_idx + 1 : 0;
+				if (!__atomic_load_n(&c->busy, __ATOMIC_ACQUIRE))	{	f = c;	break;	}
+			}
+			if (f != NULL && rx_ring_full(&s_ring))
+			{	s_stat.full++;
+				sched_yield();					// give consumer a chance on a single cpu, then drop like the ISR
+			}
+			if (f == NULL || rx_ring_full(&s_ring))
+			{	__atomic_fetch_add(&s_stat.dropped, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+
+			f->busy = 1;
+			f->seq = seq;
+			for (int k = 0; k < TEST_DATA; k++)	{	f->data[k] = (uint32_t)(seq * 2654435761u) + k;	}
+			rx_ring_put(&s_ring, f);
+		}
+		for (int k = rand_r(&seed) % 2000; k > 0; k--)	{	__asm__ volatile("" ::: "memory");	}
+		if ((rand_r(&seed) & 0xff) == 0)	{	sched_yield();	}
+	}
+	return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{	uint64_t	expect = 0;
+	(void)arg;
+
+	while (1)
+	{	test_frame_t	*f = rx_ring_get(&s_ring);
+
+		if (f == NULL)
+		{	s_stat.empty++;
+			if (s_stat.got + __atomic_load_n(&s_stat.dropped, __ATOMIC_RELAXED) >= s_opt.items)	{	break;	}
+			sched_yield();
+			continue;
+		}
+
+		if (f->seq < expect)	{	s_stat.bad_order++;	}	// dropped frames leave gaps, never go back
+		expect = f->seq + 1;
+		for (int k = 0; k < TEST_DATA; k++)
+		{	if (f->data[k] != (uint32_t)(f->seq * 2654435761u) + k)	{	s_stat.bad_data++;	break;	}
+		}
+		s_stat.got++;
+		__atomic_store_n(&f->busy, 0, __ATOMIC_RELEASE);		// like rx_frame_release()
+		if (s_stat.got + __atomic_load_n(&s_stat.dropped, __ATOMIC_RELAXED) >= s_opt.items)	{	break;	}
+	}
+	return NULL;
+}
+
+static int run_stress(void)
+{	pthread_t	prod, cons;
+
+	memset(&s_stat, 0, sizeof(s_stat));
+	memset(s_pool, 0, sizeof(s_pool));
+	rx_ring_init(&s_ring, s_slot, s_opt.size);
+
+	pthread_create(&cons, NULL, stress_consumer, NULL);
+	pthread_create(&prod, NULL, stress_producer, NULL);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+
+	int		ok = (s_stat.bad_order == 0 && s_stat.bad_data == 0 && s_stat.got + s_stat.dropped == s_opt.items
+				  && rx_ring_empty(&s_ring));
+
+	printf("STRESS size %d items %llu : GOT %llu FULL %llu DROPPED %llu EMPTY %llu BAD-ORDER %llu BAD-DATA %llu => %s\n",
+		s_opt.size, (unsigned long long)s_opt.items, (unsigned long long)s_stat.got,
+		(unsigned long long)s_stat.full, (unsigned long long)s_stat.dropped,
+		(unsigned long long)s_stat.empty, (unsigned long long)s_stat.bad_order, (unsigned long long)s_stat.bad_data,
+		ok ? "OK" : "FAIL");
+
+	return ok ? 0 : 1;
+}
+
+// ------------------------------------------------------------------
+// - Cost
+// ------------------------------------------------------------------
+static sem_t		s_sem;
+static int			s_use_sem;
+
+static uint64_t now_ns(void)
+{	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void *bench_producer(void *arg)
+{	(void)arg;
+
+	for (uint64_t i = 0; i < s_opt.bench; i++)
+	{	while (!rx_ring_put(&s_ring, &s_pool[i & (TEST_POOL - 1)]))	{	sched_yield();	}
+		if (s_use_sem)	{	sem_post(&s_sem);	}
+	}
+	return NULL;
+}
+
+static void bench_consume(uint64_t n)
+{	for (uint64_t i = 0; i < n; i++)
+	{	void	*p;
+
+		if (s_use_sem)	{	sem_wait(&s_sem);	}
+		while ((p = rx_ring_get(&s_ring)) == NULL)	{	sched_yield();	}
+		__asm__ volatile("" :: "r"(p) : "memory");
+	}
+}
+
+static void run_bench(void)
+{	static const char	*name[] = {	"ring", "ring+sem"	};
+
+	printf("COST %llu frames, size %d (%s)\n", (unsigned long long)s_opt.bench, s_opt.size,
+		test_cycles() ? "cycles by TSC" : "no cycle counter");
+	printf("%-10s %12s %12s %14s\n", "MODEL", "1T NS/FRM", "1T CYC/FRM", "2T NS/FRM");
+
+	for (int m = 0; m < 2; m++)
+	{	uint64_t	t0, c0, t1, c1, t2;
+		pthread_t	prod;
+
+		s_use_sem = m;
+		sem_init(&s_sem, 0, 0);
+		rx_ring_init(&s_ring, s_slot, s_opt.size);
+
+		// one thread : put & signal, then wait & get, pure operation cost
+		t0 = now_ns();
+		c0 = test_cycles();
+		for (uint64_t i = 0; i < s_opt.bench; i++)
+		{	rx_ring_put(&s_ring, &s_pool[i & (TEST_POOL - 1)]);
+			if (s_use_sem)	{	sem_post(&s_sem);	}
+			bench_consume(1);
+		}
+		c1 = test_cycles();
+		t1 = now_ns();
+
+		// two threads : producer & consumer run concurrently
+		pthread_create(&prod, NULL, bench_producer, NULL);
+		bench_consume(s_opt.bench);
+		pthread_join(prod, NULL);
+		t2 = now_ns();
+
+		printf("%-10s %12.1f %12.1f %14.1f\n", name[m],
+			(double)(t1 - t0) / s_opt.bench, (double)(c1 - c0) / s_opt.bench, (double)(t2 - t1) / s_opt.bench);
+		sem_destroy(&s_sem);
+	}
+}
+
+// ------------------------------------------------------------------
+// - main
+// ------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{	const char	*a = argv[i], *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (v == NULL)							{	fprintf(stderr, "%s : value missing\n", a);	return 2;	}
+		i++;
+		if (strcmp(a, "--items") == 0)			{	s_opt.items = strtoull(v, NULL, 0);	}
+		else if (strcmp(a, "--size") == 0)		{	s_opt.size = atoi(v);				}
+		else if (strcmp(a, "--burst") == 0)		{	s_opt.burst = atoi(v);				}
+		else if (strcmp(a, "--bench") == 0)		{	s_opt.bench = strtoull(v, NULL, 0);	}
+		else									{	fprintf(stderr, "%s : unknown option\n", a);	return 2;	}
+	}
+	if (s_opt.size < 2 || s_opt.size > TEST_SIZE_MAX || s_opt.burst < 1)	{	fprintf(stderr, "bad --size or --burst\n");	return 2;	}
+
+	int		rc = run_stress();
+
+	if (s_opt.bench)	{	run_bench();	}
+
+	return rc;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// LwIP port for the Linux host build, replaces src/lwip/sys_arch.c
+
+#define _GNU_SOURCE			// PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+
+#include <pthread.h>
+#include <time.h>
+
+#include "lwip/init.h"
+#include "lwip/sys.h"
+
+static pthread_mutex_t lwip_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+sys_prot_t sys_arch_protect(void) {
+    pthread_mutex_lock(&lwip_mutex);
+
+    return 0;
+}
+
+void sys_arch_unprotect(sys_prot_t pval) {
+    (void) pval;
+
+    pthread_mutex_unlock(&lwip_mutex);
+}
+
+uint32_t sys_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Convert hot path trace dump (netif_rmii_ethernet_trace_dump(), 'trace dump' of example shell)
+	to Chrome trace JSON, open by chrome://tracing or https://ui.perfetto.dev
+
+	trace_json <log> [out.json]		log : serial console capture, lines outside TRACE BEGIN ~ END are ignored
+									out : default stdout, percentiles of each event are printed to stderr
+
+	- a ring is a thread (ISR, RX, LWIP), time of a ring runs by cycle deltas from its first record
+	- rings start at their first usec timestamp, so cross ring alignment is +-1 usec (cores have own SysTick)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rmii_trace.h"
+
+static rmii_trace_ring_t	s_ring[RMII_TRACE_RING];
+static uint32_t				s_dur[RMII_TRACE_RING * RMII_TRACE_LEN / 2];
+
+static int trace_load(FILE *fp, uint32_t *hz)	// last dump of the log, return 0 if not found
+{	char		line[256];
+	int			found = 0, in = 0, ring = -1;
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{	unsigned	a, b;
+		int			idx;
+
+		if (sscanf(line, "TRACE BEGIN %u", &a) == 1)
+		{	memset(s_ring, 0, sizeof(s_ring));
+			*hz = a;
+			in = 1;
+			ring = -1;
+		}
+		else if (!in)											{	continue;	}
+		else if (strncmp(line, "TRACE END", 9) == 0)			{	in = 0;	found = 1;	}
+		else if (sscanf(line, "TRACE RING %d", &idx) == 1)		{	ring = (idx >= 0 && idx < RMII_TRACE_RING) ? idx : -1;	}
+		else if (ring >= 0 && sscanf(line, "%x %x", &a, &b) == 2 && s_ring[ring].head < RMII_TRACE_LEN)
+		{	s_ring[ring].rec[s_ring[ring].head].us = a;
+			s_ring[ring].rec[s_ring[ring].head].ev = b;
+			s_ring[ring].head++;
+		}
+	}
+	return found;
+}
+
+static void trace_json(FILE *out, uint32_t hz)
+{	static const char	ph[4] = {	'i', 'B', 'E', '?'	};
+	uint32_t			origin = 0;
+	int					first = 1, has = 0;
+
+	// earliest usec of all rings is 0
+	for (int i = 0; i < RMII_TRACE_RING; i++)
+	{	if (s_ring[i].head && (!has || (int32_t)(s_ring[i].rec[0].us - origin) < 0))
+		{	origin = s_ring[i].rec[0].us;
+			has = 1;
+		}
+	}
+
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (int i = 0; i < RMII_TRACE_RING; i++)
+	{	rmii_trace_ring_t	*r = &s_ring[i];
+		double				ts;
+
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", i, rmii_trace_ring_name(i));
+		first = 0;
+		if (r->head == 0)	{	continue;	}
+
+		ts = (double)(int32_t)(r->rec[0].us - origin);
+		for (uint32_t k = 0; k < r->head; k++)
+		{	uint32_t	ev = r->rec[k].ev;
+
+			if (k > 0)	{	ts += rmii_trace_cycles(&r->rec[k-1], &r->rec[k], hz) * 1e6 / hz;	}
+
+			fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+				rmii_trace_event_name(rmii_trace_id(ev)), ph[ev >> 30], ts, i,
+				(rmii_trace_phase(ev) == TR_INSTANT) ? ",\"s\":\"t\"" : "");
+		}
+	}
+	fprintf(out, "\n]}\n");
+}
+
+int main(int argc, char **argv)
+{	FILE		*fp, *out = stdout;
+	uint32_t	hz = 0;
+
+	if (argc < 2)
+	{	fprintf(stderr, "usage: %s <log> [out.json]\n", argv[0]);
+		return 1;
+	}
+	if ((fp = fopen(argv[1], "r")) == NULL)	{	perror(argv[1]);	return 1;	}
+	if (!trace_load(fp, &hz) || hz == 0)
+	{	fprintf(stderr, "%s: no TRACE BEGIN ~ TRACE END\n", argv[1]);
+		return 1;
+	}
+	fclose(fp);
+
+	if (argc > 2 && (out = fopen(argv[2], "w")) == NULL)	{	perror(argv[2]);	return 1;	}
+	trace_json(out, hz);
+	if (out != stdout)	{	fclose(out);	}
+
+	// percentiles to stderr, JSON may go to stdout
+	for (int i = 0; i < RMII_TRACE_RING; i++)	{	fprintf(stderr, "%-4s %u records\n", rmii_trace_ring_name(i), (unsigned)s_ring[i].head);	}
+	rmii_trace_report_all(stderr, s_ring, hz, s_dur);
+
+	return 0;
+}
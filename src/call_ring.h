@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Single producer / single consumer ring of function calls between application core & LwIP context, no lock
+
+	- same ordering as rx_ring.h : 'head' is written by producer only, 'rear' by consumer only,
+	  a message (and what 'arg' points to) is written before it is seen & read before its slot is reused
+	- a message moves a pointer, ownership of 'arg' (pbuf or buffer) passes with it, data is never copied
+	- one slot is kept empty : empty = (head == rear), full = (next of head == rear)
+*/
+
+#ifndef __CALL_RING_H__
+#define __CALL_RING_H__
+
+#include <stdint.h>
+
+#include "rmii_ethernet/call.h"
+
+typedef struct
+{	rmii_call_fn_t			fn;
+	void*					arg;
+} call_msg_t;
+
+typedef struct
+{	call_msg_t*				slot;
+	uint32_t				size;				// slots, holds size-1 messages
+	volatile uint32_t		head;				// next slot to put, producer
+	volatile uint32_t		rear;				// next slot to get, consumer
+} call_ring_t;
+
+static inline void call_ring_init(call_ring_t *r, call_msg_t *slot, uint32_t size)
+{	r->slot = slot;
+	r->size = size;
+	r->head = r->rear = 0;
+}
+
+static inline uint32_t call_ring_next(const call_ring_t *r, uint32_t x)	{	return (x != (r->size - 1)) ? x + 1 : 0;	}
+
+// producer : return 0 if full
+static inline int call_ring_put(call_ring_t *r, rmii_call_fn_t fn, void *arg)
+{	uint32_t	head = r->head;
+	uint32_t	next = call_ring_next(r, head);
+
+	if (next == __atomic_load_n(&r->rear, __ATOMIC_ACQUIRE))	{	return 0;	}
+
+	r->slot[head].fn = fn;
+	r->slot[head].arg = arg;
+	__atomic_store_n(&r->head, next, __ATOMIC_RELEASE);		// publish message to consumer
+	return 1;
+}
+
+// consumer : run up to 'budget' messages in order, return number run
+static inline int call_ring_run(call_ring_t *r, int budget)
+{	int		cnt = 0;
+
+	while (cnt < budget)
+	{	uint32_t	rear = r->rear;
+		call_msg_t	msg;
+
+		if (rear == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))	{	break;	}
+
+		msg = r->slot[rear];
+		__atomic_store_n(&r->rear, call_ring_next(r, rear), __ATOMIC_RELEASE);	// slot was read, producer may reuse it
+		msg.fn(msg.arg);
+		cnt++;
+	}
+	return cnt;
+}
+
+// either side, may be stale by the other side
+static inline uint32_t call_ring_count(call_ring_t *r)
+{	uint32_t	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE), rear = __atomic_load_n(&r->rear, __ATOMIC_ACQUIRE);
+
+	return (head >= rear) ? head - rear : head + r->size - rear;
+}
+
+#endif // __CALL_RING_H__
@@ -2,9 +2,19 @@
  * Calculate Ethernet FCS (CRC32) by zs
 */
 
+#include <stdint.h>
+
+#ifndef RMII_HAL_HOST
 #include "pico/stdlib.h"
+#else
+#define __time_critical_func(x)		x
+#endif
+
+#include "rmii_ethernet/fcs.h"
 
-#if 0 // software FCS (CRC32)
+// ------------------------------------------------------------------
+// - software FCS (CRC32), used when sniffer is occupied (USE_RX_INLINE_FCS)
+// ------------------------------------------------------------------
 const uint32_t crc32_tab[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
 	0xe963a535, 0x9e6495a3,	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -57,55 +67,275 @@ const uint32_t crc32_tab[] = {
  * of this function that's actually used in the kernel can be found
  * in sys/libkern.h, where it can be inlined.
  */
-uint32_t fcs_crc32(const uint8_t *buf, int size)
+uint32_t fcs_crc32_sw_update(uint32_t crc, const uint8_t *buf, int size)
 {   const uint8_t *p = buf;
-    uint32_t crc;
 
-    crc = ~0U;
+    crc = crc ^ ~0U;
     while (size--)
         crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
     return crc ^ ~0U;
 }
-#else // use DMA based hardware CRC engine called sniffer in pico
+
+uint32_t fcs_crc32_sw(const uint8_t *buf, int size)
+{   return fcs_crc32_sw_update(0, buf, size);
+}
+
+// ------------------------------------------------------------------
+// - slicing-by-4/8 software FCS, tables & code in RAM (no XIP cache miss), little endian
+// ------------------------------------------------------------------
+// a word of data looks up a table per byte, indexes are shifts & byte masks only (no bit field extract on M0+)
+static uint32_t				s_crc32_slice[8][256];	// [0] = crc32_tab, [k] = CRC of a byte followed by k zero bytes
+static int					s_crc32_slice_ok;
+
+static void fcs_slice_init(void)
+{	if (s_crc32_slice_ok)	{	return;	}
+
+	for (int i = 0; i < 256; i++)	{	s_crc32_slice[0][i] = crc32_tab[i];	}
+	for (int k = 1; k < 8; k++)
+	{	for (int i = 0; i < 256; i++)
+		{	uint32_t	c = s_crc32_slice[k-1][i];
+
+			s_crc32_slice[k][i] = (c >> 8) ^ s_crc32_slice[0][c & 0xff];
+		}
+	}
+	s_crc32_slice_ok = 1;
+}
+
+uint32_t __time_critical_func(fcs_crc32_s4_update)(uint32_t crc, const uint8_t *buf, int size)
+{	const uint32_t	(*t)[256] = (const uint32_t (*)[256])s_crc32_slice;
+	const uint32_t	*pw;
+
+	crc = ~crc;
+	for ( ; size > 0 && ((uintptr_t)buf & 3); size--)	{	crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);	}
+
+	for (pw = (const uint32_t*)buf; size >= 4; size -= 4)
+	{	uint32_t	a = *pw++ ^ crc;
+
+		crc = t[3][a & 0xff] ^ t[2][(a >> 8) & 0xff] ^ t[1][(a >> 16) & 0xff] ^ t[0][a >> 24];
+	}
+
+	for (buf = (const uint8_t*)pw; size > 0; size--)	{	crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);	}
+	return ~crc;
+}
+
+uint32_t __time_critical_func(fcs_crc32_s8_update)(uint32_t crc, const uint8_t *buf, int size)
+{	const uint32_t	(*t)[256] = (const uint32_t (*)[256])s_crc32_slice;
+	const uint32_t	*pw;
+
+	crc = ~crc;
+	for ( ; size > 0 && ((uintptr_t)buf & 3); size--)	{	crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);	}
+
+	for (pw = (const uint32_t*)buf; size >= 8; size -= 8)
+	{	uint32_t	a = pw[0] ^ crc, b = pw[1];
+
+		crc = t[7][a & 0xff] ^ t[6][(a >> 8) & 0xff] ^ t[5][(a >> 16) & 0xff] ^ t[4][a >> 24] ^
+			  t[3][b & 0xff] ^ t[2][(b >> 8) & 0xff] ^ t[1][(b >> 16) & 0xff] ^ t[0][b >> 24];
+		pw += 2;
+	}
+
+	for (buf = (const uint8_t*)pw; size > 0; size--)	{	crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);	}
+	return ~crc;
+}
+
+// ------------------------------------------------------------------
+// - software 16 bit ones-complement sum (IP/TCP/UDP checksum before inversion)
+// ------------------------------------------------------------------
+// same result as lwip_standard_chksum() : sum of halfwords as they are in memory, byte swapped if buf is odd
+uint16_t fcs_chksum_sw(const void *buf, int size)
+{	const uint8_t	*pb = (const uint8_t*)buf;
+	uint32_t		sum = 0;
+	uint16_t		t = 0;
+	int				odd = ((uintptr_t)pb & 1);
+
+	if (odd && size > 0)	{	((uint8_t*)&t)[1] = *pb++;	size--;	}
+
+	const uint16_t	*ps = (const uint16_t*)pb;
+
+	for ( ; size > 1; size -= 2)	{	sum += *ps++;	}
+	if (size > 0)	{	((uint8_t*)&t)[0] = *(const uint8_t*)ps;	}
+	sum += t;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	if (odd)	{	sum = ((sum & 0xff) << 8) | ((sum >> 8) & 0xff);	}
+	return (uint16_t)sum;
+}
+
+#ifndef RMII_HAL_HOST // sniffer is RP2040 only, host backend models it by software
+// ------------------------------------------------------------------
+// - use DMA based hardware CRC engine called sniffer in pico
+// ------------------------------------------------------------------
 #include "pico/mutex.h"
 #include "hardware/dma.h"
 
-uint32_t __time_critical_func(fcs_crc32)(const uint8_t *buf, int size)
-{	// calculate FCS using RP2040 sniffer engine, refer from pico-examples/dma/sniff_crc in sdk v.15
-	static int 					crc_dma = -1;
-	static dma_channel_config 	cfg;
-	static mutex_t 				mtx;
-	uint8_t				dummy_dest;
-	uint32_t			crc;
+#include "hal/rmii_hal.h"					// USE_RX_INLINE_FCS
 
-	if (crc_dma < 0)
-	{	crc_dma = dma_claim_unused_channel(true);
+#define FCS_CHKSUM_DMA_MIN		64					// shorter data is summed by software, DMA setup costs more
 
-		mutex_init(&mtx);
+static int 					s_fcs_dma = -1;		// DMA channel feeding sniffer, shared by CRC32 & checksum (-2 = none free)
+static dma_channel_config 	s_fcs_cfg_crc;		// 8 bit transfer
+static dma_channel_config 	s_fcs_cfg_sum;		// 16 bit transfer
+static uint32_t				s_fcs_sniff_crc;	// 'sniff_ctrl' register value for each calculation
+static uint32_t				s_fcs_sniff_sum;
+static int					s_fcs_sum_wide;		// sniffer adds halfword replicated to both lanes of bus
+static mutex_t 				s_fcs_mtx;			// between cores
 
-		cfg = dma_channel_get_default_config(crc_dma);
+static inline uint32_t fcs_bit_reverse(uint32_t x)
+{	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+	x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+	return (x >> 16) | (x << 16);
+}
 
-		channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
-		channel_config_set_read_increment(&cfg, true);
-		channel_config_set_write_increment(&cfg, false);
-		channel_config_set_sniff_enable(&cfg, true);
+static int fcs_dma_init(void)	// return 0 if no DMA channel is free
+{	if (s_fcs_dma != -1)	{	return s_fcs_dma >= 0;	}
 
-		dma_sniffer_enable(crc_dma, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
-		dma_sniffer_set_output_reverse_enabled(true);
-		dma_sniffer_set_output_invert_enabled(true);
+	if ((s_fcs_dma = dma_claim_unused_channel(false)) < 0)	// other peripherals took all, use software
+	{	s_fcs_dma = -2;
+		return 0;
 	}
 
-	mutex_enter_blocking(&mtx);
+	mutex_init(&s_fcs_mtx);
+
+	s_fcs_cfg_crc = dma_channel_get_default_config(s_fcs_dma);
+
+	channel_config_set_transfer_data_size(&s_fcs_cfg_crc, DMA_SIZE_8);
+	channel_config_set_read_increment(&s_fcs_cfg_crc, true);
+	channel_config_set_write_increment(&s_fcs_cfg_crc, false);
+	channel_config_set_sniff_enable(&s_fcs_cfg_crc, true);
+
+	s_fcs_cfg_sum = s_fcs_cfg_crc;
+	channel_config_set_transfer_data_size(&s_fcs_cfg_sum, DMA_SIZE_16);
+
+	// keep 'sniff_ctrl' of each mode, switched by a register write
+	dma_sniffer_enable(s_fcs_dma, DMA_SNIFF_CTRL_CALC_VALUE_SUM, true);
+	s_fcs_sniff_sum = dma_hw->sniff_ctrl;
 
-	dma_sniffer_set_data_accumulator(0xffffffff); // use 'dma_hw->sniff_data = 0xffffffff;' for sdk1.4
-	dma_channel_configure(crc_dma, &cfg, &dummy_dest, buf, size, true);
-	dma_channel_wait_for_finish_blocking(crc_dma);
+	dma_sniffer_enable(s_fcs_dma, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+	dma_sniffer_set_output_reverse_enabled(true);
+	dma_sniffer_set_output_invert_enabled(true);
+	s_fcs_sniff_crc = dma_hw->sniff_ctrl;
+
+	// probe how sniffer adds a halfword, 3 if as is, 0x00030003 if replicated to both lanes
+	uint16_t	probe[2] = {	1, 2	};
+	uint16_t	dummy_dest;
+
+	dma_hw->sniff_ctrl = s_fcs_sniff_sum;
+	dma_sniffer_set_data_accumulator(0);
+	dma_channel_configure(s_fcs_dma, &s_fcs_cfg_sum, &dummy_dest, probe, 2, true);
+	dma_channel_wait_for_finish_blocking(s_fcs_dma);
+	s_fcs_sum_wide = (dma_sniffer_get_data_accumulator() != 3);
+	return 1;
+}
+
+uint32_t __time_critical_func(fcs_crc32_dma_update)(uint32_t crc, const uint8_t *buf, int size)
+{	// calculate FCS using RP2040 sniffer engine, refer from pico-examples/dma/sniff_crc in sdk v.15
+	// 'crc' is the result of previous call (0 for first call) to calculate FCS of fragmented data
+	// channel is claimed by fcs_crc32_init() before this backend is selected
+	uint8_t				dummy_dest;
+
+	mutex_enter_blocking(&s_fcs_mtx);
+
+	// sniffer output is reversed & inverted, revert it to continue calculation (crc=0 => 0xffffffff)
+	dma_hw->sniff_ctrl = s_fcs_sniff_crc;
+	dma_sniffer_set_data_accumulator(~fcs_bit_reverse(crc)); // use 'dma_hw->sniff_data = ...;' for sdk1.4
+	dma_channel_configure(s_fcs_dma, &s_fcs_cfg_crc, &dummy_dest, buf, size, true);
+	dma_channel_wait_for_finish_blocking(s_fcs_dma);
 
 	crc = dma_sniffer_get_data_accumulator();
 
-	mutex_exit(&mtx);
+	mutex_exit(&s_fcs_mtx);
 
 	return crc;
 }
 
-#endif
\ No newline at end of file
+uint16_t __time_critical_func(fcs_chksum)(const void *buf, int size)
+{	// same as fcs_chksum_sw() by sniffer 'SUM' mode of 16 bit transfer, software while sniffer is owned by RX DMA
+	const uint8_t	*pb = (const uint8_t*)buf;
+	uint32_t		sum, acc;
+	uint16_t		t = 0, dummy_dest;
+	int				odd = ((uintptr_t)pb & 1);
+
+#ifdef USE_RX_INLINE_FCS	// sniffer is owned by RX DMA, rewriting 'sniff_ctrl' breaks FCS of received frame
+	return fcs_chksum_sw(buf, size);
+#endif
+	if (size < FCS_CHKSUM_DMA_MIN || !fcs_dma_init())	{	return fcs_chksum_sw(buf, size);	}
+
+	if (odd)	{	((uint8_t*)&t)[1] = *pb++;	size--;	}	// DMA needs aligned halfword
+	if (size & 1)	{	((uint8_t*)&t)[0] = pb[size - 1];	}
+
+	mutex_enter_blocking(&s_fcs_mtx);
+
+	dma_hw->sniff_ctrl = s_fcs_sniff_sum;
+	dma_sniffer_set_data_accumulator(0);
+	dma_channel_configure(s_fcs_dma, &s_fcs_cfg_sum, &dummy_dest, pb, size / 2, true);
+	dma_channel_wait_for_finish_blocking(s_fcs_dma);
+
+	acc = dma_sniffer_get_data_accumulator();
+
+	mutex_exit(&s_fcs_mtx);
+
+	// 32 bit accumulator never overflows (< 64K halfwords), fold it
+	if (s_fcs_sum_wide)
+	{	// acc = S + (S << 16) : low = S & 0xffff, high = (low + (S >> 16)) & 0xffff lost its carry,
+		// carry happened if high wrapped below low
+		uint32_t	lo = acc & 0xffff, hi = acc >> 16;
+
+		sum = hi + (hi < lo);
+	}
+	else
+	{	sum = (acc & 0xffff) + (acc >> 16);
+	}
+	sum += t;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	if (odd)	{	sum = ((sum & 0xff) << 8) | ((sum >> 8) & 0xff);	}
+	return (uint16_t)sum;
+}
+#else
+static int fcs_dma_init(void)	{	return 0;	}
+
+uint32_t fcs_crc32_dma_update(uint32_t crc, const uint8_t *buf, int size)
+{	return fcs_crc32_sw_update(crc, buf, size);
+}
+
+uint16_t fcs_chksum(const void *buf, int size)
+{	return fcs_chksum_sw(buf, size);
+}
+#endif // RMII_HAL_HOST
+
+// ------------------------------------------------------------------
+// - backend of fcs_crc32() & fcs_crc32_update()
+// ------------------------------------------------------------------
+static uint32_t				(*s_fcs_crc32_update)(uint32_t crc, const uint8_t *buf, int size) = fcs_crc32_sw_update;
+
+int fcs_crc32_init(int backend, int dma_ok)
+{	if (backend == RMII_FCS_AUTO || backend == RMII_FCS_DMA)
+	{	backend = (dma_ok && fcs_dma_init()) ? RMII_FCS_DMA : RMII_FCS_SLICE8;
+	}
+	fcs_slice_init();
+
+	switch (backend)
+	{	case RMII_FCS_DMA:		s_fcs_crc32_update = fcs_crc32_dma_update;	break;
+		case RMII_FCS_SLICE4:	s_fcs_crc32_update = fcs_crc32_s4_update;	break;
+		case RMII_FCS_SLICE8:	s_fcs_crc32_update = fcs_crc32_s8_update;	break;
+		default:				s_fcs_crc32_update = fcs_crc32_sw_update;	backend = RMII_FCS_TABLE;	break;
+	}
+	return backend;
+}
+
+const char* fcs_crc32_name(int backend)
+{	static const char* const	name[RMII_FCS_BACKEND] =	{	"auto", "dma", "table", "slice4", "slice8"	};
+
+	return (backend >= 0 && backend < RMII_FCS_BACKEND) ? name[backend] : "?";
+}
+
+uint32_t __time_critical_func(fcs_crc32_update)(uint32_t crc, const uint8_t *buf, int size)
+{	return s_fcs_crc32_update(crc, buf, size);
+}
+
+uint32_t __time_critical_func(fcs_crc32)(const uint8_t *buf, int size)
+{	return s_fcs_crc32_update(0, buf, size);
+}
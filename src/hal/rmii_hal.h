@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Hardware abstraction between rmii_ethernet.c (ring, ISR & LwIP glue) and the target
+
+	- RP2040 backend (rmii_hal_rp2040.h/.c) : PIO/DMA/sniffer/MDIO, hot path functions are inlined
+	- Linux host backend (rmii_hal_host.h/.c, RMII_HAL_HOST) : threads model RX SM/DMA, TX DMA & PHY,
+	  frames are exchanged with an in-process peer or a TAP device (see host/)
+
+	Every backend implements below functions
+
+	----- called in ISR (hot path)
+	void		rmii_hal_rx_start(int sm_idx, uint8_t *buf, uint32_t len);	// arm RX DMA, buf=NULL to discard frame
+	uint32_t	rmii_hal_rx_stop(int sm_idx, const uint8_t *buf);			// abort RX DMA, return received length
+	void		rmii_hal_rx_resume(int sm_idx);								// release RX SM waiting end-of-frame ISR
+	int			rmii_hal_rx_sniff(int sm_idx);		// sniff RX DMA from now, return 0 if DMA already moved data
+	uint32_t	rmii_hal_rx_sniff_result(void);		// CRC32 of sniffed data (0x2144df1c if FCS is correct)
+	void		rmii_hal_rx_signal(void);			// wake up rmii_hal_rx_wait() of other core
+	void		rmii_hal_tx_start(const rmii_hal_tx_desc_t *desc);	// send descriptors until null descriptor
+
+	----- called in poll loop
+	void		rmii_hal_rx_wait(uint32_t timeout_ms);	// sleep until rmii_hal_rx_signal() or timeout, may wake up early
+	uint32_t	rmii_hal_lock(void);					// exclude ISR of both cores
+	void		rmii_hal_unlock(uint32_t save);
+	void		rmii_hal_barrier(void);					// memory barrier
+	uint32_t	rmii_hal_time_us(void);
+	uint32_t	rmii_hal_cycles(void);					// CPU cycles of calling core, lower 24 bits at least (trace)
+	void		rmii_hal_idle(void);					// body of busy wait loop
+*/
+
+#ifndef __RMII_HAL_H__
+#define __RMII_HAL_H__
+
+#include <stdint.h>
+
+#include "rmii_ethernet/depth.h"		// USE_MULTI_RX_SM & RMII_HAL_RX_SM
+#include "rmii_ethernet/netif.h"
+
+#define USE_RX_INLINE_FCS		// check RX FCS with sniffer while DMA receives the frame
+
+#if defined(USE_RX_INLINE_FCS) && defined(USE_CHKSUM_OFFLOAD)
+	#error "USE_CHKSUM_OFFLOAD (lwipopts.h) needs sniffer, undefine USE_RX_INLINE_FCS"
+#endif
+
+typedef struct
+{	uint32_t				len;				// written to 'al3_transfer_count' of TX DMA
+	const void*				addr;				// written to 'al3_read_addr_trig' of TX DMA (NULL = stop)
+} rmii_hal_tx_desc_t;
+
+// ----- implemented in rmii_ethernet.c, called by backend in ISR
+void rx_sm_isr_run(int sm_idx);					// end-of-frame of RX SM, SM waits rmii_hal_rx_resume()
+void tx_sm_isr_run(void);						// TX SM sent a frame & IPG, waits next frame
+
+// ----- implemented in backend, not in hot path
+void		rmii_hal_init(const struct netif_rmii_ethernet_config *cfg);	// claim & configure, not started
+void		rmii_hal_start(void);				// start RX/TX SM after rmii_hal_rx_start() of each RX SM
+int			rmii_hal_rx_sm_num(void);			// RX SM in use, sm_idx 0 ~ n-1 receive frames in this order
+void		rmii_hal_rx_kick(void);				// let first RX SM receive, RX ISR runs on calling core if USE_RX_PIPELINE
+int			rmii_hal_rx_deadlock(void);			// check & clear deadlock between RX SM, return 1 if cleared
+void		rmii_hal_set_speed(int mbps);		// RX/TX timing for 10 or 100Mbps link, 100Mbps until called
+void		rmii_hal_rx_halt(void);				// stop RX SM & DMA (link down), no RX ISR until rmii_hal_rx_restart()
+void		rmii_hal_rx_restart(void);			// RX SM from program start & first SM receives, after rmii_hal_rx_start() of each
+int			rmii_hal_phy_irq(void);				// 1 if nINT of PHY is asserted, 0 if not or not wired
+int			rmii_hal_mdio_start(uint addr, uint reg, int val);	// MDIO in background, val < 0 to read, return 0 if busy
+int			rmii_hal_mdio_result(void);			// read value (0 of write) once finished, -1 while running or idle
+uint16_t	rmii_hal_mdio_read(uint addr, uint reg);		// wait result, no background transaction must be running
+void		rmii_hal_mdio_write(uint addr, uint reg, uint val);
+void		rmii_hal_board_id(uint8_t id[8]);	// unique board id to generate MAC address
+uint32_t	rmii_hal_cycles_hz(void);			// rate of rmii_hal_cycles()
+
+#ifdef RMII_HAL_HOST
+	#include "rmii_hal_host.h"
+#else
+	#include "rmii_hal_rp2040.h"
+#endif
+
+#endif // __RMII_HAL_H__
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Linux host backend, build with RMII_HAL_HOST (see host/CMakeLists.txt)
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#include "rmii_hal.h"
+#include "lan8720a.h"
+
+// ------------------------------------------------------------------
+// - Debug
+// ------------------------------------------------------------------
+#define DBG(x, y...)	printf(x "\n", ##y)
+
+// ------------------------------------------------------------------
+// - extern
+// ------------------------------------------------------------------
+extern uint32_t fcs_crc32_sw(const uint8_t *buf, int size);
+extern uint32_t fcs_crc32_sw_update(uint32_t crc, const uint8_t *buf, int size);
+
+// ------------------------------------------------------------------
+// - Static Vars
+// ------------------------------------------------------------------
+rmii_hal_t					g_rmii_hal;
+
+#define HOST_PHY_ADDR		1					// LAN8720A answers at this MDIO address only
+#define HOST_FRAME_LEN		(1514+4)
+
+static uint16_t				s_phy_reg[32];
+static int					s_mdio_val = -1;	// result of rmii_hal_mdio_start(), -1 if idle
+static int					s_link_latch;		// link went down, BMSR link status reads 0 once (latched low)
+static int					s_tap_fd = -1;
+static void					(*s_peer_rx)(const uint8_t *frame, int len);
+static pthread_t			s_tx_thread;
+static pthread_t			s_tap_thread;
+
+static struct
+{	uint32_t	rx_frame;
+	uint32_t	rx_overflow;					// frame longer than the buffer given by rmii_hal_rx_start()
+	uint32_t	tx_frame;
+	uint32_t	tx_bad_fcs;
+} s_stat;
+
+// ------------------------------------------------------------------
+// - Wire
+// ------------------------------------------------------------------
+
+void rmii_hal_host_peer_send(const uint8_t *frame, int len)
+{	// RX SM/DMA : whole frame arrives at once, then end-of-frame 'ISR' runs
+	uint8_t		wire[HOST_FRAME_LEN];
+	uint32_t	fcs;
+
+	if (len > (int)(sizeof(wire) - 4))	{	return;	}
+	if (!(s_phy_reg[LAN8720A_BASIC_STATUS_REG] & LAN8720A_BASIC_STATUS_REG_LINK_STATUS))	{	return;	}	// link down
+
+	memcpy(wire, frame, len);
+	fcs = fcs_crc32_sw(frame, len);
+	memcpy(&wire[len], &fcs, 4);
+	len += 4;
+
+	pthread_mutex_lock(&g_rmii_hal.irq);
+	if (g_rmii_hal.rx_halt)	{	pthread_mutex_unlock(&g_rmii_hal.irq);	return;	}
+
+	int					sm_idx = g_rmii_hal.rx_turn;
+	rmii_hal_host_rx_t*	rx = &g_rmii_hal.rx[sm_idx];
+	uint32_t			n = ((uint32_t)len < rx->len) ? (uint32_t)len : rx->len;
+
+	if (n < (uint32_t)len)	{	s_stat.rx_overflow++;	}
+	if (rx->buf != NULL)	{	memcpy(rx->buf, wire, n);	}
+	rx->pos = (rx->buf != NULL) ? n : 0;
+
+	if (g_rmii_hal.rx_sniff_idx == sm_idx)
+	{	g_rmii_hal.rx_sniff_data = fcs_crc32_sw_update(g_rmii_hal.rx_sniff_data, wire, n);
+	}
+	g_rmii_hal.rx_turn = (sm_idx != (g_rmii_hal.rx_sm_num-1)) ? sm_idx + 1 : 0;	// next SM takes the baton
+	s_stat.rx_frame++;
+
+	rx_sm_isr_run(sm_idx);
+
+	pthread_mutex_unlock(&g_rmii_hal.irq);
+}
+
+void rmii_hal_host_peer_set_rx(void (*cb)(const uint8_t *frame, int len))
+{	s_peer_rx = cb;
+}
+
+static void *tx_dma_thread(void *arg)
+{	// TX DMA & SM : gather descriptors until null descriptor, frame & IPG end at once, then 'ISR'
+	static uint8_t				wire[2048];
+	(void)arg;
+
+	while (1)
+	{	const rmii_hal_tx_desc_t	*desc;
+		int							len = 0;
+
+		pthread_mutex_lock(&g_rmii_hal.tx_mtx);
+		while (g_rmii_hal.tx_desc == NULL)	{	pthread_cond_wait(&g_rmii_hal.tx_cond, &g_rmii_hal.tx_mtx);	}
+		desc = g_rmii_hal.tx_desc;
+		g_rmii_hal.tx_desc = NULL;
+		pthread_mutex_unlock(&g_rmii_hal.tx_mtx);
+
+		for (; desc->addr != NULL; desc++)
+		{	if (len + desc->len <= sizeof(wire))	{	memcpy(&wire[len], desc->addr, desc->len);	}
+			len += desc->len;
+		}
+
+		pthread_mutex_lock(&g_rmii_hal.irq);
+		tx_sm_isr_run();
+		pthread_mutex_unlock(&g_rmii_hal.irq);
+
+		s_stat.tx_frame++;
+		if (len < 4 || len > (int)sizeof(wire) || fcs_crc32_sw(wire, len) != 0x2144df1c)
+		{	s_stat.tx_bad_fcs++;
+			continue;
+		}
+
+		if (!(s_phy_reg[LAN8720A_BASIC_STATUS_REG] & LAN8720A_BASIC_STATUS_REG_LINK_STATUS))	{	continue;	}	// link down
+		if (s_tap_fd >= 0)		{	if (write(s_tap_fd, wire, len - 4) < 0)	{	DBG("TAP write error");	}	}
+		if (s_peer_rx != NULL)	{	s_peer_rx(wire, len - 4);	}
+	}
+	return NULL;
+}
+
+static void *tap_thread(void *arg)
+{	uint8_t		buf[HOST_FRAME_LEN];
+	(void)arg;
+
+	while (1)
+	{	int		len = read(s_tap_fd, buf, sizeof(buf));
+
+		if (len > 0)	{	rmii_hal_host_peer_send(buf, len);	}
+	}
+	return NULL;
+}
+
+int rmii_hal_host_tap_open(const char *name)
+{	struct ifreq	ifr;
+	int				fd = open("/dev/net/tun", O_RDWR);
+
+	if (fd < 0)		{	DBG("TAP open error");	return -1;	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+	{	DBG("TAP %s ioctl error", name);
+		close(fd);
+		return -1;
+	}
+	s_tap_fd = fd;
+	pthread_create(&s_tap_thread, NULL, tap_thread, NULL);
+	DBG("TAP %s opened", ifr.ifr_name);
+
+	return 0;
+}
+
+void rmii_hal_host_set_link(int up)
+{	uint16_t	bits = LAN8720A_BASIC_STATUS_REG_LINK_STATUS | LAN8720A_BASIC_STATUS_REG_AUTO_NEGO_COMPLETE;
+
+	if (up)
+	{	s_phy_reg[LAN8720A_BASIC_STATUS_REG] |= bits;
+		s_phy_reg[LAN8720A_SPECIAL_STATUS_REG] = LAN8720A_SPECIAL_STATUS_REG_AUTO_DONE		// 100Mbps full duplex
+												 | LAN8720A_SPECIAL_STATUS_REG_SPEED_100 | LAN8720A_SPECIAL_STATUS_REG_FULL_DUPLEX;
+		s_phy_reg[LAN8720A_INT_SOURCE_REG] |= LAN8720A_INT_AUTO_NEGO_COMPLETE;
+	}
+	else
+	{	s_phy_reg[LAN8720A_BASIC_STATUS_REG] &= ~bits;
+		s_phy_reg[LAN8720A_SPECIAL_STATUS_REG] = 0;
+		s_link_latch = 1;
+		s_phy_reg[LAN8720A_INT_SOURCE_REG] |= LAN8720A_INT_LINK_DOWN;
+	}
+}
+
+void rmii_hal_host_stat_prt(void)
+{	printf("HOST RX/OVERFLOW %u %u TX/BAD-FCS %u %u\n",
+		s_stat.rx_frame, s_stat.rx_overflow, s_stat.tx_frame, s_stat.tx_bad_fcs);
+}
+
+// ------------------------------------------------------------------
+// - MDIO, LAN8720A register model
+// ------------------------------------------------------------------
+
+uint16_t rmii_hal_mdio_read(uint addr, uint reg)
+{	if (addr != HOST_PHY_ADDR)	{	return 0xffff;	}
+
+	uint16_t	val = s_phy_reg[reg & 0x1f];
+
+	if ((reg & 0x1f) == LAN8720A_INT_SOURCE_REG)	{	s_phy_reg[LAN8720A_INT_SOURCE_REG] = 0;	}	// cleared by read
+	if ((reg & 0x1f) == LAN8720A_BASIC_STATUS_REG && s_link_latch)
+	{	val &= ~LAN8720A_BASIC_STATUS_REG_LINK_STATUS;
+		s_link_latch = 0;
+	}
+	return val;
+}
+
+void rmii_hal_mdio_write(uint addr, uint reg, uint val)
+{	if (addr != HOST_PHY_ADDR)	{	return;	}
+
+	if (reg == LAN8720A_BASIC_STATUS_REG || reg == 2 || reg == 3
+		|| reg == LAN8720A_INT_SOURCE_REG || reg == LAN8720A_SPECIAL_STATUS_REG)	{	return;	}	// read only
+	s_phy_reg[reg & 0x1f] = val;
+}
+
+int rmii_hal_mdio_start(uint addr, uint reg, int val)
+{	// registers are in memory, finished at once
+	if (s_mdio_val >= 0)	{	return 0;	}
+
+	if (val < 0)	{	s_mdio_val = rmii_hal_mdio_read(addr, reg);	}
+	else			{	rmii_hal_mdio_write(addr, reg, val);	s_mdio_val = 0;	}
+	return 1;
+}
+
+int rmii_hal_mdio_result(void)
+{	int		val = s_mdio_val;
+
+	s_mdio_val = -1;
+	return val;
+}
+
+// ------------------------------------------------------------------
+// - Init
+// ------------------------------------------------------------------
+
+void rmii_hal_init(const struct netif_rmii_ethernet_config *cfg)
+{	pthread_mutexattr_t		attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);	// 'ISR' takes rmii_hal_lock() again
+	pthread_mutex_init(&g_rmii_hal.irq, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	sem_init(&g_rmii_hal.rx_sem, 0, 0);
+	pthread_mutex_init(&g_rmii_hal.tx_mtx, NULL);
+	pthread_cond_init(&g_rmii_hal.tx_cond, NULL);
+	g_rmii_hal.tx_desc = NULL;
+	g_rmii_hal.rx_turn = 0;
+
+	// no PIO placement on host, any count up to RMII_HAL_RX_SM
+	g_rmii_hal.rx_sm_num = (cfg->rx_sm_num != 0) ? (int)cfg->rx_sm_num : RMII_RX_SM_NUM;
+	if (g_rmii_hal.rx_sm_num > RMII_HAL_RX_SM)	{	g_rmii_hal.rx_sm_num = RMII_HAL_RX_SM;	}
+
+	s_phy_reg[LAN8720A_BASIC_STATUS_REG] = 0x7809;	// 10/100 HD/FD ability, extended capability
+	s_phy_reg[2] = 0x0007;							// PHY ID of LAN8720A
+	s_phy_reg[3] = 0xc0f1;
+	s_phy_reg[5] = 0x45e1;							// link partner : 10/100 HD/FD, symmetric PAUSE, acknowledge
+	rmii_hal_host_set_link(1);
+}
+
+void rmii_hal_start(void)
+{	pthread_create(&s_tx_thread, NULL, tx_dma_thread, NULL);
+}
+
+int rmii_hal_rx_sm_num(void)
+{	return g_rmii_hal.rx_sm_num;
+}
+
+void rmii_hal_rx_kick(void)
+{
+}
+
+int rmii_hal_rx_deadlock(void)
+{	return 0;
+}
+
+void rmii_hal_set_speed(int mbps)
+{	(void)mbps;		// frames are exchanged whole, no wire timing
+}
+
+void rmii_hal_rx_halt(void)
+{	pthread_mutex_lock(&g_rmii_hal.irq);
+	g_rmii_hal.rx_halt = 1;
+	pthread_mutex_unlock(&g_rmii_hal.irq);
+}
+
+void rmii_hal_rx_restart(void)
+{	pthread_mutex_lock(&g_rmii_hal.irq);
+	g_rmii_hal.rx_turn = 0;
+	g_rmii_hal.rx_halt = 0;
+	pthread_mutex_unlock(&g_rmii_hal.irq);
+}
+
+int rmii_hal_phy_irq(void)
+{	// nINT is wired on host, asserted while an unmasked source is pending
+	return (s_phy_reg[LAN8720A_INT_SOURCE_REG] & s_phy_reg[LAN8720A_INT_MASK_REG]) != 0;
+}
+
+void rmii_hal_board_id(uint8_t id[8])
+{	static const uint8_t	host_id[8] = {	'R', 'M', 'I', 'I', 'H', 0x00, 0x00, 0x01	};
+
+	memcpy(id, host_id, 8);
+}
+
+uint32_t rmii_hal_cycles_hz(void)
+{	return 1000000000;
+}
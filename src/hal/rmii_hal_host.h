@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Linux host backend of rmii_hal.h, threads model RX SM/DMA/sniffer, TX DMA & PHY (see host/)
+
+#ifndef __RMII_HAL_HOST_H__
+#define __RMII_HAL_HOST_H__
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef __time_critical_func
+	#define __time_critical_func(x)		x
+#endif
+
+typedef struct
+{	uint8_t*				buf;						// NULL = discard frame
+	uint32_t				len;
+	uint32_t				pos;						// bytes moved by 'DMA'
+} rmii_hal_host_rx_t;
+
+typedef struct
+{	pthread_mutex_t			irq;						// recursive, held while 'ISR' runs, models interrupt exclusion
+	sem_t					rx_sem;						// event of rmii_hal_rx_signal(), not a frame count
+
+	rmii_hal_host_rx_t		rx[RMII_HAL_RX_SM];
+	int						rx_sm_num;					// RX SM in use
+	int						rx_turn;					// RX SM receiving next frame
+	int						rx_halt;					// rmii_hal_rx_halt(), frames are lost on the wire
+	int						rx_sniff_idx;				// RX SM sniffed
+	uint32_t				rx_sniff_data;				// sniffer accumulator
+
+	pthread_mutex_t			tx_mtx;
+	pthread_cond_t			tx_cond;
+	const rmii_hal_tx_desc_t* volatile tx_desc;			// descriptors given to 'TX DMA'
+} rmii_hal_t;
+
+extern rmii_hal_t			g_rmii_hal;
+
+// ------------------------------------------------------------------
+// - RX
+// ------------------------------------------------------------------
+static inline void rmii_hal_rx_start(int sm_idx, uint8_t *buf, uint32_t len)
+{	g_rmii_hal.rx[sm_idx].buf = buf;
+	g_rmii_hal.rx[sm_idx].len = len;
+	g_rmii_hal.rx[sm_idx].pos = 0;
+}
+
+static inline uint32_t rmii_hal_rx_stop(int sm_idx, const uint8_t *buf)
+{	(void)buf;
+	return g_rmii_hal.rx[sm_idx].pos;
+}
+
+static inline void rmii_hal_rx_resume(int sm_idx)
+{	(void)sm_idx;	// frame is delivered under 'irq', SM never waits
+}
+
+static inline int rmii_hal_rx_sniff(int sm_idx)
+{	g_rmii_hal.rx_sniff_idx = sm_idx;
+	g_rmii_hal.rx_sniff_data = 0;
+
+	return g_rmii_hal.rx[sm_idx].pos == 0;
+}
+
+static inline uint32_t rmii_hal_rx_sniff_result(void)
+{	return g_rmii_hal.rx_sniff_data;
+}
+
+static inline void rmii_hal_rx_signal(void)
+{	sem_post(&g_rmii_hal.rx_sem);
+}
+
+static inline void rmii_hal_rx_wait(uint32_t timeout_ms)
+{	struct timespec		ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000)	{	ts.tv_sec++;	ts.tv_nsec -= 1000000000;	}
+
+	if (sem_timedwait(&g_rmii_hal.rx_sem, &ts) == 0)
+	{	while (sem_trywait(&g_rmii_hal.rx_sem) == 0)	{	}	// fold pending signals like a latched event
+	}
+}
+
+// ------------------------------------------------------------------
+// - TX
+// ------------------------------------------------------------------
+static inline void rmii_hal_tx_start(const rmii_hal_tx_desc_t *desc)
+{	pthread_mutex_lock(&g_rmii_hal.tx_mtx);
+	g_rmii_hal.tx_desc = desc;
+	pthread_cond_signal(&g_rmii_hal.tx_cond);
+	pthread_mutex_unlock(&g_rmii_hal.tx_mtx);
+}
+
+// ------------------------------------------------------------------
+// - etc
+// ------------------------------------------------------------------
+static inline uint32_t rmii_hal_lock(void)
+{	pthread_mutex_lock(&g_rmii_hal.irq);
+	return 0;
+}
+
+static inline void rmii_hal_unlock(uint32_t save)
+{	(void)save;
+	pthread_mutex_unlock(&g_rmii_hal.irq);
+}
+
+static inline void rmii_hal_barrier(void)
+{	__sync_synchronize();
+}
+
+static inline uint32_t rmii_hal_time_us(void)
+{	struct timespec		ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static inline uint32_t rmii_hal_cycles(void)	// nsec
+{	struct timespec		ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static inline void rmii_hal_idle(void)
+{	sched_yield();
+}
+
+// ------------------------------------------------------------------
+// - Host only, to drive the wire side
+// ------------------------------------------------------------------
+void	rmii_hal_host_peer_send(const uint8_t *frame, int len);	// frame without FCS, received by RX SM
+void	rmii_hal_host_peer_set_rx(void (*cb)(const uint8_t *frame, int len));	// frame sent by TX SM, FCS removed
+int		rmii_hal_host_tap_open(const char *name);		// bridge the wire to a TAP device, return 0 if OK
+void	rmii_hal_host_set_link(int up);
+void	rmii_hal_host_stat_prt(void);
+
+#endif // __RMII_HAL_HOST_H__
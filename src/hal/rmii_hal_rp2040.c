@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rmii_hal.h"
+
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+
+#include "pico/unique_id.h"
+
+#ifdef USE_MULTI_RX_SM
+	#include "rmii_ethernet_phy_rx_2.pio.h"
+	#define RX_PROG_CLK_WAIT	rmii_ethernet_phy_rx_2_data_offset_clk_wait
+	#define RX_PROG_INSTR		rmii_ethernet_phy_rx_2_data_program_instructions
+#else
+	#include "rmii_ethernet_phy_rx.pio.h"
+	#define RX_PROG_CLK_WAIT	rmii_ethernet_phy_rx_data_offset_clk_wait
+	#define RX_PROG_INSTR		rmii_ethernet_phy_rx_data_program_instructions
+#endif
+#include "rmii_ethernet_phy_tx.pio.h"
+#include "rmii_ethernet_phy_mdio.pio.h"
+
+// ------------------------------------------------------------------
+// - Debug
+// ------------------------------------------------------------------
+#define DBG(x, y...)	printf(x "\n", ##y)
+
+// ------------------------------------------------------------------
+// - Static Vars
+// ------------------------------------------------------------------
+rmii_hal_t					g_rmii_hal;
+
+static struct netif_rmii_ethernet_config s_cfg;
+#define PICO_RMII_PIO 		(s_cfg.pio)
+#define PICO_RMII_SM_RX 	(s_cfg.pio_sm_start)
+#define PICO_RMII_RX_PIN 	(s_cfg.rx_pin_start)
+#define PICO_RMII_TX_PIN 	(s_cfg.tx_pin_start)
+#define PICO_RMII_MDIO_PIN 	(s_cfg.mdio_pin_start)
+#define PICO_RMII_MDC_PIN 	(s_cfg.mdio_pin_start + 1)
+#define PICO_RMII_RETCLK_PIN (s_cfg.retclk_pin)
+#define PICO_RMII_PHY_IRQ_PIN (s_cfg.phy_irq_pin)
+
+static uint					s_rx_sm_off;		// start address of SM in PIO ram
+static uint 				s_tx_sm_off;		// start address of SM in PIO ram
+static uint					s_clkdiv = 1;		// SM clock divider, 1 = 100Mbps, 10 = 10Mbps
+
+static dma_channel_config 	s_rx_dma_chn_cfg[RMII_HAL_RX_SM];	// DMA channel configuration for RX SM
+static dma_channel_config 	s_tx_dma_chn_cfg;	// DMA channel configuration for TX SM
+static dma_channel_config 	s_tx_dma_ctrl_chn_cfg;	// DMA channel configuration for TX control block
+
+// ------------------------------------------------------------------
+// - MDIO, PIO SM runs transaction in background (bit-bang if no room in PIO)
+// ------------------------------------------------------------------
+#define MDIO_SM_HZ			(4 * 1250000)	// 4 SM cycles per MDC, MDC = 1.25MHz
+
+static PIO					s_mdio_pio;			// NULL = bit-bang
+static uint					s_mdio_sm;
+static int					s_mdio_busy;		// transaction started, result not taken yet
+static int					s_mdio_val;			// result of bit-bang, finished at start
+
+static void rmii_hal_mdio_clock_out(int bit)
+{	gpio_put(PICO_RMII_MDC_PIN, 0);			busy_wait_us(2);
+	gpio_put(PICO_RMII_MDIO_PIN, bit);
+	gpio_put(PICO_RMII_MDC_PIN, 1);			busy_wait_us(2);
+}
+
+static uint rmii_hal_mdio_clock_in()
+{	gpio_put(PICO_RMII_MDC_PIN, 0);			busy_wait_us(2);
+
+	int bit = gpio_get(PICO_RMII_MDIO_PIN);
+
+	gpio_put(PICO_RMII_MDC_PIN, 1);
+	busy_wait_us(2);
+
+	return bit;
+}
+
+static uint16_t rmii_hal_mdio_bb_read(uint addr, uint reg)
+{	gpio_init(PICO_RMII_MDIO_PIN);
+	gpio_init(PICO_RMII_MDC_PIN);
+
+	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_OUT);
+	gpio_set_dir(PICO_RMII_MDC_PIN, GPIO_OUT);
+
+	// PRE_32
+	for (int i = 0; i < 32; i++)	{	rmii_hal_mdio_clock_out(1);	}
+
+	// ST
+	rmii_hal_mdio_clock_out(0);
+	rmii_hal_mdio_clock_out(1);
+
+	// OP
+	rmii_hal_mdio_clock_out(1);
+	rmii_hal_mdio_clock_out(0);
+
+	// PA5
+	for (int i = 0; i < 5; i++)
+	{	uint bit = (addr >> (4 - i)) & 0x01;
+
+		rmii_hal_mdio_clock_out(bit);
+	}
+
+	// RA5
+	for (int i = 0; i < 5; i++)
+	{	uint bit = (reg >> (4 - i)) & 0x01;
+
+		rmii_hal_mdio_clock_out(bit);
+	}
+
+	// TA
+	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_IN);
+	rmii_hal_mdio_clock_out(0);
+	rmii_hal_mdio_clock_out(0);
+
+	uint16_t data = 0;
+
+	for (int i = 0; i < 16; i++)
+	{	data <<= 1;
+
+		data |= rmii_hal_mdio_clock_in();
+	}
+
+	return data;
+}
+
+static void rmii_hal_mdio_bb_write(uint addr, uint reg, uint val)
+{	gpio_init(PICO_RMII_MDIO_PIN);
+	gpio_init(PICO_RMII_MDC_PIN);
+
+	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_OUT);
+	gpio_set_dir(PICO_RMII_MDC_PIN, GPIO_OUT);
+
+	// PRE_32
+	for (int i = 0; i < 32; i++)	{	rmii_hal_mdio_clock_out(1);	}
+
+	// ST
+	rmii_hal_mdio_clock_out(0);
+	rmii_hal_mdio_clock_out(1);
+
+	// OP
+	rmii_hal_mdio_clock_out(0);
+	rmii_hal_mdio_clock_out(1);
+
+	// PA5
+	for (int i = 0; i < 5; i++)
+	{	uint bit = (addr >> (4 - i)) & 0x01;
+
+		rmii_hal_mdio_clock_out(bit);
+	}
+
+	// RA5
+	for (int i = 0; i < 5; i++)
+	{	uint bit = (reg >> (4 - i)) & 0x01;
+
+		rmii_hal_mdio_clock_out(bit);
+	}
+
+	// TA
+	rmii_hal_mdio_clock_out(1);
+	rmii_hal_mdio_clock_out(0);
+
+	for (int i = 0; i < 16; i++)
+	{	uint bit = (val >> (15 - i)) & 0x01;
+
+		rmii_hal_mdio_clock_out(bit);
+	}
+
+	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_IN);
+}
+
+static void rmii_hal_mdio_init(void)
+{	// prefer PIO not used by RMII, program takes 16 instructions
+	PIO		pio_list[3] = {	(PICO_RMII_PIO == pio0) ? pio1 : pio0, g_rmii_hal.tx_pio, PICO_RMII_PIO	};
+
+	for (int i = 0; i < 3; i++)
+	{	PIO		pio = pio_list[i];
+		int		sm;
+
+		if (!pio_can_add_program(pio, &rmii_ethernet_phy_mdio_program))	{	continue;	}
+		if ((sm = pio_claim_unused_sm(pio, false)) < 0)						{	continue;	}
+
+		s_mdio_pio = pio;
+		s_mdio_sm = sm;
+		rmii_ethernet_phy_mdio_init(pio, sm, pio_add_program(pio, &rmii_ethernet_phy_mdio_program),
+									PICO_RMII_MDIO_PIN, clock_get_hz(clk_sys) / MDIO_SM_HZ);
+		DBG("MDIO PIO %d SM %d", pio_get_index(pio), sm);
+		return;
+	}
+	DBG("MDIO bit-bang, no room in PIO");
+}
+
+int rmii_hal_mdio_start(uint addr, uint reg, int val)
+{	if (s_mdio_busy)	{	return 0;	}
+	s_mdio_busy = 1;
+
+	if (s_mdio_pio == NULL)
+	{	if (val < 0)	{	s_mdio_val = rmii_hal_mdio_bb_read(addr, reg);	}
+		else			{	rmii_hal_mdio_bb_write(addr, reg, val);	s_mdio_val = 0;	}
+		return 1;
+	}
+
+	// bits to drive - 1, preamble, ST/OP/PHYAD/REGAD/TA/DATA, see rmii_ethernet_phy_mdio.pio
+	uint32_t	frame = ((addr & 0x1f) << 23) | ((reg & 0x1f) << 18) | (0x2 << 16);
+
+	pio_sm_put(s_mdio_pio, s_mdio_sm, (val < 0) ? 45 : 63);
+	pio_sm_put(s_mdio_pio, s_mdio_sm, 0xffffffff);
+	pio_sm_put(s_mdio_pio, s_mdio_sm, (val < 0) ? (0x6u << 28) | frame : (0x5u << 28) | frame | (val & 0xffff));
+	return 1;
+}
+
+int rmii_hal_mdio_result(void)
+{	if (!s_mdio_busy)	{	return -1;	}
+
+	if (s_mdio_pio != NULL)
+	{	if (pio_sm_is_rx_fifo_empty(s_mdio_pio, s_mdio_sm))	{	return -1;	}
+		s_mdio_val = pio_sm_get(s_mdio_pio, s_mdio_sm) & 0xffff;
+	}
+	s_mdio_busy = 0;
+	return s_mdio_val;
+}
+
+uint16_t rmii_hal_mdio_read(uint addr, uint reg)
+{	int		val;
+
+	rmii_hal_mdio_start(addr, reg, -1);
+	while ((val = rmii_hal_mdio_result()) < 0)	{	tight_loop_contents();	}
+	return val;
+}
+
+void rmii_hal_mdio_write(uint addr, uint reg, uint val)
+{	rmii_hal_mdio_start(addr, reg, val);
+	while (rmii_hal_mdio_result() < 0)	{	tight_loop_contents();	}
+}
+
+// ------------------------------------------------------------------
+// - ISR
+// ------------------------------------------------------------------
+
+#ifdef USE_MULTI_RX_SM
+static void __time_critical_func(rx_baton_restore)(int sm_idx)
+{	// previous SM passed the baton while this SM was waiting ISR, pass it again once SM waits for it
+	uint32_t	baton = 1u << (4 + g_rmii_hal.rx_sm[sm_idx]);
+
+	for (int i = 0; i < 32; i++)	// SM reaches 'irq wait 4 rel' in a few cycles after resume, never if it took the baton
+	{	if (PICO_RMII_PIO->irq & baton)
+		{	PICO_RMII_PIO->irq = baton;		// write-1-to-clear
+			return;
+		}
+	}
+}
+#endif
+
+static void __time_critical_func(rx_sm_isr_handler) (void) // to locate code in RAM
+{
+#ifndef USE_MULTI_RX_SM
+	rx_sm_isr_run(0);
+#else
+	// SMs finish frames in ring order, serve from the oldest one
+	int		n = g_rmii_hal.rx_sm_num;
+	int		idx = g_rmii_hal.rx_next;
+
+	while (PICO_RMII_PIO->irq & (1u << g_rmii_hal.rx_sm[idx]))
+	{	int		prev = (idx != 0) ? idx - 1 : n - 1;
+
+		rx_sm_isr_run(idx);
+		// previous SM already finished the next frame, so its baton came before this SM resumed
+		if (PICO_RMII_PIO->irq & (1u << g_rmii_hal.rx_sm[prev]))	{	rx_baton_restore(idx);	}
+		idx = (idx != (n-1)) ? idx + 1 : 0;
+	}
+
+	if (idx == g_rmii_hal.rx_next)
+	{	// out of order, should not happen : serve any SM not to repeat this IRQ and follow its order
+		for (int i = 0; i < n; i++)
+		{	if (PICO_RMII_PIO->irq & (1u << g_rmii_hal.rx_sm[i]))
+			{	rx_sm_isr_run(i);
+				idx = (i != (n-1)) ? i + 1 : 0;
+				break;
+			}
+		}
+	}
+	g_rmii_hal.rx_next = idx;
+#endif
+}
+
+static void __time_critical_func(tx_sm_isr_handler)(void)
+{	// TX SM raises 'irq 0 rel' after IPG of each frame, DMA restarted earlier would append to a frame still in FIFO
+	if (!(g_rmii_hal.tx_pio->ints1 & (PIO_IRQ1_INTS_SM0_BITS << g_rmii_hal.tx_sm)))	{	return;	}	// shared handler, not mine
+	pio_interrupt_clear(g_rmii_hal.tx_pio, g_rmii_hal.tx_sm);
+
+	// FIFO ran empty within a frame (DMA stalled), the rest follows as another (bad FCS) frame
+	if (dma_channel_is_busy(g_rmii_hal.tx_dma) || dma_channel_is_busy(g_rmii_hal.tx_ctrl_dma))	{	return;	}
+	tx_sm_isr_run();
+}
+
+// ------------------------------------------------------------------
+// - Init
+// ------------------------------------------------------------------
+static void cycles_start(void)	// SysTick of calling core free runs at clk_sys, no interrupt
+{	systick_hw->rvr = 0x00ffffff;
+	systick_hw->csr = 0x05;
+}
+
+void rmii_hal_init(const struct netif_rmii_ethernet_config *cfg)
+{	memcpy(&s_cfg, cfg, sizeof(s_cfg));
+	cycles_start();
+
+	g_rmii_hal.pio = PICO_RMII_PIO;
+#ifdef USE_MULTI_RX_SM
+	int		n = (s_cfg.rx_sm_num != 0) ? s_cfg.rx_sm_num : RMII_RX_SM_NUM;
+
+	if (n != 2 && n != 4)
+	{	DBG("RX SM %d is not supported, use 2", n);
+		n = 2;
+	}
+	if (n == 4 && (s_cfg.tx_pio == NULL || s_cfg.tx_pio == PICO_RMII_PIO))
+	{	DBG("RX SM 4 needs TX SM at other PIO, use 2");
+		n = 2;
+	}
+	g_rmii_hal.rx_sm_num = n;
+	for (int i = 0; i < n; i++)	{	g_rmii_hal.rx_sm[i] = (PICO_RMII_SM_RX + i * (4 / n)) & 3;	}
+#else
+	g_rmii_hal.rx_sm_num = 1;
+	g_rmii_hal.rx_sm[0] = PICO_RMII_SM_RX;
+#endif
+	g_rmii_hal.rx_next = 0;
+
+	// TX SM sits between RX SM, or takes a free SM of other PIO
+	g_rmii_hal.tx_pio = (s_cfg.tx_pio != NULL) ? s_cfg.tx_pio : PICO_RMII_PIO;
+	if (g_rmii_hal.tx_pio == PICO_RMII_PIO)	{	g_rmii_hal.tx_sm = (PICO_RMII_SM_RX + 1) & 3;	}
+	else									{	g_rmii_hal.tx_sm = pio_claim_unused_sm(g_rmii_hal.tx_pio, true);	}
+
+	// claim RX SM (& TX SM of same PIO), others may claim the rest
+	uint32_t	sm_mask = (g_rmii_hal.tx_pio == PICO_RMII_PIO) ? (1u << g_rmii_hal.tx_sm) : 0;
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)	{	sm_mask |= 1u << g_rmii_hal.rx_sm[i];	}
+	pio_claim_sm_mask(PICO_RMII_PIO, sm_mask);
+
+	g_rmii_hal.lock = spin_lock_init(spin_lock_claim_unused(true));
+
+	// Init the RMII PIO programs
+#ifdef USE_MULTI_RX_SM
+	{	// baton goes to next SM of the ring, 'irq clear (4 + 4/N) rel'
+		uint16_t		instr[sizeof(rmii_ethernet_phy_rx_2_data_program_instructions) / sizeof(uint16_t)];
+		pio_program_t	prog = rmii_ethernet_phy_rx_2_data_program;
+
+		memcpy(instr, rmii_ethernet_phy_rx_2_data_program_instructions, sizeof(instr));
+		instr[rmii_ethernet_phy_rx_2_data_offset_handoff] = pio_encode_irq_clear(true, 4 + 4 / g_rmii_hal.rx_sm_num);
+		prog.instructions = instr;
+		s_rx_sm_off = pio_add_program(PICO_RMII_PIO, &prog);
+	}
+#else
+	s_rx_sm_off = pio_add_program(PICO_RMII_PIO, &rmii_ethernet_phy_rx_data_program);
+#endif
+	s_tx_sm_off = pio_add_program(g_rmii_hal.tx_pio, &rmii_ethernet_phy_tx_data_program);
+	rmii_hal_mdio_init();
+
+	if (PICO_RMII_PHY_IRQ_PIN >= 0)	// nINT is open drain
+	{	gpio_init(PICO_RMII_PHY_IRQ_PIN);
+		gpio_set_dir(PICO_RMII_PHY_IRQ_PIN, GPIO_IN);
+		gpio_pull_up(PICO_RMII_PHY_IRQ_PIN);
+	}
+
+	// Configure the DMA channels
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	g_rmii_hal.rx_dma[i] = dma_claim_unused_channel(true);
+		DBG("RX SM %d DMA %d", g_rmii_hal.rx_sm[i], g_rmii_hal.rx_dma[i]);
+	}
+	g_rmii_hal.tx_dma = dma_claim_unused_channel(true);
+	g_rmii_hal.tx_ctrl_dma = dma_claim_unused_channel(true);
+	DBG("TX SM %d DMA %d %d", g_rmii_hal.tx_sm, g_rmii_hal.tx_dma, g_rmii_hal.tx_ctrl_dma);
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	int		dma_no = g_rmii_hal.rx_dma[i];
+
+		s_rx_dma_chn_cfg[i] = dma_channel_get_default_config(dma_no);
+
+		channel_config_set_read_increment(&s_rx_dma_chn_cfg[i], false);
+		channel_config_set_write_increment(&s_rx_dma_chn_cfg[i], true);
+		channel_config_set_dreq(&s_rx_dma_chn_cfg[i], pio_get_dreq(PICO_RMII_PIO, g_rmii_hal.rx_sm[i], false));
+		channel_config_set_transfer_data_size(&s_rx_dma_chn_cfg[i], DMA_SIZE_8);
+#ifdef USE_RX_INLINE_FCS
+		channel_config_set_sniff_enable(&s_rx_dma_chn_cfg[i], true);
+#endif
+
+		// not started, rmii_hal_rx_start() will trigger it
+		dma_channel_configure(
+			dma_no, &s_rx_dma_chn_cfg[i],
+			&g_rmii_hal.rx_dummy[i],
+			((uint8_t*)&PICO_RMII_PIO->rxf[g_rmii_hal.rx_sm[i]]) + 3,
+			0,
+			false
+		);
+
+#ifdef USE_RX_INLINE_FCS
+		// Prepare sniffer setting for each RX DMA, rmii_hal_rx_sniff() switches it by writing 'sniff_ctrl' only
+		dma_sniffer_enable(dma_no, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, false);
+		dma_sniffer_set_output_reverse_enabled(true);
+		dma_sniffer_set_output_invert_enabled(true);
+		g_rmii_hal.rx_sniff_ctrl[i] = dma_hw->sniff_ctrl;
+#endif
+	}
+
+	s_tx_dma_chn_cfg = dma_channel_get_default_config(g_rmii_hal.tx_dma);
+
+	channel_config_set_read_increment(&s_tx_dma_chn_cfg, true);
+	channel_config_set_write_increment(&s_tx_dma_chn_cfg, false);
+	channel_config_set_dreq(&s_tx_dma_chn_cfg, pio_get_dreq(g_rmii_hal.tx_pio, g_rmii_hal.tx_sm, true));
+	channel_config_set_transfer_data_size(&s_tx_dma_chn_cfg, DMA_SIZE_8);
+	channel_config_set_chain_to(&s_tx_dma_chn_cfg, g_rmii_hal.tx_ctrl_dma);	// load next descriptor after each block
+
+	dma_channel_configure(
+		g_rmii_hal.tx_dma, &s_tx_dma_chn_cfg,
+		((uint8_t *)&g_rmii_hal.tx_pio->txf[g_rmii_hal.tx_sm]) + 3,
+		NULL,
+		0,
+		false);
+
+	// control DMA writes {len, addr} of descriptor to 'al3_transfer_count' & 'al3_read_addr_trig' of TX DMA
+	s_tx_dma_ctrl_chn_cfg = dma_channel_get_default_config(g_rmii_hal.tx_ctrl_dma);
+
+	channel_config_set_read_increment(&s_tx_dma_ctrl_chn_cfg, true);
+	channel_config_set_write_increment(&s_tx_dma_ctrl_chn_cfg, true);
+	channel_config_set_ring(&s_tx_dma_ctrl_chn_cfg, true, 3);			// wrap write address at 8 bytes
+	channel_config_set_transfer_data_size(&s_tx_dma_ctrl_chn_cfg, DMA_SIZE_32);
+
+	dma_channel_configure(
+		g_rmii_hal.tx_ctrl_dma, &s_tx_dma_ctrl_chn_cfg,
+		&dma_hw->ch[g_rmii_hal.tx_dma].al3_transfer_count,
+		NULL,
+		2,
+		false);
+
+	// Install TX SM ISR, IRQ_1 of TX PIO (IRQ_0 of RMII PIO is RX)
+	uint	irq_no = (g_rmii_hal.tx_pio == pio0) ? PIO0_IRQ_1 : PIO1_IRQ_1;
+
+	irq_add_shared_handler(irq_no, tx_sm_isr_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+	irq_set_enabled(irq_no, true);
+	g_rmii_hal.tx_pio->inte1 |= (PIO_IRQ1_INTE_SM0_BITS << g_rmii_hal.tx_sm);
+}
+
+void rmii_hal_start(void)
+{
+	// Install ISR #3 callback for RX-SM
+	uint	irq_no = (PICO_RMII_PIO == pio0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+
+	irq_set_exclusive_handler(irq_no, rx_sm_isr_handler);
+#ifndef USE_RX_PIPELINE	// enabled by rmii_hal_rx_kick() on the core checking FCS
+	irq_set_enabled(irq_no, true);
+#endif
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	PICO_RMII_PIO->inte0 |= (PIO_IRQ0_INTE_SM0_BITS<<g_rmii_hal.rx_sm[i]);
+	}
+
+	// Configure & Start the RMII SM
+	rmii_ethernet_phy_tx_init(g_rmii_hal.tx_pio, g_rmii_hal.tx_sm, s_tx_sm_off, PICO_RMII_TX_PIN, PICO_RMII_RETCLK_PIN, s_clkdiv);
+#ifdef USE_MULTI_RX_SM
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	rmii_ethernet_phy_rx_2_init(PICO_RMII_PIO, g_rmii_hal.rx_sm[i], s_rx_sm_off, PICO_RMII_RX_PIN, s_clkdiv);
+	}
+#else
+	rmii_ethernet_phy_rx_init(PICO_RMII_PIO, PICO_RMII_SM_RX, s_rx_sm_off, PICO_RMII_RX_PIN, s_clkdiv);
+#endif
+}
+
+static void sm_clk_wait_skip(PIO pio, uint sm, uint pc)
+{	// SM stalled at 'wait' on RETCLK keeps old instruction, never completes at fixed phase of divided clock
+	if (pio_sm_get_pc(pio, sm) == pc)	{	pio_sm_exec(pio, sm, pio_encode_jmp(pc + 1));	}
+}
+
+void rmii_hal_set_speed(int mbps)
+{	// 10Mbps : PHY holds each dibit for 10 RETCLK, run same programs 10 times slower.
+	// SM sees RETCLK always at same phase, so 'clk_wait' of each program must not wait RETCLK
+	uint	div = (mbps == 10) ? 10 : 1;
+
+	if (div == s_clkdiv)	{	return;	}
+	s_clkdiv = div;
+
+	PICO_RMII_PIO->instr_mem[s_rx_sm_off + RX_PROG_CLK_WAIT] =
+		(div == 1) ? RX_PROG_INSTR[RX_PROG_CLK_WAIT] : pio_encode_nop() | pio_encode_delay(1);
+	g_rmii_hal.tx_pio->instr_mem[s_tx_sm_off + rmii_ethernet_phy_tx_data_offset_clk_wait] =
+		(div == 1) ? rmii_ethernet_phy_tx_data_program_instructions[rmii_ethernet_phy_tx_data_offset_clk_wait] : pio_encode_nop();
+
+	// SM keep their state (waiting preamble, baton or ISR), a frame on the wire now is lost by bad FCS
+	uint32_t	mask = 0;
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	uint	sm = g_rmii_hal.rx_sm[i];
+
+		pio_sm_set_clkdiv_int_frac(PICO_RMII_PIO, sm, div, 0);
+		sm_clk_wait_skip(PICO_RMII_PIO, sm, s_rx_sm_off + RX_PROG_CLK_WAIT);
+		mask |= 1u << sm;
+	}
+	pio_sm_set_clkdiv_int_frac(g_rmii_hal.tx_pio, g_rmii_hal.tx_sm, div, 0);
+	sm_clk_wait_skip(g_rmii_hal.tx_pio, g_rmii_hal.tx_sm, s_tx_sm_off + rmii_ethernet_phy_tx_data_offset_clk_wait);
+
+	if (g_rmii_hal.tx_pio == PICO_RMII_PIO)	{	mask |= 1u << g_rmii_hal.tx_sm;	}
+	else									{	pio_clkdiv_restart_sm_mask(g_rmii_hal.tx_pio, 1u << g_rmii_hal.tx_sm);	}
+	pio_clkdiv_restart_sm_mask(PICO_RMII_PIO, mask);	// same divider phase for every SM
+	DBG("RMII %d Mbps, SM clock divider %d", mbps, div);
+}
+
+int rmii_hal_rx_sm_num(void)
+{	return g_rmii_hal.rx_sm_num;
+}
+
+void rmii_hal_rx_kick(void)
+{	cycles_start();		// core of netif_rmii_ethernet_loop()
+#ifdef USE_RX_PIPELINE
+	irq_set_enabled((PICO_RMII_PIO == pio0) ? PIO0_IRQ_0 : PIO1_IRQ_0, true);	// NVIC is per core, RX ISR runs here
+#endif
+#ifdef USE_MULTI_RX_SM
+	pio_interrupt_clear(PICO_RMII_PIO, 4 + g_rmii_hal.rx_sm[0]);	// trigger first sm
+	DBG("Trigger RX SM");
+#endif
+}
+
+int rmii_hal_rx_deadlock(void)
+{	// check & clear deadlock between RX SM forcefully, every SM waits the baton
+#ifdef USE_MULTI_RX_SM
+	uint32_t irq_mask = 0;
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)	{	irq_mask |= 1u << (4 + g_rmii_hal.rx_sm[i]);	}
+	if ((PICO_RMII_PIO->irq & irq_mask) == irq_mask)
+	{	pio_interrupt_clear(PICO_RMII_PIO, 4 + g_rmii_hal.rx_sm[g_rmii_hal.rx_next]);	// SM of next frame
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+void rmii_hal_rx_halt(void)
+{	// SM may be in the middle of a frame or waiting ISR, flags are cleared so RX ISR does not come again
+	uint32_t	mask = 0;
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)	{	mask |= 1u << g_rmii_hal.rx_sm[i];	}
+	pio_set_sm_mask_enabled(PICO_RMII_PIO, mask, false);
+	PICO_RMII_PIO->irq = mask | (mask << 4);	// end-of-frame & baton, write-1-to-clear
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)	{	dma_channel_abort(g_rmii_hal.rx_dma[i]);	}
+}
+
+void rmii_hal_rx_restart(void)
+{	// same state as rmii_hal_start() & rmii_hal_rx_kick(), ring starts again from first SM
+	uint32_t	mask = 0;
+
+	for (int i = 0; i < g_rmii_hal.rx_sm_num; i++)
+	{	uint	sm = g_rmii_hal.rx_sm[i];
+
+		pio_sm_clear_fifos(PICO_RMII_PIO, sm);
+		pio_sm_restart(PICO_RMII_PIO, sm);
+		pio_sm_exec(PICO_RMII_PIO, sm, pio_encode_jmp(s_rx_sm_off));
+		mask |= 1u << sm;
+	}
+	g_rmii_hal.rx_next = 0;
+	pio_enable_sm_mask_in_sync(PICO_RMII_PIO, mask);	// same divider phase for every SM
+
+#ifdef USE_MULTI_RX_SM
+	uint32_t	baton = 1u << (4 + g_rmii_hal.rx_sm[0]);
+
+	for (int i = 0; i < 32 && !(PICO_RMII_PIO->irq & baton); i++)	{	}	// first 'irq wait 4 rel' in a few cycles
+	PICO_RMII_PIO->irq = baton;
+#endif
+}
+
+int rmii_hal_phy_irq(void)
+{	return (PICO_RMII_PHY_IRQ_PIN >= 0) ? !gpio_get(PICO_RMII_PHY_IRQ_PIN) : 0;
+}
+
+void rmii_hal_board_id(uint8_t id[8])
+{	pico_unique_board_id_t board_id;
+
+	pico_get_unique_board_id(&board_id);
+	memcpy(id, board_id.id, 8);
+}
+
+uint32_t rmii_hal_cycles_hz(void)
+{	return clock_get_hz(clk_sys);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// RP2040 backend of rmii_hal.h, hot path functions are inlined to keep ISR short
+
+#ifndef __RMII_HAL_RP2040_H__
+#define __RMII_HAL_RP2040_H__
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+
+#include "pico/stdlib.h"
+
+typedef struct
+{	PIO						pio;
+	uint					rx_sm[RMII_HAL_RX_SM];		// SM number of each RX SM, in receiving order
+	int						rx_sm_num;					// RX SM in use
+	int						rx_next;					// RX SM expected to finish next frame, updated in ISR
+	PIO						tx_pio;
+	uint					tx_sm;
+
+	int						rx_dma[RMII_HAL_RX_SM];		// DMA channel number for each RX SM
+	uint32_t				rx_len[RMII_HAL_RX_SM];		// length given to rmii_hal_rx_start()
+	uint8_t					rx_dummy[RMII_HAL_RX_SM];	// dummy memory for DMA when buffer is not given
+	uint32_t				rx_sniff_ctrl[RMII_HAL_RX_SM];	// 'sniff_ctrl' register value to sniff each RX DMA
+
+	int						tx_dma;						// DMA channel number for TX SM
+	int						tx_ctrl_dma;				// DMA channel number to load descriptors to tx_dma
+
+	spin_lock_t*			lock;						// between poll loop and ISR (other core)
+} rmii_hal_t;
+
+extern rmii_hal_t			g_rmii_hal;
+
+// ------------------------------------------------------------------
+// - RX
+// ------------------------------------------------------------------
+static inline void rmii_hal_rx_start(int sm_idx, uint8_t *buf, uint32_t len)
+{	int		dma_no = g_rmii_hal.rx_dma[sm_idx];
+
+	// use 'al1_ctrl' not to trigger DMA before new address is set
+	if (buf != NULL)
+	{	dma_hw->ch[dma_no].al1_ctrl |= DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS;
+		dma_channel_set_write_addr(dma_no, buf, false);
+	}
+	else
+	{	dma_hw->ch[dma_no].al1_ctrl &= ~DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS;
+		dma_channel_set_write_addr(dma_no, &g_rmii_hal.rx_dummy[sm_idx], false);
+	}
+	g_rmii_hal.rx_len[sm_idx] = len;
+	dma_channel_set_trans_count(dma_no, len, true);
+}
+
+static inline uint32_t rmii_hal_rx_stop(int sm_idx, const uint8_t *buf)
+{	int		dma_no = g_rmii_hal.rx_dma[sm_idx];
+
+	dma_channel_abort(dma_no);
+
+	return dma_channel_hw_addr(dma_no)->write_addr - (uint32_t)buf;
+}
+
+static inline void rmii_hal_rx_resume(int sm_idx)
+{	g_rmii_hal.pio->irq = (0x01 << g_rmii_hal.rx_sm[sm_idx]);	// write-1-to-clear, clear only mine
+}
+
+static inline int rmii_hal_rx_sniff(int sm_idx)
+{	dma_hw->sniff_ctrl = g_rmii_hal.rx_sniff_ctrl[sm_idx];
+	dma_hw->sniff_data = 0xffffffff;
+
+	// frame was already started if DMA moved any byte
+	return dma_channel_hw_addr(g_rmii_hal.rx_dma[sm_idx])->transfer_count == g_rmii_hal.rx_len[sm_idx];
+}
+
+static inline uint32_t rmii_hal_rx_sniff_result(void)
+{	return dma_sniffer_get_data_accumulator();
+}
+
+static inline void rmii_hal_rx_signal(void)
+{	__sev();	// event is latched if other core is not in WFE yet
+}
+
+static inline void rmii_hal_rx_wait(uint32_t timeout_ms)
+{	best_effort_wfe_or_timeout(make_timeout_time_ms(timeout_ms));
+}
+
+// ------------------------------------------------------------------
+// - TX
+// ------------------------------------------------------------------
+static inline void rmii_hal_tx_start(const rmii_hal_tx_desc_t *desc)
+{	// control DMA loads each desc[] to the TX DMA which sends data to PIO RMII transmitter
+	// TX SM is idle, called from TX SM ISR or while TX was idle, never waits
+	dma_channel_set_read_addr(g_rmii_hal.tx_ctrl_dma, desc, true);
+}
+
+// ------------------------------------------------------------------
+// - etc
+// ------------------------------------------------------------------
+static inline uint32_t rmii_hal_lock(void)
+{	return spin_lock_blocking(g_rmii_hal.lock);
+}
+
+static inline void rmii_hal_unlock(uint32_t save)
+{	spin_unlock(g_rmii_hal.lock, save);
+}
+
+static inline void rmii_hal_barrier(void)
+{	__dmb();
+}
+
+static inline uint32_t rmii_hal_time_us(void)
+{	return time_us_32();
+}
+
+static inline uint32_t rmii_hal_cycles(void)	// SysTick of each core counts down from 0xffffff, started by init & rx kick
+{	return ~systick_hw->cvr;
+}
+
+static inline void rmii_hal_idle(void)
+{	tight_loop_contents();
+}
+
+#endif // __RMII_HAL_RP2040_H__
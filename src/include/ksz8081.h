@@ -0,0 +1,13 @@
+// KSZ8081RNA/RND, IEEE 802.3 registers 0 ~ 5 are same as LAN8720A_xxx_REG
+
+#define KSZ8081_INT_CTRL_STATUS_REG (0x1b)		// status bits are cleared by read
+#define KSZ8081_INT_CTRL_STATUS_REG_LINK_DOWN_EN    (1 << 10)
+#define KSZ8081_INT_CTRL_STATUS_REG_LINK_UP_EN      (1 <<  8)
+#define KSZ8081_INT_CTRL_STATUS_REG_LINK_DOWN       (1 <<  2)
+#define KSZ8081_INT_CTRL_STATUS_REG_LINK_UP         (1 <<  0)
+
+#define KSZ8081_PHY_CTRL1_REG (0x1e)
+#define KSZ8081_PHY_CTRL1_REG_LINK_STATUS    (1 << 8)
+#define KSZ8081_PHY_CTRL1_REG_MODE_MASK      (0b111 << 0)	// 0 = auto-negotiation running
+#define KSZ8081_PHY_CTRL1_REG_MODE_100       (1 << 1)
+#define KSZ8081_PHY_CTRL1_REG_MODE_FULL      (1 << 2)
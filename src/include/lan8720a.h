@@ -3,8 +3,8 @@
 #define LAN8720A_BASIC_CONTROL_REG_REST_AUTO_NEG (1 <<  9)
 // #define LAN8720A_BASIC_CONTROL_REG_     (1 << 10)
 // #define LAN8720A_BASIC_CONTROL_REG_     (1 << 11)
-// #define LAN8720A_BASIC_CONTROL_REG_     (1 << 12)
-// #define LAN8720A_BASIC_CONTROL_REG_     (1 << 13)
+#define LAN8720A_BASIC_CONTROL_REG_AUTO_NEGO    (1 << 12)
+#define LAN8720A_BASIC_CONTROL_REG_SPEED_100    (1 << 13)
 // #define LAN8720A_BASIC_CONTROL_REG_     (1 << 14)
 // #define LAN8720A_BASIC_CONTROL_REG_     (1 << 15)
 
@@ -17,4 +17,17 @@
 #define LAN8720A_AUTO_NEGO_REG_10_ABI        (1 << 5)
 #define LAN8720A_AUTO_NEGO_REG_10_FD_ABI     (1 << 6)
 #define LAN8720A_AUTO_NEGO_REG_100_ABI       (1 << 7)
-#define LAN8720A_AUTO_NEGO_REG_100_FD_ABI    (1 << 8)
\ No newline at end of file
+#define LAN8720A_AUTO_NEGO_REG_100_FD_ABI    (1 << 8)
+
+#define LAN8720A_AUTO_NEGO_LP_REG (5)			// link partner ability, same bits as LAN8720A_AUTO_NEGO_REG
+
+#define LAN8720A_INT_SOURCE_REG (29)			// cleared by read
+#define LAN8720A_INT_MASK_REG (30)				// same bits as LAN8720A_INT_SOURCE_REG
+#define LAN8720A_INT_AUTO_NEGO_COMPLETE      (1 << 6)
+#define LAN8720A_INT_LINK_DOWN               (1 << 4)
+
+#define LAN8720A_SPECIAL_STATUS_REG (31)
+#define LAN8720A_SPECIAL_STATUS_REG_SPEED_MASK   (0b111 << 2)	// resolved by auto-negotiation
+#define LAN8720A_SPECIAL_STATUS_REG_SPEED_100    (1 << 3)
+#define LAN8720A_SPECIAL_STATUS_REG_FULL_DUPLEX  (1 << 4)
+#define LAN8720A_SPECIAL_STATUS_REG_AUTO_DONE    (1 << 12)
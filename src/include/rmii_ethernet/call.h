@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Call forwarding between application core & LwIP context (NO_SYS, LwIP is not thread safe)
+
+	- LwIP context is netif_rmii_ethernet_poll() : core1 (netif_rmii_ethernet_loop), or core0 with USE_RX_PIPELINE
+	- application core posts calls, poll loop runs them after each RX batch, before LwIP timers
+	  no LwIP function & no lwip_mutex (sys_arch.c) is taken by application core
+	- LwIP context posts replies (e.g. from a recv callback), application core runs them by netif_rmii_ethernet_call_poll()
+	- zero copy : a message carries a pointer, ownership of a pbuf passes with it
+	  a pbuf handed to application core is returned by netif_rmii_ethernet_pbuf_free(), RX slots are freed in LwIP context
+	- a ring per direction, single producer each : post calls from main loop of application core only (no ISR),
+	  post replies from LwIP context only
+	- CALL of statistics : calls run, time in LwIP context & max queue depth
+*/
+
+#ifndef _PICO_RMII_ETHERNET_CALL_H_
+#define _PICO_RMII_ETHERNET_CALL_H_
+
+#define RMII_CALL_QUEUE			16				// messages per direction
+
+struct pbuf;
+
+typedef void (*rmii_call_fn_t)(void *arg);
+
+// application core : fn(arg) runs in LwIP context, return 0 if queue is full
+int netif_rmii_ethernet_call(rmii_call_fn_t fn, void *arg);
+
+// application core : fn(arg) runs in LwIP context & returns, runs at once with USE_RX_PIPELINE (same core)
+void netif_rmii_ethernet_call_wait(rmii_call_fn_t fn, void *arg);
+
+// LwIP context : fn(arg) runs on application core by netif_rmii_ethernet_call_poll(), return 0 if queue is full
+int netif_rmii_ethernet_reply(rmii_call_fn_t fn, void *arg);
+
+// application core main loop : run replies, return number run
+int netif_rmii_ethernet_call_poll(void);
+
+// application core : pbuf received by a reply is freed in LwIP context, return 0 if queue is full
+int netif_rmii_ethernet_pbuf_free(struct pbuf *p);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Packet capture to pcapng over stdio (USE_RMII_CAPTURE in profile.h)
+
+	- frames are copied up to 'snap' bytes by the driver into a buffer per writer context, never waits
+	  a frame not fitting the buffer is counted (CAP-LOST of statistics, epb_dropcount of next packet)
+	- netif_rmii_ethernet_poll() streams pcapng blocks as console lines "@PCAP <base64>",
+	  host/pcap_dump writes them to a .pcapng file (other console lines are ignored)
+	- timestamp is usec of driver (end-of-frame ISR for RX), frames include FCS (if_fcslen = 4)
+	- drops are annotated by epb_flags (CRC error, too long, too short) & comment (reason)
+*/
+
+#ifndef _PICO_RMII_ETHERNET_CAPTURE_H_
+#define _PICO_RMII_ETHERNET_CAPTURE_H_
+
+#include <stdint.h>
+
+// frames to capture
+#define RMII_CAP_RX				0x01			// received & passed to LwIP
+#define RMII_CAP_TX				0x02
+#define RMII_CAP_DROP			0x04			// received & dropped by driver (filter, giant, full, priority, CRC, checksum, PAUSE)
+#define RMII_CAP_ALL			(RMII_CAP_RX | RMII_CAP_TX | RMII_CAP_DROP)
+
+typedef struct
+{	uint8_t		dir;			// RMII_CAP_xxx
+	uint16_t	snap;			// max bytes of a frame, 0 = whole frame
+	uint16_t	every;			// 1-in-N of RX/TX frames matched, 0 or 1 = all, drops are never sampled
+	uint16_t	type;			// ethertype, 0 = any
+	uint8_t		proto;			// IPv4 protocol, 0 = any
+	uint16_t	port;			// TCP/UDP source or destination port, 0 = any
+} rmii_ethernet_capture_t;
+
+#define RMII_ETHERNET_CAPTURE_DEFAULT()	{	.dir = RMII_CAP_ALL, .snap = 128, .every = 1	}
+
+// (re)start capture, a new pcapng section begins at next netif_rmii_ethernet_poll()
+void netif_rmii_ethernet_capture_start(const rmii_ethernet_capture_t *cfg);
+
+// stop capture, remaining frames & interface statistics are streamed at next netif_rmii_ethernet_poll()
+void netif_rmii_ethernet_capture_stop(void);
+
+// print state, frames captured & lost
+void netif_rmii_ethernet_capture_prt(void);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Buffer depth of the driver, shared with lwipopts.h to size LwIP window & pools (RMII_LWIP_PROFILE)
+
+	- no SDK or LwIP include, lwipopts.h includes it before LwIP options are resolved
+	- slot counts are of fixed RX slots, USE_RX_ARENA divides the same memory by frame length
+*/
+
+#ifndef _PICO_RMII_ETHERNET_DEPTH_H_
+#define _PICO_RMII_ETHERNET_DEPTH_H_
+
+#define USE_MULTI_RX_SM			// use several RX SM in turn to receive back-to-back frames
+
+#ifdef USE_MULTI_RX_SM
+	#define RMII_HAL_RX_SM		4	// max, netif_rmii_ethernet_config.rx_sm_num selects 2 (default) or 4
+	#define RMII_RX_SM_NUM		2	// default rx_sm_num, RX burst below is sized for it
+#else
+	#define RMII_HAL_RX_SM		1
+	#define RMII_RX_SM_NUM		1
+#endif
+
+//#define USE_RX_PRIO_SLOT		// 4 more RX slots (~6KB) kept for priority classes under overload (RMII_PRIO_DEFAULT_SLOT), profiles are unchanged
+
+// RX slots : a frame per RX SM + 6 (LwIP profiles are sized for, 4 was enough for iperf/TCP test with 2 RX SM) + priority headroom
+#ifdef USE_RX_PRIO_SLOT
+	#define RMII_RX_PRIO_SLOT	4
+#else
+	#define RMII_RX_PRIO_SLOT	0								// default slot reserve is 0, classes keep ready ring headroom only
+#endif
+#define RMII_RX_SLOT			(RMII_HAL_RX_SM + 6 + RMII_RX_PRIO_SLOT)
+#define RMII_RX_BURST			(RMII_RX_SLOT - RMII_RX_SM_NUM - RMII_RX_PRIO_SLOT)	// frames received back-to-back before poll loop runs, rx_sm_num = 4 takes 2 of them
+#define RMII_RX_HELD			(RMII_RX_SLOT - RMII_HAL_RX_SM - RMII_RX_PRIO_SLOT - 2)	// lent to LwIP, a slot per RX SM + 2 stay free, frames beyond are copied to PBUF_POOL
+#define RMII_RX_READY			64								// received frames waiting netif_rmii_ethernet_poll()
+
+#define RMII_TX_QUEUE			4								// frames queued to TX DMA, pbufs are referenced until sent
+
+#endif
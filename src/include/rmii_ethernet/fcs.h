@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Ethernet FCS (CRC32) & IP checksum of src/fcs.c
+
+	- 'crc' of xxx_update() is the result of previous call (0 for first call), a pbuf chain is calculated piece by piece
+	- fcs_crc32() & fcs_crc32_update() use the backend selected by fcs_crc32_init() (netif_rmii_ethernet_config.fcs)
+*/
+
+#ifndef _PICO_RMII_ETHERNET_FCS_H_
+#define _PICO_RMII_ETHERNET_FCS_H_
+
+#include <stdint.h>
+
+enum // CRC32 backend
+{	RMII_FCS_AUTO = 0,							// DMA sniffer if allowed & a DMA channel is free, else RMII_FCS_SLICE8
+	RMII_FCS_DMA,								// DMA sniffer, blocks until done, shared by cores under a mutex
+	RMII_FCS_TABLE,								// byte table (1KB), smallest
+	RMII_FCS_SLICE4,							// slicing-by-4 (4KB table in RAM)
+	RMII_FCS_SLICE8,							// slicing-by-8 (8KB table in RAM), fastest without DMA
+	RMII_FCS_BACKEND,
+};
+
+// select backend, DMA sniffer only if 'dma_ok' (not owned by RX DMA), return backend in use
+int fcs_crc32_init(int backend, int dma_ok);
+const char* fcs_crc32_name(int backend);
+
+uint32_t fcs_crc32(const uint8_t *buf, int size);
+uint32_t fcs_crc32_update(uint32_t crc, const uint8_t *buf, int size);
+
+// each backend, slicing needs fcs_crc32_init() once
+uint32_t fcs_crc32_dma_update(uint32_t crc, const uint8_t *buf, int size);	// RP2040 only
+uint32_t fcs_crc32_sw(const uint8_t *buf, int size);
+uint32_t fcs_crc32_sw_update(uint32_t crc, const uint8_t *buf, int size);
+uint32_t fcs_crc32_s4_update(uint32_t crc, const uint8_t *buf, int size);
+uint32_t fcs_crc32_s8_update(uint32_t crc, const uint8_t *buf, int size);
+
+// 16 bit ones-complement sum (IP/TCP/UDP checksum before inversion), same result as lwip_standard_chksum()
+uint16_t fcs_chksum(const void *buf, int size);		// DMA sniffer if free, software if short, no DMA channel or USE_RX_INLINE_FCS
+uint16_t fcs_chksum_sw(const void *buf, int size);
+
+#endif
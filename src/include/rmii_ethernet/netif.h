@@ -7,18 +7,38 @@
 #ifndef _PICO_RMII_ETHERNET_NETIF_H_
 #define _PICO_RMII_ETHERNET_NETIF_H_
 
+#ifndef RMII_HAL_HOST
 #include "hardware/pio.h"
+#else // Linux host backend, PIO is a dummy handle
+#include <sys/types.h>
+typedef struct pio_hw *PIO;
+#define pio0 ((PIO)0)
+#define pio1 ((PIO)1)
+#endif
 
 #include "lwip/netif.h"
+#include "rmii_ethernet/depth.h"
+#include "rmii_ethernet/fcs.h"
+#include "rmii_ethernet/prio.h"
+
+// Uncomment to split RX over both cores :
+//   core1 : netif_rmii_ethernet_loop() takes RX SM ISR & checks FCS, no LwIP call
+//   core0 : calls netif_rmii_ethernet_poll() in its main loop, runs LwIP (input, timers, link) without waiting
+// #define USE_RX_PIPELINE
 
 struct netif_rmii_ethernet_config {
     PIO pio;
-    uint pio_sm_start; // uses 2 PIO sm's
+    uint pio_sm_start; // uses 3 PIO sm's (RX, TX, RX), all 4 for RX if rx_sm_num = 4
     uint rx_pin_start; // RX0, RX1, CRS
     uint tx_pin_start; // TX0, TX1, TX-EN
     uint mdio_pin_start; // MDIO, MDC
     uint retclk_pin; // RETCLK
     uint8_t *mac_addr; // 6 bytes
+    uint rx_sm_num; // RX sm's receiving in turn, 2 (default if 0) or 4
+    PIO tx_pio; // PIO of TX sm (NULL = same as pio), must differ from pio if rx_sm_num = 4
+    int phy_irq_pin; // nINT of PHY (active low) for fast link change, -1 = link is polled every second
+    int fcs; // RMII_FCS_xxx CRC32 backend of TX & late RX FCS, 0 = auto (DMA sniffer if free, else slicing-by-8)
+    int pause; // advertise 802.3x PAUSE : XOFF while RX room is low, TX held by received PAUSE, 0 = off (default), set 1 to opt in
 };
 
 #define NETIF_RMII_ETHERNET_DEFAULT_CONFIG() { \
@@ -28,13 +48,22 @@ struct netif_rmii_ethernet_config {
     .tx_pin_start = 10, \
     .mdio_pin_start = 14, \
     .retclk_pin = 21, \
-    .mac_addr = NULL \
+    .mac_addr = NULL, \
+    .rx_sm_num = RMII_RX_SM_NUM, \
+    .tx_pio = NULL, \
+    .phy_irq_pin = -1, \
+    .fcs = RMII_FCS_AUTO, \
+    .pause = 0 \
 }
 
 err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_config *config);
 
-void netif_rmii_ethernet_poll();
+void netif_rmii_ethernet_poll(); // LwIP context, waits frames up to 100ms unless USE_RX_PIPELINE
+
+void netif_rmii_ethernet_loop(); // never returns, core1
 
-void netif_rmii_ethernet_loop();
+// receive (add=1) or stop receiving (add=0) an extra unicast MAC, own MAC is always received
+// return 0 if table is full or MAC is not found, LwIP context
+int netif_rmii_ethernet_mac_filter(const uint8_t *mac, int add);
 
 #endif
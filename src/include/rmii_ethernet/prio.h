@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	802.1p priority-aware RX admission, checked by RX ISR after destination MAC filter
+
+	- a frame is classified by first matching rule (VLAN PCP, EtherType or 4 bytes of frame), class 0 = no rule matched
+	- each class reserves headroom of ready ring & RX slots, a frame of class N is admitted only while free room
+	  exceeds reserves of classes above N : under overload best-effort frames are dropped first & control frames land
+	- a dropped frame's slot re-arms its SM at once, a slot freed later is kept for each other SM left without slot
+	- the highest class is admitted while ready ring has an entry, as without classes
+	- RMII_PRIO_DEFAULT_RULES() are set at init, no rule = admission off
+	- PRIO RX/DROP of statistics : frames admitted & dropped (ring full or headroom) per class
+*/
+
+#ifndef _PICO_RMII_ETHERNET_PRIO_H_
+#define _PICO_RMII_ETHERNET_PRIO_H_
+
+#include <stdint.h>
+
+#include "rmii_ethernet/depth.h"		// USE_RX_PRIO_SLOT
+
+#define RMII_PRIO_CLASS			4				// 0 = best-effort ~ 3 = control
+#define RMII_PRIO_RULE_NUM		8
+
+enum // rmii_prio_rule_t.kind
+{	RMII_PRIO_PCP = 1,							// VLAN tagged & PCP >= val
+	RMII_PRIO_TYPE,								// EtherType (after VLAN tag) == val
+	RMII_PRIO_MATCH,							// (4 bytes at off, big endian) & mask == val
+};
+
+typedef struct
+{	uint8_t		kind;			// RMII_PRIO_xxx
+	uint8_t		cls;			// class of matched frame, 1 ~ RMII_PRIO_CLASS-1
+	uint8_t		off;			// RMII_PRIO_MATCH, offset from destination MAC, a VLAN tag is skipped for off >= 12
+	uint16_t	max_len;		// frame length with FCS at most, 0 = any
+	uint32_t	val;
+	uint32_t	mask;			// RMII_PRIO_MATCH
+} rmii_prio_rule_t;
+
+// network control & time sync first, then small TCP segments (ACKs) so bulk transfers keep their ACK clock
+#define RMII_PRIO_DEFAULT_RULES()	{																\
+	{	.kind = RMII_PRIO_PCP,		.cls = 3,	.val = 6		},								/* internetwork & network control */	\
+	{	.kind = RMII_PRIO_TYPE,		.cls = 3,	.val = 0x88f7	},								/* PTP */	\
+	{	.kind = RMII_PRIO_TYPE,		.cls = 3,	.val = 0x0806	},								/* ARP */	\
+	{	.kind = RMII_PRIO_TYPE,		.cls = 3,	.val = 0x88cc	},								/* LLDP */	\
+	{	.kind = RMII_PRIO_PCP,		.cls = 2,	.val = 4		},								/* video & voice */	\
+	{	.kind = RMII_PRIO_MATCH,	.cls = 1,	.off = 20,	.max_len = 98,	.val = 6,	.mask = 0xff	},	/* IPv4 protocol TCP, ACK & SACK */	\
+}
+
+// default headroom kept free by lower classes per class, ready ring entries & RX slots (USE_RX_PRIO_SLOT of depth.h)
+// a slot for class 1 : best-effort frame is dropped rather than leaving its SM without slot for next frame
+// 2 slots for class 3 : control frames land while bulk frames wait the poll loop (host/rx_prio_test)
+#define RMII_PRIO_DEFAULT_RING		{	0, 4, 4, 8	}
+#ifdef USE_RX_PRIO_SLOT
+	#define RMII_PRIO_DEFAULT_SLOT	{	0, 1, 0, 2	}
+#else
+	#define RMII_PRIO_DEFAULT_SLOT	{	0, 0, 0, 0	}	// no extra slots, a reserve would take slots of RX SM & LwIP
+#endif
+
+// replace rules (NULL or 0 = admission off), return 0 if too many or class is out of range, LwIP context
+int netif_rmii_ethernet_prio_rule(const rmii_prio_rule_t *rule, int num);
+
+// headroom reserved for class 'cls' : ready ring entries & RX slots (max frames of a SM's arena, USE_RX_ARENA) kept free by lower classes
+void netif_rmii_ethernet_prio_reserve(int cls, int ring, int slot);
+
+// print rules & reserves
+void netif_rmii_ethernet_prio_prt(void);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Driver statistics (USE_RMII_SM_STAT in profile.h), read by any core without lock & without calling RX core
+
+	- counters run from boot, a reader keeps its own previous snapshot & subtracts (netif_rmii_ethernet_stat_sub)
+	- max fields are high watermarks from boot
+	- each writer context (RX ISR, RX check stage, LwIP context) owns a copy, a snapshot merges the copies
+*/
+
+#ifndef _PICO_RMII_ETHERNET_STAT_H_
+#define _PICO_RMII_ETHERNET_STAT_H_
+
+#include <stdint.h>
+
+#define RMII_STAT_SIZE_BINS		7				// frame length with FCS : ~64, ~127, ~255, ~511, ~1023, ~1518, more
+#define RMII_STAT_BATCH_BINS	8				// frames per RX batch : 1 ~ 8 (RX_POLL_BUDGET)
+#define RMII_STAT_PRIO_BINS		4				// RX priority classes (RMII_PRIO_CLASS of rmii_ethernet/prio.h)
+
+typedef struct
+{	// ----- counters
+	uint32_t	rx_ok;			// RX DMA armed for a frame
+	uint32_t	tx_ok;
+	uint32_t	rx_full;		// ready ring (or FCS checked ring, USE_RX_PIPELINE) was full, frame dropped
+	uint32_t	rx_no_slot;		// no free RX slot to arm DMA, next frame of the SM is discarded
+	uint32_t	bad_crc;
+	uint32_t	giant;			// longer than RX DMA buffer, truncated & dropped
+	uint32_t	pbuf_empty;		// PBUF_POOL (RX copy) or PBUF_RAM (TX clone) exhausted
+	uint32_t	pbuf_err;		// pbuf_take() or netif input failed
+	uint32_t	rx_copy;		// copied to PBUF_POOL because too many RX slots are held by LwIP
+	uint32_t	rx_copy_bytes;	// bytes of rx_copy, RX slots lent to LwIP copy none
+	uint32_t	fcs_late;		// sniffer was not ready at start of frame, FCS checked by software
+	uint32_t	flt_drop[4];	// dropped by destination MAC filter, [1] runt [2] unicast to other [3] multicast not joined
+	uint32_t	bad_chksum;		// IPv4/TCP/UDP checksum checked by driver was bad (USE_CHKSUM_OFFLOAD)
+	uint32_t	tx_stall;		// TX queue was full, waited for DMA
+	uint32_t	tx_link_drop;	// TX while link is down
+	uint32_t	link_down;		// link down events, RX SM ring restarts at next link up
+	uint32_t	arena_frag;		// RX arena had enough free bytes but not contiguous for max frame
+	uint32_t	cap_lost;		// frames not captured, capture buffer was full (USE_RMII_CAPTURE)
+	uint32_t	batch;			// RX batches drained by netif_rmii_ethernet_poll()
+	uint32_t	batch_frm;		// frames of all batches, frames per poll = batch_frm / batch
+	uint32_t	batch_us;		// time of all batches (usec)
+	uint32_t	pause_xoff;		// PAUSE frames sent with quanta, RX room was low (or refreshed before expiry)
+	uint32_t	pause_xon;		// PAUSE frames sent with zero quanta, poll loop drained the backlog
+	uint32_t	pause_rx;		// PAUSE frames received & honoured, TX queue held
+	uint32_t	call;			// calls of application core run in LwIP context (rmii_ethernet/call.h)
+	uint32_t	call_us;		// time of all calls (usec)
+	uint32_t	reply_full;		// reply to application core dropped, queue was full
+	uint32_t	rx_size[RMII_STAT_SIZE_BINS];	// received frames passed to LwIP, by length
+	uint32_t	tx_size[RMII_STAT_SIZE_BINS];
+	uint32_t	batch_hist[RMII_STAT_BATCH_BINS];	// RX batches by frames, [0] = 1 frame
+	uint32_t	prio_rx[RMII_STAT_PRIO_BINS];	// frames queued by RX ISR, by priority class
+	uint32_t	prio_drop[RMII_STAT_PRIO_BINS];	// dropped by RX ISR, ring full or headroom of higher classes
+
+	// ----- high watermarks, MUST follow counters
+	uint32_t	tx_q_max;		// max depth of TX queue
+	uint32_t	arena_use;		// max % of RX arena used by received frames
+	uint32_t	arena_frm;		// max frames stored in a RX arena
+	uint32_t	batch_frm_max;
+	uint32_t	batch_us_max;
+	uint32_t	valid_q_max;	// max depth of FCS checked frames waiting LwIP core (USE_RX_PIPELINE)
+	uint32_t	link_rx_us;		// max time from link up to first received frame (usec)
+	uint32_t	call_us_max;	// max time of calls run after a RX batch
+	uint32_t	call_q_max;		// max calls waiting LwIP context
+} rmii_ethernet_stat_t;
+
+// consistent copy of all counters, any core & context except RX ISR, never blocks the driver
+void netif_rmii_ethernet_stat(rmii_ethernet_stat_t *snap);
+
+// d = now - prev for counters, watermarks of now, d may be now
+void netif_rmii_ethernet_stat_sub(rmii_ethernet_stat_t *d, const rmii_ethernet_stat_t *now, const rmii_ethernet_stat_t *prev);
+
+// print non-zero groups, prints nothing if all counters are 0
+void netif_rmii_ethernet_stat_prt(const rmii_ethernet_stat_t *s);
+
+// JSON object into buf, return length (snprintf, >= size if truncated)
+int netif_rmii_ethernet_stat_json(const rmii_ethernet_stat_t *s, char *buf, int size);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Hot path trace (USE_RMII_TRACE in profile.h, records in rmii_trace.h), any core except ISR
+
+	- trace stops while report/dump reads the rings, then resumes
+	- dump is text between "TRACE BEGIN" & "TRACE END", host/trace_json converts it to Chrome/Perfetto JSON
+*/
+
+#ifndef _PICO_RMII_ETHERNET_TRACE_H_
+#define _PICO_RMII_ETHERNET_TRACE_H_
+
+void netif_rmii_ethernet_trace_on(int on);		// 1 : clear rings & start, 0 : stop
+
+void netif_rmii_ethernet_trace_report(void);	// percentiles & histogram of each event
+
+void netif_rmii_ethernet_trace_dump(void);		// records of all rings, oldest first
+
+#endif
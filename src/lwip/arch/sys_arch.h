@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	lwip_mutex (SYS_ARCH_PROTECT of memp & pbuf) hold & wait time per core, see sys_arch.c
+
+	- off by default, costs a timer read & core number on every protect/unprotect
+
+	- each core writes its own entry while it holds the mutex, a reader may see a torn update
+	- application core posting calls (rmii_ethernet/call.h) instead of calling LwIP never takes the mutex
+*/
+
+#ifndef __SYS_ARCH_H__
+#define __SYS_ARCH_H__
+
+#include <stdint.h>
+
+//#define USE_LWIP_LOCK_STAT	// hold & wait time of lwip_mutex, 'lwip' command of example shell
+
+typedef struct
+{	uint32_t	enter;			// sys_arch_protect() calls
+	uint32_t	wait;			// mutex was held by other core
+	uint32_t	wait_us_max;
+	uint32_t	hold_us;		// time of all holds (usec)
+	uint32_t	hold_us_max;
+	uint32_t	since;			// usec timer at enter, hold in progress
+} sys_arch_lock_stat_t;
+
+// copy of both cores, clear after copy if 'clr'
+void sys_arch_lock_stat(sys_arch_lock_stat_t stat[2], int clr);
+
+#endif
@@ -45,11 +45,122 @@
 #define ETH_PAD_SIZE                    0
 #define LWIP_IP_ACCEPT_UDP_PORT(p)      ((p) == PP_NTOHS(67))
 
+#define LWIP_SUPPORT_CUSTOM_PBUF        1   /* RX slots are lent to LwIP without copy */
+
+/* Checksum offload, off by default : needs USE_RX_INLINE_FCS off in src/hal/rmii_hal.h (sniffer is shared),
+   default inline FCS checks RX frames for free while DMA receives, offload trades it for a sniffer pass per frame
+   - LwIP sums by DMA sniffer (fcs_chksum() in src/fcs.c) for what it still calculates
+   - rmii_ethernet.c checks & generates IPv4/TCP/UDP checksum of each protocol turned off below (0),
+     checksum of IPv4 fragments is not checked, UDP is sent without checksum if fragmented */
+//#define USE_CHKSUM_OFFLOAD
+#ifdef USE_CHKSUM_OFFLOAD
+unsigned short fcs_chksum(const void *buf, int size);
+#define LWIP_CHKSUM                     fcs_chksum
+#define LWIP_CHKSUM_ALGORITHM           2   /* keep lwip_standard_chksum() to compare */
+#define CHECKSUM_CHECK_IP               0
+#define CHECKSUM_CHECK_UDP              0
+#define CHECKSUM_CHECK_TCP              0
+#define CHECKSUM_GEN_IP                 0
+#define CHECKSUM_GEN_UDP                0
+#define CHECKSUM_GEN_TCP                0
+#endif
+
 #define LWIP_NETIF_LINK_CALLBACK        1
 #define LWIP_NETIF_STATUS_CALLBACK      1
 
+/* Performance profiles, CMake sets RMII_LWIP_PROFILE (cmake -DRMII_LWIP_PROFILE=RX ..)
+   - window & pools derive from buffer depth of the driver (rmii_ethernet/depth.h)
+     RMII_RX_BURST : frames RX slots take back-to-back before poll loop, RMII_RX_HELD : slots lent to LwIP
+   - frames beyond RMII_RX_HELD are copied to PBUF_POOL, TCP out-of-order queue holds up to a window
+   - DEFAULT keeps LwIP defaults of opt.h except TCP_SND_BUF */
+#include "rmii_ethernet/depth.h"
+
+#define RMII_LWIP_PROFILE_DEFAULT       0
+#define RMII_LWIP_PROFILE_LOWMEM        1   /* small MSS & pools, few connections, no out-of-order queue */
+#define RMII_LWIP_PROFILE_RX            2   /* bulk receive (iperf server), window = RX burst, SACK */
+#define RMII_LWIP_PROFILE_TX            3   /* bulk send (iperf client), send buffer = 2 x TX queue of frames */
+#define RMII_LWIP_PROFILE_CONN          4   /* many short connections (httpd), no out-of-order queue */
+
+#ifndef RMII_LWIP_PROFILE
+#define RMII_LWIP_PROFILE               RMII_LWIP_PROFILE_DEFAULT
+#endif
+
+#if RMII_LWIP_PROFILE == RMII_LWIP_PROFILE_LOWMEM
+#define RMII_LWIP_PROFILE_NAME          "LOWMEM"
+#define TCP_MSS                         536
+#define TCP_WND                         (((RMII_RX_BURST < 4) ? RMII_RX_BURST : 4) * TCP_MSS)
+#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_QUEUE_OOSEQ                 0
+#define LWIP_TCP_SACK_OUT               0
+#define PBUF_POOL_SIZE                  4
+#define MEM_SIZE                        (TCP_SND_BUF + 2048)
+#define MEMP_NUM_TCP_PCB                4
+#define MEMP_NUM_TCP_PCB_LISTEN         2
+
+#elif RMII_LWIP_PROFILE == RMII_LWIP_PROFILE_RX
+#define RMII_LWIP_PROFILE_NAME          "RX"
+#define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
+#define TCP_WND                         (RMII_RX_BURST * TCP_MSS)
+#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_QUEUE_OOSEQ                 1
+#define LWIP_TCP_SACK_OUT               1   /* sender repairs a burst tail dropped under overload without go-back-N */
+#define PBUF_POOL_SIZE                  16  /* LwIP default of case A (README throughput table), copies beyond RMII_RX_HELD */
+#define MEM_SIZE                        (TCP_SND_BUF + 2048)
+#if TCP_WND < 4 * TCP_MSS
+#error "RX window is below case A (TCP_WND = 4 x MSS) of README throughput table"
+#endif
+
+#elif RMII_LWIP_PROFILE == RMII_LWIP_PROFILE_TX
+#define RMII_LWIP_PROFILE_NAME          "TX"
+#define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
+#define TCP_WND                         (2 * TCP_MSS)
+#define TCP_SND_BUF                     (2 * RMII_TX_QUEUE * TCP_MSS)
+#define TCP_QUEUE_OOSEQ                 0
+#define LWIP_TCP_SACK_OUT               0
+#define PBUF_POOL_SIZE                  4
+#define MEM_SIZE                        (TCP_SND_BUF + 4096)
+#define MEMP_NUM_PBUF                   TCP_SND_QUEUELEN    /* payload refs of zero copy tcp_write() */
+
+#elif RMII_LWIP_PROFILE == RMII_LWIP_PROFILE_CONN
+#define RMII_LWIP_PROFILE_NAME          "CONN"
+#define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
+#define TCP_WND                         (2 * TCP_MSS)
+#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_QUEUE_OOSEQ                 0   /* out-of-order segments of each peer would pin RX slots */
+#define LWIP_TCP_SACK_OUT               0
+#define PBUF_POOL_SIZE                  (RMII_RX_BURST + 2)
+#define MEM_SIZE                        (4 * TCP_SND_BUF)
+#define MEMP_NUM_TCP_PCB                16
+#define MEMP_NUM_TCP_SEG                (2 * MEMP_NUM_TCP_PCB)
+
+#else
+#define RMII_LWIP_PROFILE_NAME          "DEFAULT"
 #define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
 #define TCP_SND_BUF                     (2 * TCP_MSS)
+#endif
+
+#if RMII_LWIP_PROFILE != RMII_LWIP_PROFILE_DEFAULT
+#define TCP_SND_QUEUELEN                ((4 * TCP_SND_BUF + (TCP_MSS - 1)) / TCP_MSS)
+#ifndef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                (TCP_SND_QUEUELEN + TCP_QUEUE_OOSEQ * (TCP_WND / TCP_MSS))
+#endif
+
+#if TCP_WND / TCP_MSS > RMII_RX_BURST
+#error "TCP_WND exceeds frames RX slots take back-to-back (RMII_RX_BURST), tail of a full window is dropped"
+#endif
+#if TCP_QUEUE_OOSEQ && TCP_WND / TCP_MSS > RMII_RX_HELD + PBUF_POOL_SIZE
+#error "a window of out-of-order segments exceeds RX slots lent to LwIP (RMII_RX_HELD) + PBUF_POOL_SIZE"
+#endif
+#if PBUF_POOL_SIZE < RMII_RX_BURST - RMII_RX_HELD
+#error "PBUF_POOL_SIZE can not take a RX burst copied once RX slots lent to LwIP are used up"
+#endif
+#if MEM_SIZE < TCP_SND_BUF
+#error "MEM_SIZE can not hold TCP_SND_BUF of data copied by tcp_write()"
+#endif
+#if MEMP_NUM_TCP_SEG < TCP_SND_QUEUELEN
+#error "MEMP_NUM_TCP_SEG is less than TCP_SND_QUEUELEN"
+#endif
+#endif
 
 #define LWIP_HTTPD_CGI                  0
 #define LWIP_HTTPD_SSI                  0
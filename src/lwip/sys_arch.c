@@ -4,16 +4,40 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <string.h>
+
 #include "pico/mutex.h"
 #include "pico/stdlib.h"
 
 #include "lwip/init.h"
+#include "arch/sys_arch.h"
 
 auto_init_mutex(lwip_mutex);
 
+#ifdef USE_LWIP_LOCK_STAT
+static sys_arch_lock_stat_t s_lock_stat[2];	// per core
+#endif
+
 /* lwip has provision for using a mutex, when applicable */
 sys_prot_t sys_arch_protect(void) {
+#ifdef USE_LWIP_LOCK_STAT
+    sys_arch_lock_stat_t *s = &s_lock_stat[get_core_num()];
+    uint32_t now = time_us_32();
+
+    if (!mutex_try_enter(&lwip_mutex, NULL)) {
+        mutex_enter_blocking(&lwip_mutex);
+        s->wait++;
+        uint32_t wait = time_us_32() - now;
+        if (wait > s->wait_us_max) {
+            s->wait_us_max = wait;
+        }
+        now += wait;
+    }
+    s->enter++;
+    s->since = now;
+#else
     mutex_enter_blocking(&lwip_mutex);
+#endif
 
     return 0;
 }
@@ -21,7 +45,30 @@ sys_prot_t sys_arch_protect(void) {
 void sys_arch_unprotect(sys_prot_t pval) {
     (void) pval;
 
+#ifdef USE_LWIP_LOCK_STAT
+    sys_arch_lock_stat_t *s = &s_lock_stat[get_core_num()];
+    uint32_t hold = time_us_32() - s->since;
+
+    s->hold_us += hold;
+    if (hold > s->hold_us_max) {
+        s->hold_us_max = hold;
+    }
+#endif
+
+    mutex_exit(&lwip_mutex);
+}
+
+void sys_arch_lock_stat(sys_arch_lock_stat_t stat[2], int clr) {
+#ifdef USE_LWIP_LOCK_STAT
+    mutex_enter_blocking(&lwip_mutex);
+    memcpy(stat, s_lock_stat, sizeof(s_lock_stat));
+    if (clr) {
+        memset(s_lock_stat, 0, sizeof(s_lock_stat));
+    }
     mutex_exit(&lwip_mutex);
+#else
+    memset(stat, 0, 2 * sizeof(sys_arch_lock_stat_t));
+#endif
 }
 
 /* lwip needs a millisecond time source, and the TinyUSB board support code has one available */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stddef.h>
+
+#include "hal/rmii_hal.h"
+
+#include "ksz8081.h"
+#include "lan8720a.h"
+#include "phy.h"
+
+// ------------------------------------------------------------------
+// - Generic, IEEE 802.3 registers only
+// ------------------------------------------------------------------
+static void phy_generic_init(int addr, int use_irq, int pause)
+{	(void)use_irq;
+
+	// 0b0000_0001_1110_0001
+	//           | |||⁻⁻⁻⁻⁻\__ 0b00001=IEEE 802.3
+	//           | || \_______ 10BASE-T ability
+	//           | | \________ 10BASE-T Full-Duplex ability
+	//           |  \_________ 100BASE-T ability
+	//            \___________ 100BASE-T Full-Duplex ability
+	// RX/TX SM timing follows the resolved speed at link up, bit 10 (symmetric PAUSE) if 'pause'
+	rmii_hal_mdio_write(addr, PHY_ANAR, LAN8720A_AUTO_NEGO_REG_IEEE802_3
+									   | LAN8720A_AUTO_NEGO_REG_10_ABI | LAN8720A_AUTO_NEGO_REG_10_FD_ABI
+									   | LAN8720A_AUTO_NEGO_REG_100_ABI | LAN8720A_AUTO_NEGO_REG_100_FD_ABI
+									   | (pause ? PHY_AN_PAUSE : 0));
+	// Enable & restart auto-negotiate
+	rmii_hal_mdio_write(addr, PHY_BMCR, LAN8720A_BASIC_CONTROL_REG_AUTO_NEGO | LAN8720A_BASIC_CONTROL_REG_REST_AUTO_NEG);
+}
+
+static void phy_link_pause(const uint16_t *reg, phy_link_t *link)	// PAUSE of both sides, full duplex only (802.3 annex 28B)
+{	link->pause = (link->full && (reg[PHY_ANAR] & reg[PHY_ANLPAR] & PHY_AN_PAUSE)) ? 1 : 0;
+}
+
+static int phy_generic_link(const uint16_t *reg, phy_link_t *link)
+{	if (!(reg[PHY_BMSR] & LAN8720A_BASIC_STATUS_REG_LINK_STATUS))	{	return 0;	}
+
+	if (reg[PHY_BMSR] & LAN8720A_BASIC_STATUS_REG_AUTO_NEGO_COMPLETE)
+	{	// highest ability of both sides, 100FD > 100HD > 10FD > 10HD
+		uint16_t	common = reg[PHY_ANAR] & reg[PHY_ANLPAR];
+
+		if (common & (LAN8720A_AUTO_NEGO_REG_100_FD_ABI | LAN8720A_AUTO_NEGO_REG_100_ABI))
+		{	link->speed = 100;
+			link->full = (common & LAN8720A_AUTO_NEGO_REG_100_FD_ABI) ? 1 : 0;
+		}
+		else
+		{	link->speed = 10;
+			link->full = (common & LAN8720A_AUTO_NEGO_REG_10_FD_ABI) ? 1 : 0;
+		}
+		phy_link_pause(reg, link);
+	}
+	else	// auto-negotiation disabled, forced by BMCR
+	{	link->speed = (reg[PHY_BMCR] & LAN8720A_BASIC_CONTROL_REG_SPEED_100) ? 100 : 10;
+		link->full = (reg[PHY_BMCR] & LAN8720A_BASIC_CONTROL_REG_DUPLEX_MODE) ? 1 : 0;
+		link->pause = 0;
+	}
+	return 1;
+}
+
+// ------------------------------------------------------------------
+// - LAN8720A, speed & duplex of link from special status register
+// ------------------------------------------------------------------
+static void phy_lan8720a_init(int addr, int use_irq, int pause)
+{	phy_generic_init(addr, use_irq, pause);
+
+	if (use_irq)
+	{	rmii_hal_mdio_write(addr, LAN8720A_INT_MASK_REG, LAN8720A_INT_AUTO_NEGO_COMPLETE | LAN8720A_INT_LINK_DOWN);
+		rmii_hal_mdio_read(addr, LAN8720A_INT_SOURCE_REG);
+	}
+}
+
+static int phy_lan8720a_link(const uint16_t *reg, phy_link_t *link)
+{	uint16_t	sts = reg[LAN8720A_SPECIAL_STATUS_REG];
+
+	if (!(reg[PHY_BMSR] & LAN8720A_BASIC_STATUS_REG_LINK_STATUS))	{	return 0;	}
+	if ((sts & LAN8720A_SPECIAL_STATUS_REG_SPEED_MASK) == 0)		{	return 0;	}	// not resolved yet
+
+	link->speed = (sts & LAN8720A_SPECIAL_STATUS_REG_SPEED_100) ? 100 : 10;
+	link->full = (sts & LAN8720A_SPECIAL_STATUS_REG_FULL_DUPLEX) ? 1 : 0;
+	phy_link_pause(reg, link);
+	return 1;
+}
+
+// ------------------------------------------------------------------
+// - KSZ8081, speed & duplex of link from PHY control 1 register
+// ------------------------------------------------------------------
+static void phy_ksz8081_init(int addr, int use_irq, int pause)
+{	phy_generic_init(addr, use_irq, pause);
+
+	if (use_irq)
+	{	rmii_hal_mdio_write(addr, KSZ8081_INT_CTRL_STATUS_REG,
+							KSZ8081_INT_CTRL_STATUS_REG_LINK_DOWN_EN | KSZ8081_INT_CTRL_STATUS_REG_LINK_UP_EN);
+		rmii_hal_mdio_read(addr, KSZ8081_INT_CTRL_STATUS_REG);
+	}
+}
+
+static int phy_ksz8081_link(const uint16_t *reg, phy_link_t *link)
+{	uint16_t	ctrl1 = reg[KSZ8081_PHY_CTRL1_REG];
+
+	if (!(reg[PHY_BMSR] & LAN8720A_BASIC_STATUS_REG_LINK_STATUS))	{	return 0;	}
+	if ((ctrl1 & KSZ8081_PHY_CTRL1_REG_MODE_MASK) == 0)			{	return 0;	}	// auto-negotiation running
+
+	link->speed = (ctrl1 & KSZ8081_PHY_CTRL1_REG_MODE_100) ? 100 : 10;
+	link->full = (ctrl1 & KSZ8081_PHY_CTRL1_REG_MODE_FULL) ? 1 : 0;
+	phy_link_pause(reg, link);
+	return 1;
+}
+
+// ------------------------------------------------------------------
+// - Table, first match wins, generic matches any PHY
+// ------------------------------------------------------------------
+static const phy_ops_t		s_phy_ops[] =
+{	{	.name = "LAN8720A", .id = 0x0007c0f0, .id_mask = 0xfffffff0,
+		.link_regs = PHY_REG_BIT(PHY_BMSR) | PHY_REG_BIT(PHY_ANAR) | PHY_REG_BIT(PHY_ANLPAR) | PHY_REG_BIT(LAN8720A_SPECIAL_STATUS_REG),
+		.irq_regs = PHY_REG_BIT(LAN8720A_INT_SOURCE_REG),
+		.init = phy_lan8720a_init, .link = phy_lan8720a_link,
+	},
+	{	.name = "KSZ8081", .id = 0x00221560, .id_mask = 0xfffffff0,
+		.link_regs = PHY_REG_BIT(PHY_BMSR) | PHY_REG_BIT(PHY_ANAR) | PHY_REG_BIT(PHY_ANLPAR) | PHY_REG_BIT(KSZ8081_PHY_CTRL1_REG),
+		.irq_regs = PHY_REG_BIT(KSZ8081_INT_CTRL_STATUS_REG),
+		.init = phy_ksz8081_init, .link = phy_ksz8081_link,
+	},
+	{	.name = "generic", .id = 0, .id_mask = 0,
+		.link_regs = PHY_REG_BIT(PHY_BMCR) | PHY_REG_BIT(PHY_BMSR) | PHY_REG_BIT(PHY_ANAR) | PHY_REG_BIT(PHY_ANLPAR),
+		.irq_regs = 0,
+		.init = phy_generic_init, .link = phy_generic_link,
+	},
+};
+
+const phy_ops_t *phy_find(uint32_t id)
+{	for (size_t i = 0; i < sizeof(s_phy_ops) / sizeof(s_phy_ops[0]) - 1; i++)
+	{	if ((id & s_phy_ops[i].id_mask) == s_phy_ops[i].id)	{	return &s_phy_ops[i];	}
+	}
+	return &s_phy_ops[sizeof(s_phy_ops) / sizeof(s_phy_ops[0]) - 1];
+}
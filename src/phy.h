@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	PHY drivers, selected by PHY identifier (OUI + model) at netif init, generic IEEE 802.3 driver if not known
+
+	- init() : blocking MDIO before RMII starts, advertises 10/100 HD/FD (& symmetric PAUSE) & restarts auto-negotiation
+	- link state : rmii_ethernet.c reads 'link_regs' in background (one MDIO transaction per poll), then link() resolves it
+	- interrupt (optional) : nINT of PHY at netif_rmii_ethernet_config.phy_irq_pin, 'link_regs' are read as soon as
+	  it is asserted instead of next 1 sec poll, reading 'irq_regs' releases it
+*/
+
+#ifndef __PHY_H__
+#define __PHY_H__
+
+#include <stdint.h>
+
+// IEEE 802.3 clause 22 registers, bit per register for phy_ops_t.link_regs
+#define PHY_REG_BIT(reg)		(1u << (reg))
+#define PHY_BMCR				0
+#define PHY_BMSR				1
+#define PHY_ID1					2
+#define PHY_ID2					3
+#define PHY_ANAR				4
+#define PHY_ANLPAR				5
+
+#define PHY_AN_PAUSE			(1u << 10)		// PHY_ANAR/PHY_ANLPAR, symmetric PAUSE (802.3x)
+
+typedef struct
+{	int					speed;				// 10 or 100 Mbps
+	int					full;				// full duplex
+	int					pause;				// both sides advertised symmetric PAUSE & full duplex
+} phy_link_t;
+
+typedef struct
+{	const char*			name;
+	uint32_t			id, id_mask;		// (PHY_ID1 << 16) | PHY_ID2, revision is masked
+	uint32_t			link_regs;			// registers link() needs, PHY_BMSR included
+	uint32_t			irq_regs;			// registers to read to release nINT, 0 = no interrupt
+	void				(*init)(int addr, int use_irq, int pause);	// use_irq : enable nINT for link change, pause : advertise PAUSE
+	int					(*link)(const uint16_t *reg, phy_link_t *link);	// reg[] indexed by register, 1 if link up
+} phy_ops_t;
+
+const phy_ops_t *phy_find(uint32_t id);		// never NULL
+
+#endif // __PHY_H__
@@ -7,77 +7,126 @@
 #ifndef __PROFILE_H__
 #define __PROFILE_H__
 
-#include "pico/stdlib.h"
+#include <stdio.h>
+
+#include "hal/rmii_hal.h"
+
+#include "rmii_ethernet/stat.h"
 
 #define USE_RMII_SM_STAT // for RMII SM statistics
-//#define USE_TIMELAPSE   // for simple profiling
+//#define USE_RMII_TRACE   // hot path trace with cycle timestamps, see rmii_trace.h
+//#define USE_RMII_CAPTURE // packet capture to pcapng over stdio, see rmii_ethernet/capture.h
 
-// ----- statistics
+// ----- statistics, read by netif_rmii_ethernet_stat() (rmii_stat.c)
 #ifdef USE_RMII_SM_STAT
+	enum // writer context, a copy of counters per writer so a counter is never written by 2 contexts
+	{	RMII_STAT_ISR = 0,						// RX SM ISR
+		RMII_STAT_RX,							// FCS check, netif_rmii_ethernet_loop() (USE_RX_PIPELINE) or poll
+		RMII_STAT_LWIP,							// LwIP context, poll & output
+		RMII_STAT_WRITER,
+	};
+
 	typedef struct
-	{	uint32_t	rx_ok;
-		uint32_t	tx_ok;
-		uint32_t	rx_full;
-		uint32_t	bad_crc;
-		uint32_t	pbuf_empty;
-		uint32_t	pbuf_err;
+	{	volatile uint32_t		seq;			// odd while writer updates, reader retries if changed
+		rmii_ethernet_stat_t	v;
 	} rmii_sm_stat_t;
-	#define rmii_sm_stat_declare(name)			rmii_sm_stat_t name = {0};
-	#define rmii_sm_stat_add(name_field, val)	name_field += (val);
-	#define rmii_sm_stat_clr(name)				{	name.rx_ok = name.tx_ok = 0; 	}
-
-	void rmii_sm_stat_prt(rmii_sm_stat_t* name)
-	{	int x = name->tx_ok + name->rx_ok + name->rx_full+ name->bad_crc+ name->pbuf_empty+ name->pbuf_err;
-		if (x)
-		{	printf("TX/RX %d %d RX-FULL/CRC/PBUF/ERR %d %d %d %d\n",
-				name->tx_ok, name->rx_ok, name->rx_full, name->bad_crc, name->pbuf_empty, name->pbuf_err);
-		}
+	extern rmii_sm_stat_t		g_rmii_sm_stat[RMII_STAT_WRITER];
+
+	static inline uint32_t rmii_sm_stat_bin(uint32_t len)	// RMII_STAT_SIZE_BINS index of frame length (FCS included)
+	{	if (len <= 64)		{	return 0;	}
+		if (len <= 127)		{	return 1;	}
+		if (len <= 255)		{	return 2;	}
+		if (len <= 511)		{	return 3;	}
+		if (len <= 1023)	{	return 4;	}
+		if (len <= 1518)	{	return 5;	}
+		return 6;
 	}
+
+	// a field alone, or fields of an event between begin & end with _in variants (seen all or none by reader)
+	#define rmii_sm_stat_begin(w)				{	g_rmii_sm_stat[w].seq++;	rmii_hal_barrier();	}
+	#define rmii_sm_stat_end(w)					{	rmii_hal_barrier();	g_rmii_sm_stat[w].seq++;	}
+	#define rmii_sm_stat_add_in(w, field, val)	{	g_rmii_sm_stat[w].v.field += (val);	}
+	#define rmii_sm_stat_max_in(w, field, val)	{	uint32_t sv = (val);	if (sv > g_rmii_sm_stat[w].v.field)	{	g_rmii_sm_stat[w].v.field = sv;	}	}
+	#define rmii_sm_stat_size_in(w, field, len)	rmii_sm_stat_add_in(w, field[rmii_sm_stat_bin(len)], 1)
+
+	#define rmii_sm_stat_add(w, field, val)		{	uint32_t sv = (val);	rmii_sm_stat_begin(w);	rmii_sm_stat_add_in(w, field, sv);	rmii_sm_stat_end(w);	}
+	#define rmii_sm_stat_max(w, field, val)		{	uint32_t sv = (val); \
+													if (sv > g_rmii_sm_stat[w].v.field) \
+													{	rmii_sm_stat_begin(w);	g_rmii_sm_stat[w].v.field = sv;	rmii_sm_stat_end(w);	} }
+	#define rmii_sm_stat_size(w, field, len)	rmii_sm_stat_add(w, field[rmii_sm_stat_bin(len)], 1)
 #else
-	#define rmii_sm_stat_declare(name)			;
-	#define rmii_sm_stat_add(name_field, val)	;
-	#define rmii_sm_stat_clr(name)				;
-	#define rmii_sm_stat_prt(name)				;
+	#define rmii_sm_stat_begin(w)				;
+	#define rmii_sm_stat_end(w)					;
+	#define rmii_sm_stat_add_in(w, field, val)	;
+	#define rmii_sm_stat_max_in(w, field, val)	;
+	#define rmii_sm_stat_size_in(w, field, len)	;
+	#define rmii_sm_stat_add(w, field, val)		;
+	#define rmii_sm_stat_max(w, field, val)		;
+	#define rmii_sm_stat_size(w, field, len)	;
 #endif
 
 
-// ----- for simple profiling
-#ifdef USE_TIMELAPSE
-	typedef struct timelapse_t
-	{	uint32_t			run;
-		uint32_t			start;
-		uint32_t			min, max;
-		const char* 		title;
-		struct timelapse_t* next;
-	} timelapse_t;
-	timelapse_t*	g_timelapse_head = NULL;
-
-	#define timelapse_declare(name, titled)	static timelapse_t name  = {	.title = titled, .min = -1, .max = 0, .run = 0	};
-	#define timelapse_link(name) 			{	name.next = g_timelapse_head;	g_timelapse_head = &name;	}
-	#define timelapse_start(name)			{   name.start = time_us_32();  }
-	#define timelapse_stop(name)			{	uint32_t diff = time_us_32() - name.start; \
-												name.run++; \
-												if (diff < name.min)	{	name.min = diff;	} \
-												if (diff > name.max)	{	name.max = diff;	} \
-											}
-	void timelapse_prt()	{	timelapse_t* ptr = g_timelapse_head;
-								int		wrap = 0;
-								while (ptr)
-								{	printf("%s R/N/X %d %d %d ", ptr->title, ptr->run, ptr->min, ptr->max);
-                                    ptr->run = ptr->max = 0;
-                                    ptr->min = -1;
-									wrap ++;
-									if (wrap == 4)	{	wrap = 0;	putchar('\n'); 	}
-									ptr = ptr->next;
-								}
-							}
+// ----- hot path trace, read by netif_rmii_ethernet_trace_xxx() (rmii_trace.c)
+#ifdef USE_RMII_TRACE
+	#include "rmii_trace.h"
+
+	extern rmii_trace_ring_t	g_rmii_trace[RMII_TRACE_RING];
+	extern volatile int			g_rmii_trace_on;		// 0 while a reader copies rings
+
+	// 2 timer loads & 2 stores, ring is written by its context only
+	#define rmii_trace(ring, id, phase)	{	if (g_rmii_trace_on) \
+											{	rmii_trace_ring_t *tr = &g_rmii_trace[ring]; \
+												rmii_trace_rec_t *rec = &tr->rec[tr->head & (RMII_TRACE_LEN-1)]; \
+												rec->us = rmii_hal_time_us(); \
+												rec->ev = (phase) | ((id) << 24) | (rmii_hal_cycles() & 0x00ffffff); \
+												tr->head++; \
+											} }
 #else
-	#define timelapse_declare(name, titled)			;
-	#define timelapse_link(name)					;
-	#define timelapse_start(name)					;
-	#define timelapse_stop(name)					;
-	#define timelapse_prt()							;
+	#define rmii_trace(ring, id, phase)	;
+#endif
+
+// ----- packet capture, streamed by rmii_capture_poll() in netif_rmii_ethernet_poll() (rmii_capture.c)
+#ifdef USE_RMII_CAPTURE
+	#include "rmii_ethernet/capture.h"
+
+	enum // writer context, a buffer per writer (same order as RMII_STAT_xxx)
+	{	RMII_CAPTURE_ISR = 0,					// RX SM ISR, dropped before ready ring
+		RMII_CAPTURE_RX,						// FCS check, dropped by CRC or checksum
+		RMII_CAPTURE_LWIP,						// LwIP context, received & sent
+		RMII_CAPTURE_RING,
+	};
+
+	enum // reason of captured frame
+	{	RMII_CAP_OK = 0,
+		RMII_CAP_RUNT,							// RMII_CAP_RUNT ~ MC are RX_FILTER_xxx (rx_filter.h)
+		RMII_CAP_UC,
+		RMII_CAP_MC,
+		RMII_CAP_GIANT,
+		RMII_CAP_FULL,							// ready ring or FCS checked ring was full
+		RMII_CAP_BAD_CRC,
+		RMII_CAP_BAD_CHKSUM,
+		RMII_CAP_PRIO,							// room was kept for higher priority class (rmii_ethernet/prio.h)
+		RMII_CAP_MAC_CTRL,						// MAC control (802.3x PAUSE), handled by driver
+		RMII_CAP_REASON,
+	};
 
+	extern volatile uint32_t	g_rmii_cap_on;	// RMII_CAP_xxx being captured, 0 while stopped or restarting
+
+	void rmii_capture_put(int ring, uint32_t dir, uint32_t reason, uint32_t us, const rmii_hal_tx_desc_t *seg);
+	void rmii_capture_poll(void);
+
+	// a load & a branch while stopped, 'seg' ends by 0 length like TX descriptors
+	#define rmii_capture(ring, dir, reason, us, seg)	{	if (__builtin_expect(g_rmii_cap_on & (dir), 0)) \
+															{	rmii_capture_put(ring, dir, reason, us, seg);	} }
+	#define rmii_capture_buf(ring, dir, reason, us, buf, size) \
+														{	if (__builtin_expect(g_rmii_cap_on & (dir), 0)) \
+															{	rmii_hal_tx_desc_t cs[2] = {	{	(size), (buf)	}, {	0, NULL	}	}; \
+																rmii_capture_put(ring, dir, reason, us, cs); \
+															} }
+#else
+	#define rmii_capture(ring, dir, reason, us, seg)				;
+	#define rmii_capture_buf(ring, dir, reason, us, buf, size)	;
+	#define rmii_capture_poll()									;
 #endif
 
 #endif // __PROFILE_H__
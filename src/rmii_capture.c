@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Packet capture to pcapng (see rmii_ethernet/capture.h)
+
+	- writer : rmii_capture_put() copies a record (header + 'snap' bytes) into the byte ring of its context,
+	  a record not fitting the ring is counted as lost, never waits the reader
+	- reader : rmii_capture_poll() in LwIP context merges rings by timestamp, a record is a pcapng EPB line
+	- start/stop only post a request, rings are reset or flushed by the reader so every ring keeps a single reader
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rmii_ethernet/capture.h"
+
+#include "profile.h"
+
+#ifdef USE_RMII_CAPTURE
+#define RMII_CAP_BUF		8192				// bytes of a ring, power of 2
+#define RMII_CAP_SNAP_MAX	1536				// snap 0 (whole frame) is limited to this
+#define RMII_CAP_DRAIN		4					// records streamed per rmii_capture_poll()
+#define CAP_ALIGN(x)		(((x) + 3) & ~3u)
+
+typedef struct
+{	uint32_t				us;
+	uint16_t				len;				// length on the wire, FCS included
+	uint16_t				cap;				// bytes following header
+	uint8_t					dir;				// RMII_CAP_xxx
+	uint8_t					reason;				// RMII_CAP_OK or drop reason
+	uint16_t				lost;				// records lost by full ring since previous record
+} cap_rec_t;
+
+typedef struct
+{	volatile uint32_t		head;				// bytes written, updated by writer after record
+	volatile uint32_t		tail;				// bytes read, updated by reader
+	uint32_t				put;				// records written
+	uint32_t				lost;				// records not fitting the ring
+	uint32_t				lost_mark;			// 'lost' at previous record
+	uint32_t				cnt;				// matched frames for 1-in-N
+	uint8_t					buf[RMII_CAP_BUF];
+} cap_ring_t;
+
+enum // request to reader
+{	CAP_REQ_NONE = 0,
+	CAP_REQ_START,
+	CAP_REQ_STOP,
+};
+
+volatile uint32_t			g_rmii_cap_on;
+
+static cap_ring_t			s_cap_ring[RMII_CAPTURE_RING];
+static rmii_ethernet_capture_t	s_cap_cfg;		// read by writers, changed only while g_rmii_cap_on = 0
+static rmii_ethernet_capture_t	s_cap_next;		// of start request
+static volatile uint32_t	s_cap_req, s_cap_req_seq;	// posted by start/stop
+static uint32_t				s_cap_req_done;		// s_cap_req_seq handled by reader
+static int					s_cap_run;			// section is open, reader
+static uint32_t				s_cap_us_hi, s_cap_us_last;	// 64 bit usec of pcapng
+
+static uint8_t				s_cap_blk[28 + RMII_CAP_SNAP_MAX + 64];	// EPB : header, data, options, length
+static uint32_t				s_cap_blk_len;
+static char					s_cap_line[(sizeof(s_cap_blk) + 2) / 3 * 4 + 1];
+
+static const char* const	s_cap_reason[RMII_CAP_REASON] =
+{	"", "runt", "unicast to other", "multicast not joined", "giant", "ring full", "bad crc", "bad checksum", "priority headroom",
+	"mac control"	};
+
+#define EPB_INBOUND			(1u << 0)			// epb_flags
+#define EPB_OUTBOUND		(2u << 0)
+#define EPB_CRC_ERR			(1u << 24)
+#define EPB_TOO_LONG		(1u << 25)
+#define EPB_TOO_SHORT		(1u << 26)
+
+// ------------------------------------------------------------------
+// - Writer
+// ------------------------------------------------------------------
+
+static inline int cap_match(const rmii_ethernet_capture_t *c, const uint8_t *d, uint32_t len)	// header is in first segment
+{	const uint8_t	*ip = d + 14;
+	uint32_t		ihl, port;
+
+	if (c->type == 0 && c->proto == 0 && c->port == 0)	{	return 1;	}
+	if (len < 14)										{	return 0;	}
+	if (c->type && ((d[12] << 8) | d[13]) != c->type)	{	return 0;	}
+	if (c->proto == 0 && c->port == 0)					{	return 1;	}
+
+	if (d[12] != 0x08 || d[13] != 0x00 || len < 14 + 20)	{	return 0;	}	// IPv4 only
+	if (c->proto && ip[9] != c->proto)					{	return 0;	}
+	if (c->port == 0)									{	return 1;	}
+
+	ihl = (ip[0] & 0x0f) * 4;
+	if ((ip[9] != 6 && ip[9] != 17) || ((ip[6] & 0x1f) | ip[7]) != 0 || len < 14 + ihl + 4)	{	return 0;	}
+	port = c->port;
+	return ((ip[ihl] << 8) | ip[ihl + 1]) == port || ((ip[ihl + 2] << 8) | ip[ihl + 3]) == port;
+}
+
+static inline void cap_write(cap_ring_t *r, uint32_t pos, const void *src, uint32_t n)
+{	uint32_t	idx = pos & (RMII_CAP_BUF-1), first = RMII_CAP_BUF - idx;
+
+	if (n <= first)	{	memcpy(&r->buf[idx], src, n);	}
+	else
+	{	memcpy(&r->buf[idx], src, first);
+		memcpy(r->buf, (const uint8_t*)src + first, n - first);
+	}
+}
+
+void __time_critical_func(rmii_capture_put)(int ring, uint32_t dir, uint32_t reason, uint32_t us, const rmii_hal_tx_desc_t *seg)
+{	cap_ring_t	*r = &s_cap_ring[ring];
+	cap_rec_t	rec;
+	uint32_t	len = 0, cap, pos;
+
+	if (!cap_match(&s_cap_cfg, seg->addr, seg->len))	{	return;	}
+	if (reason == RMII_CAP_OK && s_cap_cfg.every > 1)
+	{	if (++r->cnt < s_cap_cfg.every)	{	return;	}
+		r->cnt = 0;
+	}
+
+	for (const rmii_hal_tx_desc_t *s = seg; s->len; s++)	{	len += s->len;	}
+	cap = (s_cap_cfg.snap && len > s_cap_cfg.snap) ? s_cap_cfg.snap : len;
+	if (cap > RMII_CAP_SNAP_MAX)	{	cap = RMII_CAP_SNAP_MAX;	}
+
+	if (RMII_CAP_BUF - (r->head - r->tail) < CAP_ALIGN(sizeof(rec) + cap))	// reader is behind, count & go
+	{	r->lost++;
+		rmii_sm_stat_add(ring, cap_lost, 1);
+		return;
+	}
+
+	rec.us = us;
+	rec.len = len;
+	rec.cap = cap;
+	rec.dir = dir;
+	rec.reason = reason;
+	rec.lost = (r->lost - r->lost_mark < 0xffff) ? r->lost - r->lost_mark : 0xffff;
+	r->lost_mark = r->lost;
+
+	pos = r->head;
+	cap_write(r, pos, &rec, sizeof(rec));
+	pos += sizeof(rec);
+	for (const rmii_hal_tx_desc_t *s = seg; s->len && cap; s++)
+	{	uint32_t	n = (s->len < cap) ? s->len : cap;
+
+		cap_write(r, pos, s->addr, n);
+		pos += n;
+		cap -= n;
+	}
+
+	rmii_hal_barrier();							// record before head
+	r->head += CAP_ALIGN(sizeof(rec) + rec.cap);
+	r->put++;
+}
+
+// ------------------------------------------------------------------
+// - Reader, pcapng blocks as base64 console lines
+// ------------------------------------------------------------------
+
+static void cap_read(const cap_ring_t *r, uint32_t pos, void *dst, uint32_t n)
+{	uint32_t	idx = pos & (RMII_CAP_BUF-1), first = RMII_CAP_BUF - idx;
+
+	if (n <= first)	{	memcpy(dst, &r->buf[idx], n);	}
+	else
+	{	memcpy(dst, &r->buf[idx], first);
+		memcpy((uint8_t*)dst + first, r->buf, n - first);
+	}
+}
+
+static void blk_u32(uint32_t v)
+{	memcpy(&s_cap_blk[s_cap_blk_len], &v, 4);
+	s_cap_blk_len += 4;
+}
+
+static void blk_pad()
+{	while (s_cap_blk_len & 3)	{	s_cap_blk[s_cap_blk_len++] = 0;	}
+}
+
+static void blk_opt(uint16_t code, const void *val, uint16_t n)
+{	blk_u32(code | ((uint32_t)n << 16));
+	memcpy(&s_cap_blk[s_cap_blk_len], val, n);
+	s_cap_blk_len += n;
+	blk_pad();
+}
+
+static void blk_begin(uint32_t type)
+{	s_cap_blk_len = 0;
+	blk_u32(type);
+	blk_u32(0);									// length, filled by blk_end()
+}
+
+static void blk_end()							// close options & print the block
+{	static const char	b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char				*o = s_cap_line;
+
+	blk_u32(0);									// opt_endofopt
+	blk_u32(s_cap_blk_len + 4);
+	memcpy(&s_cap_blk[4], &s_cap_blk_len, 4);
+
+	for (uint32_t i = 0; i < s_cap_blk_len; i += 3)
+	{	uint32_t	n = s_cap_blk_len - i;
+		uint32_t	v = (s_cap_blk[i] << 16) | ((n > 1) ? s_cap_blk[i+1] << 8 : 0) | ((n > 2) ? s_cap_blk[i+2] : 0);
+
+		*o++ = b64[(v >> 18) & 0x3f];
+		*o++ = b64[(v >> 12) & 0x3f];
+		*o++ = (n > 1) ? b64[(v >> 6) & 0x3f] : '=';
+		*o++ = (n > 2) ? b64[v & 0x3f] : '=';
+	}
+	*o = 0;
+	printf("@PCAP %s\n", s_cap_line);			// a line by a call, not split by prints of other core
+}
+
+static void blk_time(uint32_t us)				// 64 bit usec, records are merged in time order
+{	if (us < s_cap_us_last && s_cap_us_last - us > 0x80000000u)	{	s_cap_us_hi++;	}
+	s_cap_us_last = us;
+	blk_u32(s_cap_us_hi);
+	blk_u32(us);
+}
+
+static void cap_section()						// SHB & IDB
+{	static const char	appl[] = "pico-rmii-ethernet";
+	static const char	ifname[] = "rmii";
+	const uint8_t		tsresol = 6, fcslen = 4;
+
+	blk_begin(0x0a0d0d0a);
+	blk_u32(0x1a2b3c4d);						// byte order magic
+	blk_u32(1);									// major 1, minor 0
+	blk_u32(0xffffffff);						// section length unknown
+	blk_u32(0xffffffff);
+	blk_opt(4, appl, sizeof(appl) - 1);			// shb_userappl
+	blk_end();
+
+	blk_begin(1);
+	blk_u32(1);									// LINKTYPE_ETHERNET
+	blk_u32(s_cap_cfg.snap);
+	blk_opt(2, ifname, sizeof(ifname) - 1);		// if_name
+	blk_opt(9, &tsresol, 1);					// if_tsresol, usec
+	blk_opt(13, &fcslen, 1);					// if_fcslen
+	blk_end();
+}
+
+static void cap_isb()							// interface statistics at stop
+{	uint64_t	lost = 0;
+
+	for (int i = 0; i < RMII_CAPTURE_RING; i++)	{	lost += s_cap_ring[i].lost;	}
+
+	blk_begin(5);
+	blk_u32(0);									// interface id
+	blk_time(rmii_hal_time_us());
+	blk_opt(5, &lost, 8);						// isb_ifdrop
+	blk_end();
+}
+
+static int cap_drain()							// stream the oldest record of all rings, 0 if empty
+{	cap_ring_t	*r = NULL;
+	cap_rec_t	rec, cur;
+	uint32_t	flags;
+
+	for (int i = 0; i < RMII_CAPTURE_RING; i++)
+	{	cap_ring_t	*q = &s_cap_ring[i];
+
+		if (q->head == q->tail)	{	continue;	}
+		rmii_hal_barrier();						// head before record
+		cap_read(q, q->tail, &cur, sizeof(cur));
+		if (r == NULL || (int32_t)(cur.us - rec.us) < 0)
+		{	r = q;
+			rec = cur;
+		}
+	}
+	if (r == NULL)	{	return 0;	}
+
+	blk_begin(6);
+	blk_u32(0);									// interface id
+	blk_time(rec.us);
+	blk_u32(rec.cap);
+	blk_u32(rec.len);
+	cap_read(r, r->tail + sizeof(rec), &s_cap_blk[s_cap_blk_len], rec.cap);
+	s_cap_blk_len += rec.cap;
+	blk_pad();
+
+	rmii_hal_barrier();							// record copied before writer reuses it
+	r->tail += CAP_ALIGN(sizeof(rec) + rec.cap);
+
+	flags = (rec.dir == RMII_CAP_TX) ? EPB_OUTBOUND : EPB_INBOUND;
+	flags |= (rec.reason == RMII_CAP_BAD_CRC) ? EPB_CRC_ERR : (rec.reason == RMII_CAP_GIANT) ? EPB_TOO_LONG :
+		(rec.reason == RMII_CAP_RUNT) ? EPB_TOO_SHORT : 0;
+	blk_opt(2, &flags, 4);						// epb_flags
+	if (rec.lost)
+	{	uint64_t	lost = rec.lost;
+
+		blk_opt(4, &lost, 8);					// epb_dropcount
+	}
+	if (rec.reason != RMII_CAP_OK && rec.reason < RMII_CAP_REASON)
+	{	blk_opt(1, s_cap_reason[rec.reason], strlen(s_cap_reason[rec.reason]));	// opt_comment
+	}
+	blk_end();
+	return 1;
+}
+
+static void cap_quiet()							// writers saw g_rmii_cap_on = 0, a record takes < 1 usec
+{	uint32_t	start = rmii_hal_time_us();
+
+	while (rmii_hal_time_us() - start < 100)	{	rmii_hal_idle();	}
+	rmii_hal_barrier();
+}
+
+void rmii_capture_poll(void)
+{	uint32_t	seq = s_cap_req_seq;
+
+	if (seq != s_cap_req_done)
+	{	uint32_t	req = s_cap_req;
+
+		s_cap_req_done = seq;
+		cap_quiet();
+		if (s_cap_run)							// flush & close current section
+		{	while (cap_drain())	{	}
+			cap_isb();
+			s_cap_run = 0;
+		}
+		if (req == CAP_REQ_START)
+		{	s_cap_cfg = s_cap_next;
+			for (int i = 0; i < RMII_CAPTURE_RING; i++)
+			{	cap_ring_t	*r = &s_cap_ring[i];
+
+				r->head = r->tail = 0;
+				r->put = r->lost = r->lost_mark = r->cnt = 0;
+			}
+			s_cap_us_hi = 0;
+			s_cap_us_last = rmii_hal_time_us();
+			cap_section();
+			s_cap_run = 1;
+
+			rmii_hal_barrier();
+			g_rmii_cap_on = s_cap_cfg.dir;
+		}
+	}
+
+	for (int i = 0; s_cap_run && i < RMII_CAP_DRAIN && cap_drain(); i++)	{	}
+}
+
+// ------------------------------------------------------------------
+// - API
+// ------------------------------------------------------------------
+
+void netif_rmii_ethernet_capture_start(const rmii_ethernet_capture_t *cfg)
+{	g_rmii_cap_on = 0;
+	s_cap_next = *cfg;
+	s_cap_req = CAP_REQ_START;
+	rmii_hal_barrier();
+	s_cap_req_seq++;
+}
+
+void netif_rmii_ethernet_capture_stop(void)
+{	g_rmii_cap_on = 0;
+	s_cap_req = CAP_REQ_STOP;
+	rmii_hal_barrier();
+	s_cap_req_seq++;
+}
+
+void netif_rmii_ethernet_capture_prt(void)
+{	uint32_t	put = 0, lost = 0;
+
+	for (int i = 0; i < RMII_CAPTURE_RING; i++)
+	{	put += s_cap_ring[i].put;
+		lost += s_cap_ring[i].lost;
+	}
+	printf("CAPTURE %s DIR%s%s%s SNAP %u EVERY %u TYPE %04x PROTO %u PORT %u CAPTURED/LOST %u %u\n",
+		g_rmii_cap_on ? "ON" : "OFF", (s_cap_cfg.dir & RMII_CAP_RX) ? " RX" : "", (s_cap_cfg.dir & RMII_CAP_TX) ? " TX" : "",
+		(s_cap_cfg.dir & RMII_CAP_DROP) ? " DROP" : "", (unsigned)s_cap_cfg.snap, (unsigned)s_cap_cfg.every,
+		(unsigned)s_cap_cfg.type, (unsigned)s_cap_cfg.proto, (unsigned)s_cap_cfg.port, (unsigned)put, (unsigned)lost);
+}
+#else
+void netif_rmii_ethernet_capture_start(const rmii_ethernet_capture_t *cfg)	{	(void)cfg;	printf("USE_RMII_CAPTURE is off (profile.h)\n");	}
+void netif_rmii_ethernet_capture_stop(void)	{	}
+void netif_rmii_ethernet_capture_prt(void)	{	printf("USE_RMII_CAPTURE is off (profile.h)\n");	}
+#endif
@@ -4,33 +4,30 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
-#define USE_TWO_RX_SM
-
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
-#include "lan8720a.h"
-
-#include "hardware/dma.h"
-
-#include "pico/stdlib.h"
-#include "pico/time.h"
-#include "pico/unique_id.h"
-#include "pico/sem.h"			// use semaphore to inform Ethernet RX event
-
 #include "lwip/etharp.h"
+#include "lwip/igmp.h"
+#include "lwip/mld6.h"
 #include "lwip/netif.h"
+#include "lwip/pbuf.h"
 #include "lwip/timeouts.h"
 
-#ifdef USE_TWO_RX_SM
-	#include "rmii_ethernet_phy_rx_2.pio.h"
-#else
-	#include "rmii_ethernet_phy_rx.pio.h"
-#endif
-#include "rmii_ethernet_phy_tx.pio.h"
-
+#include "rmii_ethernet/call.h"
 #include "rmii_ethernet/netif.h"
 
+#include "hal/rmii_hal.h"
+
+#include "call_ring.h"
+#include "phy.h"
 #include "profile.h"
+#include "rx_arena.h"
+#include "rx_filter.h"
+#include "rx_lend.h"
+#include "rx_prio.h"
+#include "rx_ring.h"
 
 // ------------------------------------------------------------------
 // - Debug
@@ -42,9 +39,23 @@
 #define unlikely(x)		__builtin_expect((x),0)
 
 // ------------------------------------------------------------------
-// - extern
+// - FCS & checksum
 // ------------------------------------------------------------------
-extern uint32_t fcs_crc32(const uint8_t *buf, int size);	// byte based crc32 calculation
+// CRC32 backend is selected by netif_rmii_ethernet_config.fcs at init (fcs_crc32_init)
+#define rmii_fcs_crc32(buf, size)				fcs_crc32(buf, size)
+#define rmii_fcs_crc32_update(crc, buf, size)	fcs_crc32_update(crc, buf, size)
+
+#ifdef USE_RX_INLINE_FCS // sniffer is owned by RX DMA, calculate others by software
+	#define RMII_FCS_DMA_OK							0
+	#define rmii_chksum(buf, size)					fcs_chksum_sw(buf, size)
+#else
+	#define RMII_FCS_DMA_OK							1
+	#define rmii_chksum(buf, size)					fcs_chksum(buf, size)
+#endif
+
+// checksums turned off in LwIP (lwipopts.h) are checked & generated by driver
+#define RMII_CHKSUM_CHECK		(!CHECKSUM_CHECK_IP || !CHECKSUM_CHECK_TCP || !CHECKSUM_CHECK_UDP)
+#define RMII_CHKSUM_GEN			(!CHECKSUM_GEN_IP || !CHECKSUM_GEN_TCP || !CHECKSUM_GEN_UDP)
 
 // ------------------------------------------------------------------
 // - Static Vars
@@ -52,244 +63,484 @@ extern uint32_t fcs_crc32(const uint8_t *buf, int size);	// byte based crc32 cal
 static struct netif 		*s_rmii_if;
 
 static struct netif_rmii_ethernet_config s_rmii_if_cfg = NETIF_RMII_ETHERNET_DEFAULT_CONFIG();
-#define PICO_RMII_PIO 		(s_rmii_if_cfg.pio)
-#define PICO_RMII_SM_RX 	(s_rmii_if_cfg.pio_sm_start)
-#define PICO_RMII_SM_TX 	(s_rmii_if_cfg.pio_sm_start + 1)
-#define PICO_RMII_SM_RX_2 	(s_rmii_if_cfg.pio_sm_start + 2)
-#define PICO_RMII_RX_PIN 	(s_rmii_if_cfg.rx_pin_start)
-#define PICO_RMII_TX_PIN 	(s_rmii_if_cfg.tx_pin_start)
-#define PICO_RMII_MDIO_PIN 	(s_rmii_if_cfg.mdio_pin_start)
-#define PICO_RMII_MDC_PIN 	(s_rmii_if_cfg.mdio_pin_start + 1)
-#define PICO_RMII_RETCLK_PIN (s_rmii_if_cfg.retclk_pin)
 #define PICO_RMII_MAC_ADDR 	(s_rmii_if_cfg.mac_addr)
 
-static uint					s_rx_sm_off;		// start address of SM in PIO ram
-static uint 				s_tx_sm_off;		// start address of SM in PIO ram
-
-static int 					s_rx_dma_chn;		// DMA channel number for RX SM
-static int 					s_tx_dma_chn;		// DMA channel number for TX SM
-
-static dma_channel_config 	s_rx_dma_chn_cfg;	// DMA channel configuration for RX SM
-static dma_channel_config 	s_tx_dma_chn_cfg;	// DMA channel configuration for TX SM
+// ----- buffer for RMII RX
+//#define USE_RX_ARENA	// pack frames by length (see rx_arena.h) instead of fixed slots, for floods of small frames
 
-#ifdef USE_TWO_RX_SM
-static int 					s_rx_dma_chn_2;		// DMA channel number for second RX SM
-static dma_channel_config 	s_rx_dma_chn_cfg_2;	// DMA channel configuration for RX SM
+#define ETH_FRAME_LEN		(1514+4+6)			// 1514(MAC ~ payload) + 4(FCS) + 6(reserved for data boundary guard or VLAN??)
+#define MAX_RX_FRAME		RMII_RX_SLOT		// RX slots, depth is shared with lwipopts.h (rmii_ethernet/depth.h)
+#define MAX_RX_READY		RMII_RX_READY		// received frames waiting netif_rmii_ethernet_poll()
+#define RX_POLL_BUDGET		8					// frames drained per netif_rmii_ethernet_poll(), housekeeping runs once per batch
+#define MAX_RX_VALID		MAX_RX_READY		// FCS checked frames waiting LwIP core (USE_RX_PIPELINE)
+#if RX_POLL_BUDGET > RMII_STAT_BATCH_BINS
+	#error "RX_POLL_BUDGET exceeds batch histogram of statistics (rmii_ethernet/stat.h)"
+#endif
+#if RMII_PRIO_CLASS > RMII_STAT_PRIO_BINS
+	#error "RMII_PRIO_CLASS exceeds priority counters of statistics (rmii_ethernet/stat.h)"
 #endif
 
-// ----- buffer for RMII RX
-#define ETH_FRAME_LEN		(1514+4+6)			// 1514(MAC ~ payload) + 4(FCS) + 6(reserved for data boundary guard or VLAN??)
-#define MAX_RX_FRAME		4					// 4 frame needs for iperf/TCP test (21Mbps), adjust as your application needs
-static volatile int			s_rx_frame_head;	// updated in ISR code
-static volatile int			s_rx_frame_rear;	// updated in netif_rmii_ethernet_poll()
+enum // state of rx_frame_t, changed only by the current owner of the slot
+{	RX_SLOT_FREE = RX_ARENA_FREE,				// owner : ISR
+	RX_SLOT_DMA,								// owner : ISR, DMA is writing
+	RX_SLOT_READY,								// owner : netif_rmii_ethernet_poll(), waiting CRC check & input
+												//         or netif_rmii_ethernet_loop() then poll (USE_RX_PIPELINE)
+	RX_SLOT_LWIP,								// owner : LwIP, returned to FREE by rx_frame_pbuf_free()
+};
+
+enum // FCS result of rx_frame_t, checked by sniffer while receiving
+{	RX_FCS_UNKNOWN = 0,							// sniffer was not ready at start of frame, check by software
+	RX_FCS_GOOD,
+	RX_FCS_BAD,
+};
+#define ETH_FCS_RESIDUE		0x2144df1c			// CRC32 of (frame + FCS) when FCS is correct
+
 typedef struct
-{	int						len;				// length of data
-	uint8_t 				data[ETH_FRAME_LEN];
+{	rx_arena_blk_t			blk;				// MUST be first, state = RX_SLOT_xxx, user = pool index
+	struct pbuf_custom		pc;					// custom pbuf to lend 'data' to LwIP without copy
+	uint8_t					fcs;				// RX_FCS_xxx
+	uint16_t				len;				// length of data
+#ifdef USE_RMII_CAPTURE
+	uint32_t				us;					// end-of-frame, timestamp of capture
+#endif
+	uint8_t 				data[];				// ETH_FRAME_LEN while DMA, trimmed to 'len' at end-of-frame (arena)
 } rx_frame_t;
-static rx_frame_t			s_rx_frame[MAX_RX_FRAME];	// buffer between RX-SM ~ DMA
-static uint8_t				s_rx_frame_dummy[2];		// dummy memory for DMA when s_rx_frame == full
-static int 					s_rx_frame_idx[2];
+#define RX_FRAME_NEED		RX_ARENA_ALIGN(sizeof(rx_frame_t) + ETH_FRAME_LEN)	// contiguous bytes to arm a DMA
 
-static semaphore_t			s_rx_frame_sem;		// to trigger packet receiving event from ISR code to netif_rmii_ethernet_poll()
+#ifdef USE_RX_ARENA
+	#define RX_POOL_NUM		RMII_HAL_RX_SM		// an arena per RX SM in use, SMs are armed in advance, a full one borrows
+	static rx_arena_t		s_rx_arena[RX_POOL_NUM];	// s_rx_pool[] is divided by RX SM in use
+#else
+	#define RX_POOL_NUM		1
+	#define RX_HELD_MAX		RMII_RX_HELD		// slots lent to LwIP, remains are kept for RX SM/DMA (copied to PBUF_POOL if exceed)
+	static int				s_rx_frame_last;	// last slot assigned to DMA, to search next free slot
+#endif
+static uint32_t				s_rx_pool[MAX_RX_FRAME * RX_FRAME_NEED / 4];	// buffer between RX-SM ~ DMA
+static rx_frame_t*			s_rx_frame_cur[RMII_HAL_RX_SM];	// frame assigned to each RX SM/DMA (NULL = discard)
+static int					s_rx_sm_num;		// RX SM in use, receive frames in index order
 
-static int 					s_phy_addr = 0;		// LAN8720A PHY Address (auto-detected)
+#ifdef USE_RX_INLINE_FCS
+static int					s_rx_sniff_idx;		// RX SM index of sniffed DMA
+static int					s_rx_sniff_clean;	// sniffer was ready before first byte of frame
+#endif
+
+static void* volatile		s_rx_ready_slot[MAX_RX_READY];
+static rx_ring_t			s_rx_ready;			// frames in receiving order, ISR -> netif_rmii_ethernet_poll()
+#ifdef USE_RX_PIPELINE
+static void* volatile		s_rx_valid_slot[MAX_RX_VALID];
+static rx_ring_t			s_rx_valid;			// FCS checked frames, netif_rmii_ethernet_loop() (core1) -> poll (core0)
+#endif
+static rx_lend_t			s_rx_lend[RX_POOL_NUM];	// RX_SLOT_LWIP per pool (bytes or slots), accessed in LwIP context only
+static rx_filter_t			s_rx_filter;		// destination MAC filter, checked in ISR
+static rx_prio_t			s_rx_prio;			// priority classes & headroom, checked in ISR
+
+// ----- call forwarding (rmii_ethernet/call.h), ready before netif_rmii_ethernet_init()
+static call_msg_t			s_call_slot[RMII_CALL_QUEUE];
+static call_ring_t			s_call = {	s_call_slot, RMII_CALL_QUEUE, 0, 0	};		// application core -> LwIP context
+static call_msg_t			s_reply_slot[RMII_CALL_QUEUE];
+static call_ring_t			s_reply = {	s_reply_slot, RMII_CALL_QUEUE, 0, 0	};	// LwIP context -> application core
+
+// ----- buffer for RMII TX
+#define MAX_TX_QUEUE		RMII_TX_QUEUE		// frames queued to TX DMA (rmii_ethernet/depth.h)
+#define MAX_TX_DESC			(16+3)				// pbuf chain + padding + FCS + null descriptor
+#define ETH_MIN_FRAME_LEN	60					// minimal frame length without FCS
+typedef struct
+{	rmii_hal_tx_desc_t		desc[MAX_TX_DESC];	// DMA control blocks of a frame
+	uint8_t					fcs[4];
+	struct pbuf*			p;					// referenced until TX DMA finished
+} tx_frame_t;
+static tx_frame_t			s_tx_frame[MAX_TX_QUEUE];
+static volatile int			s_tx_frame_head;	// next s_tx_frame[] to queue, updated in netif_rmii_ethernet_output()
+static volatile int			s_tx_frame_send;	// s_tx_frame[] on DMA, updated in TX SM ISR
+static int					s_tx_frame_rear;	// next s_tx_frame[] to release, updated in LwIP context
+static volatile int			s_tx_busy;			// TX DMA is running
+static const uint8_t		s_tx_pad[ETH_MIN_FRAME_LEN];	// zero padding for short frame
+
+// ----- 802.3x flow control (netif_rmii_ethernet_config.pause), PAUSE is sent ahead of queued frames
+#define RX_PAUSE_RING_ON	24					// XOFF when free ready ring entries fall to this (above RMII_PRIO_DEFAULT_RING)
+#define RX_PAUSE_SLOT_ON	3					// or free RX slots (max frames of free arena bytes, USE_RX_ARENA)
+#define RX_PAUSE_BACKLOG	2					// frames waiting poll loop, XOFF needs more, XON at this or less
+#define RX_PAUSE_MIN_US		200					// shortest XOFF, frames in flight & PAUSE waiting TX DMA
+#define RX_PAUSE_FRAME_US	20					// poll loop cost per frame until measured
+static struct
+{	volatile int		on;						// PAUSE resolved at link up, full duplex
+	volatile int		xoff;					// XOFF was sent, XON not yet
+	volatile int		req;					// PAUSE frame waits TX DMA
+	volatile int		dma;					// PAUSE frame is on TX DMA, TX queue is not advanced
+	volatile uint32_t	quanta;					// of requested PAUSE frame
+	volatile uint32_t	refresh_us;				// XOFF again at, before link partner resumes
+	volatile uint32_t	frame_us;				// poll loop cost per frame (average), sets quanta of XOFF
+	volatile int		hold;					// TX queue held by received PAUSE until 'hold_us'
+	volatile uint32_t	hold_us;
+	uint32_t			crc0, crc_bit[16];		// FCS of PAUSE frame with quanta 0 & change by each quanta bit
+} s_pause;
+static tx_frame_t			s_tx_pause;			// PAUSE frame on TX DMA, 'p' is not used
+static uint8_t				s_tx_pause_data[ETH_MIN_FRAME_LEN];
+
+#define PHY_POLL_UP_US		(1000*1000)			// link poll interval while link is up (nINT of PHY is checked every poll)
+#define PHY_POLL_DOWN_US	(100*1000)			// while link is down, to restart soon
+
+static int 					s_phy_addr = 0;		// PHY Address (auto-detected)
+static const phy_ops_t*		s_phy_ops;			// PHY driver, by PHY identifier
+static int					s_link_speed = 100;	// Mbps of RX/TX SM timing, resolved at link up
+static int					s_link_full = 1;	// full duplex
+static uint32_t				s_link_up_us;		// time of link up
+static int					s_link_rx_wait;		// first frame after link up is not received yet
+#ifdef USE_RX_PIPELINE
+static volatile int			s_link_rx_req;		// RX_LINK_xxx of phy_link_xxx() (core0), done by netif_rmii_ethernet_check() (core1)
+#endif
+static uint32_t				s_mdio_poll_expire;	// next link poll, nINT of PHY polls at once
+static uint32_t				s_stat_expire;		// next statistics print
 
 // ----- etc
 #define time_after(now, expire) (((int32_t)(expire) - (int32_t)(now)) < 0) //  return 1(now > expire), 0 (now < expire)
 
 // ----- profile & statistics
-rmii_sm_stat_declare(s_sm_stat);
-timelapse_declare(tl_crc, "CRC");
-timelapse_declare(tl_rx, "RX");
-timelapse_declare(tl_tx, "TX");
-timelapse_declare(tl_net, "NET");
+#ifdef USE_RMII_SM_STAT
+static rmii_ethernet_stat_t	s_stat_now, s_stat_prev;	// snapshots of statistics print
+#endif
 
 
 // ------------------------------------------------------------------
-// - MDIO bit-bang
+// - Ethernet FCS
 // ------------------------------------------------------------------
 
-static void netif_rmii_ethernet_mdio_clock_out(int bit)
-{	gpio_put(PICO_RMII_MDC_PIN, 0);			busy_wait_us(2);
-	gpio_put(PICO_RMII_MDIO_PIN, bit);
-	gpio_put(PICO_RMII_MDC_PIN, 1);			busy_wait_us(2);
+#if 0 // zs, useless, code to search end-of-frame using calculated CRC but already know the packet length
+static uint ethernet_frame_length(const uint8_t *data, int length) // zs, replace to use byte base calculation
+{	extern const uint32_t crc32_tab[];
+
+    uint crc = 0xffffffff;  // Initial value.
+    uint index = 0;
+
+    while(--length >= 0)
+    {   crc = crc32_tab[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+        index++;
+
+        uint inverted_crc = ~crc;
+
+        if (memcmp(data, &inverted_crc, sizeof(inverted_crc)) == 0) {
+            return index;
+        }
+    }
+
+    return 0;
 }
+#endif
 
-static uint netif_rmii_ethernet_mdio_clock_in()
-{	gpio_put(PICO_RMII_MDC_PIN, 0);			busy_wait_us(2);
+// ------------------------------------------------------------------
+// - IPv4/TCP/UDP checksum (for CHECKSUM_CHECK_xxx / CHECKSUM_GEN_xxx = 0)
+// ------------------------------------------------------------------
+#define ETH_HDR_LEN			14
+#define IP_PROTO_TCP		6
+#define IP_PROTO_UDP		17
 
-	int bit = gpio_get(PICO_RMII_MDIO_PIN);
+static inline uint32_t chksum_fold(uint32_t sum)
+{	sum = (sum & 0xffff) + (sum >> 16);
+	return (sum & 0xffff) + (sum >> 16);
+}
 
-	gpio_put(PICO_RMII_MDC_PIN, 1);
-	busy_wait_us(2);
+static inline uint32_t chksum_swap(uint32_t sum)	{	return ((sum & 0xff) << 8) | ((sum >> 8) & 0xff);	}
 
-	return bit;
+static inline uint32_t chksum_pseudo(const uint8_t *ip, int proto, int l4_len)	// IPv4 pseudo header
+{	return rmii_chksum(ip + 12, 8) + lwip_htons(proto) + lwip_htons(l4_len);
 }
 
-static uint16_t netif_rmii_ethernet_mdio_read(uint addr, uint reg)
-{	gpio_init(PICO_RMII_MDIO_PIN);
-	gpio_init(PICO_RMII_MDC_PIN);
+static inline int chksum_l4_offset(int proto)	// offset of checksum in TCP/UDP header, 0 = others
+{	return (proto == IP_PROTO_TCP) ? 16 : (proto == IP_PROTO_UDP) ? 6 : 0;
+}
 
-	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_OUT);
-	gpio_set_dir(PICO_RMII_MDC_PIN, GPIO_OUT);
+#if RMII_CHKSUM_CHECK
+static int rx_frame_chksum_ok(const uint8_t *data, int len)	// frame without FCS, 0 if a checksum is bad
+{	const uint8_t	*ip = data + ETH_HDR_LEN;
+	int				ihl, tot_len, proto;
 
-	// PRE_32
-	for (int i = 0; i < 32; i++)	{	netif_rmii_ethernet_mdio_clock_out(1);	}
+	if (len < ETH_HDR_LEN + 20 || data[12] != 0x08 || data[13] != 0x00)	{	return 1;	}	// not IPv4
 
-	// ST
-	netif_rmii_ethernet_mdio_clock_out(0);
-	netif_rmii_ethernet_mdio_clock_out(1);
+	ihl = (ip[0] & 0x0f) * 4;
+	tot_len = (ip[2] << 8) | ip[3];
+	if (ihl < 20 || tot_len < ihl || ETH_HDR_LEN + tot_len > len)	{	return 1;	}	// let LwIP drop it
 
-	// OP
-	netif_rmii_ethernet_mdio_clock_out(1);
-	netif_rmii_ethernet_mdio_clock_out(0);
+#if !CHECKSUM_CHECK_IP
+	if (chksum_fold(rmii_chksum(ip, ihl)) != 0xffff)	{	return 0;	}
+#endif
 
-	// PA5
-	for (int i = 0; i < 5; i++)
-	{	uint bit = (addr >> (4 - i)) & 0x01;
+	proto = ip[9];
+	if (((ip[6] & 0x3f) | ip[7]) != 0)	{	return 1;	}	// fragment, L4 checksum spans fragments
 
-		netif_rmii_ethernet_mdio_clock_out(bit);
-	}
+#if !CHECKSUM_CHECK_TCP
+	if (proto == IP_PROTO_TCP)	{	goto check_l4;	}
+#endif
+#if !CHECKSUM_CHECK_UDP
+	if (proto == IP_PROTO_UDP && (ip[ihl + 6] | ip[ihl + 7]) != 0)	{	goto check_l4;	}	// 0 = no checksum
+#endif
+	return 1;
 
-	// RA5
-	for (int i = 0; i < 5; i++)
-	{	uint bit = (reg >> (4 - i)) & 0x01;
+check_l4:
+	if (tot_len < ihl + chksum_l4_offset(proto) + 2)	{	return 0;	}
+	return chksum_fold(chksum_pseudo(ip, proto, tot_len - ihl) + rmii_chksum(ip + ihl, tot_len - ihl)) == 0xffff;
+}
+#endif
 
-		netif_rmii_ethernet_mdio_clock_out(bit);
-	}
+#if RMII_CHKSUM_GEN
+static void tx_frame_chksum(struct pbuf *p)	// fill checksums, headers are in first pbuf (allocated by LwIP)
+{	uint8_t		*ip = (uint8_t*)p->payload + ETH_HDR_LEN;
+	uint8_t		*data = (uint8_t*)p->payload;
+	int			ihl, tot_len, proto, off;
+	uint16_t	ck;
 
-	// TA
-	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_IN);
-	netif_rmii_ethernet_mdio_clock_out(0);
-	netif_rmii_ethernet_mdio_clock_out(0);
+	if (p->len < ETH_HDR_LEN + 20 || data[12] != 0x08 || data[13] != 0x00)	{	return;	}
 
-	uint16_t data = 0;
+	ihl = (ip[0] & 0x0f) * 4;
+	tot_len = (ip[2] << 8) | ip[3];
+	if (ihl < 20 || ETH_HDR_LEN + ihl > p->len)	{	return;	}
 
-	for (int i = 0; i < 16; i++)
-	{	data <<= 1;
+#if !CHECKSUM_GEN_IP
+	ip[10] = ip[11] = 0;
+	ck = ~chksum_fold(rmii_chksum(ip, ihl));
+	memcpy(&ip[10], &ck, 2);
+#endif
 
-		data |= netif_rmii_ethernet_mdio_clock_in();
+	proto = ip[9];
+	off = chksum_l4_offset(proto);
+	if (off == 0 || ((ip[6] & 0x3f) | ip[7]) != 0)	{	return;	}	// fragmented UDP keeps 0 (no checksum)
+#if CHECKSUM_GEN_TCP
+	if (proto == IP_PROTO_TCP)	{	return;	}
+#endif
+#if CHECKSUM_GEN_UDP
+	if (proto == IP_PROTO_UDP)	{	return;	}
+#endif
+	if (ETH_HDR_LEN + ihl + off + 2 > p->len || tot_len < ihl + off + 2)	{	return;	}
+
+	// sum L4 header & payload over pbuf chain, a pbuf of odd length swaps bytes of following sum
+	uint8_t		*l4 = ip + ihl;
+	uint32_t	sum = 0;
+	int			left = tot_len - ihl, swapped = 0;
+
+	l4[off] = l4[off + 1] = 0;
+	for (struct pbuf *q = p; q != NULL && left > 0; q = q->next)
+	{	const uint8_t	*d = (q == p) ? l4 : (const uint8_t*)q->payload;
+		int				n = (q == p) ? p->len - (ETH_HDR_LEN + ihl) : q->len;
+
+		if (n > left)	{	n = left;	}
+		sum = chksum_fold(sum + rmii_chksum(d, n));
+		if (n & 1)	{	swapped ^= 1;	sum = chksum_swap(sum);	}
+		left -= n;
 	}
+	if (swapped)	{	sum = chksum_swap(sum);	}
 
-	return data;
+	ck = ~chksum_fold(sum + chksum_pseudo(ip, proto, tot_len - ihl));
+	if (ck == 0 && proto == IP_PROTO_UDP)	{	ck = 0xffff;	}
+	memcpy(&l4[off], &ck, 2);
 }
+#endif
 
-void netif_rmii_ethernet_mdio_write(int addr, int reg, int val)
-{	gpio_init(PICO_RMII_MDIO_PIN);
-	gpio_init(PICO_RMII_MDC_PIN);
+// ------------------------------------------------------------------
+// - Ethernet Tx
+// ------------------------------------------------------------------
 
-	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_OUT);
-	gpio_set_dir(PICO_RMII_MDC_PIN, GPIO_OUT);
+static inline int tx_frame_depth()
+{	int		depth = s_tx_frame_head - s_tx_frame_rear;
 
-	// PRE_32
-	for (int i = 0; i < 32; i++)	{	netif_rmii_ethernet_mdio_clock_out(1);	}
+	return (depth >= 0) ? depth : depth + MAX_TX_QUEUE;
+}
 
-	// ST
-	netif_rmii_ethernet_mdio_clock_out(0);
-	netif_rmii_ethernet_mdio_clock_out(1);
+static inline void tx_frame_start(tx_frame_t *pframe)
+{	// control DMA loads each desc[] to the TX DMA which sends data to PIO RMII transmitter
+	s_tx_busy = 1;
+	rmii_hal_tx_start(pframe->desc);
+}
 
-	// OP
-	netif_rmii_ethernet_mdio_clock_out(0);
-	netif_rmii_ethernet_mdio_clock_out(1);
+static inline int tx_frame_held()	// under lock, TX queue is held by received PAUSE
+{	if (s_pause.hold && time_after(rmii_hal_time_us(), s_pause.hold_us))	{	s_pause.hold = 0;	}
+	return s_pause.hold;
+}
 
-	// PA5
-	for (int i = 0; i < 5; i++)
-	{	uint bit = (addr >> (4 - i)) & 0x01;
+static inline void tx_pause_fill()	// TX DMA is idle, quanta & FCS of PAUSE frame
+{	uint32_t	q = s_pause.quanta, crc = s_pause.crc0;
 
-		netif_rmii_ethernet_mdio_clock_out(bit);
+	s_tx_pause_data[16] = q >> 8;
+	s_tx_pause_data[17] = q;
+	for (int i = 0; q != 0; i++, q >>= 1)
+	{	if (q & 1)	{	crc ^= s_pause.crc_bit[i];	}
 	}
+	memcpy(s_tx_pause.fcs, &crc, 4);
+}
 
-	// RA5
-	for (int i = 0; i < 5; i++)
-	{	uint bit = (reg >> (4 - i)) & 0x01;
-
-		netif_rmii_ethernet_mdio_clock_out(bit);
+static inline void tx_frame_next()	// under lock & TX DMA idle, PAUSE frame first, then queued frames unless held
+{	if (s_pause.req)
+	{	tx_pause_fill();
+		s_pause.req = 0;
+		s_pause.dma = 1;
+		tx_frame_start(&s_tx_pause);
 	}
+	else if (s_tx_frame_send != s_tx_frame_head && !tx_frame_held())	{	tx_frame_start(&s_tx_frame[s_tx_frame_send]);	}
+	else																{	s_tx_busy = 0;	}
+}
 
-	// TA
-	netif_rmii_ethernet_mdio_clock_out(1);
-	netif_rmii_ethernet_mdio_clock_out(0);
+void __time_critical_func(tx_sm_isr_run)(void)
+{	// TX SM sent the frame & IPG, start next frame as soon as possible
+	uint32_t	save = rmii_hal_lock();
 
-	for (int i = 0; i < 16; i++)
-	{	uint bit = (val >> (15 - i)) & 0x01;
+	if (s_tx_busy)	// not the IPG after SM (re)start
+	{	if (s_pause.dma)	{	s_pause.dma = 0;	}	// PAUSE frame was not queued
+		else				{	s_tx_frame_send = (s_tx_frame_send != (MAX_TX_QUEUE-1)) ? s_tx_frame_send + 1 : 0;	}
 
-		netif_rmii_ethernet_mdio_clock_out(bit);
+		tx_frame_next();
 	}
-
-	gpio_set_dir(PICO_RMII_MDIO_PIN, GPIO_IN);
+	rmii_hal_unlock(save);
 }
 
-// ------------------------------------------------------------------
-// - Ethernet FCS
-// ------------------------------------------------------------------
+static void tx_frame_kick()	// any context, restart TX after received PAUSE expired
+{	uint32_t	save = rmii_hal_lock();
 
-#if 0 // zs, useless, code to search end-of-frame using calculated CRC but already know the packet length
-static uint ethernet_frame_length(const uint8_t *data, int length) // zs, replace to use byte base calculation
-{	extern const uint32_t crc32_tab[];
+	if (!s_tx_busy)	{	tx_frame_next();	}
+	rmii_hal_unlock(save);
+}
 
-    uint crc = 0xffffffff;  // Initial value.
-    uint index = 0;
+static void tx_pause_send(uint32_t quanta)	// any context, XOFF (quanta) or XON (0), replaces a PAUSE frame not sent yet
+{	uint32_t	save = rmii_hal_lock();
 
-    while(--length >= 0)
-    {   crc = crc32_tab[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	s_pause.quanta = quanta;
+	s_pause.xoff = (quanta != 0);
+	s_pause.refresh_us = rmii_hal_time_us() + quanta * 256 / s_link_speed;	// half of pause, a quanta is 512 bit times
+	s_pause.req = 1;
+	if (!s_tx_busy)	{	tx_frame_next();	}
+	rmii_hal_unlock(save);
+}
 
-        index++;
+static void tx_pause_init(const uint8_t *mac)	// PAUSE frame, FCS is linear : fcs(a ^ b) = fcs(a) ^ fcs(b) ^ fcs(0)
+{	static const uint8_t	dst[6] = {	0x01, 0x80, 0xc2, 0x00, 0x00, 0x01	};
+	uint8_t					*d = s_tx_pause_data;
 
-        uint inverted_crc = ~crc;
+	memset(d, 0, ETH_MIN_FRAME_LEN);
+	memcpy(&d[0], dst, 6);
+	memcpy(&d[6], mac, 6);
+	d[12] = 0x88;	d[13] = 0x08;				// MAC control
+	d[14] = 0x00;	d[15] = 0x01;				// opcode PAUSE, quanta at 16
 
-        if (memcmp(data, &inverted_crc, sizeof(inverted_crc)) == 0) {
-            return index;
-        }
-    }
+	s_pause.crc0 = rmii_fcs_crc32(d, ETH_MIN_FRAME_LEN);
+	for (int i = 0; i < 16; i++)
+	{	d[16] = (1u << i) >> 8;
+		d[17] = (1u << i);
+		s_pause.crc_bit[i] = rmii_fcs_crc32(d, ETH_MIN_FRAME_LEN) ^ s_pause.crc0;
+	}
+	d[16] = d[17] = 0;
 
-    return 0;
+	s_tx_pause.desc[0].len = ETH_MIN_FRAME_LEN;
+	s_tx_pause.desc[0].addr = d;
+	s_tx_pause.desc[1].len = 4;
+	s_tx_pause.desc[1].addr = s_tx_pause.fcs;
+	s_tx_pause.desc[2].len = 0;
+	s_tx_pause.desc[2].addr = NULL;
+
+	s_pause.on = s_pause.xoff = s_pause.req = s_pause.dma = s_pause.hold = 0;
+	s_pause.frame_us = RX_PAUSE_FRAME_US;
 }
-#endif
 
-// ------------------------------------------------------------------
-// - Ethernet Tx
-// ------------------------------------------------------------------
+static void netif_rmii_ethernet_tx_release()	// free pbufs already sent, MUST be called in LwIP context
+{	while (s_tx_frame_rear != s_tx_frame_send)
+	{	pbuf_free(s_tx_frame[s_tx_frame_rear].p);
+		s_tx_frame[s_tx_frame_rear].p = NULL;
+
+		s_tx_frame_rear = (s_tx_frame_rear != (MAX_TX_QUEUE-1)) ? s_tx_frame_rear + 1 : 0;
+	}
+}
 
 static err_t netif_rmii_ethernet_output(struct netif *netif, struct pbuf *p)
-{	// TODO: use a ping-pong buffer ? => zs, No. meaningless. tested
+{	if (unlikely(!netif_is_link_up(netif)))	// lost on the wire, SM timing may change at link up
+	{	rmii_sm_stat_add(RMII_STAT_LWIP, tx_link_drop, 1);
+		return ERR_IF;
+	}
 
-	static uint8_t	tx_frame[ETH_FRAME_LEN];	// MUST be static, accessed by DMA at background
+	rmii_trace(RMII_TRACE_LWIP, TR_TX, TR_BEGIN);
 
-	timelapse_start(tl_tx);
+	netif_rmii_ethernet_tx_release();
 
-	dma_channel_wait_for_finish_blocking(s_tx_dma_chn);
+	int			next = (s_tx_frame_head != (MAX_TX_QUEUE-1)) ? s_tx_frame_head + 1 : 0;
 
-	// assemble fragmented pbufs to a single buffer for DMA access
-	uint tot_len = 0;
-	for (struct pbuf *q = p; q != NULL; q = q->next)
-	{	memcpy(tx_frame + tot_len, q->payload, q->len);
+	if (unlikely(next == s_tx_frame_rear))	// queue full, wait until a frame is sent
+	{	rmii_sm_stat_add(RMII_STAT_LWIP, tx_stall, 1);
+
+		while (next == s_tx_frame_rear)
+		{	rmii_hal_idle();
+			if (s_pause.hold)	{	tx_frame_kick();	}	// held by received PAUSE, restart at expiry
+			netif_rmii_ethernet_tx_release();
+		}
+	}
+
+	if (likely(pbuf_clen(p) <= (MAX_TX_DESC - 3)))
+	{	pbuf_ref(p);	// LwIP can free 'p' after return, hold it until DMA finished
+	}
+	else // too many fragments, assemble to a single pbuf
+	{	if ((p = pbuf_clone(PBUF_RAW, PBUF_RAM, p)) == NULL)
+		{	rmii_sm_stat_add(RMII_STAT_LWIP, pbuf_empty, 1);
+			rmii_trace(RMII_TRACE_LWIP, TR_TX, TR_END);
+			return ERR_MEM;
+		}
+	}
+
+#if RMII_CHKSUM_GEN
+	tx_frame_chksum(p);
+#endif
 
-		tot_len += q->len;
+	// build DMA control blocks from pbuf chain, no copy
+	tx_frame_t*	pframe = &s_tx_frame[s_tx_frame_head];
+	rmii_hal_tx_desc_t*	desc = pframe->desc;
+	uint 		tot_len = 0;
+	uint32_t	crc = 0;
 
+	rmii_trace(RMII_TRACE_LWIP, TR_TX_CRC, TR_BEGIN);
+	for (struct pbuf *q = p; q != NULL; q = q->next)
+	{	if (q->len)
+		{	desc->len = q->len;
+			desc->addr = q->payload;
+			desc++;
+
+			crc = rmii_fcs_crc32_update(crc, q->payload, q->len);
+			tot_len += q->len;
+		}
 		if (q->len == q->tot_len)	{	break;	}
 	}
 
 	// Minimal Ethernet payload is 64 bytes, 4-bytes CRC included
 	// Pad the payload to 64-4=60 bytes, and then add the CRC
-	// TODO-zs : may need to fill zero for padding data area ??
-	if (tot_len < 60)	{	tot_len = 60;	}
+	if (tot_len < ETH_MIN_FRAME_LEN)
+	{	desc->len = ETH_MIN_FRAME_LEN - tot_len;
+		desc->addr = s_tx_pad;
+		desc++;
+
+		crc = rmii_fcs_crc32_update(crc, s_tx_pad, ETH_MIN_FRAME_LEN - tot_len);
+	}
 
 	// Append the CRC to the frame
-	timelapse_start(tl_crc);
-	uint crc = fcs_crc32(tx_frame, tot_len);	// zs, replace ethernet_frame_crc
-	for (int i = 0; i < 4; i++)	{	tx_frame[tot_len++] = ((uint8_t *)&crc)[i];	}
-	timelapse_stop(tl_crc);
-
-	// Setup and start the DMA to send the frame via the PIO RMII tansmitter
-	dma_channel_configure(
-		s_tx_dma_chn, &s_tx_dma_chn_cfg,
-		((uint8_t *)&PICO_RMII_PIO->txf[PICO_RMII_SM_TX]) + 3,
-		tx_frame,
-		tot_len,
-		true);
-
-	rmii_sm_stat_add(s_sm_stat.tx_ok, 1);
-	timelapse_stop(tl_tx);
+	memcpy(pframe->fcs, &crc, 4);
+	desc->len = 4;
+	desc->addr = pframe->fcs;
+	desc++;
+
+	desc->len = 0;
+	desc->addr = NULL;
+	rmii_trace(RMII_TRACE_LWIP, TR_TX_CRC, TR_END);
+	rmii_capture(RMII_CAPTURE_LWIP, RMII_CAP_TX, RMII_CAP_OK, rmii_hal_time_us(), pframe->desc);
+
+	pframe->p = p;
+
+	// queue, start DMA if idle (otherwise TX SM ISR will start it)
+	rmii_hal_barrier();
+	uint32_t	save = rmii_hal_lock();
+
+	s_tx_frame_head = next;
+	if (!s_tx_busy)	{	tx_frame_next();	}
+
+	rmii_hal_unlock(save);
+
+	rmii_sm_stat_begin(RMII_STAT_LWIP);
+	rmii_sm_stat_max_in(RMII_STAT_LWIP, tx_q_max, tx_frame_depth());
+	rmii_sm_stat_add_in(RMII_STAT_LWIP, tx_ok, 1);
+	rmii_sm_stat_size_in(RMII_STAT_LWIP, tx_size, ((tot_len < ETH_MIN_FRAME_LEN) ? ETH_MIN_FRAME_LEN : tot_len) + 4);
+	rmii_sm_stat_end(RMII_STAT_LWIP);
+	rmii_trace(RMII_TRACE_LWIP, TR_TX, TR_END);
 
 	return ERR_OK;
 }
@@ -297,169 +548,609 @@ static err_t netif_rmii_ethernet_output(struct netif *netif, struct pbuf *p)
 // ------------------------------------------------------------------
 // - Ethernet Rx
 // ------------------------------------------------------------------
-void __time_critical_func(rx_sm_isr_run)(int sm_no)
-{	int sm_idx, frame_idx, dma_no;
+#ifdef USE_RX_ARENA
+static inline rx_frame_t* rx_frame_alloc(int sm_idx)	// ISR, take a free run for max frame, own arena first then borrow
+{	int		idx = sm_idx;
 
-#ifdef USE_TWO_RX_SM
-	if (sm_no == PICO_RMII_SM_RX)
-	{	dma_no = s_rx_dma_chn;		sm_idx = 0; 	frame_idx = s_rx_frame_idx[0]; 		}
-	else
-	{	dma_no = s_rx_dma_chn_2;	sm_idx = 1; 	frame_idx = s_rx_frame_idx[1]; 		}
+	for (int i = 0; i < s_rx_sm_num; i++)
+	{	rx_frame_t	*pframe = (rx_frame_t*)rx_arena_reserve(&s_rx_arena[idx], RX_FRAME_NEED);
+
+		if (pframe != NULL)
+		{	pframe->blk.user = idx;		// arena, not SM
+			return pframe;
+		}
+		idx = (idx != (s_rx_sm_num - 1)) ? idx + 1 : 0;	// a frame held by LwIP splits an arena, next one may have a run
+	}
+	return NULL;
+}
+
+static inline void rx_frame_commit(rx_frame_t *pframe)	// ISR, trim to received length
+{	rx_arena_commit(&s_rx_arena[pframe->blk.user], &pframe->blk, sizeof(rx_frame_t) + pframe->len);
+}
+
+static inline uint32_t rx_frame_room(int sm_idx, int len)	// ISR, max frames fitting free bytes of all arenas after current one
+{	uint32_t	free = 0;
+	(void)sm_idx;
+
+	for (int i = 0; i < s_rx_sm_num; i++)	{	free += s_rx_arena[i].size - rx_arena_used(&s_rx_arena[i]);	}
+	return (free - RX_ARENA_ALIGN(sizeof(rx_frame_t) + len)) / RX_FRAME_NEED;
+}
+
+static inline uint32_t rx_frame_held_unit(rx_frame_t *pframe)	{	return pframe->blk.size;	}
+
+static inline void rx_frame_release(rx_frame_t *pframe)	// LwIP context
+{	rmii_hal_barrier();					// finish reading data before ISR reuse the slot
+	rx_arena_release(&s_rx_arena[pframe->blk.user], &pframe->blk, 0);
+}
+
+static inline void rx_frame_drop(rx_frame_t *pframe)	// FCS check stage, core1 with USE_RX_PIPELINE, counts apart from LwIP core
+{	rmii_hal_barrier();
+	rx_arena_release(&s_rx_arena[pframe->blk.user], &pframe->blk, 1);
+}
 #else
-	dma_no = s_rx_dma_chn;		sm_idx = 0; 	frame_idx = s_rx_frame_idx[0];
+static inline rx_frame_t* rx_frame_alloc(int sm_idx)	// ISR, search free slot (slots lent to LwIP are returned out of order)
+{	int		idx = s_rx_frame_last;
+	(void)sm_idx;
+
+	for (int i = 0; i < MAX_RX_FRAME; i++)
+	{	rx_frame_t	*pframe;
+
+		idx = (idx != (MAX_RX_FRAME -1)) ? idx + 1 : 0;
+		pframe = (rx_frame_t*)((uint8_t*)s_rx_pool + idx * RX_FRAME_NEED);
+
+		if (pframe->blk.state == RX_SLOT_FREE)
+		{	s_rx_frame_last = idx;
+			return pframe;
+		}
+	}
+	return NULL;
+}
+
+static inline uint32_t rx_frame_room(int sm_idx, int len)	// ISR, free slots, one is kept for each other SM without slot
+{	int		n = 0;
+	(void)len;
+
+	for (int i = 0; i < MAX_RX_FRAME; i++)
+	{	if (((rx_frame_t*)((uint8_t*)s_rx_pool + i * RX_FRAME_NEED))->blk.state == RX_SLOT_FREE)	{	n++;	}
+	}
+	for (int i = 0; i < s_rx_sm_num; i++)
+	{	if (i != sm_idx && s_rx_frame_cur[i] == NULL)	{	n--;	}
+	}
+	return (n > 0) ? n : 0;
+}
+
+static inline void rx_frame_commit(rx_frame_t *pframe)		{	(void)pframe;	}
+static inline uint32_t rx_frame_held_unit(rx_frame_t *pframe)	{	(void)pframe;	return 1;	}
+
+static inline void rx_frame_release(rx_frame_t *pframe)
+{	rmii_hal_barrier();					// finish reading data before ISR reuse the slot
+	pframe->blk.state = RX_SLOT_FREE;
+}
+
+#define rx_frame_drop(pframe)	rx_frame_release(pframe)	// state store only, safe on any core
 #endif
-	int	is_real_rx = dma_hw->ch[dma_no].ctrl_trig & DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS;
 
-	// 1. abort DMA
-	dma_channel_abort(dma_no);
+static void rx_frame_pbuf_free(struct pbuf *p)	// called by LwIP when the lent slot is released
+{	rx_frame_t	*pframe = (rx_frame_t*)((uint8_t*)p - offsetof(rx_frame_t, pc));
 
-	// 2. calculate length
-	if (is_real_rx)
-	{	uint32_t	offset = dma_channel_hw_addr(dma_no)->write_addr;
-		uint32_t 	start = (uint32_t)s_rx_frame[frame_idx].data;
+	rx_lend_back(&s_rx_lend[pframe->blk.user], rx_frame_held_unit(pframe));
+	rx_frame_release(pframe);
+}
 
-		s_rx_frame[frame_idx].len = offset - start;
+// ----- 802.3x flow control
+#ifdef USE_RX_PIPELINE
+	#define rx_pause_backlog()		(rx_ring_count(&s_rx_ready) + rx_ring_count(&s_rx_valid))
+#else
+	#define rx_pause_backlog()		rx_ring_count(&s_rx_ready)
+#endif
+#ifdef USE_RX_INLINE_FCS
+	#define rx_pause_fcs_bad(pframe)	((pframe)->fcs == RX_FCS_BAD)
+#else
+	#define rx_pause_fcs_bad(pframe)	0		// not checked in ISR, a broken PAUSE holds TX at most its quanta
+#endif
+
+static inline uint32_t rx_pause_quanta(uint32_t backlog)	// time for poll loop to drain backlog, in 512 bit times
+{	uint32_t	us = backlog * s_pause.frame_us;
+	uint32_t	quanta;
+
+	if (us < RX_PAUSE_MIN_US)	{	us = RX_PAUSE_MIN_US;	}
+	quanta = us * s_link_speed / 512 + 1;
+	return (quanta < 0xffff) ? quanta : 0xffff;
+}
+
+static inline void rx_pause_check(int sm_idx)	// ISR, XOFF when free room is low with frames waiting poll loop
+{	uint32_t	backlog = rx_pause_backlog();
+
+	if (backlog > RX_PAUSE_BACKLOG &&
+		(MAX_RX_READY - 1 - rx_ring_count(&s_rx_ready) <= RX_PAUSE_RING_ON || rx_frame_room(sm_idx, 0) <= RX_PAUSE_SLOT_ON))
+	{	tx_pause_send(rx_pause_quanta(backlog));
+		rmii_sm_stat_add(RMII_STAT_ISR, pause_xoff, 1);
+	}
+}
+
+static inline void rx_pause_input(const uint8_t *data)	// ISR, MAC control frame, PAUSE holds TX queue for quanta x 512 bit times
+{	static const uint8_t	dst[6] = {	0x01, 0x80, 0xc2, 0x00, 0x00, 0x01	};
+	uint32_t				quanta = (data[16] << 8) | data[17];
+	int						mc = 1, uc = 1;
+
+	if (!s_pause.on || data[14] != 0x00 || data[15] != 0x01)	{	return;	}	// opcode PAUSE only
+	for (int i = 0; i < 6; i++)
+	{	mc &= (data[i] == dst[i]);
+		uc &= (data[i] == s_rmii_if->hwaddr[i]);
 	}
+	if (!mc && !uc)	{	return;	}
 
-	// 3. prepare DMA
-	int			rear = s_rx_frame_rear;
-	int 		next = (s_rx_frame_head != (MAX_RX_FRAME -1)) ? s_rx_frame_head + 1 : 0;
+	uint32_t	save = rmii_hal_lock();
+
+	s_pause.hold_us = rmii_hal_time_us() + quanta * 512 / s_link_speed;
+	s_pause.hold = (quanta != 0);
+	if (!s_tx_busy)	{	tx_frame_next();	}	// zero quanta resumes at once
+	rmii_hal_unlock(save);
+
+	rmii_sm_stat_add(RMII_STAT_ISR, pause_rx, 1);
+}
+
+void __time_critical_func(rx_sm_isr_run)(int sm_idx)
+{	rx_frame_t	*pframe = s_rx_frame_cur[sm_idx];
+	int			is_real_rx = (pframe != NULL);
+
+	rmii_trace(RMII_TRACE_ISR, TR_RX_ISR, TR_BEGIN);
+
+#ifdef USE_RX_INLINE_FCS
+	// 0. latch FCS & pass sniffer to the SM receiving next frame as soon as possible
+	if (is_real_rx)
+	{	if (s_rx_sniff_idx == sm_idx && s_rx_sniff_clean)
+		{	pframe->fcs = (rmii_hal_rx_sniff_result() == ETH_FCS_RESIDUE) ? RX_FCS_GOOD : RX_FCS_BAD;
+		}
+		else
+		{	pframe->fcs = RX_FCS_UNKNOWN;
+		}
+	}
+#ifdef USE_MULTI_RX_SM
+	s_rx_sniff_idx = (sm_idx != (s_rx_sm_num-1)) ? sm_idx + 1 : 0;	// SMs receive in turn
+	s_rx_sniff_clean = rmii_hal_rx_sniff(s_rx_sniff_idx);
+#endif
+#endif
 
-	int			is_full;
-	int 		sem_permit = sem_available(&s_rx_frame_sem);
+	// 1. abort DMA & calculate length
+	if (is_real_rx)
+	{	int		len = rmii_hal_rx_stop(sm_idx, pframe->data);
+		int		flt = rx_filter_check(&s_rx_filter, pframe->data, len);
+		int		cls = (flt == RX_FILTER_PASS) ? rx_prio_class(&s_rx_prio, pframe->data, len) : 0;
 
-	if 	(is_real_rx)
-	{	if (sem_permit <= (MAX_RX_FRAME-3))	{	is_full = 0;	}
-		else								{	is_full = 1;	}
+#ifdef USE_RMII_CAPTURE
+		pframe->us = rmii_hal_time_us();
+#endif
+		if (unlikely(len >= 18 && pframe->data[12] == 0x88 && pframe->data[13] == 0x08))	// MAC control, never passed to LwIP
+		{	if (!rx_pause_fcs_bad(pframe))	{	rx_pause_input(pframe->data);	}
+			rmii_capture_buf(RMII_CAPTURE_ISR, RMII_CAP_DROP, RMII_CAP_MAC_CTRL, pframe->us, pframe->data, len);
+			is_real_rx = 0;
+		}
+		else if (unlikely(flt != RX_FILTER_PASS))	// not for us, reuse the slot without FCS check & pbuf
+		{	rmii_sm_stat_add(RMII_STAT_ISR, flt_drop[flt], 1);
+			rmii_capture_buf(RMII_CAPTURE_ISR, RMII_CAP_DROP, flt, pframe->us, pframe->data, len);
+			is_real_rx = 0;
+		}
+		else if (unlikely(len >= ETH_FRAME_LEN))	// DMA buffer is full, the rest of frame was not stored
+		{	rmii_sm_stat_add(RMII_STAT_ISR, giant, 1);
+			rmii_capture_buf(RMII_CAPTURE_ISR, RMII_CAP_DROP, RMII_CAP_GIANT, pframe->us, pframe->data, ETH_FRAME_LEN);
+			is_real_rx = 0;
+		}
+		else if (unlikely(rx_ring_full(&s_rx_ready)))	// too many small frames are waiting, drop & reuse the slot
+		{	rmii_sm_stat_add(RMII_STAT_ISR, rx_full, 1);
+			rmii_sm_stat_add(RMII_STAT_ISR, prio_drop[cls], 1);
+			rmii_capture_buf(RMII_CAPTURE_ISR, RMII_CAP_DROP, RMII_CAP_FULL, pframe->us, pframe->data, len);
+			is_real_rx = 0;
+		}
+		else if (unlikely(!rx_prio_admit(&s_rx_prio, cls, MAX_RX_READY - 1 - rx_ring_count(&s_rx_ready), rx_frame_room(sm_idx, len))))
+		{	// room is kept for higher classes or next frame, drop & reuse the slot
+			rmii_sm_stat_add(RMII_STAT_ISR, prio_drop[cls], 1);
+			rmii_capture_buf(RMII_CAPTURE_ISR, RMII_CAP_DROP, RMII_CAP_PRIO, pframe->us, pframe->data, len);
+			is_real_rx = 0;
+		}
+		else
+		{	// 2. queue received frame in order, rx_ring_put() publishes it after below writes
+			pframe->len = len;
+			rx_frame_commit(pframe);
+			pframe->blk.state = RX_SLOT_READY;
+
+			rx_ring_put(&s_rx_ready, pframe);
+			rmii_sm_stat_add(RMII_STAT_ISR, prio_rx[cls], 1);
+			pframe = NULL;
+		}
 	}
 	else
-	{	if (sem_permit <= (MAX_RX_FRAME-2))	{	is_full = 0;	}
-		else								{	is_full = 1;	}
+	{	rmii_hal_rx_stop(sm_idx, NULL);
 	}
 
-	if (unlikely(is_full))
-	{	dma_hw->ch[dma_no].ctrl_trig &= ~DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS;
-		dma_channel_set_write_addr(dma_no, &s_rx_frame_dummy[sm_idx], false);
-		rmii_sm_stat_add(s_sm_stat.rx_full, 1);
+	// 3. prepare DMA
+	if (pframe == NULL)
+	{	pframe = rx_frame_alloc(sm_idx);
+		if (pframe != NULL)	{	pframe->blk.state = RX_SLOT_DMA;	}
 	}
-	else
-	{	dma_hw->ch[dma_no].ctrl_trig |= DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS;
-		dma_channel_set_write_addr(dma_no, s_rx_frame[next].data, false);
-		s_rx_frame_head = next;
-		s_rx_frame_idx[sm_idx] = next;
 
-		rmii_sm_stat_add(s_sm_stat.rx_ok, 1);
+	if (unlikely(pframe == NULL))
+	{	rmii_hal_rx_start(sm_idx, NULL, ETH_FRAME_LEN);
+		rmii_sm_stat_add(RMII_STAT_ISR, rx_no_slot, 1);
+	}
+	else
+	{	rmii_hal_rx_start(sm_idx, pframe->data, ETH_FRAME_LEN);
+		rmii_sm_stat_add(RMII_STAT_ISR, rx_ok, 1);
 	}
-	dma_channel_set_trans_count(dma_no, sizeof(s_rx_frame[0].data), true);
+	s_rx_frame_cur[sm_idx] = pframe;
+	rmii_trace(RMII_TRACE_ISR, TR_RX_DMA, TR_INSTANT);
+
+#if defined(USE_RX_INLINE_FCS) && !defined(USE_MULTI_RX_SM)
+	s_rx_sniff_clean = rmii_hal_rx_sniff(sm_idx);	// SM is waiting ISR, sniffer is always ready before next frame
+#endif
 
 	// 4. resume SM
-	PICO_RMII_PIO->irq |= (0x01 << sm_no);
+	rmii_hal_rx_resume(sm_idx);
 
-	if (is_real_rx)	{	sem_release(&s_rx_frame_sem);	}
+	if (is_real_rx)	{	rmii_hal_rx_signal();	}
+
+	// 5. XOFF as soon as room is low, XON by poll loop
+	if (s_pause.on && !s_pause.xoff)	{	rx_pause_check(sm_idx);	}
+	rmii_trace(RMII_TRACE_ISR, TR_RX_ISR, TR_END);
 }
 
-void __time_critical_func(rx_sm_isr_handler) (void) // to locate code in RAM
-{	int		sm_no, next;
+static void rx_sm_arm()	// start DMA of every RX SM (halted), slot already assigned to a SM is kept
+{	for (int i = 0; i < s_rx_sm_num; i++)
+	{	rx_frame_t	*pframe = s_rx_frame_cur[i];
 
-#ifndef USE_TWO_RX_SM
-	sm_no = PICO_RMII_SM_RX;
-#else
-	if (PICO_RMII_PIO->irq & (1<<PICO_RMII_SM_RX))			{	sm_no = PICO_RMII_SM_RX;	next = PICO_RMII_SM_RX_2; 	}
-	else if (PICO_RMII_PIO->irq & (1<<PICO_RMII_SM_RX_2))	{	sm_no = PICO_RMII_SM_RX_2;	next = PICO_RMII_SM_RX; 	}
-	else
-	{	// FIXME can happen??
-		return;
+		if (pframe == NULL && (pframe = rx_frame_alloc(i)) != NULL)	{	pframe->blk.state = RX_SLOT_DMA;	}
+
+		rmii_hal_rx_start(i, (pframe != NULL) ? pframe->data : NULL, ETH_FRAME_LEN);
+		s_rx_frame_cur[i] = pframe;
 	}
+#ifdef USE_RX_INLINE_FCS
+	s_rx_sniff_idx = 0;
+	s_rx_sniff_clean = rmii_hal_rx_sniff(0);
 #endif
+	rmii_hal_barrier();
+}
 
-	rx_sm_isr_run(sm_no);
-#ifdef USE_TWO_RX_SM
-	if (PICO_RMII_PIO->irq & (1<<next))	{	rx_sm_isr_run(next);}
+static int rx_frame_check(rx_frame_t *pframe)	// return length without FCS, 0 if FCS or checksum is bad
+{	int		rx_len = 0;
+
+#ifdef USE_RX_INLINE_FCS
+	if (likely(pframe->fcs != RX_FCS_UNKNOWN))
+	{	if (pframe->fcs == RX_FCS_GOOD)	{	rx_len = pframe->len - 4;	}
+	}
+	else if (pframe->len > 4)
+	{	rmii_sm_stat_add(RMII_STAT_RX, fcs_late, 1);
+#else
+	if (likely(pframe->len > 4))
+	{
 #endif
+		uint32_t	*crc_in = (uint32_t*)(&pframe->data[pframe->len - 4]);
+		rmii_trace(RMII_TRACE_RX, TR_RX_CRC, TR_BEGIN);
+		uint32_t	crc_calc = rmii_fcs_crc32(pframe->data, pframe->len - 4);
+		rmii_trace(RMII_TRACE_RX, TR_RX_CRC, TR_END);
+
+		if (memcmp(&crc_calc, crc_in, 4) == 0)	{	rx_len = pframe->len - 4; }
+	}
+
+	if (unlikely(rx_len == 0))
+	{	rmii_sm_stat_add(RMII_STAT_RX, bad_crc, 1);
+		rmii_capture_buf(RMII_CAPTURE_RX, RMII_CAP_DROP, RMII_CAP_BAD_CRC, pframe->us, pframe->data, pframe->len);
+	}
+#if RMII_CHKSUM_CHECK
+	else if (unlikely(!rx_frame_chksum_ok(pframe->data, rx_len)))
+	{	rmii_sm_stat_add(RMII_STAT_RX, bad_chksum, 1);
+		rmii_capture_buf(RMII_CAPTURE_RX, RMII_CAP_DROP, RMII_CAP_BAD_CHKSUM, pframe->us, pframe->data, pframe->len);
+		rx_len = 0;
+	}
+#endif
+	return rx_len;
 }
 
-void netif_rmii_ethernet_poll()
-{	static uint32_t		mdio_poll_expire = 0;
+static void rx_frame_input(rx_frame_t *pframe, int rx_len)	// pass to LwIP, MUST be called in LwIP context
+{	struct pbuf *p = NULL;
 
-	{	uint32_t	now = time_us_32();
-		if (time_after(now, mdio_poll_expire))
-		{	uint16_t mdio_read = netif_rmii_ethernet_mdio_read(s_phy_addr, 1);
-			uint16_t link_status = (mdio_read & 0x04) >> 2;
+	// DBG("RXD H/R %d %d", s_rx_ready.head, s_rx_ready.rear);
 
-			if (netif_is_link_up(s_rmii_if) ^ link_status)
-			{	// TODO need control stop/start SM/DMA ??
-				if (link_status)	{	netif_set_link_up(s_rmii_if);	}
-				else				{	netif_set_link_down(s_rmii_if);	}
-			}
-			mdio_poll_expire = now + (1000*1000); 	// 1sec interval
+	if (unlikely(rx_len == 0))	// dropped by rx_frame_check()
+	{	rx_frame_release(pframe);
+		return;
+	}
+	rmii_capture_buf(RMII_CAPTURE_LWIP, RMII_CAP_RX, RMII_CAP_OK, pframe->us, pframe->data, pframe->len);
 
-			rmii_sm_stat_prt(&s_sm_stat);
-			rmii_sm_stat_clr(s_sm_stat);
+	rmii_trace(RMII_TRACE_LWIP, TR_RX_PBUF, TR_BEGIN);
+	if (likely(rx_lend_take(&s_rx_lend[pframe->blk.user], rx_frame_held_unit(pframe))))
+	{	// lend the block to LwIP, returned at rx_frame_pbuf_free()
+		pframe->pc.custom_free_function = rx_frame_pbuf_free;
+		p = pbuf_alloced_custom(PBUF_RAW, rx_len, PBUF_REF, &pframe->pc, pframe->data, pframe->len);
 
-			timelapse_prt();
+		pframe->blk.state = RX_SLOT_LWIP;
+	}
+	else
+	{	// LwIP holds too many slots (TCP out-of-order queue...), copy to keep slots for RX SM
+		p = pbuf_alloc(PBUF_RAW, rx_len, PBUF_POOL);
+
+		if (unlikely(p == NULL))					{	rmii_sm_stat_add(RMII_STAT_LWIP, pbuf_empty, 1);	}
+		else if (pbuf_take(p, pframe->data, rx_len) == ERR_OK)
+		{	rmii_sm_stat_begin(RMII_STAT_LWIP);
+			rmii_sm_stat_add_in(RMII_STAT_LWIP, rx_copy, 1);
+			rmii_sm_stat_add_in(RMII_STAT_LWIP, rx_copy_bytes, rx_len);
+			rmii_sm_stat_end(RMII_STAT_LWIP);
+		}
+		else
+		{	rmii_sm_stat_add(RMII_STAT_LWIP, pbuf_err, 1);
+			pbuf_free(p);
+			p = NULL;
 		}
+		rx_frame_release(pframe);
 	}
-
-	// check & clear deadlock between two RX SM forcefully
-#ifdef USE_TWO_RX_SM
-	{	uint32_t irq_mask = (1<<(4+PICO_RMII_SM_RX)) | (1<<(4+PICO_RMII_SM_RX_2));
-		if ((PICO_RMII_PIO->irq & irq_mask) == irq_mask)
-		{	pio_interrupt_clear(PICO_RMII_PIO, 4 + PICO_RMII_SM_RX);
-			DBG("RX SM Deadlock cleared");
+	rmii_trace(RMII_TRACE_LWIP, TR_RX_PBUF, TR_END);
+
+	if (p != NULL)
+	{	rmii_sm_stat_size(RMII_STAT_LWIP, rx_size, rx_len + 4);
+		rmii_trace(RMII_TRACE_LWIP, TR_RX_INPUT, TR_BEGIN);
+		if (unlikely(s_rmii_if->input(p, s_rmii_if) != ERR_OK))
+		{	rmii_sm_stat_add(RMII_STAT_LWIP, pbuf_err, 1);
+			pbuf_free(p);
 		}
+		rmii_trace(RMII_TRACE_LWIP, TR_RX_INPUT, TR_END);
 	}
+}
+
+#ifdef USE_RX_PIPELINE
+	#define rx_poll_get()			rx_ring_get(&s_rx_valid)	// FCS was checked by netif_rmii_ethernet_loop() of other core
+	#define rx_poll_len(pframe)		((pframe)->len - 4)
+#else
+	#define rx_poll_get()			rx_ring_get(&s_rx_ready)
+	#define rx_poll_len(pframe)		rx_frame_check(pframe)
 #endif
-	if (sem_acquire_timeout_ms(&s_rx_frame_sem, 100) == true)
-	{	timelapse_start(tl_rx);
 
-		rx_frame_t* pframe = &s_rx_frame[s_rx_frame_rear];
+// ----- PHY registers are read in background by MDIO engine, poll loop never waits MDIO
+static struct
+{	uint32_t			want;				// registers to read, bit per register
+	int					reg;				// register on MDIO, -1 if none
+	void				(*done)(void);		// called once every wanted register is read
+	uint16_t			val[32];			// last read value of each register
+} s_phy = {	.reg = -1	};
 
-		uint32_t	*crc_in = (uint32_t*)(&pframe->data[pframe->len - 4]);
-		timelapse_start(tl_crc);
-		uint32_t	crc_calc = fcs_crc32(pframe->data, pframe->len - 4);
-		timelapse_stop(tl_crc);
+#define phy_busy()		(s_phy.want != 0 || s_phy.reg >= 0 || s_phy.done != NULL)
 
-		int		rx_len;
+static void phy_read(uint32_t regs, void (*done)(void))	// ignored if previous read is running
+{	if (phy_busy())	{	return;	}
 
-		if (memcmp(&crc_calc, crc_in, 4) == 0)	{	rx_len = pframe->len - 4; }
-		else									{	rx_len = 0;	}
+	s_phy.want = regs;
+	s_phy.done = done;
+}
 
-		// DBG("RXD H/R %d %d", s_rx_frame_head, s_rx_frame_rear);
+static void phy_mdio_poll()	// advance background read, LwIP context
+{	if (s_phy.reg >= 0)
+	{	int		val = rmii_hal_mdio_result();
 
-		if (unlikely(rx_len == 0))
-		{	rmii_sm_stat_add(s_sm_stat.bad_crc, 1);
-			s_rx_frame_rear = (s_rx_frame_rear != (MAX_RX_FRAME-1)) ? s_rx_frame_rear + 1 : 0;
+		if (val < 0)	{	return;	}
+		s_phy.val[s_phy.reg] = val;
+		s_phy.reg = -1;
+	}
+
+	if (s_phy.want)
+	{	int		reg = __builtin_ctz(s_phy.want);
+
+		if (rmii_hal_mdio_start(s_phy_addr, reg, -1))
+		{	s_phy.want &= ~(1u << reg);
+			s_phy.reg = reg;
 		}
-		else
-		{	struct pbuf *p = pbuf_alloc(PBUF_RAW, rx_len, PBUF_POOL);
+	}
+	else if (s_phy.done != NULL)
+	{	void	(*done)(void) = s_phy.done;
 
-			if (unlikely(p == NULL))
-			{	rmii_sm_stat_add(s_sm_stat.pbuf_empty, 1);
-				s_rx_frame_rear = (s_rx_frame_rear != (MAX_RX_FRAME-1)) ? s_rx_frame_rear + 1 : 0;
-			}
-			else
-			{	if (pbuf_take(p, pframe->data, rx_len) == ERR_OK)
-				{	// update rear indicator befre time-consuming input() job
-					s_rx_frame_rear = (s_rx_frame_rear != (MAX_RX_FRAME-1)) ? s_rx_frame_rear + 1 : 0;
-
-					timelapse_start(tl_net);
-					if (unlikely(s_rmii_if->input(p, s_rmii_if) != ERR_OK))
-					{	rmii_sm_stat_add(s_sm_stat.pbuf_err, 1);
-						pbuf_free(p);
-					}
-					timelapse_stop(tl_net);
-				}
-				else
-				{	rmii_sm_stat_add(s_sm_stat.pbuf_err, 1);
-					s_rx_frame_rear = (s_rx_frame_rear != (MAX_RX_FRAME-1)) ? s_rx_frame_rear + 1 : 0;
-				}
+		s_phy.done = NULL;
+		done();
+	}
+}
+
+static void rx_pause_poll()	// LwIP context, XON once backlog is drained, XOFF again before link partner resumes
+{	uint32_t	backlog = rx_pause_backlog();
+
+	if (backlog <= RX_PAUSE_BACKLOG)
+	{	tx_pause_send(0);
+		rmii_sm_stat_add(RMII_STAT_LWIP, pause_xon, 1);
+	}
+	else if (time_after(rmii_hal_time_us(), s_pause.refresh_us))
+	{	tx_pause_send(rx_pause_quanta(backlog));
+		rmii_sm_stat_add(RMII_STAT_LWIP, pause_xoff, 1);
+	}
+}
+
+// ----- RX SM, DMA & slots of each SM belong to the core of RX ISR, a link change is done there
+#define RX_LINK_NONE	0
+#define RX_LINK_DOWN	1				// halt, frame cut by link down is never queued
+#define RX_LINK_UP		2				// ring of RX SM restarts from first SM at s_link_speed
+
+static void rx_link_run(int req)	// core of RX ISR, halted SM raise no ISR until restart
+{	rmii_hal_rx_halt();
+	if (req == RX_LINK_UP)
+	{	rmii_hal_set_speed(s_link_speed);
+		rx_sm_arm();
+		rmii_hal_rx_restart();
+	}
+}
+
+static void rx_link_change(int req)	// LwIP context, returns when done
+{
+#ifdef USE_RX_PIPELINE
+	__atomic_store_n(&s_link_rx_req, req, __ATOMIC_RELEASE);	// s_link_speed is written before
+	rmii_hal_rx_signal();
+	while (__atomic_load_n(&s_link_rx_req, __ATOMIC_ACQUIRE) != RX_LINK_NONE)	{	rmii_hal_idle();	}
+#else
+	rx_link_run(req);
+#endif
+}
+
+static void phy_link_down()	// netif, RX & TX follow link down
+{	netif_set_link_down(s_rmii_if);		// TX : netif_rmii_ethernet_output() drops frames
+	rx_link_change(RX_LINK_DOWN);		// RX : frame cut by link down is never queued
+	s_link_rx_wait = 0;
+	s_pause.on = s_pause.xoff = s_pause.hold = 0;	// PAUSE of old link is void
+
+	rmii_sm_stat_add(RMII_STAT_LWIP, link_down, 1);
+	DBG("Link down");
+}
+
+static void phy_link_up(const phy_link_t *link)
+{	while (s_tx_busy)	{	rmii_hal_idle();	}	// TX : frames queued before link down leave at old timing
+
+	// RX : ring of RX SM restarts from first SM at new timing, no SM is left in middle of frame or waiting baton
+	s_link_speed = link->speed;
+	s_link_full = link->full;
+	s_pause.on = link->pause && s_rmii_if_cfg.pause;
+	rx_link_change(RX_LINK_UP);
+
+	s_link_up_us = rmii_hal_time_us();
+	s_link_rx_wait = 1;
+
+	DBG("Link up %d Mbps %s duplex%s", s_link_speed, s_link_full ? "full" : "half", s_pause.on ? ", PAUSE" : "");
+	if (!s_link_full)	{	DBG("Half duplex : no collision detection, frames collided are lost");	}
+
+	netif_set_link_up(s_rmii_if);
+}
+
+static void phy_link_check()	// link registers of PHY driver were read
+{	phy_link_t	link;
+	int			up = s_phy_ops->link(s_phy.val, &link);
+
+	// link status of BMSR is latched low, a flap between polls is seen as down then up at next poll
+	if (netif_is_link_up(s_rmii_if) && (!up || link.speed != s_link_speed || link.full != s_link_full))
+	{	phy_link_down();
+	}
+	if (up && !netif_is_link_up(s_rmii_if))	{	phy_link_up(&link);	}
+}
+
+static void phy_link_first_rx()	// first frame after link up, LwIP context
+{	uint32_t	elapsed = rmii_hal_time_us() - s_link_up_us;
+
+	s_link_rx_wait = 0;
+	rmii_sm_stat_max(RMII_STAT_LWIP, link_rx_us, elapsed);
+	DBG("Link up to first RX frame %u us", (unsigned)elapsed);
+}
+
+static void call_run(void)	// calls of application core, between RX batches
+{	uint32_t	depth = call_ring_count(&s_call), start, elapsed;
+	int			cnt;
+
+	if (depth == 0)	{	return;	}
+
+	start = rmii_hal_time_us();
+	cnt = call_ring_run(&s_call, RMII_CALL_QUEUE);	// a call posted meanwhile waits next poll, RX is not held longer
+	elapsed = rmii_hal_time_us() - start;
+
+	rmii_sm_stat_begin(RMII_STAT_LWIP);
+	rmii_sm_stat_add_in(RMII_STAT_LWIP, call, cnt);
+	rmii_sm_stat_add_in(RMII_STAT_LWIP, call_us, elapsed);
+	rmii_sm_stat_max_in(RMII_STAT_LWIP, call_us_max, elapsed);
+	rmii_sm_stat_max_in(RMII_STAT_LWIP, call_q_max, depth);
+	rmii_sm_stat_end(RMII_STAT_LWIP);
+}
+
+void netif_rmii_ethernet_poll()
+{	phy_mdio_poll();
+
+	{	uint32_t	now = rmii_hal_time_us();
+		if (time_after(now, s_mdio_poll_expire) || (s_phy_ops->irq_regs && rmii_hal_phy_irq()))
+		{	phy_read(s_phy_ops->link_regs | s_phy_ops->irq_regs, phy_link_check);
+			s_mdio_poll_expire = now + (netif_is_link_up(s_rmii_if) ? PHY_POLL_UP_US : PHY_POLL_DOWN_US);
+		}
+		if (time_after(now, s_stat_expire))
+		{	s_stat_expire = now + (1000*1000); 	// 1sec interval
+
+#ifdef USE_RX_ARENA
+			for (int i = 0; i < s_rx_sm_num; i++)
+			{	rmii_sm_stat_max(RMII_STAT_LWIP, arena_use, s_rx_arena[i].use_max * 100 / s_rx_arena[i].size);
+				rmii_sm_stat_max(RMII_STAT_LWIP, arena_frm, s_rx_arena[i].frm_max);
+				rmii_sm_stat_add(RMII_STAT_LWIP, arena_frag, s_rx_arena[i].frag);
+				s_rx_arena[i].use_max = rx_arena_used(&s_rx_arena[i]);
+				s_rx_arena[i].frm_max = rx_arena_frames(&s_rx_arena[i]);
+				s_rx_arena[i].frag = 0;
 			}
+#endif
+#ifdef USE_RMII_SM_STAT
+			netif_rmii_ethernet_stat(&s_stat_now);	// print change of last second
+			netif_rmii_ethernet_stat_sub(&s_stat_prev, &s_stat_now, &s_stat_prev);
+			netif_rmii_ethernet_stat_prt(&s_stat_prev);
+			s_stat_prev = s_stat_now;
+#endif
 		}
-		timelapse_stop(tl_rx);
 	}
+
+#ifdef USE_RX_PIPELINE
+	// never wait, the caller (core0) has other jobs
+	rx_frame_t	*pframe = rx_poll_get();
+#else
+	if (rmii_hal_rx_deadlock())	{	DBG("RX SM Deadlock cleared");	}
+
+	rx_frame_t	*pframe = rx_poll_get();
+
+	if (pframe == NULL && call_ring_count(&s_call) == 0)
+	{	rmii_hal_rx_wait((phy_busy() || s_pause.xoff || s_pause.hold) ? 1 : 100);	// ring is checked again, wake up may be spurious
+		pframe = rx_poll_get();
+	}
+#endif
+	if (pframe != NULL)
+	{	uint32_t	start = rmii_hal_time_us();
+		int			cnt = 0;
+
+		if (unlikely(s_link_rx_wait))	{	phy_link_first_rx();	}
+
+		// drain ready frames up to budget, then housekeeping once for the batch
+		rmii_trace(RMII_TRACE_LWIP, TR_RX_BATCH, TR_BEGIN);
+		do
+		{	rx_frame_input(pframe, rx_poll_len(pframe));
+		} while (++cnt < RX_POLL_BUDGET && (pframe = rx_poll_get()) != NULL);
+		rmii_trace(RMII_TRACE_LWIP, TR_RX_BATCH, TR_END);
+
+		uint32_t	elapsed = rmii_hal_time_us() - start;
+
+		rmii_sm_stat_begin(RMII_STAT_LWIP);
+		rmii_sm_stat_add_in(RMII_STAT_LWIP, batch, 1);
+		rmii_sm_stat_add_in(RMII_STAT_LWIP, batch_frm, cnt);
+		rmii_sm_stat_add_in(RMII_STAT_LWIP, batch_hist[cnt - 1], 1);
+		rmii_sm_stat_max_in(RMII_STAT_LWIP, batch_frm_max, cnt);
+		rmii_sm_stat_add_in(RMII_STAT_LWIP, batch_us, elapsed);
+		rmii_sm_stat_max_in(RMII_STAT_LWIP, batch_us_max, elapsed);
+		rmii_sm_stat_end(RMII_STAT_LWIP);
+
+		elapsed /= cnt;
+		s_pause.frame_us = (s_pause.frame_us * 7 + ((elapsed < 10000) ? elapsed : 10000) + 4) / 8;
+	}
+	call_run();
+	if (s_pause.xoff)	{	rx_pause_poll();	}
+	if (s_pause.hold)	{	tx_frame_kick();	}
+	netif_rmii_ethernet_tx_release();
+	rmii_capture_poll();
+
 	sys_check_timeouts();
 }
 
+// ------------------------------------------------------------------
+// - Ethernet Rx Filter
+// ------------------------------------------------------------------
+#if LWIP_IGMP
+static err_t netif_rmii_ethernet_igmp_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{	uint8_t		mac[6] = {	0x01, 0x00, 0x5e, ip4_addr2(group) & 0x7f, ip4_addr3(group), ip4_addr4(group)	};
+	(void)netif;
+
+	rx_filter_mc(&s_rx_filter, mac, action == NETIF_ADD_MAC_FILTER);
+	return ERR_OK;
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t netif_rmii_ethernet_mld_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{	const uint8_t	*low = (const uint8_t*)&group->addr[3];
+	uint8_t			mac[6] = {	0x33, 0x33, low[0], low[1], low[2], low[3]	};
+	(void)netif;
+
+	rx_filter_mc(&s_rx_filter, mac, action == NETIF_ADD_MAC_FILTER);
+	return ERR_OK;
+}
+#endif
+
 // ------------------------------------------------------------------
 // - Ethernet Init
 // ------------------------------------------------------------------
@@ -478,150 +1169,242 @@ static err_t netif_rmii_ethernet_low_init(struct netif *netif)
 	{	memcpy(netif->hwaddr, PICO_RMII_MAC_ADDR, 6);
 	}
 	else // generate one for unique board id
-	{	pico_unique_board_id_t board_id;
+	{	uint8_t		board_id[8];
 
-		pico_get_unique_board_id(&board_id);
+		rmii_hal_board_id(board_id);
 
 		netif->hwaddr[0] = 0xb8;
 		netif->hwaddr[1] = 0x27;
 		netif->hwaddr[2] = 0xeb;
-		memcpy(&netif->hwaddr[3], &board_id.id[5], 3);
+		memcpy(&netif->hwaddr[3], &board_id[5], 3);
 	}
 	netif->hwaddr_len = ETH_HWADDR_LEN;
 	DBG("MAC : %02x:%02x:%02x:%02x:%02x:%02x",
 		netif->hwaddr[0], netif->hwaddr[1], netif->hwaddr[2],
 		netif->hwaddr[3], netif->hwaddr[4], netif->hwaddr[5]);
 
-	// Init s_rx_frame & semaphore
-	s_rx_frame_head = s_rx_frame_rear = 0;
-	for (int i = 0; i < MAX_RX_FRAME; i++)	{	s_rx_frame[i].len = 0;	}
-	sem_init(&s_rx_frame_sem, 0, MAX_RX_FRAME);
-
-	// Init the RMII PIO programs
-#ifdef USE_TWO_RX_SM
-	s_rx_sm_off = pio_add_program(PICO_RMII_PIO, &rmii_ethernet_phy_rx_2_data_program);
-#else
-	s_rx_sm_off = pio_add_program(PICO_RMII_PIO, &rmii_ethernet_phy_rx_data_program);
+	DBG("FCS : %s", fcs_crc32_name(fcs_crc32_init(s_rmii_if_cfg.fcs, RMII_FCS_DMA_OK)));
+#if LWIP_TCP
+	DBG("LwIP : %s, TCP WND %u of %d RX slots", RMII_LWIP_PROFILE_NAME, (unsigned)TCP_WND, MAX_RX_FRAME);
 #endif
-	s_tx_sm_off = pio_add_program(PICO_RMII_PIO, &rmii_ethernet_phy_tx_data_program);
 
-	// Configure the DMA channels
-	s_rx_dma_chn = dma_claim_unused_channel(true);
-	s_tx_dma_chn = dma_claim_unused_channel(true);
-#ifdef USE_TWO_RX_SM
-	s_rx_dma_chn_2 = dma_claim_unused_channel(true);
-#endif
-#ifdef USE_TWO_RX_SM
-	DBG("DMA RX %d %d TX %d", s_rx_dma_chn, s_rx_dma_chn_2, s_tx_dma_chn);
+	// Receive own MAC, broadcast & joined groups only
+	rx_filter_init(&s_rx_filter);
+	rx_filter_uc(&s_rx_filter, netif->hwaddr, 1);
+
+	// Keep ready ring & slot headroom for control frames under overload
+	{	static const rmii_prio_rule_t	rule[] = RMII_PRIO_DEFAULT_RULES();
+		static const uint8_t			ring[RMII_PRIO_CLASS] = RMII_PRIO_DEFAULT_RING;
+#ifdef USE_RX_ARENA
+		static const uint8_t			slot[RMII_PRIO_CLASS] = {	0	};	// arena of a SM holds few max frames, ring only
 #else
-	DBG("DMA RX %d TX %d", s_rx_dma_chn, s_tx_dma_chn);
+		static const uint8_t			slot[RMII_PRIO_CLASS] = RMII_PRIO_DEFAULT_SLOT;
 #endif
 
-	s_rx_dma_chn_cfg = dma_channel_get_default_config(s_rx_dma_chn);
+		rx_prio_init(&s_rx_prio);
+		rx_prio_rule(&s_rx_prio, rule, sizeof(rule) / sizeof(rule[0]));
+		for (int i = 1; i < RMII_PRIO_CLASS; i++)	{	rx_prio_reserve(&s_rx_prio, i, ring[i], slot[i]);	}
+	}
+#if LWIP_IGMP
+	netif_set_igmp_mac_filter(netif, netif_rmii_ethernet_igmp_filter);	// igmp_start() joins all-systems later
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+	{	ip6_addr_t	allnodes;
 
-	channel_config_set_read_increment(&s_rx_dma_chn_cfg, false);
-	channel_config_set_write_increment(&s_rx_dma_chn_cfg, true);
-	channel_config_set_dreq(&s_rx_dma_chn_cfg, pio_get_dreq(PICO_RMII_PIO, PICO_RMII_SM_RX, false));
-	channel_config_set_transfer_data_size(&s_rx_dma_chn_cfg, DMA_SIZE_8);
+		netif_set_mld_mac_filter(netif, netif_rmii_ethernet_mld_filter);
+		ip6_addr_set_allnodes_linklocal(&allnodes);		// not joined by MLD, let it in here
+		netif_rmii_ethernet_mld_filter(netif, &allnodes, NETIF_ADD_MAC_FILTER);
+	}
+#endif
 
-#ifdef USE_TWO_RX_SM
-	s_rx_dma_chn_cfg_2 = dma_channel_get_default_config(s_rx_dma_chn_2);
+	// Claim & configure PIO/DMA, not started yet
+	rmii_hal_init(&s_rmii_if_cfg);
 
-	channel_config_set_read_increment(&s_rx_dma_chn_cfg_2, false);
-	channel_config_set_write_increment(&s_rx_dma_chn_cfg_2, true);
-	channel_config_set_dreq(&s_rx_dma_chn_cfg_2, pio_get_dreq(PICO_RMII_PIO, PICO_RMII_SM_RX_2, false));
-	channel_config_set_transfer_data_size(&s_rx_dma_chn_cfg_2, DMA_SIZE_8);
+	// Init RX buffer
+	rx_ring_init(&s_rx_ready, s_rx_ready_slot, MAX_RX_READY);
+#ifdef USE_RX_PIPELINE
+	rx_ring_init(&s_rx_valid, s_rx_valid_slot, MAX_RX_VALID);
 #endif
+	s_rx_sm_num = rmii_hal_rx_sm_num();
+	for (int i = 0; i < RX_POOL_NUM; i++)	{	rx_lend_init(&s_rx_lend[i], 0);	}
+#ifdef USE_RX_ARENA
+	for (int i = 0; i < s_rx_sm_num; i++)
+	{	uint32_t	size = (sizeof(s_rx_pool) / s_rx_sm_num) & ~3u;
+
+		rx_arena_init(&s_rx_arena[i], (uint8_t*)s_rx_pool + i * size, size);
+		rx_lend_init(&s_rx_lend[i], s_rx_arena[i].size / 4);	// bytes of an arena lent to LwIP
+	}
+#else
+	rx_lend_init(&s_rx_lend[0], RX_HELD_MAX);
+	for (int i = 0; i < MAX_RX_FRAME; i++)
+	{	rx_frame_t	*pframe = (rx_frame_t*)((uint8_t*)s_rx_pool + i * RX_FRAME_NEED);
 
-	s_tx_dma_chn_cfg = dma_channel_get_default_config(s_tx_dma_chn);
+		pframe->blk.size = RX_FRAME_NEED;
+		pframe->blk.state = RX_SLOT_FREE;
+		pframe->blk.user = 0;
+	}
+	s_rx_frame_last = MAX_RX_FRAME - 1;
+#endif
 
-	channel_config_set_read_increment(&s_tx_dma_chn_cfg, true);
-	channel_config_set_write_increment(&s_tx_dma_chn_cfg, false);
-	channel_config_set_dreq(&s_tx_dma_chn_cfg, pio_get_dreq(PICO_RMII_PIO, PICO_RMII_SM_TX, true));
-	channel_config_set_transfer_data_size(&s_tx_dma_chn_cfg, DMA_SIZE_8);
+	// Init s_tx_frame
+	s_tx_frame_head = s_tx_frame_send = s_tx_frame_rear = 0;
+	s_tx_busy = 0;
+	tx_pause_init(netif->hwaddr);
 
-	// Auto-Detection LAN8720A PHY address
+	// Auto-Detection PHY address, driver by PHY identifier
 	for (int i = 0; i < 32; i++)
-	{	if (netif_rmii_ethernet_mdio_read(i, 0) != 0xffff)
+	{	if (rmii_hal_mdio_read(i, 0) != 0xffff)
 		{	s_phy_addr = i;
-			DBG("LAN8720A PHY ADDR : %d", s_phy_addr);
 			break;
 		}
 	}
+	uint32_t	phy_id = (rmii_hal_mdio_read(s_phy_addr, PHY_ID1) << 16) | rmii_hal_mdio_read(s_phy_addr, PHY_ID2);
+
+	s_phy_ops = phy_find(phy_id);
+	DBG("PHY %s (ID %08x) ADDR : %d", s_phy_ops->name, (unsigned)phy_id, s_phy_addr);
+
+	// Advertise 10/100Mbps half/full duplex (& symmetric PAUSE) & auto-negotiate, RX/TX SM timing follows the resolved speed at link up
+	// to force 100Mbps, write PHY_BMCR after init (0x2100 = 100Mbps full duplex, auto-negotiate disabled, no PAUSE)
+	s_phy_ops->init(s_phy_addr, s_rmii_if_cfg.phy_irq_pin >= 0 && s_phy_ops->irq_regs != 0, s_rmii_if_cfg.pause);
+
+	// Start RX DMA of each RX SM, first SM receives first frame
+	rx_sm_arm();
+	s_mdio_poll_expire = s_stat_expire = rmii_hal_time_us();	// link is polled at first netif_rmii_ethernet_poll()
+
+	// Install ISR & start the RMII SM
+	rmii_hal_start();
 
-	// Default mode is 10Mbps, auto-negociate disabled
-	// Uncomment this to switch to 100Mbps, auto-negociate disabled
-	// netif_rmii_ethernet_mdio_write(s_phy_addr, LAN8720A_BASIC_CONTROL_REG, 0x2000); // 100 Mbps, auto-negeotiate disabled
-
-	// Or keep the following config to auto-negotiate 10/100Mbps
-	// 0b0000_0001_1110_0001
-	//           | |||⁻⁻⁻⁻⁻\__ 0b00001=IEEE 802.3
-	//           | || \_______ 10BASE-T ability
-	//           | | \________ 10BASE-T Full-Duplex ability
-	//           |  \_________ 100BASE-T ability
-	//            \___________ 100BASE-T Full-Duplex ability
-	netif_rmii_ethernet_mdio_write(s_phy_addr, LAN8720A_AUTO_NEGO_REG,
-								   LAN8720A_AUTO_NEGO_REG_IEEE802_3
-									   // TODO: the PIO RX and TX are hardcoded to 100Mbps, make it configurable to uncomment this
-									   // | LAN8720A_AUTO_NEGO_REG_10_ABI | LAN8720A_AUTO_NEGO_REG_10_FD_ABI
-									   | LAN8720A_AUTO_NEGO_REG_100_ABI | LAN8720A_AUTO_NEGO_REG_100_FD_ABI);
-	// Enable auto-negotiate
-	netif_rmii_ethernet_mdio_write(s_phy_addr, LAN8720A_BASIC_CONTROL_REG, 0x1000);
-
-	// Configure & Start RX DMA
-	dma_channel_configure(
-		s_rx_dma_chn, &s_rx_dma_chn_cfg,
-		s_rx_frame[0].data,
-		((uint8_t*)&PICO_RMII_PIO->rxf[PICO_RMII_SM_RX]) + 3,
-		sizeof(s_rx_frame[0].data),
-		true
-	);
-	s_rx_frame_idx[0] = 0;
-
-#ifdef USE_TWO_RX_SM
-	dma_channel_configure(
-		s_rx_dma_chn_2, &s_rx_dma_chn_cfg_2,
-		s_rx_frame[1].data,
-		((uint8_t*)&PICO_RMII_PIO->rxf[PICO_RMII_SM_RX_2]) + 3,
-		sizeof(s_rx_frame[1].data),
-		true
-	);
-	s_rx_frame_idx[1] = 1;
-	s_rx_frame_head = 1;
-#endif
-
-	// Install ISR #3 callback for RX-SM
-	irq_set_exclusive_handler(PIO0_IRQ_0, rx_sm_isr_handler);
-    irq_set_enabled(PIO0_IRQ_0, true);
-    PICO_RMII_PIO->inte0 |= (PIO_IRQ0_INTE_SM0_BITS<<PICO_RMII_SM_RX);
-#ifdef USE_TWO_RX_SM
-    PICO_RMII_PIO->inte0 |= (PIO_IRQ0_INTE_SM0_BITS<<PICO_RMII_SM_RX_2);
-#endif
-
-	// Configure & Start the RMII SM
-	rmii_ethernet_phy_tx_init(PICO_RMII_PIO, PICO_RMII_SM_TX, s_tx_sm_off, PICO_RMII_TX_PIN, PICO_RMII_RETCLK_PIN, 1);
-#ifdef USE_TWO_RX_SM
-	rmii_ethernet_phy_rx_2_init(PICO_RMII_PIO, PICO_RMII_SM_RX, s_rx_sm_off, PICO_RMII_RX_PIN, 1);
-	rmii_ethernet_phy_rx_2_init(PICO_RMII_PIO, PICO_RMII_SM_RX_2, s_rx_sm_off, PICO_RMII_RX_PIN, 1);
-#else
-	rmii_ethernet_phy_rx_init(PICO_RMII_PIO, PICO_RMII_SM_RX, s_rx_sm_off, PICO_RMII_RX_PIN, 1);
-#endif
 	return ERR_OK;
 }
 
-void netif_rmii_ethernet_loop()
-{
-#ifdef USE_TWO_RX_SM
-	pio_interrupt_clear(PICO_RMII_PIO, 4 + PICO_RMII_SM_RX);	// trigger first sm
-	DBG("Trigger RX SM");
+#ifdef USE_RX_PIPELINE
+static void netif_rmii_ethernet_check()	// first stage of RX, check FCS & pass good frames to LwIP core
+{	int		req = __atomic_load_n(&s_link_rx_req, __ATOMIC_ACQUIRE);
+
+	if (req != RX_LINK_NONE)
+	{	rx_link_run(req);
+		__atomic_store_n(&s_link_rx_req, RX_LINK_NONE, __ATOMIC_RELEASE);	// LwIP core waits in rx_link_change()
+	}
+	if (rmii_hal_rx_deadlock())	{	DBG("RX SM Deadlock cleared");	}
+
+	rx_frame_t	*pframe = rx_ring_get(&s_rx_ready);
+
+	if (pframe == NULL)
+	{	rmii_hal_rx_wait(100);
+		return;
+	}
+
+	do
+	{	if (unlikely(rx_frame_check(pframe) == 0))
+		{	rx_frame_release(pframe);
+		}
+		else if (unlikely(!rx_ring_put(&s_rx_valid, pframe)))	// LwIP core is too slow, drop
+		{	rmii_sm_stat_add(RMII_STAT_RX, rx_full, 1);
+			rmii_capture_buf(RMII_CAPTURE_RX, RMII_CAP_DROP, RMII_CAP_FULL, pframe->us, pframe->data, pframe->len);
+			rx_frame_drop(pframe);
+		}
+		rmii_sm_stat_max(RMII_STAT_RX, valid_q_max, rx_ring_count(&s_rx_valid));
+	} while ((pframe = rx_ring_get(&s_rx_ready)) != NULL);
+}
 #endif
+
+void netif_rmii_ethernet_loop()
+{	rmii_hal_rx_kick();
+
+#ifdef USE_RX_PIPELINE
+	while (1)	{	netif_rmii_ethernet_check();	}
+#else
 	while (1)	{	netif_rmii_ethernet_poll();	}
+#endif
 }
 
 // ------------------------------------------------------------------
 // - Extra
 // ------------------------------------------------------------------
 
+int netif_rmii_ethernet_mac_filter(const uint8_t *mac, int add)
+{	return rx_filter_uc(&s_rx_filter, mac, add);
+}
+
+int netif_rmii_ethernet_prio_rule(const rmii_prio_rule_t *rule, int num)
+{	return rx_prio_rule(&s_rx_prio, rule, (rule != NULL) ? num : 0);
+}
+
+void netif_rmii_ethernet_prio_reserve(int cls, int ring, int slot)
+{	rx_prio_reserve(&s_rx_prio, cls, ring, slot);
+}
+
+#ifndef USE_RX_PIPELINE
+typedef struct
+{	rmii_call_fn_t			fn;
+	void*					arg;
+	volatile int			done;
+} call_wait_t;
+
+static void call_wait_run(void *arg)
+{	call_wait_t	*w = (call_wait_t*)arg;
+
+	w->fn(w->arg);
+	__atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);	// w is on stack of waiting core, not touched after
+}
+#endif
+
+static void call_pbuf_free(void *arg)
+{	pbuf_free((struct pbuf*)arg);
+}
+
+int netif_rmii_ethernet_call(rmii_call_fn_t fn, void *arg)
+{	if (!call_ring_put(&s_call, fn, arg))	{	return 0;	}
+	rmii_hal_rx_signal();	// poll loop may sleep waiting frames
+	return 1;
+}
+
+void netif_rmii_ethernet_call_wait(rmii_call_fn_t fn, void *arg)
+{
+#ifdef USE_RX_PIPELINE
+	fn(arg);				// LwIP context is the calling core
+#else
+	call_wait_t	w = {	fn, arg, 0	};
+
+	while (!netif_rmii_ethernet_call(call_wait_run, &w))	{	rmii_hal_idle();	}
+	while (!__atomic_load_n(&w.done, __ATOMIC_ACQUIRE))	{	rmii_hal_idle();	}
+#endif
+}
+
+int netif_rmii_ethernet_reply(rmii_call_fn_t fn, void *arg)
+{	if (call_ring_put(&s_reply, fn, arg))	{	return 1;	}
+	rmii_sm_stat_add(RMII_STAT_LWIP, reply_full, 1);
+	return 0;
+}
+
+int netif_rmii_ethernet_call_poll(void)
+{	return call_ring_run(&s_reply, RMII_CALL_QUEUE);
+}
+
+int netif_rmii_ethernet_pbuf_free(struct pbuf *p)
+{	return netif_rmii_ethernet_call(call_pbuf_free, p);
+}
+
+void netif_rmii_ethernet_prio_prt(void)
+{	static const char* const	kind[] = {	"?", "PCP >=", "TYPE", "MATCH"	};
+
+	if (s_rx_prio.rule_num == 0)	{	LOG("Priority admission off");	}
+	for (int i = 0; i < s_rx_prio.rule_num; i++)
+	{	const rmii_prio_rule_t	*r = &s_rx_prio.rule[i];
+
+		if (r->kind == RMII_PRIO_MATCH)
+		{	LOG("%d : CLASS %u MATCH @%u & %08x == %08x MAX-LEN %u", i, r->cls, r->off, (unsigned)r->mask, (unsigned)r->val, r->max_len);
+		}
+		else
+		{	LOG("%d : CLASS %u %s %x MAX-LEN %u", i, r->cls, kind[(r->kind <= RMII_PRIO_MATCH) ? r->kind : 0], (unsigned)r->val, r->max_len);
+		}
+	}
+	for (int i = 0; i < RMII_PRIO_CLASS; i++)
+	{	LOG("CLASS %d RESERVE RING/SLOT %u %u LEAVES FREE %u %u", i, s_rx_prio.reserve_ring[i], s_rx_prio.reserve_slot[i],
+			s_rx_prio.need_ring[i], s_rx_prio.need_slot[i]);
+	}
+}
+
 err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_config *config)
 {
 	if (config != NULL)
@@ -640,9 +1423,6 @@ err_t netif_rmii_ethernet_init(struct netif *netif, struct netif_rmii_ethernet_c
 	netif->name[0] = 'e';
 	netif->name[1] = '0';
 
-	timelapse_link(tl_crc);
-	timelapse_link(tl_net);
-	timelapse_link(tl_rx);
-	timelapse_link(tl_tx);
+	return ERR_OK;
 }
 
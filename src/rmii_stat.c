@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Statistics snapshot (see rmii_ethernet/stat.h)
+
+	- writer : rmii_sm_stat_xxx() of profile.h, odd 'seq' of its own copy while updating a field or an event
+	- reader : copies each writer's counters until 'seq' is even & unchanged, never waits the RX core
+	  (a writer updates a field in a few cycles, a reader retries only if it raced one)
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+
+#define STAT_WORDS			(sizeof(rmii_ethernet_stat_t) / 4)
+#define STAT_CNT_WORDS		(offsetof(rmii_ethernet_stat_t, tx_q_max) / 4)	// counters, then high watermarks
+
+#define STAT_FIELD(f)		{	#f, offsetof(rmii_ethernet_stat_t, f) / 4, sizeof(((rmii_ethernet_stat_t*)0)->f) / 4	}
+static const struct
+{	const char*			name;
+	uint8_t				idx, num;			// first word & words, num > 1 is an array
+} s_stat_field[] =
+{	STAT_FIELD(rx_ok),		STAT_FIELD(tx_ok),		STAT_FIELD(rx_full),	STAT_FIELD(rx_no_slot),
+	STAT_FIELD(bad_crc),	STAT_FIELD(giant),		STAT_FIELD(pbuf_empty),	STAT_FIELD(pbuf_err),
+	STAT_FIELD(rx_copy),	STAT_FIELD(rx_copy_bytes),	STAT_FIELD(fcs_late),	STAT_FIELD(flt_drop),
+	STAT_FIELD(bad_chksum),	STAT_FIELD(tx_stall),	STAT_FIELD(tx_link_drop),	STAT_FIELD(link_down),	STAT_FIELD(arena_frag),
+	STAT_FIELD(cap_lost),	STAT_FIELD(batch),		STAT_FIELD(batch_frm),	STAT_FIELD(batch_us),
+	STAT_FIELD(pause_xoff),	STAT_FIELD(pause_xon),	STAT_FIELD(pause_rx),	STAT_FIELD(call),
+	STAT_FIELD(call_us),	STAT_FIELD(reply_full),
+	STAT_FIELD(rx_size),	STAT_FIELD(tx_size),	STAT_FIELD(batch_hist),	STAT_FIELD(prio_rx),	STAT_FIELD(prio_drop),
+	STAT_FIELD(tx_q_max),	STAT_FIELD(arena_use),	STAT_FIELD(arena_frm),	STAT_FIELD(batch_frm_max),
+	STAT_FIELD(batch_us_max),	STAT_FIELD(valid_q_max),	STAT_FIELD(link_rx_us),	STAT_FIELD(call_us_max),
+	STAT_FIELD(call_q_max),
+};
+
+#ifdef USE_RMII_SM_STAT
+rmii_sm_stat_t				g_rmii_sm_stat[RMII_STAT_WRITER];
+#endif
+
+void netif_rmii_ethernet_stat(rmii_ethernet_stat_t *snap)
+{	uint32_t	*d = (uint32_t*)snap;
+
+	memset(snap, 0, sizeof(*snap));
+
+#ifdef USE_RMII_SM_STAT
+	for (int w = 0; w < RMII_STAT_WRITER; w++)
+	{	rmii_sm_stat_t			*b = &g_rmii_sm_stat[w];
+		rmii_ethernet_stat_t	copy;
+		const uint32_t			*s = (const uint32_t*)&copy;
+		uint32_t				seq;
+
+		do
+		{	while ((seq = b->seq) & 1)	{	rmii_hal_idle();	}	// writer of other core is in the middle of an update
+			rmii_hal_barrier();
+			copy = b->v;
+			rmii_hal_barrier();
+		} while (b->seq != seq);
+
+		for (uint32_t i = 0; i < STAT_CNT_WORDS; i++)	{	d[i] += s[i];	}
+		for (uint32_t i = STAT_CNT_WORDS; i < STAT_WORDS; i++)
+		{	if (s[i] > d[i])	{	d[i] = s[i];	}
+		}
+	}
+#else
+	(void)d;
+#endif
+}
+
+void netif_rmii_ethernet_stat_sub(rmii_ethernet_stat_t *d, const rmii_ethernet_stat_t *now, const rmii_ethernet_stat_t *prev)
+{	uint32_t		*pd = (uint32_t*)d;
+	const uint32_t	*pn = (const uint32_t*)now, *pp = (const uint32_t*)prev;
+
+	for (uint32_t i = 0; i < STAT_WORDS; i++)	{	pd[i] = (i < STAT_CNT_WORDS) ? pn[i] - pp[i] : pn[i];	}
+}
+
+#define U(x)		((unsigned)(x))
+
+void netif_rmii_ethernet_stat_prt(const rmii_ethernet_stat_t *s)
+{	const uint32_t	*p = (const uint32_t*)s;
+	uint32_t		x = 0;
+
+	for (uint32_t i = 0; i < STAT_CNT_WORDS; i++)	{	x |= p[i];	}
+	if (x == 0)	{	return;	}
+
+	printf("TX/RX %u %u RX-FULL/SLOT/CRC/GIANT %u %u %u %u PBUF/ERR/COPY/BYTES %u %u %u %u\n",
+		U(s->tx_ok), U(s->rx_ok), U(s->rx_full), U(s->rx_no_slot), U(s->bad_crc), U(s->giant),
+		U(s->pbuf_empty), U(s->pbuf_err), U(s->rx_copy), U(s->rx_copy_bytes));
+	printf("FCS-LATE %u TXQ-MAX/STALL/LINK %u %u %u ARENA USE%%/FRM/FRAG %u %u %u\n", U(s->fcs_late),
+		U(s->tx_q_max), U(s->tx_stall), U(s->tx_link_drop), U(s->arena_use), U(s->arena_frm), U(s->arena_frag));
+	printf("FILTER RUNT/UC/MC %u %u %u BAD-CHKSUM %u LINK-DOWN/RX-US %u %u CAP-LOST %u\n", U(s->flt_drop[1]),
+		U(s->flt_drop[2]), U(s->flt_drop[3]), U(s->bad_chksum), U(s->link_down), U(s->link_rx_us), U(s->cap_lost));
+	if (s->batch)
+	{	printf("BATCH %u FRM-AVG/MAX %u.%02u %u US-AVG/MAX %u %u VALID-Q-MAX %u HIST", U(s->batch),
+			U(s->batch_frm / s->batch), U((s->batch_frm % s->batch) * 100 / s->batch), U(s->batch_frm_max),
+			U(s->batch_us / s->batch), U(s->batch_us_max), U(s->valid_q_max));
+		for (int i = 0; i < RMII_STAT_BATCH_BINS; i++)	{	printf(" %u", U(s->batch_hist[i]));	}
+		putchar('\n');
+	}
+	if (s->pause_xoff | s->pause_xon | s->pause_rx)
+	{	printf("PAUSE XOFF/XON %u %u RX %u\n", U(s->pause_xoff), U(s->pause_xon), U(s->pause_rx));
+	}
+	if (s->call | s->reply_full)
+	{	printf("CALL %u US-AVG/MAX %u %u Q-MAX %u REPLY-FULL %u\n", U(s->call), U(s->call ? s->call_us / s->call : 0),
+			U(s->call_us_max), U(s->call_q_max), U(s->reply_full));
+	}
+	if (s->prio_drop[0] | s->prio_drop[1] | s->prio_drop[2] | s->prio_drop[3])
+	{	printf("PRIO 0/1/2/3 RX");
+		for (int i = 0; i < RMII_STAT_PRIO_BINS; i++)	{	printf(" %u", U(s->prio_rx[i]));	}
+		printf(" DROP");
+		for (int i = 0; i < RMII_STAT_PRIO_BINS; i++)	{	printf(" %u", U(s->prio_drop[i]));	}
+		putchar('\n');
+	}
+	printf("SIZE 64/127/255/511/1023/1518/MORE RX");
+	for (int i = 0; i < RMII_STAT_SIZE_BINS; i++)	{	printf(" %u", U(s->rx_size[i]));	}
+	printf(" TX");
+	for (int i = 0; i < RMII_STAT_SIZE_BINS; i++)	{	printf(" %u", U(s->tx_size[i]));	}
+	putchar('\n');
+}
+
+static int stat_json_add(char *buf, int size, int len, const char *fmt, ...)	// append, keep counting if truncated
+{	va_list		ap;
+	int			n;
+
+	va_start(ap, fmt);
+	n = vsnprintf((len < size) ? buf + len : NULL, (len < size) ? size - len : 0, fmt, ap);
+	va_end(ap);
+
+	return len + ((n > 0) ? n : 0);
+}
+
+int netif_rmii_ethernet_stat_json(const rmii_ethernet_stat_t *s, char *buf, int size)
+{	const uint32_t	*p = (const uint32_t*)s;
+	int				len = 0;
+
+	if (size > 0)	{	buf[0] = 0;	}
+
+	for (size_t i = 0; i < sizeof(s_stat_field) / sizeof(s_stat_field[0]); i++)
+	{	len = stat_json_add(buf, size, len, "%s\"%s\":", (i == 0) ? "{" : ",", s_stat_field[i].name);
+
+		if (s_stat_field[i].num == 1)
+		{	len = stat_json_add(buf, size, len, "%u", U(p[s_stat_field[i].idx]));
+			continue;
+		}
+		for (int k = 0; k < s_stat_field[i].num; k++)
+		{	len = stat_json_add(buf, size, len, "%s%u", (k == 0) ? "[" : ",", U(p[s_stat_field[i].idx + k]));
+		}
+		len = stat_json_add(buf, size, len, "]");
+	}
+	return stat_json_add(buf, size, len, "}");
+}
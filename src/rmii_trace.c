@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Hot path trace reader (see rmii_ethernet/trace.h), writers are rmii_trace() of profile.h
+
+	- writers check 'g_rmii_trace_on' before each record, a reader clears it & waits a record in flight
+	  (a record takes < 1 usec, an ISR may delay a thread writer, so 100 usec)
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rmii_ethernet/trace.h"
+
+#include "profile.h"
+
+#ifdef USE_RMII_TRACE
+rmii_trace_ring_t			g_rmii_trace[RMII_TRACE_RING];
+volatile int				g_rmii_trace_on = 1;
+
+static uint32_t				s_trace_dur[RMII_TRACE_RING * RMII_TRACE_LEN / 2];	// scratch of report
+
+static int trace_stop()	// return previous state
+{	int			on = g_rmii_trace_on;
+	uint32_t	start = rmii_hal_time_us();
+
+	g_rmii_trace_on = 0;
+	while (rmii_hal_time_us() - start < 100)	{	rmii_hal_idle();	}
+	rmii_hal_barrier();
+	return on;
+}
+
+void netif_rmii_ethernet_trace_on(int on)
+{	trace_stop();
+	if (on)
+	{	for (int i = 0; i < RMII_TRACE_RING; i++)	{	g_rmii_trace[i].head = 0;	}
+		rmii_hal_barrier();
+		g_rmii_trace_on = 1;
+	}
+}
+
+void netif_rmii_ethernet_trace_report(void)
+{	int		on = trace_stop();
+
+	rmii_trace_report_all(stdout, g_rmii_trace, rmii_hal_cycles_hz(), s_trace_dur);
+	g_rmii_trace_on = on;
+}
+
+void netif_rmii_ethernet_trace_dump(void)
+{	int		on = trace_stop();
+
+	printf("TRACE BEGIN %u\n", (unsigned)rmii_hal_cycles_hz());
+	for (int i = 0; i < RMII_TRACE_RING; i++)
+	{	rmii_trace_ring_t	*r = &g_rmii_trace[i];
+		uint32_t			n = (r->head < RMII_TRACE_LEN) ? r->head : RMII_TRACE_LEN;
+
+		printf("TRACE RING %d %s %u\n", i, rmii_trace_ring_name(i), (unsigned)n);
+		for (uint32_t k = r->head - n; k != r->head; k++)
+		{	printf("%08x %08x\n", (unsigned)r->rec[k & (RMII_TRACE_LEN-1)].us, (unsigned)r->rec[k & (RMII_TRACE_LEN-1)].ev);
+		}
+	}
+	printf("TRACE END\n");
+	g_rmii_trace_on = on;
+}
+#else
+void netif_rmii_ethernet_trace_on(int on)	{	(void)on;	}
+void netif_rmii_ethernet_trace_report(void)	{	printf("USE_RMII_TRACE is off (profile.h)\n");	}
+void netif_rmii_ethernet_trace_dump(void)	{	printf("USE_RMII_TRACE is off (profile.h)\n");	}
+#endif
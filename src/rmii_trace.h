@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Hot path trace record & decoder, shared by rmii_trace.c (target) and host/trace_json.c
+
+	- a ring per writer context (RX ISR, RX FCS check, LwIP context), so a record is never written by 2 contexts
+	- record : usec timer (all cores) + 24 bit CPU cycle counter of writing core (SysTick, 8ns at 125MHz)
+	  time between 2 records of a ring = cycle delta, wraps of 24 bit counter are resolved by usec delta
+	- begin/end records of same event nest per ring, instant records mark a point (DMA restart)
+*/
+
+#ifndef __RMII_TRACE_H__
+#define __RMII_TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RMII_TRACE_LEN			512				// records per ring, power of 2
+
+enum // ring, writer context
+{	RMII_TRACE_ISR = 0,
+	RMII_TRACE_RX,
+	RMII_TRACE_LWIP,
+	RMII_TRACE_RING,
+};
+
+enum // event id, names are written to dump (rmii_trace.c)
+{	TR_RX_ISR = 0,								// end-of-frame ISR of RX SM
+	TR_RX_DMA,									// RX DMA restarted for next frame (instant)
+	TR_RX_CRC,									// FCS checked by software
+	TR_RX_PBUF,									// pbuf for received frame, lent or copied
+	TR_RX_INPUT,								// netif->input() (LwIP)
+	TR_RX_BATCH,								// frames drained by a netif_rmii_ethernet_poll()
+	TR_TX,										// netif_rmii_ethernet_output()
+	TR_TX_CRC,									// DMA descriptors & FCS of TX frame
+	TR_EVENT,
+};
+
+#define TR_INSTANT				(0u << 30)
+#define TR_BEGIN				(1u << 30)
+#define TR_END					(2u << 30)
+
+typedef struct
+{	uint32_t				us;					// rmii_hal_time_us()
+	uint32_t				ev;					// phase(31:30) | id(29:24) | cycles(23:0)
+} rmii_trace_rec_t;
+
+typedef struct
+{	uint32_t				head;				// records written, index = head % RMII_TRACE_LEN
+	rmii_trace_rec_t		rec[RMII_TRACE_LEN];
+} rmii_trace_ring_t;
+
+#define rmii_trace_id(ev)		(((ev) >> 24) & 0x3f)
+#define rmii_trace_phase(ev)	((ev) & (3u << 30))
+
+static inline const char* rmii_trace_event_name(int id)
+{	static const char* const	name[TR_EVENT] =
+	{	"RX_ISR", "RX_DMA", "RX_CRC", "RX_PBUF", "RX_INPUT", "RX_BATCH", "TX", "TX_CRC"	};
+
+	return (id < TR_EVENT) ? name[id] : "?";
+}
+
+static inline const char* rmii_trace_ring_name(int ring)
+{	static const char* const	name[RMII_TRACE_RING] =	{	"ISR", "RX", "LWIP"	};
+
+	return (ring < RMII_TRACE_RING) ? name[ring] : "?";
+}
+
+static inline int rmii_trace_span_from(int id)	// span of an instant event starts at begin of this event
+{	return (id == TR_RX_DMA) ? TR_RX_ISR : id;
+}
+
+static inline uint32_t rmii_trace_cycles(const rmii_trace_rec_t *a, const rmii_trace_rec_t *b, uint32_t hz)	// a -> b of a ring
+{	uint32_t	cyc = (b->ev - a->ev) & 0x00ffffff;
+	uint64_t	expect = (uint64_t)(b->us - a->us) * hz / 1000000;
+
+	if (expect > cyc + 0x00800000)	{	cyc += (uint32_t)(((expect - cyc + 0x00800000) >> 24) << 24);	}	// wrapped
+	return cyc;
+}
+
+static inline int rmii_trace_cmp(const void *a, const void *b)
+{	uint32_t	x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+// nsec of each span of event 'id' in a ring : begin ~ end, or begin of rmii_trace_span_from() ~ instant
+static inline int rmii_trace_span(const rmii_trace_ring_t *r, int id, uint32_t hz, uint32_t *dur, int max)
+{	uint32_t				n = (r->head < RMII_TRACE_LEN) ? r->head : RMII_TRACE_LEN;
+	int						from = rmii_trace_span_from(id);
+	uint32_t				stop = (id == from) ? TR_END : TR_INSTANT;
+	const rmii_trace_rec_t	*begin = NULL;
+	int						cnt = 0;
+
+	for (uint32_t i = r->head - n; i != r->head && cnt < max; i++)
+	{	const rmii_trace_rec_t	*rec = &r->rec[i & (RMII_TRACE_LEN-1)];
+		uint32_t				eid = rmii_trace_id(rec->ev), phase = rmii_trace_phase(rec->ev);
+
+		if (eid == (uint32_t)from && phase == TR_BEGIN)
+		{	begin = rec;
+		}
+		else if (eid == (uint32_t)id && phase == stop && begin != NULL)
+		{	dur[cnt++] = (uint32_t)((uint64_t)rmii_trace_cycles(begin, rec, hz) * 1000000000 / hz);
+			if (id == from)	{	begin = NULL;	}
+		}
+	}
+	return cnt;
+}
+
+// percentiles & histogram of durations (nsec), dur[] is sorted in place
+static inline void rmii_trace_report(FILE *out, const char *name, uint32_t *dur, int n)
+{	uint32_t	hist[9] = {0};					// < 250, 500, 1000, ... 32000 nsec, more
+
+	if (n == 0)	{	return;	}
+	qsort(dur, n, sizeof(dur[0]), rmii_trace_cmp);
+	for (int i = 0; i < n; i++)
+	{	int		b = 0;
+
+		while (b < 8 && dur[i] >= (250u << b))	{	b++;	}
+		hist[b]++;
+	}
+
+	fprintf(out, "%-9s N %5d NS P50/P90/P99/MAX %6u %6u %6u %6u HIST", name, n,
+		(unsigned)dur[n / 2], (unsigned)dur[n * 9 / 10], (unsigned)dur[n * 99 / 100], (unsigned)dur[n - 1]);
+	for (int i = 0; i < 9; i++)	{	fprintf(out, " %u", (unsigned)hist[i]);	}
+	fputc('\n', out);
+}
+
+// report every event over all rings, dur[] is scratch of RMII_TRACE_RING * RMII_TRACE_LEN / 2 (a span takes 2 records)
+static inline void rmii_trace_report_all(FILE *out, const rmii_trace_ring_t *ring, uint32_t hz, uint32_t *dur)
+{	for (int id = 0; id < TR_EVENT; id++)
+	{	int		n = 0;
+
+		for (int i = 0; i < RMII_TRACE_RING; i++)
+		{	n += rmii_trace_span(&ring[i], id, hz, dur + n, RMII_TRACE_RING * RMII_TRACE_LEN / 2 - n);
+		}
+		rmii_trace_report(out, rmii_trace_event_name(id), dur, n);
+	}
+}
+
+#endif // __RMII_TRACE_H__
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Packed RX arena, frames are stored back-to-back by their actual length
+
+	- length is unknown until end-of-frame, so rx_arena_reserve() takes the whole free run (>= max frame)
+	  for DMA and rx_arena_commit() trims it to the received length, the remainder stays free
+	- one arena per RX SM : SMs are armed in advance, a shared arena would leave a max-frame gap
+	  between the frames of each SM
+	- blocks tile the arena (boundary tags), released out of order by marking the block free,
+	  adjacent free blocks are merged by the producer when searching
+	- single producer (ISR) changes block sizes, consumer only sets 'state' of an owned block to RX_ARENA_FREE
+	- up to RX_ARENA_CONSUMER consumers may release (e.g. one per core), each counts in its own free_xxx[]
+	  so no counter is written by two cores (Cortex-M0+ has no atomic read-modify-write)
+*/
+
+#ifndef __RX_ARENA_H__
+#define __RX_ARENA_H__
+
+#include <stdint.h>
+
+#define RX_ARENA_FREE			0				// rx_arena_blk_t.state, other values are defined by user
+#define RX_ARENA_ALIGN(x)		(((x) + 3) & ~3u)
+#define RX_ARENA_CONSUMER		2				// releasing contexts, index of rx_arena_release()
+
+typedef struct
+{	uint16_t				size;				// block size including this header, multiple of 4 (arena <= 64KB)
+	volatile uint8_t		state;				// RX_ARENA_FREE or user defined
+	uint8_t					user;				// free to use by owner
+} rx_arena_blk_t;
+
+typedef struct
+{	uint8_t*				base;
+	uint32_t				size;
+	uint32_t				rover;				// offset to search next free run, end of last committed block
+	uint32_t				last;				// size of last committed block, to place next reservation
+
+	// statistics, alloc_xxx by producer, free_xxx[n] by consumer n only (used = alloc - sum of free)
+	uint32_t				alloc_bytes, alloc_cnt;
+	volatile uint32_t		free_bytes[RX_ARENA_CONSUMER], free_cnt[RX_ARENA_CONSUMER];
+	uint32_t				use_max;			// max bytes used by committed blocks
+	uint32_t				frm_max;			// max committed blocks
+	uint32_t				frag;				// reserve failed while total free bytes were enough (fragmentation)
+} rx_arena_t;
+
+static inline void rx_arena_init(rx_arena_t *a, void *base, uint32_t size)
+{	rx_arena_blk_t	*blk = (rx_arena_blk_t*)base;
+
+	a->base = (uint8_t*)base;
+	a->size = size & ~3u;
+	a->rover = a->last = 0;
+	a->alloc_bytes = a->alloc_cnt = 0;
+	for (int i = 0; i < RX_ARENA_CONSUMER; i++)	{	a->free_bytes[i] = a->free_cnt[i] = 0;	}
+	a->use_max = a->frm_max = a->frag = 0;
+
+	blk->size = a->size;
+	blk->state = RX_ARENA_FREE;
+}
+
+static inline uint32_t rx_arena_used(const rx_arena_t *a)
+{	uint32_t	used = a->alloc_bytes;
+
+	for (int i = 0; i < RX_ARENA_CONSUMER; i++)	{	used -= a->free_bytes[i];	}
+	return used;
+}
+
+static inline uint32_t rx_arena_frames(const rx_arena_t *a)
+{	uint32_t	frm = a->alloc_cnt;
+
+	for (int i = 0; i < RX_ARENA_CONSUMER; i++)	{	frm -= a->free_cnt[i];	}
+	return frm;
+}
+
+// producer : return a free run of at least 'need' bytes, caller must change its state before next call
+static inline rx_arena_blk_t* rx_arena_reserve(rx_arena_t *a, uint32_t need)
+{	uint32_t	pos = a->rover;
+	uint32_t	scanned = 0;
+
+	need = RX_ARENA_ALIGN(need);
+
+	while (scanned < a->size)
+	{	rx_arena_blk_t	*blk = (rx_arena_blk_t*)(a->base + pos);
+
+		if (blk->state == RX_ARENA_FREE)
+		{	// merge following free blocks, a released block is never touched by its old owner
+			while (pos + blk->size < a->size)
+			{	rx_arena_blk_t	*nxt = (rx_arena_blk_t*)(a->base + pos + blk->size);
+
+				if (nxt->state != RX_ARENA_FREE)	{	break;	}
+				blk->size += nxt->size;
+			}
+			if (blk->size >= need)
+			{	// run is too short to pack the next frame (expect same size as last one) after this one,
+				// reserve at its end so the remainder joins free space before it
+				if (blk->size - need < a->last)
+				{	uint32_t	head = blk->size - need;
+
+					if (head != 0)
+					{	blk->size = head;
+						pos += head;
+						blk = (rx_arena_blk_t*)(a->base + pos);
+						blk->size = need;
+					}
+				}
+				a->rover = pos;
+				return blk;
+			}
+		}
+		scanned += blk->size;
+		pos += blk->size;
+		if (pos >= a->size)	{	pos = 0;	}
+	}
+
+	if (a->size - rx_arena_used(a) >= need)	{	a->frag++;	}
+	a->rover = 0;						// old rover may be merged into a free run, offset 0 is always a block
+	return NULL;
+}
+
+// producer : trim reserved block to 'used' bytes (header included), remainder becomes a free block
+static inline void rx_arena_commit(rx_arena_t *a, rx_arena_blk_t *blk, uint32_t used)
+{	uint32_t	pos = (uint8_t*)blk - a->base;
+
+	used = RX_ARENA_ALIGN(used);
+	if (used < blk->size)
+	{	rx_arena_blk_t	*rest = (rx_arena_blk_t*)((uint8_t*)blk + used);
+
+		rest->size = blk->size - used;
+		rest->state = RX_ARENA_FREE;
+		blk->size = used;
+	}
+	a->rover = (pos + blk->size < a->size) ? pos + blk->size : 0;
+	a->last = blk->size;
+
+	a->alloc_bytes += blk->size;
+	a->alloc_cnt++;
+
+	uint32_t	use = rx_arena_used(a), frm = rx_arena_frames(a);
+	if (use > a->use_max)	{	a->use_max = use;	}
+	if (frm > a->frm_max)	{	a->frm_max = frm;	}
+}
+
+// consumer 'who' : return committed block, caller must finish reading data before (memory barrier)
+static inline void rx_arena_release(rx_arena_t *a, rx_arena_blk_t *blk, int who)
+{	a->free_bytes[who] += blk->size;
+	a->free_cnt[who]++;
+	blk->state = RX_ARENA_FREE;
+}
+
+#endif // __RX_ARENA_H__
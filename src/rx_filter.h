@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Destination MAC filter, checked by RX ISR before a frame is queued (no FCS check, no pbuf for dropped frames)
+
+	- unicast : exact match table, own MAC + added by netif_rmii_ethernet_mac_filter()
+	- multicast : 64 bins hashed from destination MAC, each bin counts groups joined by LwIP
+	  (igmp_mac_filter / mld_mac_filter callbacks), a bin may pass other groups, LwIP drops them
+	- broadcast : always passed
+
+	Table is changed in LwIP context & read by ISR without lock, a frame may be dropped while an entry changes
+*/
+
+#ifndef __RX_FILTER_H__
+#define __RX_FILTER_H__
+
+#include <stdint.h>
+
+#define RX_FILTER_UC_NUM		4					// exact match unicast entries, own MAC included
+
+enum // result of rx_filter_check(), index of drop counter
+{	RX_FILTER_PASS = 0,
+	RX_FILTER_RUNT,								// shorter than MAC header
+	RX_FILTER_UC,								// unicast to other host
+	RX_FILTER_MC,								// multicast of group not joined
+	RX_FILTER_REASON,
+};
+
+typedef struct
+{	uint8_t					uc[RX_FILTER_UC_NUM][6];
+	volatile int			uc_num;
+	volatile uint32_t		mc_hash[2];			// bit per bin, read by ISR
+	uint8_t					mc_ref[64];			// groups per bin
+} rx_filter_t;
+
+static inline void rx_filter_init(rx_filter_t *f)
+{	f->uc_num = 0;
+	f->mc_hash[0] = f->mc_hash[1] = 0;
+	for (int i = 0; i < 64; i++)	{	f->mc_ref[i] = 0;	}
+}
+
+static inline uint32_t rx_filter_hash(const uint8_t *mac)	// fold to 6 bits, no CRC table in flash from ISR
+{	uint32_t	h = mac[0] ^ mac[1] ^ mac[2] ^ mac[3] ^ mac[4] ^ mac[5];
+
+	return (h ^ (h >> 6)) & 63;
+}
+
+static inline int rx_filter_mac_eq(const uint8_t *a, const uint8_t *b)
+{	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3] && a[4] == b[4] && a[5] == b[5];
+}
+
+// ISR, return RX_FILTER_PASS or reason to drop
+static inline int rx_filter_check(const rx_filter_t *f, const uint8_t *data, uint32_t len)
+{	if (len < 14)	{	return RX_FILTER_RUNT;	}
+
+	if (data[0] & 0x01)	// group address
+	{	if ((data[0] & data[1] & data[2] & data[3] & data[4] & data[5]) == 0xff)	{	return RX_FILTER_PASS;	}
+
+		uint32_t	bin = rx_filter_hash(data);
+
+		return (f->mc_hash[bin >> 5] & (1u << (bin & 31))) ? RX_FILTER_PASS : RX_FILTER_MC;
+	}
+
+	for (int i = 0; i < f->uc_num; i++)
+	{	if (rx_filter_mac_eq(data, f->uc[i]))	{	return RX_FILTER_PASS;	}
+	}
+	return RX_FILTER_UC;
+}
+
+// add or delete exact match unicast, return 0 if table is full or not found
+static inline int rx_filter_uc(rx_filter_t *f, const uint8_t *mac, int add)
+{	int		n = f->uc_num;
+
+	for (int i = 0; i < n; i++)
+	{	if (rx_filter_mac_eq(mac, f->uc[i]))
+		{	if (!add)	// move last entry here
+			{	for (int k = 0; k < 6; k++)	{	f->uc[i][k] = f->uc[n-1][k];	}
+				f->uc_num = n - 1;
+			}
+			return 1;
+		}
+	}
+	if (!add || n >= RX_FILTER_UC_NUM)	{	return 0;	}
+
+	for (int k = 0; k < 6; k++)	{	f->uc[n][k] = mac[k];	}
+	__atomic_store_n(&f->uc_num, n + 1, __ATOMIC_RELEASE);	// entry is written before ISR sees it
+	return 1;
+}
+
+// join or leave multicast group, counted per bin
+static inline void rx_filter_mc(rx_filter_t *f, const uint8_t *mac, int add)
+{	uint32_t	bin = rx_filter_hash(mac);
+
+	if (add)
+	{	if (f->mc_ref[bin]++ == 0)							{	f->mc_hash[bin >> 5] |= (1u << (bin & 31));	}
+	}
+	else if (f->mc_ref[bin] != 0 && --f->mc_ref[bin] == 0)	{	f->mc_hash[bin >> 5] &= ~(1u << (bin & 31));	}
+}
+
+#endif // __RX_FILTER_H__
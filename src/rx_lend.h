@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	RX frames lent to LwIP as custom pbufs, limit of src/rmii_ethernet.c
+
+	- a received frame is lent (no copy) while units held by LwIP stay within 'max', otherwise it is copied
+	  to PBUF_POOL and its slot goes back to RX SM at once, so frames LwIP keeps for long (TCP out-of-order
+	  queue) never take the slots RX SM/DMA need
+	- unit is a slot (fixed RX slots) or bytes of the block (USE_RX_ARENA), one rx_lend_t per pool
+	- rx_lend_take() & rx_lend_back() (custom free) run in LwIP context only, no lock
+*/
+
+#ifndef __RX_LEND_H__
+#define __RX_LEND_H__
+
+#include <stdint.h>
+
+typedef struct
+{	uint32_t				held;				// units lent to LwIP
+	uint32_t				max;				// units lent at most
+} rx_lend_t;
+
+static inline void rx_lend_init(rx_lend_t *l, uint32_t max)
+{	l->held = 0;
+	l->max = max;
+}
+
+// LwIP context : 1 = lend the frame, 0 = copy it & release the slot
+static inline int rx_lend_take(rx_lend_t *l, uint32_t unit)
+{	if (l->held + unit > l->max)	{	return 0;	}
+	l->held += unit;
+	return 1;
+}
+
+// LwIP context : lent frame is freed by LwIP
+static inline void rx_lend_back(rx_lend_t *l, uint32_t unit)
+{	l->held -= unit;
+}
+
+#endif // __RX_LEND_H__
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	RX priority classes & admission headroom (rmii_ethernet/prio.h), checked by RX ISR after rx_filter_check()
+
+	- rules are changed in LwIP context & read by ISR without lock, a frame may be classified by old rules while they change
+	- need_xxx[N] = sum of reserves of classes above N, room a frame of class N leaves free
+*/
+
+#ifndef __RX_PRIO_H__
+#define __RX_PRIO_H__
+
+#include <stdint.h>
+
+#include "rmii_ethernet/prio.h"
+
+#define RX_PRIO_TOP				(RMII_PRIO_CLASS - 1)
+
+typedef struct
+{	rmii_prio_rule_t		rule[RMII_PRIO_RULE_NUM];
+	volatile int			rule_num;			// 0 = admission off
+	uint8_t					reserve_ring[RMII_PRIO_CLASS];
+	uint8_t					reserve_slot[RMII_PRIO_CLASS];
+	volatile uint8_t		need_ring[RMII_PRIO_CLASS];
+	volatile uint8_t		need_slot[RMII_PRIO_CLASS];
+} rx_prio_t;
+
+static inline void rx_prio_need(rx_prio_t *p)	// sum reserves of classes above each class
+{	uint32_t	ring = 0, slot = 0;
+
+	for (int i = RX_PRIO_TOP; i >= 0; i--)
+	{	p->need_ring[i] = (ring < 255) ? ring : 255;
+		p->need_slot[i] = (slot < 255) ? slot : 255;
+		ring += p->reserve_ring[i];
+		slot += p->reserve_slot[i];
+	}
+}
+
+static inline void rx_prio_init(rx_prio_t *p)
+{	p->rule_num = 0;
+	for (int i = 0; i < RMII_PRIO_CLASS; i++)	{	p->reserve_ring[i] = p->reserve_slot[i] = 0;	}
+	rx_prio_need(p);
+}
+
+// replace rules, return 0 if too many or class is out of range
+static inline int rx_prio_rule(rx_prio_t *p, const rmii_prio_rule_t *rule, int num)
+{	if (num < 0 || num > RMII_PRIO_RULE_NUM)	{	return 0;	}
+	for (int i = 0; i < num; i++)
+	{	if (rule[i].cls == 0 || rule[i].cls > RX_PRIO_TOP)	{	return 0;	}
+	}
+
+	p->rule_num = 0;
+	for (int i = 0; i < num; i++)	{	p->rule[i] = rule[i];	}
+	__atomic_store_n(&p->rule_num, num, __ATOMIC_RELEASE);	// rules are written before ISR sees them
+	return 1;
+}
+
+static inline void rx_prio_reserve(rx_prio_t *p, int cls, int ring, int slot)
+{	if (cls <= 0 || cls > RX_PRIO_TOP)	{	return;	}
+
+	p->reserve_ring[cls] = (ring < 0) ? 0 : (ring > 255) ? 255 : ring;
+	p->reserve_slot[cls] = (slot < 0) ? 0 : (slot > 255) ? 255 : slot;
+	rx_prio_need(p);
+}
+
+// ISR, class of a frame passed by rx_filter_check() (len >= 14), 'len' includes FCS
+static inline int rx_prio_class(const rx_prio_t *p, const uint8_t *data, uint32_t len)
+{	int			num = __atomic_load_n(&p->rule_num, __ATOMIC_ACQUIRE);
+	uint32_t	type = (data[12] << 8) | data[13], tci = 0, skip = 0;
+
+	if (num == 0)	{	return 0;	}
+
+	if ((type == 0x8100 || type == 0x88a8) && len >= 18)	// 802.1Q / 802.1ad, outer tag only
+	{	tci = (data[14] << 8) | data[15];
+		type = (data[16] << 8) | data[17];
+		skip = 4;
+	}
+
+	for (int i = 0; i < num; i++)
+	{	const rmii_prio_rule_t	*r = &p->rule[i];
+
+		if (r->max_len != 0 && len > r->max_len)	{	continue;	}
+
+		if (r->kind == RMII_PRIO_PCP)
+		{	if (skip != 0 && (tci >> 13) >= r->val)	{	return r->cls;	}
+		}
+		else if (r->kind == RMII_PRIO_TYPE)
+		{	if (type == r->val)	{	return r->cls;	}
+		}
+		else if (r->kind == RMII_PRIO_MATCH)
+		{	uint32_t		off = r->off + ((r->off >= 12) ? skip : 0);
+			const uint8_t	*d = data + off;
+
+			if (off + 4 <= len &&
+				((((uint32_t)d[0] << 24) | (d[1] << 16) | (d[2] << 8) | d[3]) & r->mask) == r->val)	{	return r->cls;	}
+		}
+	}
+	return 0;
+}
+
+// ISR, 1 if a frame of 'cls' may be queued, 'ring' = free ready ring entries, 'slot' = free RX slots before its SM is re-armed
+// a macro, 'slot' is evaluated only when needed (cost of counting slots)
+#define rx_prio_admit(p, cls, ring, slot)																\
+	((cls) == RX_PRIO_TOP || (p)->rule_num == 0 ||														\
+	 ((ring) > (p)->need_ring[cls] && (p)->need_slot[cls] <= (slot)))
+
+#endif // __RX_PRIO_H__
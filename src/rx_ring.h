@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 zsdotkr@gmail.com
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+	Single producer (ISR) / single consumer (poll loop) ring of pointers, no lock
+
+	- 'head' is written by producer only, 'rear' by consumer only, each side reads the other with acquire
+	  and publishes its own with release, so a slot is filled before it is seen & read before it is reused
+	- one slot is kept empty : empty = (head == rear), full = (next of head == rear), both exact
+	- ring does not wake the consumer, producer calls rmii_hal_rx_signal() after rx_ring_put()
+*/
+
+#ifndef __RX_RING_H__
+#define __RX_RING_H__
+
+#include <stdint.h>
+
+typedef struct
+{	void* volatile*			slot;
+	uint32_t				size;				// slots, holds size-1 entries
+	volatile uint32_t		head;				// next slot to put, producer
+	volatile uint32_t		rear;				// next slot to get, consumer
+} rx_ring_t;
+
+#define rx_ring_load(p)			__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define rx_ring_store(p, v)		__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static inline void rx_ring_init(rx_ring_t *r, void* volatile *slot, uint32_t size)
+{	r->slot = slot;
+	r->size = size;
+	r->head = r->rear = 0;
+}
+
+static inline uint32_t rx_ring_next(const rx_ring_t *r, uint32_t x)	{	return (x != (r->size - 1)) ? x + 1 : 0;	}
+
+// producer : return 0 if full
+static inline int rx_ring_put(rx_ring_t *r, void *p)
+{	uint32_t	head = r->head;
+	uint32_t	next = rx_ring_next(r, head);
+
+	if (next == rx_ring_load(&r->rear))	{	return 0;	}
+
+	r->slot[head] = p;
+	rx_ring_store(&r->head, next);		// publish slot (and what p points to) to consumer
+	return 1;
+}
+
+// consumer : return NULL if empty
+static inline void* rx_ring_get(rx_ring_t *r)
+{	uint32_t	rear = r->rear;
+	void		*p;
+
+	if (rear == rx_ring_load(&r->head))	{	return NULL;	}
+
+	p = r->slot[rear];
+	rx_ring_store(&r->rear, rx_ring_next(r, rear));		// slot was read, producer may reuse it
+	return p;
+}
+
+// producer
+static inline int rx_ring_full(rx_ring_t *r)	{	return rx_ring_next(r, r->head) == rx_ring_load(&r->rear);	}
+
+// consumer
+static inline int rx_ring_empty(rx_ring_t *r)	{	return r->rear == rx_ring_load(&r->head);	}
+
+// either side, may be stale by the other side
+static inline uint32_t rx_ring_count(rx_ring_t *r)
+{	uint32_t	head = rx_ring_load(&r->head), rear = rx_ring_load(&r->rear);
+
+	return (head >= rear) ? head - rear : head + r->size - rear;
+}
+
+#endif // __RX_RING_H__